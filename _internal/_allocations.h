@@ -0,0 +1,241 @@
+// This content is part of test.h
+// Allocation tracking, enabled by defining BTR_TRACK_ALLOCATIONS before including test.h
+// The test binary replaces malloc, calloc, realloc, free and the aligned allocations, which glibc supports for the whole
+// process. Sizes are the ones requested, not the ones the allocator rounded the blocks up to
+
+typedef struct AllocationStats AllocationStats;
+
+// Counted from the start of the running test, blocks allocated before it are not part of liveBlocks or liveBytes
+struct AllocationStats
+{
+  long long allocations;
+  long long frees;
+  long long bytes;
+  long long liveBlocks;
+  long long liveBytes;
+  long long peakLiveBytes;
+};
+
+AllocationStats allocationStats = {0};
+
+#ifdef BTR_TRACK_ALLOCATIONS
+#ifndef __GLIBC__
+#error "BTR_TRACK_ALLOCATIONS is only supported with glibc"
+#endif
+#include <malloc.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define assert_allocations(expression, maxAllocations) do{\
+    long long _allocationsBefore = allocationStats.allocations;\
+    expression;\
+    _assert(_C_STRING_LITERAL(__FILE__), __LINE__, allocationStats.allocations - _allocationsBefore <= (maxAllocations),\
+      _C_STRING_LITERAL("at most " #maxAllocations " allocations in " #expression));\
+  }while(0)
+#define assert_no_allocations(expression) assert_allocations(expression, 0)
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* block, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* block);
+
+// The size the block was requested with, as the allocator may round it up
+typedef struct
+{
+  void* block;
+  size_t size;
+} _AllocationEntry;
+
+// Open addressing set of the blocks allocated by the running test
+typedef struct
+{
+  _AllocationEntry* entries;
+  size_t capacity;
+  size_t count;
+} _AllocationSet;
+
+_AllocationSet _testAllocations;
+bool _allocationTracking = false;
+int _allocationLock = 0;
+char* _allocationTestContext;
+char* _allocationTestDescription;
+char _stdoutBuffer[BUFSIZ];
+
+size_t _allocationSlot(_AllocationSet* set, void* block)
+{
+  size_t slot = ((uintptr_t)block >> 4)*0x9E3779B97F4A7C15ULL & (set->capacity - 1);
+  while(set->entries[slot].block && set->entries[slot].block != block)
+    slot = (slot + 1) & (set->capacity - 1);
+  return slot;
+}
+
+void _allocationSetAdd(_AllocationSet* set, void* block, size_t size)
+{
+  if((set->count + 1)*2 > set->capacity)
+  {
+    size_t capacity = set->capacity ? set->capacity*2 : 1024;
+    _AllocationSet grown = {(_AllocationEntry*)__libc_calloc(capacity, sizeof(_AllocationEntry)), capacity, set->count};
+    if(!grown.entries) return;
+    for(size_t i = 0; i < set->capacity; i++)
+      if(set->entries[i].block) grown.entries[_allocationSlot(&grown, set->entries[i].block)] = set->entries[i];
+    __libc_free(set->entries);
+    *set = grown;
+  }
+  size_t slot = _allocationSlot(set, block);
+  if(!set->entries[slot].block) set->count++;
+  set->entries[slot].block = block;
+  set->entries[slot].size = size;
+}
+
+// Gives the size the block was allocated with, or -1 when it is not in the set
+long long _allocationSetRemove(_AllocationSet* set, void* block)
+{
+  if(!set->count) return -1;
+  size_t slot = _allocationSlot(set, block);
+  if(!set->entries[slot].block) return -1;
+  long long size = set->entries[slot].size;
+  set->entries[slot].block = 0;
+  set->count--;
+  // Moves back the entries of the same probe sequence so lookups do not stop at the hole
+  for(size_t next = (slot + 1) & (set->capacity - 1); set->entries[next].block; next = (next + 1) & (set->capacity - 1))
+  {
+    _AllocationEntry moved = set->entries[next];
+    set->entries[next].block = 0;
+    set->entries[_allocationSlot(set, moved.block)] = moved;
+  }
+  return size;
+}
+
+bool _shouldTrackAllocation()
+{
+  return _allocationTracking && !_untrackedAllocations;
+}
+
+void _trackAllocation(void* block, size_t size)
+{
+  if(!block || !_shouldTrackAllocation()) return;
+  while(__sync_lock_test_and_set(&_allocationLock, 1));
+  _allocationSetAdd(&_testAllocations, block, size);
+  allocationStats.allocations++;
+  allocationStats.bytes += size;
+  allocationStats.liveBlocks++;
+  allocationStats.liveBytes += size;
+  if(allocationStats.liveBytes > allocationStats.peakLiveBytes) allocationStats.peakLiveBytes = allocationStats.liveBytes;
+  __sync_lock_release(&_allocationLock);
+}
+
+// Gives the size the freed block was allocated with, or -1 when the test did not allocate it
+long long _trackFree(void* block)
+{
+  if(!block || !_shouldTrackAllocation()) return -1;
+  while(__sync_lock_test_and_set(&_allocationLock, 1));
+  allocationStats.frees++;
+  long long size = _allocationSetRemove(&_testAllocations, block);
+  if(size >= 0)
+  {
+    allocationStats.liveBlocks--;
+    allocationStats.liveBytes -= size;
+  }
+  __sync_lock_release(&_allocationLock);
+  return size;
+}
+
+// Undoes _trackFree for a block that is still allocated
+void _untrackFree(void* block, long long size)
+{
+  if(!block || !_shouldTrackAllocation()) return;
+  while(__sync_lock_test_and_set(&_allocationLock, 1));
+  allocationStats.frees--;
+  if(size >= 0)
+  {
+    _allocationSetAdd(&_testAllocations, block, size);
+    allocationStats.liveBlocks++;
+    allocationStats.liveBytes += size;
+  }
+  __sync_lock_release(&_allocationLock);
+}
+
+void* malloc(size_t size) _BTR_NOTHROW
+{
+  void* block = __libc_malloc(size);
+  _trackAllocation(block, size);
+  return block;
+}
+
+void* calloc(size_t count, size_t size) _BTR_NOTHROW
+{
+  void* block = __libc_calloc(count, size);
+  _trackAllocation(block, count*size);
+  return block;
+}
+
+void* realloc(void* block, size_t size) _BTR_NOTHROW
+{
+  // Untracked first, as once moved another thread may be given the same address
+  long long previousSize = _trackFree(block);
+  void* moved = __libc_realloc(block, size);
+  // A failed realloc leaves the block allocated
+  if(moved || !size) _trackAllocation(moved, size);
+  else _untrackFree(block, previousSize);
+  return moved;
+}
+
+void* memalign(size_t alignment, size_t size) _BTR_NOTHROW
+{
+  void* block = __libc_memalign(alignment, size);
+  _trackAllocation(block, size);
+  return block;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) _BTR_NOTHROW
+{
+  return memalign(alignment, size);
+}
+
+int posix_memalign(void** output, size_t alignment, size_t size) _BTR_NOTHROW
+{
+  if(!alignment || alignment % sizeof(void*) || (alignment & (alignment - 1))) return EINVAL;
+  void* block = memalign(alignment, size);
+  if(!block) return ENOMEM;
+  *output = block;
+  return 0;
+}
+
+void free(void* block) _BTR_NOTHROW
+{
+  _trackFree(block);
+  __libc_free(block);
+}
+
+// Reports the blocks the test allocated and never freed
+void _writeLeakReport()
+{
+  _allocationTracking = false;
+  if(allocationStats.liveBlocks > 0)
+    printf("\n[LEAK] on \"%s\" test \"%s\" %lli blocks (%lli bytes) were not freed\n", _allocationTestContext,
+      _allocationTestDescription, allocationStats.liveBlocks, allocationStats.liveBytes);
+}
+
+void _startAllocationTracking(char* context, char* description)
+{
+  _allocationTestContext = context;
+  _allocationTestDescription = description;
+  static bool reportRegistered = false;
+  if(!reportRegistered)
+  {
+    reportRegistered = true;
+    atexit(_writeLeakReport);
+    // Otherwise stdio allocates its buffer on the first output of the test, which is never freed
+    setvbuf(stdout, _stdoutBuffer, isatty(fileno(stdout)) ? _IOLBF : _IOFBF, sizeof(_stdoutBuffer));
+  }
+  while(__sync_lock_test_and_set(&_allocationLock, 1));
+  memset(&allocationStats, 0, sizeof(allocationStats));
+  if(_testAllocations.entries) memset(_testAllocations.entries, 0, _testAllocations.capacity*sizeof(_AllocationEntry));
+  _testAllocations.count = 0;
+  _allocationTracking = true;
+  __sync_lock_release(&_allocationLock);
+}
+#else
+void _startAllocationTracking(char* context, char* description){}
+#endif
@@ -0,0 +1,637 @@
+// This content is part of test.h
+// DWARF debug info, used for deriving mock descriptors from the objects of a static lib
+// Based on https://dwarfstd.org/doc/DWARF5.pdf
+
+typedef struct _DebugInfo _DebugInfo;
+typedef struct _DebugInfoReader _DebugInfoReader;
+typedef struct _DebugInfoUnit _DebugInfoUnit;
+typedef struct _DebugInfoAbbrev _DebugInfoAbbrev;
+typedef struct _DebugInfoEntry _DebugInfoEntry;
+typedef struct _DebugInfoFunctions _DebugInfoFunctions;
+
+enum _DebugInfoTag
+{
+  _DW_TAG_ENUMERATION_TYPE = 0x04,
+  _DW_TAG_FORMAL_PARAMETER = 0x05,
+  _DW_TAG_POINTER_TYPE = 0x0f,
+  _DW_TAG_REFERENCE_TYPE = 0x10,
+  _DW_TAG_TYPEDEF = 0x16,
+  _DW_TAG_UNSPECIFIED_PARAMETERS = 0x18,
+  _DW_TAG_BASE_TYPE = 0x24,
+  _DW_TAG_CONST_TYPE = 0x26,
+  _DW_TAG_SUBPROGRAM = 0x2e,
+  _DW_TAG_VOLATILE_TYPE = 0x35,
+  _DW_TAG_RESTRICT_TYPE = 0x37,
+  _DW_TAG_RVALUE_REFERENCE_TYPE = 0x42,
+  _DW_TAG_ATOMIC_TYPE = 0x47
+};
+
+enum _DebugInfoAttribute
+{
+  _DW_AT_NAME = 0x03,
+  _DW_AT_BYTE_SIZE = 0x0b,
+  _DW_AT_LOW_PC = 0x11,
+  _DW_AT_ABSTRACT_ORIGIN = 0x31,
+  _DW_AT_DECLARATION = 0x3c,
+  _DW_AT_ENCODING = 0x3e,
+  _DW_AT_EXTERNAL = 0x3f,
+  _DW_AT_SPECIFICATION = 0x47,
+  _DW_AT_TYPE = 0x49,
+  _DW_AT_RANGES = 0x55,
+  _DW_AT_LINKAGE_NAME = 0x6e,
+  _DW_AT_MIPS_LINKAGE_NAME = 0x2007
+};
+
+enum _DebugInfoEncoding
+{
+  _DW_ATE_BOOLEAN = 0x02,
+  _DW_ATE_FLOAT = 0x04,
+  _DW_ATE_SIGNED = 0x05,
+  _DW_ATE_SIGNED_CHAR = 0x06,
+  _DW_ATE_UNSIGNED = 0x07,
+  _DW_ATE_UNSIGNED_CHAR = 0x08,
+  _DW_ATE_UTF = 0x10
+};
+
+struct _DebugInfoReader
+{
+  const unsigned char* data;
+  long long size;
+  long long position;
+  bool failed;
+};
+
+struct _DebugInfoUnit
+{
+  long long offset;
+  int version;
+  int offsetSize;
+  int addressSize;
+};
+
+struct _DebugInfoAbbrev
+{
+  unsigned long long code;
+  int tag;
+  bool hasChildren;
+  long long specPosition;
+};
+
+// Only the attributes needed for describing functions are kept, offsets are relative to .debug_info and -1 when missing
+struct _DebugInfoEntry
+{
+  long long offset;
+  int tag;
+  int depth;
+  const char* name;
+  const char* linkageName;
+  long long type;
+  long long specification;
+  long long abstractOrigin;
+  long long encoding;
+  long long byteSize;
+  bool external;
+  bool declaration;
+  bool hasCode;
+};
+
+struct _DebugInfo
+{
+  _DebugInfoReader info;
+  _DebugInfoReader abbrev;
+  _DebugInfoReader strings;
+  _DebugInfoReader lineStrings;
+  unsigned char* relocated;
+  _DebugInfoEntry* entries;
+  int entryCount;
+  int entryCapacity;
+};
+
+struct _DebugInfoFunctions
+{
+  FunctionDescriptor* items;
+  int count;
+  int capacity;
+};
+
+unsigned long long _debugInfoRead(_DebugInfoReader* reader, int size)
+{
+  if(size < 0 || reader->position + size > reader->size)
+  {
+    reader->failed = true;
+    reader->position = reader->size;
+    return 0;
+  }
+  unsigned long long value = 0;
+  for(int i = 0; i < size && i < 8; i++)
+    value |= (unsigned long long)reader->data[reader->position + i] << (8*i);
+  reader->position += size;
+  return value;
+}
+
+unsigned long long _debugInfoReadLeb(_DebugInfoReader* reader, bool isSigned)
+{
+  unsigned long long value = 0;
+  int shift = 0;
+  unsigned char byte;
+  do
+  {
+    if(reader->position >= reader->size)
+    {
+      reader->failed = true;
+      return 0;
+    }
+    byte = reader->data[reader->position++];
+    if(shift < 64) value |= (unsigned long long)(byte & 0x7f) << shift;
+    shift += 7;
+  }
+  while(byte & 0x80);
+  if(isSigned && shift < 64 && (byte & 0x40)) value |= ~0ULL << shift;
+  return value;
+}
+
+const char* _debugInfoString(_DebugInfoReader* strings, unsigned long long offset)
+{
+  if(offset >= (unsigned long long)strings->size || !memchr(strings->data + offset, 0, strings->size - offset)) return 0;
+  return (const char*)strings->data + offset;
+}
+
+// Reads an attribute value in any form, setting string for the string forms
+unsigned long long _debugInfoReadValue(_DebugInfo* info, _DebugInfoUnit* unit, unsigned long long form, long long implicitConst, const char** string)
+{
+  _DebugInfoReader* reader = &info->info;
+  *string = 0;
+  switch(form)
+  {
+    case 0x01: return _debugInfoRead(reader, unit->addressSize);
+    case 0x03: return _debugInfoRead(reader, _debugInfoRead(reader, 2));
+    case 0x04: return _debugInfoRead(reader, _debugInfoRead(reader, 4));
+    case 0x09: case 0x18: return _debugInfoRead(reader, _debugInfoReadLeb(reader, false));
+    case 0x0a: return _debugInfoRead(reader, _debugInfoRead(reader, 1));
+    case 0x0b: case 0x0c: case 0x11: case 0x25: case 0x29: return _debugInfoRead(reader, 1);
+    case 0x05: case 0x12: case 0x26: case 0x2a: return _debugInfoRead(reader, 2);
+    case 0x27: case 0x2b: return _debugInfoRead(reader, 3);
+    case 0x06: case 0x13: case 0x1c: case 0x28: case 0x2c: return _debugInfoRead(reader, 4);
+    case 0x07: case 0x14: case 0x20: case 0x24: return _debugInfoRead(reader, 8);
+    case 0x1e: return _debugInfoRead(reader, 16);
+    case 0x0d: return _debugInfoReadLeb(reader, true);
+    case 0x0f: case 0x15: case 0x1a: case 0x1b: case 0x22: case 0x23: case 0x1f01: case 0x1f02:
+      return _debugInfoReadLeb(reader, false);
+    case 0x10: return _debugInfoRead(reader, unit->version == 2 ? unit->addressSize : unit->offsetSize);
+    case 0x17: case 0x1d: case 0x1f20: case 0x1f21: return _debugInfoRead(reader, unit->offsetSize);
+    case 0x19: return 1;
+    case 0x21: return implicitConst;
+    case 0x16: return _debugInfoReadValue(info, unit, _debugInfoReadLeb(reader, false), 0, string);
+    case 0x08:
+      *string = _debugInfoString(reader, reader->position);
+      if(!*string) reader->failed = true;
+      else reader->position += strlen(*string) + 1;
+      return 0;
+    case 0x0e: case 0x1f:
+    {
+      unsigned long long offset = _debugInfoRead(reader, unit->offsetSize);
+      *string = _debugInfoString(form == 0x0e ? &info->strings : &info->lineStrings, offset);
+      return offset;
+    }
+  }
+  reader->failed = true;
+  return 0;
+}
+
+bool _debugInfoIsUnitReference(unsigned long long form)
+{
+  return form >= 0x11 && form <= 0x15;
+}
+
+int _debugInfoReadAbbrevs(_DebugInfo* info, unsigned long long offset, _DebugInfoAbbrev** output)
+{
+  _DebugInfoReader reader = info->abbrev;
+  reader.position = offset;
+  int count = 0, capacity = 0;
+  *output = 0;
+  while(!reader.failed)
+  {
+    unsigned long long code = _debugInfoReadLeb(&reader, false);
+    if(!code) break;
+    if(count == capacity)
+    {
+      capacity = capacity*2 + 64;
+      *output = (_DebugInfoAbbrev*)realloc(*output, sizeof(_DebugInfoAbbrev)*capacity);
+    }
+    _DebugInfoAbbrev* abbrev = &(*output)[count++];
+    abbrev->code = code;
+    abbrev->tag = _debugInfoReadLeb(&reader, false);
+    abbrev->hasChildren = _debugInfoRead(&reader, 1);
+    abbrev->specPosition = reader.position;
+    while(!reader.failed)
+    {
+      unsigned long long attribute = _debugInfoReadLeb(&reader, false);
+      unsigned long long form = _debugInfoReadLeb(&reader, false);
+      if(form == 0x21) _debugInfoReadLeb(&reader, true);
+      if(!attribute && !form) break;
+    }
+  }
+  return reader.failed ? -1 : count;
+}
+
+_DebugInfoAbbrev* _debugInfoFindAbbrev(int count, _DebugInfoAbbrev* abbrevs, unsigned long long code)
+{
+  // Codes are usually numbered from 1 in order
+  if(code >= 1 && code <= (unsigned long long)count && abbrevs[code - 1].code == code) return &abbrevs[code - 1];
+  for(int i = 0; i < count; i++)
+    if(abbrevs[i].code == code) return &abbrevs[i];
+  return 0;
+}
+
+bool _debugInfoReadEntries(_DebugInfo* info, _DebugInfoUnit* unit, long long end, int abbrevCount, _DebugInfoAbbrev* abbrevs)
+{
+  _DebugInfoReader* reader = &info->info;
+  int depth = 0;
+  while(reader->position < end && !reader->failed)
+  {
+    long long offset = reader->position;
+    unsigned long long code = _debugInfoReadLeb(reader, false);
+    if(!code)
+    {
+      depth--;
+      continue;
+    }
+    _DebugInfoAbbrev* abbrev = _debugInfoFindAbbrev(abbrevCount, abbrevs, code);
+    if(!abbrev) return false;
+
+    _DebugInfoEntry entry = {offset, abbrev->tag, depth, 0, 0, -1, -1, -1, -1, -1, false, false, false};
+    _DebugInfoReader spec = info->abbrev;
+    spec.position = abbrev->specPosition;
+    while(!spec.failed && !reader->failed)
+    {
+      unsigned long long attribute = _debugInfoReadLeb(&spec, false);
+      unsigned long long form = _debugInfoReadLeb(&spec, false);
+      long long implicitConst = form == 0x21 ? (long long)_debugInfoReadLeb(&spec, true) : 0;
+      if(!attribute && !form) break;
+      const char* string;
+      long long value = _debugInfoReadValue(info, unit, form, implicitConst, &string);
+      if(_debugInfoIsUnitReference(form)) value += unit->offset;
+      switch(attribute)
+      {
+        case _DW_AT_NAME: entry.name = string; break;
+        case _DW_AT_LINKAGE_NAME: case _DW_AT_MIPS_LINKAGE_NAME: entry.linkageName = string; break;
+        case _DW_AT_TYPE: entry.type = value; break;
+        case _DW_AT_SPECIFICATION: entry.specification = value; break;
+        case _DW_AT_ABSTRACT_ORIGIN: entry.abstractOrigin = value; break;
+        case _DW_AT_ENCODING: entry.encoding = value; break;
+        case _DW_AT_BYTE_SIZE: entry.byteSize = value; break;
+        case _DW_AT_EXTERNAL: entry.external = value; break;
+        case _DW_AT_DECLARATION: entry.declaration = value; break;
+        case _DW_AT_LOW_PC: case _DW_AT_RANGES: entry.hasCode = true; break;
+      }
+    }
+    if(spec.failed) return false;
+
+    if(info->entryCount == info->entryCapacity)
+    {
+      info->entryCapacity = info->entryCapacity*2 + 256;
+      info->entries = (_DebugInfoEntry*)realloc(info->entries, sizeof(_DebugInfoEntry)*info->entryCapacity);
+    }
+    info->entries[info->entryCount++] = entry;
+    if(abbrev->hasChildren) depth++;
+  }
+  return !reader->failed;
+}
+
+// Every unit of .debug_info is read into one array of entries, sorted by offset
+bool _debugInfoReadUnits(_DebugInfo* info)
+{
+  _DebugInfoReader* reader = &info->info;
+  while(reader->position < reader->size && !reader->failed)
+  {
+    _DebugInfoUnit unit = {reader->position, 0, 4, 8};
+    long long length = _debugInfoRead(reader, 4);
+    if(length == 0xffffffff)
+    {
+      unit.offsetSize = 8;
+      length = _debugInfoRead(reader, 8);
+    }
+    long long end = reader->position + length;
+    if(reader->failed || length < 0 || end > reader->size) return false;
+
+    unit.version = _debugInfoRead(reader, 2);
+    unsigned long long abbrevOffset;
+    if(unit.version >= 5)
+    {
+      int unitType = _debugInfoRead(reader, 1);
+      unit.addressSize = _debugInfoRead(reader, 1);
+      abbrevOffset = _debugInfoRead(reader, unit.offsetSize);
+      if(unitType == 2 || unitType == 6) _debugInfoRead(reader, 8 + unit.offsetSize); // type signature and offset
+      else if(unitType == 4 || unitType == 5) _debugInfoRead(reader, 8); // dwo id
+    }
+    else
+    {
+      abbrevOffset = _debugInfoRead(reader, unit.offsetSize);
+      unit.addressSize = _debugInfoRead(reader, 1);
+    }
+    if(unit.version < 2 || unit.version > 5 || reader->failed) return false;
+
+    _DebugInfoAbbrev* abbrevs;
+    int abbrevCount = _debugInfoReadAbbrevs(info, abbrevOffset, &abbrevs);
+    bool ret = abbrevCount >= 0 && _debugInfoReadEntries(info, &unit, end, abbrevCount, abbrevs);
+    free(abbrevs);
+    if(!ret) return false;
+    reader->position = end;
+  }
+  return !reader->failed;
+}
+
+_DebugInfoEntry* _debugInfoFindEntry(_DebugInfo* info, long long offset)
+{
+  int low = 0, high = info->entryCount - 1;
+  while(low <= high)
+  {
+    int middle = (low + high)/2;
+    if(info->entries[middle].offset == offset) return &info->entries[middle];
+    if(info->entries[middle].offset < offset) low = middle + 1;
+    else high = middle - 1;
+  }
+  return 0;
+}
+
+// Relocatable objects leave offsets into other debug sections to relocations, only absolute ones are applied
+int _debugInfoRelocationSize(int machine, unsigned int type)
+{
+  if(machine == 62) return type == 1 ? 8 : (type == 10 || type == 11) ? 4 : 0; // x86-64
+  if(machine == 183) return type == 257 ? 8 : type == 258 ? 4 : 0; // AArch64
+  return 0;
+}
+
+void _debugInfoRelocate(_StaticLibFile* libFile, _ElfHeader* header, _ElfSectionHeader* sections, int infoIndex, unsigned char* content)
+{
+  long long size = sections[infoIndex].sh_size;
+  for(int i = 0; i < header->e_shnum; i++)
+  {
+    if(sections[i].sh_type != 4 || sections[i].sh_info != (uint32_t)infoIndex || sections[i].sh_link >= header->e_shnum) continue;
+    _ElfSectionHeader* symbolTable = &sections[sections[i].sh_link];
+    long long symbolCount = symbolTable->sh_size/sizeof(_ElfSymbol);
+    if(sections[i].sh_offset + sections[i].sh_size > (unsigned long long)libFile->contentSize ||
+       symbolTable->sh_offset + symbolTable->sh_size > (unsigned long long)libFile->contentSize) continue;
+    for(unsigned long long r = 0; r < sections[i].sh_size/sizeof(_ElfRela); r++)
+    {
+      _ElfRela relocation;
+      memcpy(&relocation, libFile->content + sections[i].sh_offset + sizeof(_ElfRela)*r, sizeof(_ElfRela));
+      int relocationSize = _debugInfoRelocationSize(header->e_machine, relocation.r_info & 0xffffffff);
+      long long symbolIndex = relocation.r_info >> 32;
+      if(!relocationSize || symbolIndex >= symbolCount || relocation.r_offset + relocationSize > (unsigned long long)size) continue;
+      _ElfSymbol symbol;
+      memcpy(&symbol, libFile->content + symbolTable->sh_offset + sizeof(_ElfSymbol)*symbolIndex, sizeof(_ElfSymbol));
+      unsigned long long value = symbol.st_value + relocation.r_addend;
+      for(int b = 0; b < relocationSize; b++)
+        content[relocation.r_offset + b] = (value >> (8*b)) & 0xff;
+    }
+  }
+}
+
+bool _debugInfoLoad(_DebugInfo* info, _StaticLibFile* libFile)
+{
+  memset(info, 0, sizeof(_DebugInfo));
+  _ElfHeader header;
+  if(libFile->contentSize < (long long)sizeof(_ElfHeader)) return false;
+  memcpy(&header, libFile->content, sizeof(_ElfHeader));
+  if(!_objectFileIsSupportedElf64(&header) || header.e_shstrndx >= header.e_shnum ||
+     header.e_shoff + (long long)sizeof(_ElfSectionHeader)*header.e_shnum > (unsigned long long)libFile->contentSize)
+    return false;
+
+  _ElfSectionHeader sections[header.e_shnum];
+  for(int i = 0; i < header.e_shnum; i++)
+    memcpy(&sections[i], libFile->content + header.e_shoff + sizeof(_ElfSectionHeader)*i, sizeof(_ElfSectionHeader));
+
+  const char* names[] = {".debug_info", ".debug_abbrev", ".debug_str", ".debug_line_str"};
+  _DebugInfoReader* readers[] = {&info->info, &info->abbrev, &info->strings, &info->lineStrings};
+  int infoIndex = -1;
+  _ElfSectionHeader* sectionNames = &sections[header.e_shstrndx];
+  for(int i = 0; i < header.e_shnum; i++)
+  {
+    // Compressed sections are not supported
+    if(sections[i].sh_type == 8 || (sections[i].sh_flags & 0x800) || sections[i].sh_name >= sectionNames->sh_size ||
+       sections[i].sh_offset + sections[i].sh_size > (unsigned long long)libFile->contentSize)
+      continue;
+    const char* name = _objectFileElfGetString(libFile, sectionNames, sections[i].sh_name);
+    for(int n = 0; n < 4; n++)
+      if(strcmp(name, names[n]) == 0)
+      {
+        readers[n]->data = (const unsigned char*)libFile->content + sections[i].sh_offset;
+        readers[n]->size = sections[i].sh_size;
+        if(n == 0) infoIndex = i;
+      }
+  }
+  if(infoIndex < 0 || !info->abbrev.data) return false;
+
+  info->relocated = (unsigned char*)malloc(info->info.size + 1);
+  memcpy(info->relocated, info->info.data, info->info.size);
+  _debugInfoRelocate(libFile, &header, sections, infoIndex, info->relocated);
+  info->info.data = info->relocated;
+  return _debugInfoReadUnits(info);
+}
+
+void _debugInfoFree(_DebugInfo* info)
+{
+  free(info->relocated);
+  free(info->entries);
+  memset(info, 0, sizeof(_DebugInfo));
+}
+
+const char* _debugInfoScalarName(long long encoding, long long byteSize)
+{
+  const char* signedNames[] = {"signed char", "short", 0, "int", 0, 0, 0, "long long"};
+  const char* unsignedNames[] = {"unsigned char", "unsigned short", 0, "unsigned int", 0, 0, 0, "unsigned long long"};
+  if(encoding == _DW_ATE_FLOAT) return byteSize == 4 ? "float" : byteSize == 8 ? "double" : byteSize == 16 ? "long double" : 0;
+  if(encoding == _DW_ATE_BOOLEAN) return byteSize == 1 ? "bool" : 0;
+  if(byteSize == 16) return encoding == _DW_ATE_SIGNED || encoding == _DW_ATE_SIGNED_CHAR ? "__int128" : "unsigned __int128";
+  if(byteSize < 1 || byteSize > 8) return 0;
+  if(encoding == _DW_ATE_SIGNED || encoding == _DW_ATE_SIGNED_CHAR) return signedNames[byteSize - 1];
+  if(encoding == _DW_ATE_UNSIGNED || encoding == _DW_ATE_UNSIGNED_CHAR || encoding == _DW_ATE_UTF) return unsignedNames[byteSize - 1];
+  return 0;
+}
+
+// Names a type the way the mock file can declare it without any header: qualifiers and typedefs are dropped,
+// every pointer or reference becomes void* and enums their underlying integer. Records passed by value are not supported
+const char* _debugInfoTypeName(_DebugInfo* info, long long offset)
+{
+  for(int i = 0; i < 64; i++)
+  {
+    if(offset < 0) return "void";
+    _DebugInfoEntry* entry = _debugInfoFindEntry(info, offset);
+    if(!entry) return 0;
+    switch(entry->tag)
+    {
+      case _DW_TAG_CONST_TYPE: case _DW_TAG_VOLATILE_TYPE: case _DW_TAG_RESTRICT_TYPE: case _DW_TAG_ATOMIC_TYPE: case _DW_TAG_TYPEDEF:
+        offset = entry->type;
+        break;
+      case _DW_TAG_POINTER_TYPE: case _DW_TAG_REFERENCE_TYPE: case _DW_TAG_RVALUE_REFERENCE_TYPE:
+        return "void*";
+      case _DW_TAG_ENUMERATION_TYPE:
+        if(entry->type < 0) return _debugInfoScalarName(_DW_ATE_UNSIGNED, entry->byteSize < 0 ? 4 : entry->byteSize);
+        offset = entry->type;
+        break;
+      case _DW_TAG_BASE_TYPE:
+        return _debugInfoScalarName(entry->encoding, entry->byteSize);
+      default:
+        return 0;
+    }
+  }
+  return 0;
+}
+
+// Longer chains of declarations are taken as malformed, so pointers in a cycle are not followed forever
+#define _DEBUG_INFO_MAX_ORIGINS 16
+
+// Definitions may only point to the declaration holding the name, type and linkage
+_DebugInfoEntry* _debugInfoOrigin(_DebugInfo* info, _DebugInfoEntry* entry)
+{
+  long long origin = entry->specification >= 0 ? entry->specification : entry->abstractOrigin;
+  _DebugInfoEntry* originEntry = origin >= 0 ? _debugInfoFindEntry(info, origin) : 0;
+  return originEntry != entry ? originEntry : 0;
+}
+
+char* _debugInfoCopyString(const char* string)
+{
+  char* copy = (char*)malloc(strlen(string) + 1);
+  strcpy(copy, string);
+  return copy;
+}
+
+// Builds the arguments from the parameters following a function entry, false if any of them can not be declared
+bool _debugInfoFunctionArgs(_DebugInfo* info, int index, char* args)
+{
+  _DebugInfoEntry* function = &info->entries[index];
+  args[0] = '\0';
+  for(int i = index + 1; i < info->entryCount && info->entries[i].depth > function->depth; i++)
+  {
+    _DebugInfoEntry* parameter = &info->entries[i];
+    if(parameter->depth != function->depth + 1) continue;
+    if(parameter->tag == _DW_TAG_UNSPECIFIED_PARAMETERS) return false; // variadic arguments can not be forwarded
+    if(parameter->tag != _DW_TAG_FORMAL_PARAMETER) continue;
+    long long type = parameter->type;
+    _DebugInfoEntry* origin = _debugInfoOrigin(info, parameter);
+    for(int depth = 0; type < 0 && origin && depth < _DEBUG_INFO_MAX_ORIGINS; depth++, origin = _debugInfoOrigin(info, origin))
+      type = origin->type;
+    const char* typeName = _debugInfoTypeName(info, type);
+    if(!typeName || type < 0) return false;
+    if(args[0]) strcat(args, ", ");
+    strcat(args, typeName);
+  }
+  return true;
+}
+
+void _debugInfoAppendFunction(_DebugInfoFunctions* functions, const char* returnType, const char* name, const char* args)
+{
+  if(functions->count == functions->capacity)
+  {
+    functions->capacity = functions->capacity*2 + 64;
+    functions->items = (FunctionDescriptor*)realloc(functions->items, sizeof(FunctionDescriptor)*functions->capacity);
+  }
+  FunctionDescriptor function = {_debugInfoCopyString(returnType), _debugInfoCopyString(name), _debugInfoCopyString(args), 0};
+  functions->items[functions->count++] = function;
+}
+
+// Appends the global functions defined in an object, skipping the ones whose types can not be declared.
+// Only entries with code whose name is a defined symbol are taken, along with the other symbols at the same address,
+// as a C++ constructor is described once but defined for both the complete and base object
+void _debugInfoReadFunctions(_StaticLibFile* libFile, _DebugInfoFunctions* functions)
+{
+  _DebugInfo info;
+  const char** symbolNames;
+  _ElfSymbol* symbols;
+  int symbolCount = _objectFileGlobalFunctions(libFile, &symbolNames, &symbols);
+  if(symbolCount && _debugInfoLoad(&info, libFile))
+    for(int i = 0; i < info.entryCount; i++)
+    {
+      _DebugInfoEntry entry = info.entries[i];
+      if(entry.tag != _DW_TAG_SUBPROGRAM || entry.declaration || !entry.hasCode) continue;
+      int parameterCount = 0;
+      for(int p = i + 1; p < info.entryCount && info.entries[p].depth > entry.depth; p++)
+        parameterCount++;
+
+      // Definitions may not have children, the declaration then lists the parameters
+      int parametersIndex = i;
+      _DebugInfoEntry* origin = _debugInfoOrigin(&info, &info.entries[i]);
+      for(int depth = 0; origin && depth < _DEBUG_INFO_MAX_ORIGINS; depth++, origin = _debugInfoOrigin(&info, origin))
+      {
+        if(!entry.name) entry.name = origin->name;
+        if(!entry.linkageName) entry.linkageName = origin->linkageName;
+        if(entry.type < 0) entry.type = origin->type;
+        entry.external |= origin->external;
+        if(!parameterCount)
+        {
+          parametersIndex = origin - info.entries;
+          for(int p = parametersIndex + 1; p < info.entryCount && info.entries[p].depth > origin->depth; p++)
+            parameterCount++;
+        }
+      }
+      const char* name = entry.linkageName ? entry.linkageName : entry.name;
+      const char* returnType = _debugInfoTypeName(&info, entry.type);
+      char args[parameterCount*24 + 1];
+      if(!entry.external || !name || !returnType || !_debugInfoFunctionArgs(&info, parametersIndex, args)) continue;
+
+      int symbol = 0;
+      while(symbol < symbolCount && strcmp(symbolNames[symbol], name) != 0) symbol++;
+      if(symbol == symbolCount) continue;
+      for(int alias = 0; alias < symbolCount; alias++)
+        if(symbols[alias].st_shndx == symbols[symbol].st_shndx && symbols[alias].st_value == symbols[symbol].st_value)
+          _debugInfoAppendFunction(functions, returnType, symbolNames[alias], args);
+    }
+  if(symbolCount) _debugInfoFree(&info);
+  free(symbolNames);
+  free(symbols);
+}
+
+int _compareFunctionDescriptors(const void* a, const void* b)
+{
+  return strcmp(((FunctionDescriptor*)a)->name, ((FunctionDescriptor*)b)->name);
+}
+
+void freeFunctionDescriptors(int functionCount, FunctionDescriptor* functions)
+{
+  for(int i = 0; i < functionCount; i++)
+  {
+    free((void*)functions[i].returnType);
+    free((void*)functions[i].name);
+    free((void*)functions[i].args);
+  }
+  free(functions);
+}
+
+int _debugInfoReadLibFunctions(_StaticLib* lib, FunctionDescriptor** output)
+{
+  _DebugInfoFunctions functions = {0, 0, 0};
+  for(int i = 0; i < lib->fileCount; i++)
+    _debugInfoReadFunctions(&lib->files[i], &functions);
+  if(functions.count)
+    qsort(functions.items, functions.count, sizeof(FunctionDescriptor), _compareFunctionDescriptors);
+
+  // Inline functions may be defined by several objects
+  int count = 0;
+  for(int i = 0; i < functions.count; i++)
+  {
+    FunctionDescriptor* function = &functions.items[i];
+    if(count && strcmp(functions.items[count - 1].name, function->name) == 0)
+    {
+      free((void*)function->returnType);
+      free((void*)function->name);
+      free((void*)function->args);
+    }
+    else
+      functions.items[count++] = *function;
+  }
+  *output = functions.items;
+  return count;
+}
+
+// Describes every global function of a static lib compiled with debug info (-g), sorted by name.
+// Returns the count or -1 if the lib can not be read, free the output with freeFunctionDescriptors
+int readFunctionDescriptors(char* libPath, FunctionDescriptor** output)
+{
+  _StaticLib lib;
+  *output = 0;
+  if(!_staticLibRead(&lib, libPath)) return -1;
+  int count = _debugInfoReadLibFunctions(&lib, output);
+  _staticLibFree(&lib);
+  return count;
+}
@@ -1,9 +1,12 @@
 // This content is part of test.h
 // Main testing functionalities
 typedef struct _TestSelect _TestSelect;
+typedef struct _TestOptions _TestOptions;
 typedef struct _TestContext _TestContext;
+typedef struct _TimingRun _TimingRun;
+typedef struct _StressTest _StressTest;
 typedef struct TestEnvironment TestEnvironment;
-typedef struct FunctionMock FunctionMock;
+typedef struct MockTable MockTable;
 typedef struct FunctionDescriptor FunctionDescriptor;
 
 enum _TestSelectMode
@@ -21,11 +24,21 @@ struct _TestSelect
   char* name;
 };
 
+// Runner flags that are passed on to every test process
+struct _TestOptions
+{
+  char* tracePath;
+  char* profilePath;
+  bool hasSeed;
+  unsigned long long seed;
+  long long fuzzRuns;
+};
+
 struct _TestContext
 {
   bool set;
-  FunctionMock* mocksPointer;
-  void** mocksSnapshot;
+  int mockChangesCount;
+  int runtimeMocksCount;
   void (*setupFunction)();
   void (*cleanFunction)();
   void (*onFail)(char* file, int line, char* expr);
@@ -33,6 +46,26 @@ struct _TestContext
   void (*onRaise)(int);
 };
 
+// Samples of an assert_faster_than, each one the mean time of a batch of runs long enough for the clock resolution
+struct _TimingRun
+{
+  int batchSize;
+  int sampleCount;
+  bool calibrated;
+  unsigned long long batchStart;
+  unsigned long long samples[_TIMING_SAMPLES];
+};
+
+struct _StressTest
+{
+  int testIndex;
+  int threadCount;
+  long long iterations;
+  int arrived;
+  void* threads;
+  unsigned long long* elapsed;
+};
+
 struct TestEnvironment
 {
   _TestContext globalContext;
@@ -48,24 +81,58 @@ struct TestEnvironment
   void* helperMemoryBlock[_TEST_HELPER_BLOCK_SIZE];
 };
 
-struct FunctionMock
+// The mock table generated with the mock file, every array is indexed by the position of the name in sorted order
+// and has one extra entry, used as target when a name is not found
+struct MockTable
 {
-  bool set;
-  int calls;
-  void* mockPointer;
-  const char* name;
-  void* original;
+  int count;
+  const char* names;
+  const unsigned int* nameOffsets;
+  int* calls;
+  void** slots;
+  void** originals;
 };
 
 struct FunctionDescriptor
 {
-  char returnType[32];
-  char name[_BTR_MAX_NAME_SIZE];
-  char args[_BTR_MAX_NAME_SIZE];
-  char* implementation;
+  const char* returnType;
+  const char* name;
+  const char* args;
+  const char* implementation;
 };
 
+// Options for the generated mock files, combined in mockFileOptions before calling createMocks or createObjectMocks
+// MOCK_FILE_PASS_THROUGH: on x86-64 ELF targets unmocked functions are counted and jump straight to the original, so
+// code running against the mockable lib keeps close to its real cost. Not set by default
+// MOCK_FILE_TRACE: every call is recorded when the runner is given --trace <directory>, which gets a Chrome trace
+// event file per test. Needs a C mock file and takes precedence over MOCK_FILE_PASS_THROUGH
+// MOCK_FILE_LATENCY: wrappers time every call into a log2 histogram per function, each test prints the call counts
+// and p50/p99 latencies when it ends. Needs a C mock file and takes precedence over MOCK_FILE_PASS_THROUGH
+enum MockFileOption
+{
+  MOCK_FILE_DEFAULT = 0,
+  MOCK_FILE_PASS_THROUGH = 0b0010,
+  MOCK_FILE_TRACE = 0b0100,
+  MOCK_FILE_LATENCY = 0b1000
+};
+
+int mockFileOptions = MOCK_FILE_DEFAULT;
+
 void _ignore();
+void _restoreMocks(int count);
+void _startTrace(char* path, int testIndex);
+bool _startProfiler(char* path);
+void _startAllocationTracking(char* context, char* description);
+void _nameLatencySummary(char* context, char* description);
+void _startVirtualClock();
+void _stopVirtualClock();
+void _resetMemoryFiles();
+void _restoreRuntimeMocks(int count);
+unsigned long long _monotonicTime();
+unsigned long long _currentThreadId();
+void* _startThreads(int count, void (*job)(void* data, int index), void* data, int* startedCount);
+void _joinThreads(void* threads, int count);
+void _exitThread();
 void _defaultTestPass();
 void _defaultFailure(char* file, int line, char* expr);
 
@@ -78,29 +145,18 @@ void (*onRaise)(int) = (void(*)(int))_ignore;
 int __numArgsCopy;
 char** _argsCopy;
 char* _sourceFile;
+int _mockChangesCount = 0;
+int _runtimeMocksCount = 0;
 TestEnvironment* testEnv = 0;
-extern FunctionMock _mocks[];
-
-void _snapShotGlobalMocks()
-{
-  if(!testEnv->globalContext.mocksPointer || testEnv->globalContext.mocksSnapshot) return;
-  int count = 0;  
-  while(testEnv->globalContext.mocksPointer[count].set){count++;}
-  count++;
-  testEnv->globalContext.mocksSnapshot = (void**)malloc(sizeof(void*)*(count));
-  for(int i = 0; i < count-1; i++)
-    testEnv->globalContext.mocksSnapshot[i] = *((void**)testEnv->globalContext.mocksPointer[i].mockPointer);
-}
-
-void _recoverGlobalMocksSnapShot()
-{
-  if(!testEnv->globalContext.mocksSnapshot || !testEnv->globalContext.mocksPointer) return;
-  int count = 0;  
-  while(testEnv->globalContext.mocksPointer[count].set){count++;}
-  count++;
-  for(int i = 0; i < count-1; i++)
-    *((void**)testEnv->globalContext.mocksPointer[i].mockPointer) = testEnv->globalContext.mocksSnapshot[i];
-}
+// Nonzero while the framework allocates for itself inside a test, so allocation tracking leaves it out
+_BTR_THREAD_LOCAL int _untrackedAllocations = 0;
+_TestOptions _testOptions = {0};
+int (*_allTestsFunction)() = 0;
+_StressTest _stressTest = {0};
+// Index of the thread running the body of a stress test, -1 outside of one. Threads other than 0 only run that body
+_BTR_THREAD_LOCAL int _stressThread = -1;
+unsigned long long _failingThread = 0;
+extern MockTable _mocks;
 
 void _maybeSetGlobalContext()
 {
@@ -113,12 +169,14 @@ void _maybeSetGlobalContext()
     testEnv->globalContext.onTestPass = onTestPass;
     testEnv->globalContext.onRaise = onRaise;
 
-    _snapShotGlobalMocks();
+    testEnv->globalContext.mockChangesCount = _mockChangesCount;
+    testEnv->globalContext.runtimeMocksCount = _runtimeMocksCount;
   }
 }
 
 void _setContext(char* contextName)
 {
+  if(_stressThread > 0) return;
   _maybeSetGlobalContext();
   setupFunction = testEnv->globalContext.setupFunction;
   cleanFunction = testEnv->globalContext.cleanFunction;
@@ -126,7 +184,8 @@ void _setContext(char* contextName)
   onTestPass = testEnv->globalContext.onTestPass;
   onRaise = testEnv->globalContext.onRaise;
   testEnv->_candidateContext = contextName;
-  _recoverGlobalMocksSnapShot();
+  _restoreMocks(testEnv->globalContext.mockChangesCount);
+  _restoreRuntimeMocks(testEnv->globalContext.runtimeMocksCount);
 }
 
 void _initializeTest(int index, int line, char* description)
@@ -136,6 +195,10 @@ void _initializeTest(int index, int line, char* description)
   testEnv->testDescription = description;
   testEnv->testLine = __LINE__;
   testEnv->testContext = testEnv->_candidateContext;
+  _startAllocationTracking(testEnv->testContext, description);
+  _nameLatencySummary(testEnv->testContext, description);
+  _startVirtualClock();
+  _resetMemoryFiles();
 }
 
 char** _copyArgs(int numArgs, char** args)
@@ -169,7 +232,7 @@ void _ignore(){}
 bool _shouldRunTest(int index, int line, char* context)
 {
   int mode = testEnv->selection.mode;
-  if(mode == _TEST_SELECT_MODE_NONE) return false;
+  if(mode == _TEST_SELECT_MODE_NONE || _stressThread > 0) return false;
   if(!((mode & _TEST_SELECT_MODE_INDEX) || (mode & _TEST_SELECT_MODE_LINE)))
     return false;
   if((mode & _TEST_SELECT_MODE_INDEX) && index != testEnv->selection.index)
@@ -185,13 +248,21 @@ bool _shouldRunTest(int index, int line, char* context)
 void _defaultTestPass()
 {
   printf(".");
+  _stopVirtualClock();
   cleanFunction();
 }
 
 void _defaultFailure(char* file, int line, char* expr)
 {
-  printf("\n[FAIL] on \"%s\" test \"%s\" failed %s:%i (%s)\n", testEnv->testContext, testEnv->testDescription, file, line, expr);
+  // Only the first thread to fail reports, the others stop where they are while it exits
+  unsigned long long thread = _currentThreadId();
+  unsigned long long failing = __sync_val_compare_and_swap(&_failingThread, 0, thread);
+  if(failing != 0 && failing != thread) _exitThread();
+  printf("\n[FAIL] on \"%s\" test \"%s\" failed %s:%i (%s)", testEnv->testContext, testEnv->testDescription, file, line, expr);
+  if(_stressThread >= 0) printf(" on stress thread %i", _stressThread);
+  printf("\n");
   
+  _stopVirtualClock();
   void (*noLoopClean)() = cleanFunction;
   cleanFunction = _ignore;
   noLoopClean();
@@ -220,6 +291,243 @@ void _assert(char* file, int line, bool assertion, char* expr)
   if(!assertion) onFail(file, line, expr);
 }
 
+_TimingRun _startTiming()
+{
+  _TimingRun run = {0};
+  run.batchSize = 1;
+  run.batchStart = _monotonicTime();
+  return run;
+}
+
+// Ends the batch that just ran and tells whether another one is needed. Batches double in size until one lasts
+// _TIMING_MIN_BATCH_NS, which also warms up caches and branch predictors, then _TIMING_SAMPLES batches are measured
+bool _nextTimingBatch(_TimingRun* run)
+{
+  unsigned long long elapsed = _monotonicTime() - run->batchStart;
+  if(!run->calibrated)
+  {
+    if(elapsed >= _TIMING_MIN_BATCH_NS || run->batchSize >= (1 << 24)) run->calibrated = true;
+    else run->batchSize *= 2;
+  }
+  else
+    run->samples[run->sampleCount++] = elapsed/run->batchSize;
+  run->batchStart = _monotonicTime();
+  return run->sampleCount < _TIMING_SAMPLES;
+}
+
+int _compareTimingSamples(const void* a, const void* b)
+{
+  unsigned long long sampleA = *(const unsigned long long*)a, sampleB = *(const unsigned long long*)b;
+  return sampleA < sampleB ? -1 : sampleA > sampleB;
+}
+
+// Compares the median sample with the budget, failing with the measured distribution
+void _assertTiming(char* file, int line, _TimingRun* run, unsigned long long budget, char* expr)
+{
+  qsort(run->samples, _TIMING_SAMPLES, sizeof(unsigned long long), _compareTimingSamples);
+  unsigned long long median = run->samples[_TIMING_SAMPLES/2];
+  if(median <= budget) return;
+  static char message[1024];
+  snprintf(message, sizeof(message), "%.700s took %lluns, budget %lluns (min %llu, p25 %llu, median %llu, p75 %llu, max %llu ns "
+    "over %i samples of %i runs)", expr, median, budget, run->samples[0], run->samples[_TIMING_SAMPLES/4], median,
+    run->samples[_TIMING_SAMPLES*3/4], run->samples[_TIMING_SAMPLES - 1], _TIMING_SAMPLES, run->batchSize);
+  onFail(file, line, message);
+}
+
+// Offset of the first differing byte of two buffers, or size when they are equal
+size_t _firstMismatch(const unsigned char* a, const unsigned char* b, size_t size)
+{
+  size_t offset = 0;
+#ifdef __SSE2__
+  for(; offset + 64 <= size; offset += 64)
+  {
+    __m128i equal = _mm_and_si128(
+      _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + offset)), _mm_loadu_si128((const __m128i*)(b + offset))),
+        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + offset + 16)), _mm_loadu_si128((const __m128i*)(b + offset + 16)))),
+      _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + offset + 32)), _mm_loadu_si128((const __m128i*)(b + offset + 32))),
+        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + offset + 48)), _mm_loadu_si128((const __m128i*)(b + offset + 48)))));
+    if(_mm_movemask_epi8(equal) != 0xFFFF) break;
+  }
+  for(; offset + 16 <= size; offset += 16)
+  {
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + offset)), _mm_loadu_si128((const __m128i*)(b + offset))));
+    if(mask != 0xFFFF) return offset + __builtin_ctz(~mask);
+  }
+#else
+  for(; offset + 8 <= size; offset += 8)
+  {
+    unsigned long long wordA, wordB;
+    memcpy(&wordA, a + offset, 8);
+    memcpy(&wordB, b + offset, 8);
+    if(wordA != wordB) break;
+  }
+#endif
+  while(offset < size && a[offset] == b[offset]) offset++;
+  return offset;
+}
+
+// Writes the rows around the mismatch as hex, one line for each buffer
+int _writeHexWindow(char* output, int capacity, const unsigned char* a, const unsigned char* b, size_t size, size_t mismatch)
+{
+  int length = 0;
+  size_t first = mismatch/16 > 0 ? (mismatch/16 - 1)*16 : 0;
+  for(size_t row = first; row < size && row <= first + 32 && length < capacity; row += 16)
+    for(int buffer = 0; buffer < 2 && length < capacity; buffer++)
+    {
+      const unsigned char* data = buffer ? b : a;
+      if(buffer) length += snprintf(output + length, capacity - length, "\n              expected:");
+      else length += snprintf(output + length, capacity - length, "\n  0x%08llx    actual:", (unsigned long long)row);
+      for(size_t i = row; i < row + 16 && i < size && length < capacity; i++)
+        length += snprintf(output + length, capacity - length, i == mismatch ? "[%02x]" : " %02x ", data[i]);
+    }
+  return length;
+}
+
+void _assertMemEq(char* file, int line, const void* actual, const void* expected, size_t size, size_t elementSize, char* expr)
+{
+  size_t mismatch = _firstMismatch((const unsigned char*)actual, (const unsigned char*)expected, size);
+  if(mismatch == size) return;
+  static char message[4096];
+  int length = elementSize > 1 ?
+    snprintf(message, sizeof(message), "%.500s differ at element %llu (byte %llu of %llu)", expr,
+      (unsigned long long)(mismatch/elementSize), (unsigned long long)mismatch, (unsigned long long)size) :
+    snprintf(message, sizeof(message), "%.500s differ at byte %llu of %llu", expr, (unsigned long long)mismatch, (unsigned long long)size);
+  _writeHexWindow(message + length, sizeof(message) - length, (const unsigned char*)actual, (const unsigned char*)expected, size, mismatch);
+  onFail(file, line, message);
+}
+
+// Index of the first pair of floats or doubles further apart than the tolerance, or count when there is none
+size_t _firstFarElement(const void* a, const void* b, size_t count, size_t elementSize, double tolerance)
+{
+  size_t index = 0;
+#ifdef __SSE2__
+  if(elementSize == sizeof(float))
+  {
+    __m128 limit = _mm_set1_ps((float)tolerance), absolute = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    for(; index + 4 <= count; index += 4)
+    {
+      __m128 difference = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps((const float*)a + index), _mm_loadu_ps((const float*)b + index)), absolute);
+      if(_mm_movemask_ps(_mm_cmple_ps(difference, limit)) != 0xF) break;
+    }
+  }
+  else
+  {
+    __m128d limit = _mm_set1_pd(tolerance), absolute = _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+    for(; index + 2 <= count; index += 2)
+    {
+      __m128d difference = _mm_and_pd(_mm_sub_pd(_mm_loadu_pd((const double*)a + index), _mm_loadu_pd((const double*)b + index)), absolute);
+      if(_mm_movemask_pd(_mm_cmple_pd(difference, limit)) != 0x3) break;
+    }
+  }
+#endif
+  for(; index < count; index++)
+  {
+    // Equal infinities are near, though their difference is NaN
+    if(memcmp((const char*)a + index*elementSize, (const char*)b + index*elementSize, elementSize) == 0) continue;
+    double valueA = elementSize == sizeof(float) ? ((const float*)a)[index] : ((const double*)a)[index];
+    double valueB = elementSize == sizeof(float) ? ((const float*)b)[index] : ((const double*)b)[index];
+    // Written so that NaN never counts as near
+    if(!(valueA - valueB <= tolerance && valueB - valueA <= tolerance)) break;
+  }
+  return index;
+}
+
+// Element types of assert_array_near, taken from the type of the arrays as other types have the same sizes
+enum _ArrayNearType
+{
+  _ARRAY_NEAR_UNSUPPORTED = 0,
+  _ARRAY_NEAR_FLOAT,
+  _ARRAY_NEAR_DOUBLE
+};
+
+#ifdef __cplusplus
+extern "C++"
+{
+int _arrayNearType(const float* array){ return _ARRAY_NEAR_FLOAT; }
+int _arrayNearType(const double* array){ return _ARRAY_NEAR_DOUBLE; }
+template<typename Type> int _arrayNearType(const Type* array){ return _ARRAY_NEAR_UNSUPPORTED; }
+}
+#else
+#define _arrayNearType(array) _Generic(*(array), float: _ARRAY_NEAR_FLOAT, double: _ARRAY_NEAR_DOUBLE,\
+  default: _ARRAY_NEAR_UNSUPPORTED)
+#endif
+
+void _assertArrayNear(char* file, int line, const void* actual, const void* expected, size_t count, int actualType,
+  int expectedType, double tolerance, char* expr)
+{
+  if(actualType == _ARRAY_NEAR_UNSUPPORTED || actualType != expectedType)
+  {
+    onFail(file, line, _C_STRING_LITERAL("assert_array_near needs two float or two double arrays"));
+    return;
+  }
+  size_t elementSize = actualType == _ARRAY_NEAR_FLOAT ? sizeof(float) : sizeof(double);
+  size_t mismatch = _firstFarElement(actual, expected, count, elementSize, tolerance);
+  if(mismatch == count) return;
+  static char message[4096];
+  int length = snprintf(message, sizeof(message), "%.500s differ by more than %g at element %llu of %llu", expr, tolerance,
+    (unsigned long long)mismatch, (unsigned long long)count);
+  size_t first = mismatch > 3 ? mismatch - 3 : 0;
+  for(size_t i = first; i < count && i <= mismatch + 3 && length < (int)sizeof(message); i++)
+  {
+    double valueA = elementSize == sizeof(float) ? ((const float*)actual)[i] : ((const double*)actual)[i];
+    double valueB = elementSize == sizeof(float) ? ((const float*)expected)[i] : ((const double*)expected)[i];
+    length += snprintf(message + length, sizeof(message) - length, "\n  %s[%llu] actual %.9g expected %.9g",
+      i == mismatch ? ">" : " ", (unsigned long long)i, valueA, valueB);
+  }
+  onFail(file, line, message);
+}
+
+void _stressWorker(void* data, int index)
+{
+  _stressThread = index;
+  _allTestsFunction();
+}
+
+bool _shouldRunStressTest(int index, int line, char* description, int threadCount, long long iterations)
+{
+  if(_stressThread > 0) return index == _stressTest.testIndex;
+  if(!_shouldRunTest(index, line, testEnv->_candidateContext)) return false;
+  _initializeTest(index, line, description);
+  setupFunction();
+  _stressTest.testIndex = index;
+  _stressTest.threadCount = threadCount > 0 ? threadCount : 1;
+  _stressTest.iterations = iterations;
+  _stressTest.arrived = 0;
+  _stressTest.elapsed = (unsigned long long*)calloc(_stressTest.threadCount, sizeof(unsigned long long));
+  _stressThread = 0;
+  int started;
+  _stressTest.threads = _startThreads(_stressTest.threadCount, _stressWorker, 0, &started);
+  // Threads that could not start are counted as arrived so the others are not kept waiting
+  __sync_fetch_and_add(&_stressTest.arrived, _stressTest.threadCount - started);
+  return true;
+}
+
+// Waits for every thread to arrive so the iterations overlap as much as possible
+long long _startStress()
+{
+  __sync_fetch_and_add(&_stressTest.arrived, 1);
+  while(__sync_fetch_and_add(&_stressTest.arrived, 0) < _stressTest.threadCount);
+  _stressTest.elapsed[_stressThread] = _monotonicTime();
+  return 0;
+}
+
+// Ends the stress test body of a thread. Thread 0 waits for the others and prints their throughput
+bool _endStress()
+{
+  _stressTest.elapsed[_stressThread] = _monotonicTime() - _stressTest.elapsed[_stressThread];
+  if(_stressThread > 0) _exitThread();
+  _joinThreads(_stressTest.threads, _stressTest.threadCount);
+  printf("\n[STRESS] on \"%s\" test \"%s\" %i threads x %lli iterations\n", testEnv->testContext, testEnv->testDescription,
+    _stressTest.threadCount, _stressTest.iterations);
+  for(int i = 0; i < _stressTest.threadCount; i++)
+    printf("  thread %i: %.0f iterations/s (%.3f ms)\n", i, _stressTest.elapsed[i] ? _stressTest.iterations*1e9/_stressTest.elapsed[i] : 0.0,
+      _stressTest.elapsed[i]/1e6);
+  free(_stressTest.elapsed);
+  _stressTest.elapsed = 0;
+  _stressThread = -1;
+  return false;
+}
+
 _TestSelect _getArgsSelection(int numArgs, char** args)
 {
   _TestSelect ret = {0};
@@ -243,6 +551,30 @@ _TestSelect _getArgsSelection(int numArgs, char** args)
       }
       i++;
     }
+    else if(strcmp(args[i], "--trace") == 0)
+    {
+      if(i+1 < numArgs) _testOptions.tracePath = args[i+1];
+      i++;
+    }
+    else if(strcmp(args[i], "--profile") == 0)
+    {
+      if(i+1 < numArgs) _testOptions.profilePath = args[i+1];
+      i++;
+    }
+    else if(strcmp(args[i], "--fuzz") == 0)
+    {
+      if(i+1 < numArgs) _testOptions.fuzzRuns = strtoll(args[i+1], 0, 10);
+      i++;
+    }
+    else if(strcmp(args[i], "--seed") == 0)
+    {
+      if(i+1 < numArgs)
+      {
+        _testOptions.hasSeed = true;
+        _testOptions.seed = strtoull(args[i+1], 0, 10);
+      }
+      i++;
+    }
     else if(strcmp(args[i], "--line") == 0)
     {
       if(i+1 < numArgs)
@@ -360,8 +692,16 @@ int runTestsForFile(int numArgs, char** args, char* file)
     sprintf(fixedParams, " --line %i", selection.line);
   if((selection.mode & _TEST_SELECT_MODE_MODULE))
     sprintf(fixedParams + strlen(fixedParams), " --module \"%s\"", selection.name);
-
-  char program[(strlen(file)+64)*4];
+  if(_testOptions.tracePath && strlen(_testOptions.tracePath) < 256)
+    sprintf(fixedParams + strlen(fixedParams), " --trace \"%s\"", _testOptions.tracePath);
+  if(_testOptions.profilePath && strlen(_testOptions.profilePath) < 256)
+    sprintf(fixedParams + strlen(fixedParams), " --profile \"%s\"", _testOptions.profilePath);
+  if(_testOptions.hasSeed)
+    sprintf(fixedParams + strlen(fixedParams), " --seed %llu", _testOptions.seed);
+  if(_testOptions.fuzzRuns > 0)
+    sprintf(fixedParams + strlen(fixedParams), " --fuzz %lli", _testOptions.fuzzRuns);
+
+  char program[strlen(file) + sizeof(fixedParams) + 64];
   strcpy(program, file);
   int count = _doRunTest(program);
   for(int j = 0; j < count; j++)
@@ -400,34 +740,46 @@ int runAllTests(int numArgs, char** args)
   return failures;
 }
 
+// Names the file a test process writes in a directory given to the runner: <directory>/<test file>.<index>.<extension>
+char* _testOutputPath(char* directory, int testIndex, const char* extension)
+{
+  char* sourceName = _sourceFile;
+  for(char* c = _sourceFile; *c; c++)
+    if(*c == '/' || *c == '\\') sourceName = c + 1;
+  char* path = (char*)malloc(strlen(directory) + strlen(sourceName) + strlen(extension) + 32);
+  sprintf(path, "%s/%s.%i.%s", directory, sourceName, testIndex, extension);
+  return path;
+}
+
 int _testFileMain(int numArgs, char** args, int (*_allTests)())
 {
   args = _copyArgs(numArgs, args);
   TestEnvironment _testEnv;
   testEnv = &_testEnv;
-  void** snapShot;
 
   int signals[] = {SIGABRT, SIGFPE, SIGILL, SIGINT, SIGSEGV, SIGTERM};
   for(unsigned int i = 0; i < sizeof(signals)/sizeof(int); i++)
     signal(signals[i], _defaultRaiseHandler);
 
+  _allTestsFunction = _allTests;
   _testEnv = (TestEnvironment){0};
   _testEnv._helperBlockIndex = &_testEnv.helperMemoryBlock[0];
   _testEnv.testContext = _C_STRING_LITERAL("global");
   _testEnv.testDescription = _C_STRING_LITERAL("setup");
   int _testCount = _allTests();
-  _recoverGlobalMocksSnapShot();
-  snapShot = _testEnv.globalContext.mocksSnapshot;
-  if(snapShot) free(snapShot);
+  _restoreMocks(0);
+  _restoreRuntimeMocks(0);
   
   _testEnv = (TestEnvironment){0};
   _testEnv._helperBlockIndex = &_testEnv.helperMemoryBlock[0];
   _testEnv.testContext = _C_STRING_LITERAL("global");
   _testEnv.testDescription = _C_STRING_LITERAL("setup");
   _testEnv.selection = _getArgsSelection(numArgs, args);
+  if(_testOptions.tracePath && (_testEnv.selection.mode & _TEST_SELECT_MODE_INDEX))
+    _startTrace(_testOutputPath(_testOptions.tracePath, _testEnv.selection.index, "trace.json"), _testEnv.selection.index);
+  if(_testOptions.profilePath && (_testEnv.selection.mode & _TEST_SELECT_MODE_INDEX))
+    _startProfiler(_testOutputPath(_testOptions.profilePath, _testEnv.selection.index, "folded"));
   _allTests();
-  snapShot = _testEnv.globalContext.mocksSnapshot;
-  if(snapShot) free(snapShot);
 
   _freeArgsCopy();
   
@@ -0,0 +1,408 @@
+// This content is part of test.h
+// Fuzz targets: the body runs in process for every input, reading it from fuzzData and fuzzSize.
+// A normal run replays the inputs saved in <fuzzInputsPath>/<test file>.<target name>/, --fuzz RUNS mutates them
+// for that many runs, keeping the ones that reach new code when built with -fsanitize-coverage=trace-pc-guard (clang)
+// or trace-pc (gcc). Failing inputs are saved there as crash-<hash>, so the next normal run replays them.
+// With BTR_LIBFUZZER defined the test file becomes a libFuzzer target running the fuzz target named by the
+// BTR_FUZZ_TARGET environment variable, or the first one
+
+#define _FUZZ_MAX_INPUT 4096
+#define _FUZZ_EDGES 65536
+
+// Relative to the working directory of the test run
+char* fuzzInputsPath = _C_STRING_LITERAL("fuzz");
+
+enum _FuzzMode
+{
+  _FUZZ_REPLAY,
+  _FUZZ_MUTATE,
+  _FUZZ_ONE_INPUT
+};
+
+typedef struct
+{
+  unsigned char* data;
+  size_t size;
+} _FuzzInput;
+
+typedef struct
+{
+  _BTR_JMP_BUF jump;
+  int mode;
+  char* name;
+  char* directory;
+  void (*onFail)(char* file, int line, char* expr);
+  int mockChangesCount, runtimeMocksCount;
+  bool running, failed, ranEmpty;
+  char* failFile;
+  int failLine;
+  char* failExpr;
+  // The running input and the file it was read from, if any
+  unsigned char* data;
+  size_t size;
+  char* inputPath;
+  unsigned char* buffer;
+  char** files;
+  int fileCount, fileIndex;
+  _FuzzInput* corpus;
+  int corpusCount, corpusCapacity;
+  long long runs, run;
+  unsigned long long random, startTime;
+  int edgesFound;
+  // Only for libFuzzer
+  bool targetFound;
+  const char* target;
+} _Fuzz;
+
+_Fuzz _fuzz;
+bool _fuzzOneInput = false;
+
+#define fuzzData ((const unsigned char*)_fuzz.data)
+#define fuzzSize (_fuzz.size)
+
+bool _makeParentDirectories(char* path);
+
+// Code reached from the coverage callbacks or handling the edges must not be instrumented too
+#if defined(__clang__)
+#define _BTR_NO_COVERAGE __attribute__((no_sanitize("coverage")))
+#elif defined(__GNUC__) && __GNUC__ >= 12
+#define _BTR_NO_COVERAGE __attribute__((no_sanitize_coverage))
+#else
+#define _BTR_NO_COVERAGE
+#endif
+
+#ifndef BTR_LIBFUZZER
+// Edges hit by the running input, also listed so merging them does not scan the whole map
+unsigned char _fuzzEdges[_FUZZ_EDGES];
+unsigned int _fuzzHitEdges[_FUZZ_EDGES];
+int _fuzzHitCount = 0;
+unsigned char _fuzzSeenEdges[_FUZZ_EDGES];
+unsigned int _fuzzGuards = 0;
+
+_BTR_NO_COVERAGE void _hitFuzzEdge(unsigned int edge)
+{
+  if(_fuzzEdges[edge] || _fuzzHitCount >= _FUZZ_EDGES) return;
+  _fuzzEdges[edge] = 1;
+  _fuzzHitEdges[_fuzzHitCount++] = edge;
+}
+
+// Coverage callbacks of the sanitizer instrumentation
+_BTR_NO_COVERAGE void __sanitizer_cov_trace_pc_guard_init(uint32_t* start, uint32_t* stop)
+{
+  if(start == stop || *start) return;
+  for(uint32_t* guard = start; guard < stop; guard++)
+    *guard = ++_fuzzGuards;
+}
+
+_BTR_NO_COVERAGE void __sanitizer_cov_trace_pc_guard(uint32_t* guard)
+{
+  _hitFuzzEdge(*guard % _FUZZ_EDGES);
+}
+
+_BTR_NO_COVERAGE void __sanitizer_cov_trace_pc()
+{
+  uintptr_t pc = (uintptr_t)__builtin_return_address(0);
+  _hitFuzzEdge((pc ^ (pc >> 16)) % _FUZZ_EDGES);
+}
+#endif
+
+// Merges the edges of the last run, telling whether any was new
+_BTR_NO_COVERAGE bool _fuzzFoundEdges()
+{
+#ifndef BTR_LIBFUZZER
+  bool found = false;
+  for(int i = 0; i < _fuzzHitCount; i++)
+  {
+    unsigned int edge = _fuzzHitEdges[i];
+    _fuzzEdges[edge] = 0;
+    if(_fuzzSeenEdges[edge]) continue;
+    _fuzzSeenEdges[edge] = 1;
+    _fuzz.edgesFound++;
+    found = true;
+  }
+  _fuzzHitCount = 0;
+  return found;
+#else
+  return false;
+#endif
+}
+
+void _fuzzFailure(char* file, int line, char* expr)
+{
+  _fuzz.failed = true;
+  _fuzz.failFile = file;
+  _fuzz.failLine = line;
+  _fuzz.failExpr = expr;
+  _btrLongjmp(_fuzz.jump);
+}
+
+bool _shouldRunFuzzTarget(int index, int line, char* name)
+{
+  if(_fuzzOneInput)
+  {
+    if(_fuzz.targetFound || (_fuzz.target && strcmp(_fuzz.target, name) != 0)) return false;
+    _fuzz.targetFound = true;
+  }
+  else
+  {
+    if(!_shouldRunTest(index, line, testEnv->_candidateContext)) return false;
+    _initializeTest(index, line, name);
+  }
+  _fuzz.name = name;
+  setupFunction();
+  return true;
+}
+
+void _addFuzzCorpus(const unsigned char* data, size_t size)
+{
+  _untrackedAllocations++;
+  if(_fuzz.corpusCount == _fuzz.corpusCapacity)
+  {
+    _fuzz.corpusCapacity = _fuzz.corpusCapacity ? _fuzz.corpusCapacity*2 : 64;
+    _fuzz.corpus = (_FuzzInput*)realloc(_fuzz.corpus, sizeof(_FuzzInput)*_fuzz.corpusCapacity);
+  }
+  _FuzzInput* input = &_fuzz.corpus[_fuzz.corpusCount++];
+  input->data = (unsigned char*)malloc(size + 1);
+  memcpy(input->data, data, size);
+  input->size = size;
+  _untrackedAllocations--;
+}
+
+void _startFuzz()
+{
+  _fuzz.onFail = onFail;
+  _fuzz.mockChangesCount = _mockChangesCount;
+  _fuzz.runtimeMocksCount = _runtimeMocksCount;
+  _fuzz.running = _fuzz.failed = false;
+  if(_fuzzOneInput)
+  {
+    _fuzz.mode = _FUZZ_ONE_INPUT;
+    return;
+  }
+  _fuzz.mode = _testOptions.fuzzRuns > 0 ? _FUZZ_MUTATE : _FUZZ_REPLAY;
+  _fuzz.runs = _testOptions.fuzzRuns;
+  _fuzz.random = _testOptions.hasSeed ? _testOptions.seed : _monotonicTime();
+
+  _untrackedAllocations++;
+  char* sourceName = _sourceFile;
+  for(char* c = _sourceFile; *c; c++)
+    if(*c == '/' || *c == '\\') sourceName = c + 1;
+  _fuzz.directory = (char*)malloc(strlen(fuzzInputsPath) + strlen(sourceName) + strlen(_fuzz.name) + 8);
+  sprintf(_fuzz.directory, "%s/%s.%s", fuzzInputsPath, sourceName, _fuzz.name);
+  _fuzz.fileCount = _isDirectory(_fuzz.directory) ? _listFiles(_fuzz.directory, 0) : 0;
+  _fuzz.files = (char**)malloc(sizeof(char*)*(_fuzz.fileCount + 1));
+  _listFiles(_fuzz.directory, _fuzz.files);
+  _fuzz.buffer = (unsigned char*)malloc(_FUZZ_MAX_INPUT);
+  _untrackedAllocations--;
+  _addFuzzCorpus(0, 0);
+}
+
+// Reads a saved input into the buffer, inputs longer than _FUZZ_MAX_INPUT are cut
+bool _loadFuzzInput(char* path)
+{
+  FILE* file = fopen(path, "rb");
+  if(!file) return false;
+  _fuzz.size = fread(_fuzz.buffer, 1, _FUZZ_MAX_INPUT, file);
+  fclose(file);
+  _fuzz.data = _fuzz.buffer;
+  _fuzz.inputPath = path;
+  return true;
+}
+
+void _mutateFuzzInput()
+{
+  static const unsigned char interesting[] = {0, 1, 2, 0x7F, 0x80, 0xFE, 0xFF, 16, 32, 64, 100};
+  _FuzzInput* base = &_fuzz.corpus[_nextRandom(&_fuzz.random) % _fuzz.corpusCount];
+  unsigned char* input = _fuzz.buffer;
+  size_t size = base->size;
+  memcpy(input, base->data, size);
+  for(int mutations = 1 + _nextRandom(&_fuzz.random) % 4; mutations > 0; mutations--)
+  {
+    unsigned long long random = _nextRandom(&_fuzz.random);
+    size_t position = size ? (random >> 8) % size : 0;
+    size_t length = 1 + (random >> 40) % 8;
+    switch(random % 7)
+    {
+      case 0: if(size) input[position] ^= 1 << ((random >> 32) % 8); break;
+      case 1: if(size) input[position] = (unsigned char)(random >> 32); break;
+      case 2: if(size) input[position] = interesting[(random >> 32) % sizeof(interesting)]; break;
+      case 3: if(size) input[position] += (unsigned char)((random >> 32) % 35 - 17); break;
+      case 4:
+        // Inserts random bytes
+        if(size + length > _FUZZ_MAX_INPUT) break;
+        position = (random >> 8) % (size + 1);
+        memmove(input + position + length, input + position, size - position);
+        for(size_t i = 0; i < length; i++)
+          input[position + i] = (unsigned char)_nextRandom(&_fuzz.random);
+        size += length;
+        break;
+      case 5:
+        // Deletes bytes
+        if(!size) break;
+        if(length > size - position) length = size - position;
+        memmove(input + position, input + position + length, size - position - length);
+        size -= length;
+        break;
+      case 6:
+      {
+        // Copies in part of another input
+        _FuzzInput* other = &_fuzz.corpus[(random >> 32) % _fuzz.corpusCount];
+        if(!other->size) break;
+        size_t start = _nextRandom(&_fuzz.random) % other->size;
+        length = 1 + _nextRandom(&_fuzz.random) % (other->size - start);
+        position = (random >> 8) % (size + 1);
+        if(position + length > _FUZZ_MAX_INPUT) length = _FUZZ_MAX_INPUT - position;
+        memcpy(input + position, other->data + start, length);
+        if(position + length > size) size = position + length;
+        break;
+      }
+    }
+  }
+  _fuzz.data = input;
+  _fuzz.size = size;
+  _fuzz.inputPath = 0;
+}
+
+unsigned long long _fuzzInputHash(const unsigned char* data, size_t size)
+{
+  unsigned long long hash = 0xCBF29CE484222325ULL;
+  for(size_t i = 0; i < size; i++)
+    hash = (hash ^ data[i])*0x100000001B3ULL;
+  return hash;
+}
+
+void _reportFuzzFailure()
+{
+  static char message[1024];
+  if(_fuzz.mode == _FUZZ_ONE_INPUT)
+  {
+    printf("\n[FAIL] on fuzz target \"%s\" failed %s:%i (%s)\n", _fuzz.name, _fuzz.failFile, _fuzz.failLine, _fuzz.failExpr);
+    fflush(stdout);
+    // Lets libFuzzer save the input
+    abort();
+  }
+  if(_fuzz.inputPath)
+    snprintf(message, sizeof(message), "%.500s with input %.400s", _fuzz.failExpr, _fuzz.inputPath);
+  else
+  {
+    char path[1024];
+    snprintf(path, sizeof(path), "%.900s/crash-%016llx", _fuzz.directory, _fuzzInputHash(_fuzz.data, _fuzz.size));
+    FILE* file = _makeParentDirectories(path) ? fopen(path, "wb") : 0;
+    if(file)
+    {
+      fwrite(_fuzz.data, 1, _fuzz.size, file);
+      fclose(file);
+    }
+    snprintf(message, sizeof(message), "%.500s after %lli runs, input saved to %.400s", _fuzz.failExpr, _fuzz.run,
+      file ? path : "nowhere");
+  }
+  _fuzz.onFail(_fuzz.failFile, _fuzz.failLine, message);
+}
+
+void _finishFuzz()
+{
+  if(_fuzz.mode == _FUZZ_MUTATE)
+  {
+    unsigned long long elapsed = _monotonicTime() - _fuzz.startTime;
+    printf("\n[FUZZ] on \"%s\" test \"%s\" %lli runs in %.3f s (%.0f runs/s), corpus of %i inputs, %i edges\n",
+      testEnv->testContext, _fuzz.name, _fuzz.run, elapsed/1e9, elapsed ? _fuzz.run*1e9/elapsed : 0.0, _fuzz.corpusCount,
+      _fuzz.edgesFound);
+  }
+  _untrackedAllocations++;
+  for(int i = 0; i < _fuzz.fileCount; i++)
+    free(_fuzz.files[i]);
+  for(int i = 0; i < _fuzz.corpusCount; i++)
+    free(_fuzz.corpus[i].data);
+  free(_fuzz.files);
+  free(_fuzz.corpus);
+  free(_fuzz.buffer);
+  free(_fuzz.directory);
+  _untrackedAllocations--;
+  _fuzz.files = 0;
+  _fuzz.corpus = 0;
+  _fuzz.corpusCount = _fuzz.corpusCapacity = _fuzz.fileCount = _fuzz.fileIndex = 0;
+  _fuzz.run = 0;
+  _fuzz.ranEmpty = false;
+}
+
+// Picks the input for the next run, after looking at the outcome of the last one. Returns false once done
+bool _nextFuzzInput()
+{
+  onFail = _fuzz.onFail;
+  if(_fuzz.running)
+  {
+    _fuzz.running = false;
+    _restoreMocks(_fuzz.mockChangesCount);
+    _restoreRuntimeMocks(_fuzz.runtimeMocksCount);
+    if(_fuzz.failed)
+    {
+      _reportFuzzFailure();
+      return false;
+    }
+    if(_fuzzFoundEdges() && _fuzz.mode == _FUZZ_MUTATE && !_fuzz.inputPath)
+      _addFuzzCorpus(_fuzz.data, _fuzz.size);
+    if(_fuzz.mode == _FUZZ_ONE_INPUT)
+    {
+      cleanFunction();
+      return false;
+    }
+  }
+  else if(_fuzz.mode != _FUZZ_ONE_INPUT)
+    _fuzz.startTime = _monotonicTime();
+
+  bool next = false;
+  if(_fuzz.mode == _FUZZ_ONE_INPUT)
+    next = true;
+  while(!next && _fuzz.fileIndex < _fuzz.fileCount)
+    if(_loadFuzzInput(_fuzz.files[_fuzz.fileIndex++]))
+    {
+      if(_fuzz.mode == _FUZZ_MUTATE) _addFuzzCorpus(_fuzz.data, _fuzz.size);
+      next = true;
+    }
+  if(!next && _fuzz.mode == _FUZZ_REPLAY && !_fuzz.ranEmpty && _fuzz.fileCount == 0)
+  {
+    _fuzz.data = _fuzz.buffer;
+    _fuzz.size = 0;
+    _fuzz.inputPath = 0;
+    _fuzz.ranEmpty = next = true;
+  }
+  if(!next && _fuzz.mode == _FUZZ_MUTATE && _fuzz.run < _fuzz.runs)
+  {
+    _mutateFuzzInput();
+    _fuzz.run++;
+    next = true;
+  }
+  if(!next)
+  {
+    _finishFuzz();
+    return false;
+  }
+  _fuzz.running = true;
+  _fuzz.failed = false;
+  onFail = _fuzzFailure;
+  return true;
+}
+
+// Runs the selected fuzz target with one input given by libFuzzer
+int _runFuzzInput(const unsigned char* data, size_t size, int (*allTests)())
+{
+  static TestEnvironment environment;
+  if(!testEnv)
+  {
+    testEnv = &environment;
+    environment._helperBlockIndex = &environment.helperMemoryBlock[0];
+    environment.testContext = _C_STRING_LITERAL("global");
+    environment.testDescription = _C_STRING_LITERAL("setup");
+    _allTestsFunction = allTests;
+    _fuzz.target = getenv("BTR_FUZZ_TARGET");
+  }
+  _fuzzOneInput = true;
+  _fuzz.targetFound = false;
+  _fuzz.data = (unsigned char*)data;
+  _fuzz.size = size;
+  _fuzz.inputPath = 0;
+  allTests();
+  _restoreMocks(0);
+  _restoreRuntimeMocks(0);
+  return 0;
+}
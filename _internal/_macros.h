@@ -37,13 +37,43 @@ extern "C"
 #define _C_STRING_LITERAL(literal) literal
 #endif
 
+#ifdef _MSC_VER
+#define _BTR_THREAD_LOCAL __declspec(thread)
+#else
+#define _BTR_THREAD_LOCAL __thread
+#endif
+
+// Jumps that also restore the signal mask, as failures may come from a signal handler
+#ifdef _WIN32
+#define _BTR_JMP_BUF jmp_buf
+#define _btrSetjmp(buffer) setjmp(buffer)
+#define _btrLongjmp(buffer) longjmp(buffer, 1)
+#else
+#define _BTR_JMP_BUF sigjmp_buf
+#define _btrSetjmp(buffer) sigsetjmp(buffer, 1)
+#define _btrLongjmp(buffer) siglongjmp(buffer, 1)
+#endif
+
+// Replacements of libc functions must repeat the exception specification of their C++ declarations
+#ifdef __cplusplus
+#define _BTR_NOTHROW __THROW
+#else
+#define _BTR_NOTHROW
+#endif
+
 #include <stdio.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <signal.h>
+#include <time.h>
+#include <setjmp.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define 🐛 beginTests
 #define 🚀 endTests
@@ -54,6 +84,24 @@ extern "C"
 #define refute(boolean) _assert(_C_STRING_LITERAL(__FILE__), __LINE__, !(boolean), _C_STRING_LITERAL(#boolean))
 #define refute_called(mockedFunction) assert(mockCalls(mockedFunction) == 0)
 
+// Compare buffers of size bytes, arrays of count elements, and float or double arrays within a tolerance
+#define assert_mem_eq(actual, expected, size) _assertMemEq(_C_STRING_LITERAL(__FILE__), __LINE__, actual, expected, size, 1,\
+  _C_STRING_LITERAL(#actual " and " #expected))
+#define assert_array_eq(actual, expected, count) _assertMemEq(_C_STRING_LITERAL(__FILE__), __LINE__, actual, expected,\
+  (count)*sizeof(*(actual)), sizeof(*(actual)), _C_STRING_LITERAL(#actual " and " #expected))
+#define assert_array_near(actual, expected, count, tolerance) _assertArrayNear(_C_STRING_LITERAL(__FILE__), __LINE__, actual,\
+  expected, count, _arrayNearType(actual), _arrayNearType(expected), tolerance, _C_STRING_LITERAL(#actual " and " #expected))
+
+#define _TIMING_SAMPLES 31
+#define _TIMING_MIN_BATCH_NS 20000
+// Fails when the median time of the expression is above the budget, given in nanoseconds
+#define assert_faster_than(expression, budgetNanoseconds) do{\
+    _TimingRun _timingRun = _startTiming();\
+    do{ for(int _timingIndex = 0; _timingIndex < _timingRun.batchSize; _timingIndex++){ expression; } }\
+    while(_nextTimingBatch(&_timingRun));\
+    _assertTiming(_C_STRING_LITERAL(__FILE__), __LINE__, &_timingRun, budgetNanoseconds, _C_STRING_LITERAL(#expression));\
+  }while(0)
+
 #define beginTests \
   int _allTests(){ int _testCount = 0; int _testRunning = 0; int _testDefinition = 0; {
 
@@ -71,20 +119,62 @@ extern "C"
     _testRunning++;\
     setupFunction();
 
-#define mock(function, newFunction) _mock(_C_STRING_LITERAL(__FILE__), __LINE__, _C_STRING_LITERAL(#function), (void*)newFunction, _mocks)
+// Like test, but the body runs for iterationCount generated cases, drawing its inputs with anyInt and the other any*
+// functions. A failure is shrunk to a small counterexample and reported with the seed, which --seed replays.
+// Every case runs with the mocks of the context and its own setupFunction and cleanFunction calls
+#define property(description, iterationCount) \
+  _finishLastScope()\
+  _testDefinition++;\
+  if(_shouldRunTest(_testCount++, __LINE__, testEnv->_candidateContext)){\
+    _initializeTest(_testCount-1, __LINE__, _C_STRING_LITERAL(description));\
+    _testRunning++;\
+    setupFunction();\
+    for(_startProperty(__LINE__, iterationCount); _nextPropertyCase();)\
+      if(_btrSetjmp(_property.jump) == 0)
+
+// Like test, but the body runs in process for every input, given by fuzzData and fuzzSize. See _internal/_fuzz.h
+#define fuzz_target(name) \
+  _finishLastScope()\
+  _testDefinition++;\
+  if(_shouldRunFuzzTarget(_testCount++, __LINE__, _C_STRING_LITERAL(name))){\
+    _testRunning += !_fuzzOneInput;\
+    for(_startFuzz(); _nextFuzzInput();)\
+      if(_btrSetjmp(_fuzz.jump) == 0)
+
+// Runs the body iterations times on each of the threads, which start together, the calling thread being thread 0.
+// The other threads reach the body by running the file from the start, skipping tests, setup and mock calls, so the
+// rest of the code at the scope of contexts runs once per thread and must not have side effects
+#define stress_test(description, threadCount, iterationCount) \
+  _finishLastScope()\
+  _testDefinition++;\
+  if(_shouldRunStressTest(_testCount++, __LINE__, _C_STRING_LITERAL(description), threadCount, iterationCount)){\
+    _testRunning++;\
+    for(long long _stressIteration = _startStress(); _stressIteration < _stressTest.iterations || _endStress(); _stressIteration++)
+
+#define mock(function, newFunction) _mock(_C_STRING_LITERAL(__FILE__), __LINE__, _C_STRING_LITERAL(#function), (void*)newFunction, &_mocks)
 
-#define mockReset(function) _mockReset(_C_STRING_LITERAL(__FILE__), __LINE__, _C_STRING_LITERAL(#function), _mocks)
+#define mockReset(function) _mockReset(_C_STRING_LITERAL(__FILE__), __LINE__, _C_STRING_LITERAL(#function), &_mocks)
 
-#define mockCalls(function) _getMock(_C_STRING_LITERAL(__FILE__), __LINE__, _C_STRING_LITERAL(#function), _mocks)->calls
+#define mockCalls(function) _mocks.calls[_getMock(_C_STRING_LITERAL(__FILE__), __LINE__, _C_STRING_LITERAL(#function), &_mocks)]
 
-#define mockGetOrginal(function) _getMock(_C_STRING_LITERAL(__FILE__), __LINE__, _C_STRING_LITERAL(#function), _mocks)->original
+#define mockRuntime(function, newFunction) _mockRuntime(_C_STRING_LITERAL(__FILE__), __LINE__, _C_STRING_LITERAL(#function), (void*)function, (void*)newFunction)
+
+#define mockRuntimeReset(function) _mockRuntimeReset(_C_STRING_LITERAL(__FILE__), __LINE__, _C_STRING_LITERAL(#function))
+
+#define mockGetOrginal(function) _mocks.originals[_getMock(_C_STRING_LITERAL(__FILE__), __LINE__, _C_STRING_LITERAL(#function), &_mocks)]
 
 #define testAlloc(type) (type*)(testEnv->_helperBlockIndex += sizeof(type), testEnv->_helperBlockIndex - sizeof(type))
 
+#ifdef BTR_LIBFUZZER
+#define endTests _finishLastScope() return _testCount; }\
+  int LLVMFuzzerTestOneInput(const unsigned char* data, size_t size){\
+    _sourceFile = _C_STRING_LITERAL(__FILE__);\
+    return _runFuzzInput(data, size, _allTests);\
+  }
+#else
 #define endTests _finishLastScope() return _testCount; }\
   int main(int numArgs, char** args){\
     _sourceFile = _C_STRING_LITERAL(__FILE__);\
     return _testFileMain(numArgs, args, _allTests);\
   }
-
-#define _BTR_MAX_NAME_SIZE 512
\ No newline at end of file
+#endif
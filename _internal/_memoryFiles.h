@@ -0,0 +1,316 @@
+// This content is part of test.h
+// In memory files, enabled by defining BTR_MEMORY_FILES before including test.h
+// The test binary replaces open, openat, fopen, stat, access, unlink, remove, rename and mkdir so that paths under
+// memoryFilesPrefix name memfd files instead of files on disk. They get real descriptors, so read, write, fread,
+// fwrite, lseek and close work unchanged. Directories only exist while they have files, so mkdir does nothing for them.
+// Other calls taking paths, such as the *at functions given a relative path, see the files on disk.
+// Every test starts with no files
+
+char* memoryFilesPrefix = _C_STRING_LITERAL("/memory/");
+
+#ifdef BTR_MEMORY_FILES
+#ifndef __linux__
+#error "BTR_MEMORY_FILES is only supported on Linux"
+#endif
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+// O_TMPFILE takes a mode too, glibc tells which flags do
+#ifdef __OPEN_NEEDS_MODE
+#define _openNeedsMode(flags) __OPEN_NEEDS_MODE(flags)
+#else
+#define _openNeedsMode(flags) ((flags) & O_CREAT)
+#endif
+
+typedef struct
+{
+  char* path;
+  int descriptor;
+} _MemoryFile;
+
+_MemoryFile* _memoryFiles = 0;
+int _memoryFilesCount = 0;
+int _memoryFilesCapacity = 0;
+int _memoryFilesLock = 0;
+
+bool _isMemoryFilePath(const char* path)
+{
+  return path && strncmp(path, memoryFilesPrefix, strlen(memoryFilesPrefix)) == 0;
+}
+
+_MemoryFile* _findMemoryFile(const char* path)
+{
+  for(int i = 0; i < _memoryFilesCount; i++)
+    if(strcmp(_memoryFiles[i].path, path) == 0) return &_memoryFiles[i];
+  return 0;
+}
+
+_MemoryFile* _createMemoryFile(const char* path)
+{
+  int descriptor = syscall(SYS_memfd_create, "btr", 0);
+  if(descriptor < 0) return 0;
+  _untrackedAllocations++;
+  if(_memoryFilesCount == _memoryFilesCapacity)
+  {
+    _memoryFilesCapacity = _memoryFilesCapacity ? _memoryFilesCapacity*2 : 16;
+    _memoryFiles = (_MemoryFile*)realloc(_memoryFiles, sizeof(_MemoryFile)*_memoryFilesCapacity);
+  }
+  _MemoryFile* file = &_memoryFiles[_memoryFilesCount++];
+  file->path = strdup(path);
+  file->descriptor = descriptor;
+  _untrackedAllocations--;
+  return file;
+}
+
+// Opens a new description of the memfd through /proc, so every open has its own offset and flags
+int _openMemoryFile(const char* path, int flags, mode_t mode)
+{
+  while(__sync_lock_test_and_set(&_memoryFilesLock, 1));
+  _MemoryFile* file = _findMemoryFile(path);
+  int error = 0;
+  if(file && (flags & O_CREAT) && (flags & O_EXCL)) error = EEXIST;
+  else if(!file && !(flags & O_CREAT)) error = ENOENT;
+  else if(!file && !(file = _createMemoryFile(path))) error = EMFILE;
+  int descriptor = -1;
+  if(!error)
+  {
+    char procPath[64];
+    sprintf(procPath, "/proc/self/fd/%i", file->descriptor);
+    descriptor = openat(AT_FDCWD, procPath, flags & ~(O_CREAT | O_EXCL), mode);
+  }
+  __sync_lock_release(&_memoryFilesLock);
+  if(error) errno = error;
+  return descriptor;
+}
+
+int _statMemoryFile(const char* path, struct stat* status)
+{
+  while(__sync_lock_test_and_set(&_memoryFilesLock, 1));
+  _MemoryFile* file = _findMemoryFile(path);
+  int result = file ? fstat(file->descriptor, status) : -1;
+  size_t length = strlen(path);
+  // Directories exist as long as there are files in them
+  for(int i = 0; !file && i < _memoryFilesCount; i++)
+    if(strncmp(_memoryFiles[i].path, path, length) == 0 && (path[length - 1] == '/' || _memoryFiles[i].path[length] == '/'))
+    {
+      memset(status, 0, sizeof(*status));
+      status->st_mode = S_IFDIR | 0755;
+      result = 0;
+      break;
+    }
+  __sync_lock_release(&_memoryFilesLock);
+  if(result < 0 && !file) errno = ENOENT;
+  return result;
+}
+
+void _removeMemoryFile(_MemoryFile* file)
+{
+  close(file->descriptor);
+  _untrackedAllocations++;
+  free(file->path);
+  _untrackedAllocations--;
+  *file = _memoryFiles[--_memoryFilesCount];
+}
+
+int _unlinkMemoryFile(const char* path)
+{
+  while(__sync_lock_test_and_set(&_memoryFilesLock, 1));
+  _MemoryFile* file = _findMemoryFile(path);
+  if(file) _removeMemoryFile(file);
+  __sync_lock_release(&_memoryFilesLock);
+  if(!file) errno = ENOENT;
+  return file ? 0 : -1;
+}
+
+// Replaces the file at the new path, if any, as rename does
+int _renameMemoryFile(const char* from, const char* to)
+{
+  while(__sync_lock_test_and_set(&_memoryFilesLock, 1));
+  _MemoryFile* file = _findMemoryFile(from);
+  _MemoryFile* replaced = _findMemoryFile(to);
+  if(file && replaced && replaced != file)
+  {
+    _removeMemoryFile(replaced);
+    file = _findMemoryFile(from);
+  }
+  if(file)
+  {
+    _untrackedAllocations++;
+    char* path = strdup(to);
+    _untrackedAllocations--;
+    if(path)
+    {
+      _untrackedAllocations++;
+      free(file->path);
+      _untrackedAllocations--;
+      file->path = path;
+    }
+    else
+      file = 0;
+  }
+  __sync_lock_release(&_memoryFilesLock);
+  if(!file) errno = ENOENT;
+  return file ? 0 : -1;
+}
+
+void _resetMemoryFiles()
+{
+  while(__sync_lock_test_and_set(&_memoryFilesLock, 1));
+  _untrackedAllocations++;
+  for(int i = 0; i < _memoryFilesCount; i++)
+  {
+    close(_memoryFiles[i].descriptor);
+    free(_memoryFiles[i].path);
+  }
+  _untrackedAllocations--;
+  _memoryFilesCount = 0;
+  __sync_lock_release(&_memoryFilesLock);
+}
+
+int _openFlagsForMode(const char* mode)
+{
+  int flags = strchr(mode, '+') ? O_RDWR : mode[0] == 'r' ? O_RDONLY : O_WRONLY;
+  if(mode[0] == 'w') flags |= O_CREAT | O_TRUNC;
+  if(mode[0] == 'a') flags |= O_CREAT | O_APPEND;
+  if(strchr(mode, 'x')) flags |= O_EXCL;
+  return flags;
+}
+
+int openat(int directory, const char* path, int flags, ...)
+{
+  mode_t mode = 0;
+  if(_openNeedsMode(flags))
+  {
+    va_list args;
+    va_start(args, flags);
+    mode = va_arg(args, int);
+    va_end(args);
+  }
+  // Memory file paths are absolute, so the directory does not change them
+  if(_isMemoryFilePath(path)) return _openMemoryFile(path, flags, mode);
+  static int (*realOpen)(int, const char*, int, ...) = 0;
+  if(!realOpen) *(void**)&realOpen = _realFunction("openat");
+  return realOpen(directory, path, flags, mode);
+}
+
+int open(const char* path, int flags, ...)
+{
+  mode_t mode = 0;
+  if(_openNeedsMode(flags))
+  {
+    va_list args;
+    va_start(args, flags);
+    mode = va_arg(args, int);
+    va_end(args);
+  }
+  if(_isMemoryFilePath(path)) return _openMemoryFile(path, flags, mode);
+  return openat(AT_FDCWD, path, flags, mode);
+}
+
+FILE* fopen(const char* path, const char* mode)
+{
+  if(!_isMemoryFilePath(path))
+  {
+    static FILE* (*realOpen)(const char*, const char*) = 0;
+    if(!realOpen) *(void**)&realOpen = _realFunction("fopen");
+    return realOpen(path, mode);
+  }
+  int descriptor = _openMemoryFile(path, _openFlagsForMode(mode), 0666);
+  if(descriptor < 0) return 0;
+  FILE* file = fdopen(descriptor, mode);
+  if(!file) close(descriptor);
+  return file;
+}
+
+int stat(const char* path, struct stat* status) _BTR_NOTHROW
+{
+  if(_isMemoryFilePath(path)) return _statMemoryFile(path, status);
+  return fstatat(AT_FDCWD, path, status, 0);
+}
+
+int unlink(const char* path) _BTR_NOTHROW
+{
+  if(_isMemoryFilePath(path)) return _unlinkMemoryFile(path);
+  return unlinkat(AT_FDCWD, path, 0);
+}
+
+int access(const char* path, int mode) _BTR_NOTHROW
+{
+  struct stat status;
+  if(_isMemoryFilePath(path)) return _statMemoryFile(path, &status);
+  return faccessat(AT_FDCWD, path, mode, 0);
+}
+
+int remove(const char* path) _BTR_NOTHROW
+{
+  if(!_isMemoryFilePath(path))
+  {
+    static int (*realRemove)(const char*) = 0;
+    if(!realRemove) *(void**)&realRemove = _realFunction("remove");
+    return realRemove(path);
+  }
+  struct stat status;
+  if(_unlinkMemoryFile(path) == 0) return 0;
+  // A directory that exists has files in it
+  if(_statMemoryFile(path, &status) == 0) errno = ENOTEMPTY;
+  return -1;
+}
+
+int rename(const char* from, const char* to) _BTR_NOTHROW
+{
+  if(_isMemoryFilePath(from) && _isMemoryFilePath(to)) return _renameMemoryFile(from, to);
+  if(!_isMemoryFilePath(from) && !_isMemoryFilePath(to)) return renameat(AT_FDCWD, from, AT_FDCWD, to);
+  errno = EXDEV;
+  return -1;
+}
+
+int mkdir(const char* path, mode_t mode) _BTR_NOTHROW
+{
+  if(!_isMemoryFilePath(path)) return mkdirat(AT_FDCWD, path, mode);
+  while(__sync_lock_test_and_set(&_memoryFilesLock, 1));
+  bool exists = _findMemoryFile(path) != 0;
+  __sync_lock_release(&_memoryFilesLock);
+  if(exists) errno = EEXIST;
+  return exists ? -1 : 0;
+}
+
+// With _FILE_OFFSET_BITS=64 the functions above already are the 64 bit variants
+#ifndef __USE_FILE_OFFSET64
+int open64(const char* path, int flags, ...)
+{
+  mode_t mode = 0;
+  if(_openNeedsMode(flags))
+  {
+    va_list args;
+    va_start(args, flags);
+    mode = va_arg(args, int);
+    va_end(args);
+  }
+  return open(path, flags, mode);
+}
+
+int openat64(int directory, const char* path, int flags, ...)
+{
+  mode_t mode = 0;
+  if(_openNeedsMode(flags))
+  {
+    va_list args;
+    va_start(args, flags);
+    mode = va_arg(args, int);
+    va_end(args);
+  }
+  return openat(directory, path, flags, mode);
+}
+
+FILE* fopen64(const char* path, const char* mode)
+{
+  return fopen(path, mode);
+}
+#endif
+#else
+void _resetMemoryFiles(){}
+#endif
@@ -1,7 +1,7 @@
 // This content is part of test.h
 // Mock functionalities
 
-int _writeArgs(FILE* file, char* args)
+int _writeArgs(FILE* file, const char* args)
 {
   int argsCount = 0;
   int argsSize = strlen(args);
@@ -29,137 +29,1023 @@ int _writeArgs(FILE* file, char* args)
   return argsCount;
 }
 
-void _getMockedName(char* output, char* functioName)
+void _getMockedName(char* output, const char* functioName)
 {
   strcpy(output, "🐛");
   strcat(output, functioName);
   strcat(output, "🚀");
 }
 
-FunctionMock* _getMock(char* file, int line, char* functionName, FunctionMock* mocks)
+typedef struct _MockChange _MockChange;
+
+// Every mock slot write is pushed with the value it replaced, so contexts undo only what changed by popping back to a count
+struct _MockChange
 {
-  if(!testEnv->globalContext.mocksSnapshot)
+  void** slot;
+  void* previous;
+};
+
+_MockChange* _mockChanges = 0;
+int _mockChangesCapacity = 0;
+
+void _setMockSlot(void** slot, void* function)
+{
+  if(_mockChangesCount == _mockChangesCapacity)
   {
-    testEnv->globalContext.mocksPointer = mocks;
-    if(testEnv->globalContext.set)
-      _snapShotGlobalMocks();
+    _mockChangesCapacity = _mockChangesCapacity ? _mockChangesCapacity*2 : 64;
+    _untrackedAllocations++;
+    _mockChanges = (_MockChange*)realloc(_mockChanges, sizeof(_MockChange)*_mockChangesCapacity);
+    _untrackedAllocations--;
   }
-  
-  FunctionMock* mock = 0;
-  for(int i = 0; mocks[i].set; i++)
+  _mockChanges[_mockChangesCount].slot = slot;
+  _mockChanges[_mockChangesCount++].previous = *slot;
+  *slot = function;
+}
+
+void _restoreMocks(int count)
+{
+  while(_mockChangesCount > count)
   {
-    if(strcmp(mocks[i].name, functionName) == 0)
-    {
-      mock = &mocks[i];
-      break;
-    }
+    _MockChange* change = &_mockChanges[--_mockChangesCount];
+    *change->slot = change->previous;
+  }
+}
+
+// Returns the index of the function in the table, or count when it is not found
+int _getMock(char* file, int line, char* functionName, MockTable* mocks)
+{
+  int low = 0, high = mocks->count - 1;
+  while(low <= high)
+  {
+    int middle = (low + high)/2;
+    int comparison = strcmp(mocks->names + mocks->nameOffsets[middle], functionName);
+    if(comparison == 0) return middle;
+    if(comparison < 0) low = middle + 1;
+    else high = middle - 1;
   }
 
-  char message[_BTR_MAX_NAME_SIZE];
+  char message[strlen(functionName) + 64];
   strcpy(message, "Could not mock function ");
   strcat(message, functionName);
-  if(!mock) onFail(file, line, message);
+  onFail(file, line, message);
+  return mocks->count;
+}
+
+// Stress test threads other than 0 run the code of the contexts again on their way to the body, where mocking is left
+// to thread 0 so the mock tables are only changed by one thread
+void _mock(char* file, int line, char* functionName, void* function, MockTable* mocks)
+{
+  if(_stressThread > 0) return;
+  int index = _getMock(file, line, functionName, mocks);
+  if(index < mocks->count) _setMockSlot(&mocks->slots[index], function);
+}
+
+bool _runtimeMockReset(char* functionName);
+
+void _mockReset(char* file, int line, char* functionName, MockTable* mocks)
+{
+  if(_stressThread > 0) return;
+  if(_runtimeMockReset(functionName)) return;
+  int index = _getMock(file, line, functionName, mocks);
+  if(index < mocks->count) _setMockSlot(&mocks->slots[index], mocks->originals[index]);
+}
+
+typedef struct _RuntimeMock _RuntimeMock;
+
+#define _RUNTIME_MOCK_PATCH_SIZE 14
+#define _RUNTIME_MOCK_SHORT_PATCH_SIZE 5
+
+// Runtime mocks patch a jump into the prologue of the function, no mock file or mockable lib is needed
+// Every patch and reset is pushed with the bytes it overwrote, so contexts undo them by popping back to a count
+struct _RuntimeMock
+{
+  const char* name;
+  void* address;
+  int size;
+  unsigned char saved[_RUNTIME_MOCK_PATCH_SIZE];
+};
+
+_RuntimeMock* _runtimeMocks = 0;
+int _runtimeMocksCapacity = 0;
+
+// Overwrites executable code, implemented by the platform specific section
+bool _writeCode(void* address, const void* code, int size);
+// Size in bytes of the function starting at address, -1 when unknown, implemented by the platform specific section
+long long _functionSize(void* address);
+
+bool _pushRuntimeMock(const char* name, void* address, const unsigned char* code, int size)
+{
+  if(_runtimeMocksCount == _runtimeMocksCapacity)
+  {
+    _runtimeMocksCapacity = _runtimeMocksCapacity ? _runtimeMocksCapacity*2 : 16;
+    _untrackedAllocations++;
+    _runtimeMocks = (_RuntimeMock*)realloc(_runtimeMocks, sizeof(_RuntimeMock)*_runtimeMocksCapacity);
+    _untrackedAllocations--;
+  }
+  _RuntimeMock* runtimeMock = &_runtimeMocks[_runtimeMocksCount];
+  runtimeMock->name = name;
+  runtimeMock->address = address;
+  runtimeMock->size = size;
+  memcpy(runtimeMock->saved, address, size);
+  if(!_writeCode(address, code, size)) return false;
+  _runtimeMocksCount++;
+  return true;
+}
+
+void _restoreRuntimeMocks(int count)
+{
+  while(_runtimeMocksCount > count)
+  {
+    _RuntimeMock* runtimeMock = &_runtimeMocks[--_runtimeMocksCount];
+    _writeCode(runtimeMock->address, runtimeMock->saved, runtimeMock->size);
+  }
+}
+
+void _mockRuntime(char* file, int line, char* functionName, void* function, void* newFunction)
+{
+  if(_stressThread > 0) return;
+#if defined(__x86_64__) || defined(_M_X64)
+  // The patch size only depends on the function, so every patch and reset of it overwrites the same bytes
+  long long functionSize = _functionSize(function);
+  int size = functionSize >= _RUNTIME_MOCK_PATCH_SIZE ? _RUNTIME_MOCK_PATCH_SIZE : _RUNTIME_MOCK_SHORT_PATCH_SIZE;
+  long long distance = (long long)((char*)newFunction - ((char*)function + _RUNTIME_MOCK_SHORT_PATCH_SIZE));
+  unsigned char code[_RUNTIME_MOCK_PATCH_SIZE] = {0xFF, 0x25, 0, 0, 0, 0};
+  char message[strlen(functionName) + 128];
+  if(size == _RUNTIME_MOCK_PATCH_SIZE)
+    // jmp qword ptr [rip+0] followed by the absolute target, so no register is clobbered
+    memcpy(code + 6, &newFunction, sizeof(void*));
+  else if(functionSize >= 0 && functionSize < _RUNTIME_MOCK_SHORT_PATCH_SIZE)
+  {
+    sprintf(message, "Could not patch function %s, it is only %lli bytes long", functionName, functionSize);
+    onFail(file, line, message);
+    return;
+  }
+  else if(distance < INT32_MIN || distance > INT32_MAX)
+  {
+    sprintf(message, "Could not patch function %s, it is too short for a jump to a function that far", functionName);
+    onFail(file, line, message);
+    return;
+  }
+  else
+  {
+    // jmp rel32
+    int32_t relative = (int32_t)distance;
+    code[0] = 0xE9;
+    memcpy(code + 1, &relative, sizeof(relative));
+  }
+  sprintf(message, "Could not patch function %s", functionName);
+  if(!_pushRuntimeMock(functionName, function, code, size)) onFail(file, line, message);
+#else
+  onFail(file, line, _C_STRING_LITERAL("Runtime mocks are only supported on x86-64"));
+#endif
+}
+
+// The oldest patch of a function saved its original prologue
+bool _runtimeMockReset(char* functionName)
+{
+  for(int i = 0; i < _runtimeMocksCount; i++)
+    if(strcmp(_runtimeMocks[i].name, functionName) == 0)
+    {
+      unsigned char original[_RUNTIME_MOCK_PATCH_SIZE];
+      memcpy(original, _runtimeMocks[i].saved, _runtimeMocks[i].size);
+      return _pushRuntimeMock(functionName, _runtimeMocks[i].address, original, _runtimeMocks[i].size);
+    }
+  return false;
+}
+
+void _mockRuntimeReset(char* file, int line, char* functionName)
+{
+  if(_stressThread > 0) return;
+  char message[strlen(functionName) + 64];
+  strcpy(message, "Could not reset runtime mock of ");
+  strcat(message, functionName);
+  if(!_runtimeMockReset(functionName)) onFail(file, line, message);
+}
+
+typedef struct _TraceRecord _TraceRecord;
+typedef struct _TraceBuffer _TraceBuffer;
+
+#define _TRACE_BUFFER_SIZE 4096
+
+struct _TraceRecord
+{
+  unsigned long long timestamp;
+  int index;
+};
+
+// Each thread appends to its own buffer, new buffers are pushed to the global list without locking
+struct _TraceBuffer
+{
+  _TraceBuffer* next;
+  unsigned long long thread;
+  int count;
+  _TraceRecord records[_TRACE_BUFFER_SIZE];
+};
+
+_TraceBuffer* volatile _traceBuffers = 0;
+_BTR_THREAD_LOCAL _TraceBuffer* _traceBuffer = 0;
+MockTable* volatile _tracedMocks = 0;
+char* _tracePath = 0;
+int _traceTestIndex = 0;
+unsigned long long _traceStartClock = 0, _traceStartTime = 0;
+
+// Implemented by the platform specific section
+bool _makeParentDirectories(char* path);
+
+// Ticks are converted to time when the trace is written
+unsigned long long _traceClock()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc();
+#else
+  return _monotonicTime();
+#endif
+}
+
+_TraceBuffer* _pushTraceBuffer()
+{
+  _untrackedAllocations++;
+  _TraceBuffer* buffer = (_TraceBuffer*)malloc(sizeof(_TraceBuffer));
+  _untrackedAllocations--;
+  buffer->thread = _currentThreadId();
+  buffer->count = 0;
+  do
+    buffer->next = _traceBuffers;
+  while(!__sync_bool_compare_and_swap(&_traceBuffers, buffer->next, buffer));
+  return _traceBuffer = buffer;
+}
+
+// Called by the wrappers of mock files generated with MOCK_FILE_TRACE
+void _traceMockCall(MockTable* mocks, int index)
+{
+  if(!_tracePath) return;
+  if(_tracedMocks != mocks) _tracedMocks = mocks;
+  _TraceBuffer* buffer = _traceBuffer;
+  if(!buffer || buffer->count == _TRACE_BUFFER_SIZE) buffer = _pushTraceBuffer();
+  _TraceRecord* record = &buffer->records[buffer->count++];
+  record->timestamp = _traceClock();
+  record->index = index;
+}
+
+void _writeTrace()
+{
+  double nanosecondsPerTick = 1;
+  unsigned long long clock = _traceClock(), time = _monotonicTime();
+  if(clock != time && clock > _traceStartClock)
+    nanosecondsPerTick = (double)(time - _traceStartTime)/(clock - _traceStartClock);
+
+  FILE* file = _makeParentDirectories(_tracePath) ? fopen(_tracePath, "wb") : 0;
+  if(file) fprintf(file, "{\"traceEvents\":[");
+  const char* separator = "";
+  for(_TraceBuffer* buffer = _traceBuffers, *next; buffer; buffer = next)
+  {
+    for(int i = 0; file && i < buffer->count; i++)
+    {
+      _TraceRecord* record = &buffer->records[i];
+      fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"mock\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%i,\"tid\":%llu}",
+        separator, _tracedMocks->names + _tracedMocks->nameOffsets[record->index],
+        (long long)(record->timestamp - _traceStartClock)*nanosecondsPerTick/1000, _traceTestIndex, buffer->thread);
+      separator = ",";
+    }
+    next = buffer->next;
+    free(buffer);
+  }
+  if(file)
+  {
+    fprintf(file, "\n]}\n");
+    fclose(file);
+  }
+  _traceBuffers = 0;
+  free(_tracePath);
+  _tracePath = 0;
+}
 
-  return mock;
+// Records the mock calls of a test into a file written when the process exits, which takes ownership of the path
+void _startTrace(char* path, int testIndex)
+{
+  _tracePath = path;
+  _traceTestIndex = testIndex;
+  _traceStartTime = _monotonicTime();
+  _traceStartClock = _traceClock();
+  atexit(_writeTrace);
 }
 
-void _mock(char* file, int line, char* functionName, void* function, FunctionMock* mocks)
+#define _LATENCY_BUCKETS 64
+
+// Bucket b counts the calls that took from 2^b to 2^(b+1) clock ticks
+unsigned int (*_latencyBuckets)[_LATENCY_BUCKETS] = 0;
+MockTable* _latencyMocks = 0;
+char* _latencyTestContext = 0;
+char* _latencyTestDescription = 0;
+unsigned long long _latencyStartClock = 0, _latencyStartTime = 0;
+
+// The summary names the test that ran last, as calls may come before it from the code of its context
+void _nameLatencySummary(char* context, char* description)
 {
-  FunctionMock* mock = _getMock(file, line, functionName, mocks);
-  if(mock) *((void**)mock->mockPointer) = function;
+  _latencyTestContext = context;
+  _latencyTestDescription = description;
 }
 
-void _mockReset(char* file, int line, char* functionName, FunctionMock* mocks)
+// Called by the wrappers of mock files generated with MOCK_FILE_LATENCY
+unsigned long long _latencyStart()
 {
-  FunctionMock* mock = _getMock(file, line, functionName, mocks);
-  if(mock) *((void**)mock->mockPointer) = mock->original;
+  return _traceClock();
 }
 
-bool _createMockFile(char* mockFilePath, int functionCount, FunctionDescriptor* functions)
+double _latencyPercentile(unsigned int* buckets, unsigned long long total, double percentile, double nanosecondsPerTick)
+{
+  unsigned long long count = 0;
+  for(int b = 0; b < _LATENCY_BUCKETS; b++)
+    if((count += buckets[b]) >= total*percentile) return 2.0*(1ULL << b)*nanosecondsPerTick;
+  return 0;
+}
+
+void _writeLatencySummary()
+{
+  double nanosecondsPerTick = 1;
+  unsigned long long clock = _traceClock(), time = _monotonicTime();
+  if(clock != time && clock > _latencyStartClock)
+    nanosecondsPerTick = (double)(time - _latencyStartTime)/(clock - _latencyStartClock);
+
+  printf("\n[LATENCY] on \"%s\" test \"%s\" (upper bounds)\n", _latencyTestContext, _latencyTestDescription);
+  for(int i = 0; i < _latencyMocks->count; i++)
+  {
+    unsigned long long total = 0;
+    for(int b = 0; b < _LATENCY_BUCKETS; b++)
+      total += _latencyBuckets[i][b];
+    if(total)
+      printf("  %s: %llu calls, p50 %.0fns, p99 %.0fns\n", _latencyMocks->names + _latencyMocks->nameOffsets[i], total,
+        _latencyPercentile(_latencyBuckets[i], total, 0.5, nanosecondsPerTick), _latencyPercentile(_latencyBuckets[i], total, 0.99, nanosecondsPerTick));
+  }
+  fflush(stdout);
+}
+
+void _latencyEnd(MockTable* mocks, int index, unsigned long long start)
+{
+  unsigned long long ticks = _traceClock() - start;
+  if(!_latencyBuckets)
+  {
+    _untrackedAllocations++;
+    unsigned int (*buckets)[_LATENCY_BUCKETS] = (unsigned int (*)[_LATENCY_BUCKETS])calloc(mocks->count + 1, sizeof(*buckets));
+    _untrackedAllocations--;
+    if(!__sync_bool_compare_and_swap(&_latencyBuckets, 0, buckets))
+      free(buckets);
+    else
+    {
+      _latencyMocks = mocks;
+      _latencyStartClock = start;
+      _latencyStartTime = _monotonicTime();
+      atexit(_writeLatencySummary);
+    }
+  }
+  int bucket = 0;
+  while(ticks >>= 1) bucket++;
+  __sync_fetch_and_add(&_latencyBuckets[index][bucket], 1);
+}
+
+// Mock files either wrap the renamed functions of a mockable lib or, when interposing, the functions of a shared library
+// that are found with dlsym(RTLD_NEXT, ...). Modes are combined with the public MockFileOption flags
+enum _MockFileMode
+{
+  _MOCK_FILE_MODE_ARCHIVE = 0,
+  _MOCK_FILE_MODE_INTERPOSE = 0b001
+};
+
+void _writeMockWrapper(FILE* file, int index, FunctionDescriptor* function, const char* prefix, int mode)
+{
+  bool timed = mode & MOCK_FILE_LATENCY;
+  bool returns = strcmp(function->returnType, "void") != 0;
+  fprintf(file, "%s %s%s(", function->returnType, prefix, function->name);
+  int argsCount = _writeArgs(file, function->args);
+  fprintf(file, "){ _mockCalls[%i]++; ", index);
+  // Constructors of other libraries may call it before the mock file constructor resolved the original
+  if((mode & _MOCK_FILE_MODE_INTERPOSE) && !function->implementation)
+    fprintf(file, "if(!_mockSlots[%i]) _resolveInterposedMock(%i); ", index, index);
+  if(mode & MOCK_FILE_TRACE) fprintf(file, "_traceMockCall(&_mocks, %i); ", index);
+  if(timed) fprintf(file, "unsigned long long start = _latencyStart(); ");
+  if(timed && returns) fprintf(file, "%s result = ", function->returnType);
+  else if(!timed) fprintf(file, "return ");
+  fprintf(file, "_BTR_CONVERT(_mockSlots[%i], %s (*)(%s))(", index, function->returnType, function->args);
+  for(int a = 0; a < argsCount; a++)
+    if(a)
+      fprintf(file, ", a%i", a);
+    else
+      fprintf(file, "a%i", a);
+  fprintf(file, "); ");
+  if(timed) fprintf(file, "_latencyEnd(&_mocks, %i, start); ", index);
+  if(timed && returns) fprintf(file, "return result; ");
+  fprintf(file, "}\n");
+}
+
+// Emits the trampolines and the mock table straight into an x86-64 ELF object, so they need no compilation.
+// Trampolines count the call and jump through their slot, pass-through ones jump straight to the original while the slot
+// holds it
+bool _createMockObject(char* mockFilePath, int functionCount, FunctionDescriptor* functions, int mode)
+{
+#if defined(__x86_64__) && defined(__ELF__)
+  for(int i = 0; i < functionCount; i++)
+    if(functions[i].implementation || (mode & (_MOCK_FILE_MODE_INTERPOSE | MOCK_FILE_TRACE | MOCK_FILE_LATENCY)))
+    {
+      printf("Could not emit %s as an object file, mocks with implementations, interposed or instrumented mocks need a C mock file\n", mockFilePath);
+      return false;
+    }
+
+  _ElfObject object;
+  _elfObjectInit(&object);
+  unsigned int offsets[functionCount + 1];
+  for(int i = 0; i < functionCount; i++)
+    offsets[i] = _objectFileBufferAppend(&object.rodata, functions[i].name, strlen(functions[i].name) + 1);
+  offsets[functionCount] = _objectFileBufferAppend(&object.rodata, "", 1);
+  _objectFileBufferAlign(&object.rodata, 8, 0);
+  long long nameOffsets = _objectFileBufferAppend(&object.rodata, offsets, sizeof(offsets));
+
+  long long table = _objectFileBufferAppend(&object.data, 0, sizeof(MockTable));
+  _objectFileBufferAlign(&object.data, 8, 0);
+  long long calls = _objectFileBufferAppend(&object.data, 0, sizeof(int)*(functionCount + 1));
+  _objectFileBufferAlign(&object.data, 8, 0);
+  long long slots = _objectFileBufferAppend(&object.data, 0, sizeof(void*)*(functionCount + 1));
+  long long originals = _objectFileBufferAppend(&object.data, 0, sizeof(void*)*(functionCount + 1));
+  memcpy(object.data.data + table + offsetof(MockTable, count), &functionCount, sizeof(int));
+  _elfObjectAddSymbol(&object, "_mocks", _ELF_OBJECT_DATA, 1, table, sizeof(MockTable));
+  _elfObjectAddSymbol(&object, "_mockCalls", _ELF_OBJECT_DATA, 1, calls, sizeof(int)*(functionCount + 1));
+  _elfObjectAddSymbol(&object, "_mockSlots", _ELF_OBJECT_DATA, 1, slots, sizeof(void*)*(functionCount + 1));
+  _elfObjectAddSymbol(&object, "_mockOriginals", _ELF_OBJECT_DATA, 1, originals, sizeof(void*)*(functionCount + 1));
+  _elfObjectAddRelocation(&object, _ELF_OBJECT_DATA, table + offsetof(MockTable, names), _ELF_OBJECT_RODATA, _ELF_R_X86_64_64, 0);
+  _elfObjectAddRelocation(&object, _ELF_OBJECT_DATA, table + offsetof(MockTable, nameOffsets), _ELF_OBJECT_RODATA, _ELF_R_X86_64_64, nameOffsets);
+  _elfObjectAddRelocation(&object, _ELF_OBJECT_DATA, table + offsetof(MockTable, calls), _ELF_OBJECT_DATA, _ELF_R_X86_64_64, calls);
+  _elfObjectAddRelocation(&object, _ELF_OBJECT_DATA, table + offsetof(MockTable, slots), _ELF_OBJECT_DATA, _ELF_R_X86_64_64, slots);
+  _elfObjectAddRelocation(&object, _ELF_OBJECT_DATA, table + offsetof(MockTable, originals), _ELF_OBJECT_DATA, _ELF_R_X86_64_64, originals);
+
+  bool passThrough = mode & MOCK_FILE_PASS_THROUGH;
+  for(int i = 0; i < functionCount; i++)
+  {
+    const char* name = functions[i].name;
+    char mockedName[strlen(name) + 64];
+    _getMockedName(mockedName, name);
+    long long callsEntry = calls + sizeof(int)*i;
+    long long slot = slots + sizeof(void*)*i;
+    int original = _elfObjectAddSymbol(&object, mockedName, _ELF_OBJECT_UNDEFINED, 0, 0, 0);
+    _elfObjectAddRelocation(&object, _ELF_OBJECT_DATA, slot, original, _ELF_R_X86_64_64, 0);
+    _elfObjectAddRelocation(&object, _ELF_OBJECT_DATA, originals + sizeof(void*)*i, original, _ELF_R_X86_64_64, 0);
+
+    // incl calls(%rip)
+    const unsigned char count[] = {0xFF, 0x05, 0, 0, 0, 0};
+    long long start = _objectFileBufferAppend(&object.text, count, sizeof(count));
+    _elfObjectAddRelocation(&object, _ELF_OBJECT_TEXT, start + 2, _ELF_OBJECT_DATA, _ELF_R_X86_64_PC32, callsEntry - 4);
+    if(passThrough)
+    {
+      // leaq original(%rip), %r11; cmpq %r11, slot(%rip); jne mocked; jmp original
+      const unsigned char check[] = {0x4C, 0x8D, 0x1D, 0, 0, 0, 0, 0x4C, 0x39, 0x1D, 0, 0, 0, 0, 0x0F, 0x85, 5, 0, 0, 0, 0xE9, 0, 0, 0, 0};
+      long long checked = _objectFileBufferAppend(&object.text, check, sizeof(check));
+      _elfObjectAddRelocation(&object, _ELF_OBJECT_TEXT, checked + 3, original, _ELF_R_X86_64_PC32, -4);
+      _elfObjectAddRelocation(&object, _ELF_OBJECT_TEXT, checked + 10, _ELF_OBJECT_DATA, _ELF_R_X86_64_PC32, slot - 4);
+      _elfObjectAddRelocation(&object, _ELF_OBJECT_TEXT, checked + 21, original, _ELF_R_X86_64_PLT32, -4);
+    }
+    // mocked: jmp *slot(%rip)
+    const unsigned char jump[] = {0xFF, 0x25, 0, 0, 0, 0};
+    long long mocked = _objectFileBufferAppend(&object.text, jump, sizeof(jump));
+    _elfObjectAddRelocation(&object, _ELF_OBJECT_TEXT, mocked + 2, _ELF_OBJECT_DATA, _ELF_R_X86_64_PC32, slot - 4);
+    // Padding keeps room for patching runtime mocks over the trampoline
+    _objectFileBufferAlign(&object.text, 16, (char)0xCC);
+    _elfObjectAddSymbol(&object, name, _ELF_OBJECT_TEXT, 2, start, object.text.size - start);
+  }
+
+  bool ret = _elfObjectWrite(&object, mockFilePath);
+  _elfObjectFree(&object);
+  return ret;
+#else
+  printf("Could not emit %s, mock object files are only supported on x86-64 ELF hosts\n", mockFilePath);
+  return false;
+#endif
+}
+
+bool _isObjectFilePath(const char* path)
+{
+  int length = strlen(path);
+  return length > 2 && strcmp(path + length - 2, ".o") == 0;
+}
+
+bool _writeMockFile(char* mockFilePath, int functionCount, FunctionDescriptor* functions, int mode)
 {
   FILE* file = fopen(mockFilePath, "wb");
   if(!file) return false;
 
+  bool interpose = mode & _MOCK_FILE_MODE_INTERPOSE;
   fprintf(file, "// This file was generated by BugTestsRocket test framework\n");
   fprintf(file, "// Link it when building your tests for implementing the mocks\n");
+  if(interpose)
+    fprintf(file, "// Functions are interposed, link the tests against the original shared library\n"
+                  "#ifndef _GNU_SOURCE\n#define _GNU_SOURCE\n#endif\n"
+                  "#include <dlfcn.h>\n");
   fprintf(file, "#ifdef __cplusplus\nextern \"C\"{\n"
                 "#define _BTR_CONVERT(what, to) reinterpret_cast<to>(what)\n"
                 "#else\n"
                 "#define _BTR_CONVERT(what, to) ((to)(what))\n"
                 "#endif\n");
   fprintf(file, "#include <stdbool.h>\n");
-  fprintf(file, "typedef struct {bool set; int calls; void* mockPointer; const char* name; void* original; } FunctionMock;\n");
-  fprintf(file, "extern FunctionMock _mocks[];\n");
+  fprintf(file, "typedef struct {int count; const char* names; const unsigned int* nameOffsets; int* calls; void** slots; void** originals;} MockTable;\n");
+  fprintf(file, "extern int _mockCalls[];\nextern void* _mockSlots[];\n");
+  if(interpose) fprintf(file, "static void _resolveInterposedMock(int index);\n");
+  if(mode & (MOCK_FILE_TRACE | MOCK_FILE_LATENCY))
+    fprintf(file, "extern MockTable _mocks;\nvoid _traceMockCall(MockTable* mocks, int index);\n"
+                  "unsigned long long _latencyStart();\nvoid _latencyEnd(MockTable* mocks, int index, unsigned long long start);\n");
 
   for(int i = 0; i < functionCount; i++)
   {
-    char mockedName[_BTR_MAX_NAME_SIZE];
+    if(interpose && !functions[i].implementation) continue;
+    char mockedName[strlen(functions[i].name) + 64];
     _getMockedName(mockedName, functions[i].name);
-    char* implementation = _C_STRING_LITERAL(";");
+    const char* implementation = ";";
     if(functions[i].implementation) implementation = functions[i].implementation;
     fprintf(file, "%s %s(%s)%s\n", functions[i].returnType, mockedName, functions[i].args, implementation);
-    fprintf(file, "void* _mocked_%s = _BTR_CONVERT(%s, void*);\n", functions[i].name, mockedName);
   }
-  for(int i = 0; i < functionCount; i++)
+  // The trampoline compares the slot with the original, only jumping to the wrapper when a mock is set. Unmocked calls
+  // are counted in place and jump straight to the original
+  bool passThrough = (mode & MOCK_FILE_PASS_THROUGH) && !(mode & (MOCK_FILE_TRACE | MOCK_FILE_LATENCY)) && !interpose;
+  if(passThrough)
   {
-    fprintf(file, "%s %s(", functions[i].returnType, functions[i].name);
-    int argsCount = _writeArgs(file, functions[i].args);
-    fprintf(file, "){ _mocks[%i].calls++; return _BTR_CONVERT(_mocked_%s, %s (*)(%s))(",
-      i, functions[i].name, functions[i].returnType, functions[i].args);
-    for(int a = 0; a < argsCount; a++)
-      if(a)
-        fprintf(file, ", a%i", a);
-      else
-        fprintf(file, "a%i", a);
-    fprintf(file, "); }\n");
+    fprintf(file, "#if defined(__x86_64__) && defined(__ELF__)\n");
+    for(int i = 0; i < functionCount; i++)
+    {
+      const char* name = functions[i].name;
+      char mockedName[strlen(name) + 64];
+      _getMockedName(mockedName, name);
+      _writeMockWrapper(file, i, &functions[i], "_counted_", mode);
+      fprintf(file, "__asm__(\".pushsection .text\\n.globl %s\\n.type %s, @function\\n%s:\\n"
+                    "  leaq \\\"%s\\\"(%%rip), %%r11\\n  cmpq %%r11, _mockSlots+%i(%%rip)\\n  jne _counted_%s\\n"
+                    "  incl _mockCalls+%i(%%rip)\\n  jmp \\\"%s\\\"\\n.size %s, .-%s\\n.popsection\\n\");\n",
+        name, name, name, mockedName, (int)sizeof(void*)*i, name, (int)sizeof(int)*i, mockedName, name, name);
+    }
+    fprintf(file, "#else\n");
   }
-  fprintf(file, "FunctionMock _mocks[] = {\n");
   for(int i = 0; i < functionCount; i++)
+    _writeMockWrapper(file, i, &functions[i], "", mode);
+  if(passThrough) fprintf(file, "#endif\n");
+
+  fprintf(file, "const char _mockNames[] =");
+  for(int i = 0; i < functionCount; i++)
+    fprintf(file, " \"%s\\0\"", functions[i].name);
+  fprintf(file, " \"\";\nconst unsigned int _mockNameOffsets[] = {");
+  unsigned int nameOffset = 0;
+  for(int i = 0; i <= functionCount; i++)
   {
-    char mockedName[_BTR_MAX_NAME_SIZE];
-    _getMockedName(mockedName, functions[i].name);
-    fprintf(file, "  {true, (int)0, (void*)&_mocked_%s, \"%s\", _BTR_CONVERT(%s, void*)},\n", functions[i].name, functions[i].name, mockedName);
+    fprintf(file, "%u, ", nameOffset);
+    if(i < functionCount) nameOffset += strlen(functions[i].name) + 1;
   }
-  fprintf(file, "  {false, (int)0, (void*)0, \"\", (void*)0}\n};\n");
+  fprintf(file, "};\nint _mockCalls[%i] = {0};\n", functionCount + 1);
+  const char* tables[] = {"_mockSlots", "_mockOriginals"};
+  for(int t = 0; t < 2; t++)
+  {
+    fprintf(file, "void* %s[] = {\n", tables[t]);
+    for(int i = 0; i < functionCount; i++)
+    {
+      char mockedName[strlen(functions[i].name) + 64];
+      _getMockedName(mockedName, functions[i].name);
+      if(interpose && !functions[i].implementation)
+        fprintf(file, "  (void*)0,\n");
+      else
+        fprintf(file, "  _BTR_CONVERT(%s, void*),\n", mockedName);
+    }
+    fprintf(file, "  (void*)0\n};\n");
+  }
+  fprintf(file, "MockTable _mocks = {%i, _mockNames, _mockNameOffsets, _mockCalls, _mockSlots, _mockOriginals};\n", functionCount);
+  if(interpose)
+    fprintf(file, "static void _resolveInterposedMock(int index)\n{\n"
+                  "  void* original = dlsym(RTLD_NEXT, _mocks.names + _mocks.nameOffsets[index]);\n"
+                  "  _mocks.originals[index] = original;\n"
+                  "  if(!_mocks.slots[index]) _mocks.slots[index] = original;\n"
+                  "}\n"
+                  "__attribute__((constructor)) static void _resolveInterposedMocks()\n{\n"
+                  "  for(int i = 0; i < _mocks.count; i++)\n"
+                  "    if(!_mocks.originals[i]) _resolveInterposedMock(i);\n"
+                  "}\n");
   fprintf(file, "#ifdef __cplusplus\n}\n#endif\n"); 
 
   fclose(file);
   return true;
 }
 
+bool _createMockFile(char* mockFilePath, int functionCount, FunctionDescriptor* functions, int mode)
+{
+  // The table is sorted by name so _getMock can search it
+  FunctionDescriptor* sorted = (FunctionDescriptor*)malloc(sizeof(FunctionDescriptor)*(functionCount + 1));
+  memcpy(sorted, functions, sizeof(FunctionDescriptor)*functionCount);
+  qsort(sorted, functionCount, sizeof(FunctionDescriptor), _compareFunctionDescriptors);
+  bool ret;
+  if(_isObjectFilePath(mockFilePath))
+    ret = _createMockObject(mockFilePath, functionCount, sorted, mode);
+  else
+    ret = _writeMockFile(mockFilePath, functionCount, sorted, mode);
+  free(sorted);
+  return ret;
+}
+
+typedef struct _MockJob _MockJob;
+typedef struct _MockCache _MockCache;
+
+// Calls job once for every index spreading them over the available processors, implemented by the platform specific section
+void _runInParallel(int jobCount, void (*job)(void* data, int index), void* data);
+// Creates all missing parent directories of a file path, implemented by the platform specific section
+bool _makeParentDirectories(char* path);
+
+// Changes whenever the generator writes mockable libs or mock files differently, so older outputs are not reused
+#define _MOCK_FILE_FORMAT_VERSION 2
+
+// Remembers what produced the mockable lib, stored next to it as "<mockableLibPath>.cache"
+// A member is reused from the previous mockable lib when its content hash and the descriptors did not change
+struct _MockCache
+{
+  unsigned long long descriptorsHash;
+  int fileCount;
+  unsigned long long* fileHashes;
+};
+
+struct _MockJob
+{
+  _StaticLib* lib;
+  int renameCount;
+  _ObjectFileRename* renames;
+  bool* supported;
+  unsigned long long* fileHashes;
+  _MockCache* cache;
+  _StaticLib* previous;
+};
+
+// FNV-1a, chained through hash so several buffers can be combined
+unsigned long long _hashBytes(unsigned long long hash, const void* data, long long size)
+{
+  const unsigned char* bytes = (const unsigned char*)data;
+  if(!hash) hash = 0xcbf29ce484222325ull;
+  for(long long i = 0; i < size; i++)
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  return hash;
+}
+
+// Covers everything besides the lib that shapes the outputs: generator version, mock file path, mode and descriptors
+unsigned long long _hashDescriptors(int functionCount, FunctionDescriptor* functions, int mode, char* mockFilePath)
+{
+  int version = _MOCK_FILE_FORMAT_VERSION;
+  unsigned long long hash = _hashBytes(0, &version, sizeof(version));
+  hash = _hashBytes(hash, mockFilePath, strlen(mockFilePath) + 1);
+  hash = _hashBytes(hash, &functionCount, sizeof(functionCount));
+  hash = _hashBytes(hash, &mode, sizeof(mode));
+  for(int i = 0; i < functionCount; i++)
+  {
+    const char* fields[] = {functions[i].returnType, functions[i].name, functions[i].args, functions[i].implementation};
+    for(unsigned int f = 0; f < sizeof(fields)/sizeof(char*); f++)
+      hash = _hashBytes(hash, fields[f] ? fields[f] : "", fields[f] ? strlen(fields[f]) + 1 : 1);
+  }
+  return hash;
+}
+
+bool _readMockCache(char* cachePath, _MockCache* cache)
+{
+  memset(cache, 0, sizeof(_MockCache));
+  FILE* file = fopen(cachePath, "rb");
+  if(!file) return false;
+
+  bool ok = fscanf(file, "BugTestsRocket mock cache %llx %i", &cache->descriptorsHash, &cache->fileCount) == 2 && cache->fileCount >= 0;
+  if(ok)
+  {
+    cache->fileHashes = (unsigned long long*)malloc(sizeof(unsigned long long)*(cache->fileCount + 1));
+    for(int i = 0; ok && i < cache->fileCount; i++)
+      ok = fscanf(file, "%llx", &cache->fileHashes[i]) == 1;
+  }
+  fclose(file);
+
+  if(!ok)
+  {
+    if(cache->fileHashes) free(cache->fileHashes);
+    memset(cache, 0, sizeof(_MockCache));
+  }
+  return ok;
+}
+
+bool _writeMockCache(char* cachePath, unsigned long long descriptorsHash, int fileCount, unsigned long long* fileHashes)
+{
+  FILE* file = fopen(cachePath, "wb");
+  if(!file) return false;
+  fprintf(file, "BugTestsRocket mock cache %llx %i\n", descriptorsHash, fileCount);
+  for(int i = 0; i < fileCount; i++)
+    fprintf(file, "%llx\n", fileHashes[i]);
+  return fclose(file) == 0;
+}
+
+// Runs the object file rewrite of every function for one archive member, members are independent of each other
+void _createMocksForFile(void* data, int index)
+{
+  _MockJob* job = (_MockJob*)data;
+  _StaticLibFile* libFile = &job->lib->files[index];
+  job->supported[index] = true;
+  job->fileHashes[index] = _hashBytes(0, libFile->content, libFile->contentSize);
+
+  if(job->previous && index < job->cache->fileCount && job->cache->fileHashes[index] == job->fileHashes[index] &&
+     strcmp(_staticLibFileName(job->lib, libFile), _staticLibFileName(job->previous, &job->previous->files[index])) == 0)
+  {
+    libFile->content = job->previous->files[index].content;
+    libFile->contentSize = job->previous->files[index].contentSize;
+    return;
+  }
+
+  job->supported[index] = _objectFileMockFunctions(libFile, job->renameCount, job->renames);
+}
+
+// Builds the renames from every function to its mocked name, sorted for lookups. Names are kept in one block at *names
+_ObjectFileRename* _createMockRenames(int functionCount, FunctionDescriptor* functions, char** names)
+{
+  long long namesSize = 0;
+  for(int f = 0; f < functionCount; f++)
+    namesSize += strlen(functions[f].name) + 64;
+
+  _ObjectFileRename* renames = (_ObjectFileRename*)malloc(sizeof(_ObjectFileRename)*(functionCount + 1));
+  char* name = *names = (char*)malloc(namesSize + 1);
+  for(int f = 0; f < functionCount; f++)
+  {
+    _getMockedName(name, functions[f].name);
+    renames[f].from = functions[f].name;
+    renames[f].to = name;
+    name += strlen(name) + 1;
+  }
+  qsort(renames, functionCount, sizeof(_ObjectFileRename), _objectFileCompareRenames);
+  return renames;
+}
+
+// Descriptors given only a name (null returnType) are completed from the debug info of the lib
+int _describeMockFunctions(_StaticLib* lib, int functionCount, FunctionDescriptor* functions, FunctionDescriptor* output, FunctionDescriptor** debugFunctions, bool needsTypes)
+{
+  int debugFunctionCount = -1;
+  *debugFunctions = 0;
+  memcpy(output, functions, sizeof(FunctionDescriptor)*functionCount);
+  for(int i = 0; i < functionCount && needsTypes; i++)
+  {
+    if(output[i].returnType) continue;
+    if(debugFunctionCount < 0) debugFunctionCount = _debugInfoReadLibFunctions(lib, debugFunctions);
+    FunctionDescriptor* found = (FunctionDescriptor*)bsearch(&output[i], *debugFunctions, debugFunctionCount, sizeof(FunctionDescriptor), _compareFunctionDescriptors);
+    if(found)
+    {
+      output[i].returnType = found->returnType;
+      output[i].args = found->args;
+    }
+  }
+  return debugFunctionCount < 0 ? 0 : debugFunctionCount;
+}
+
 bool createMocks(char* libPath, char* mockableLibPath, char* mockFilePath, int functionCount, FunctionDescriptor* functions)
 {
   bool ret = true;
  
-  _StaticLib lib;
+  _StaticLib lib, previous;
+  memset(&previous, 0, sizeof(_StaticLib));
 
   if(_staticLibRead(&lib, libPath))
   {
-    for(int f = 0; f < functionCount; f++)
-    {
-      char mockedName[strlen(functions[f].name)+64];
-      _getMockedName(mockedName, functions[f].name);
-    
-      for(int i = 0; i < lib.header.globalSymbolCount; i++)
-        if(strcmp(lib.globalSymbols[i].name, functions[f].name) == 0)
-          strcpy(lib.globalSymbols[i].name, mockedName);
-    
-      for(int i = 0; i < lib.fileCount; i++)
+    char cachePath[strlen(mockableLibPath) + 16];
+    sprintf(cachePath, "%s.cache", mockableLibPath);
+
+    // Object mock files do not need types, C mock files can not be written without them
+    FunctionDescriptor* described = (FunctionDescriptor*)malloc(sizeof(FunctionDescriptor)*(functionCount + 1));
+    FunctionDescriptor* debugFunctions;
+    int debugFunctionCount = _describeMockFunctions(&lib, functionCount, functions, described, &debugFunctions, !_isObjectFilePath(mockFilePath));
+    functions = described;
+    for(int i = 0; i < functionCount; i++)
+      if(!functions[i].returnType && !_isObjectFilePath(mockFilePath))
       {
-        if(memcmp(lib.files[i].fileInfo, "//", 2) != 0)
-          if(!_objectFileMockFunction(&lib.files[i], functions[f].name, mockedName))
-              printf("Could not mock object file %s. Supported formats are ELF64. Symbols must be relocatable. Maybe try adding --fPIC to your compiler flags?\n",
-                    lib.files[i].fileInfo);
+        printf("Could not describe %s, compile %s with debug info (-g) or write its descriptor by hand\n", functions[i].name, libPath);
+        ret = false;
       }
+
+    _MockCache cache;
+    unsigned long long descriptorsHash = _hashDescriptors(functionCount, functions, _MOCK_FILE_MODE_ARCHIVE | mockFileOptions, mockFilePath);
+    bool cached = _readMockCache(cachePath, &cache) && cache.descriptorsHash == descriptorsHash &&
+                  _staticLibRead(&previous, mockableLibPath) && previous.fileCount == cache.fileCount;
+
+    char* mockedNames;
+    _ObjectFileRename* renames = _createMockRenames(functionCount, functions, &mockedNames);
+    bool supported[lib.fileCount + 1];
+    unsigned long long fileHashes[lib.fileCount + 1];
+    _MockJob job = {&lib, functionCount, renames, supported, fileHashes, &cache, cached ? &previous : 0};
+    _runInParallel(lib.fileCount, _createMocksForFile, &job);
+
+    for(int i = 0; i < lib.fileCount; i++)
+      if(!supported[i])
+        printf("Could not mock object file %s. Supported formats are ELF64. Symbols must be relocatable. Maybe try adding --fPIC to your compiler flags?\n",
+              _staticLibFileName(&lib, &lib.files[i]));
+
+    bool changed = !cached || lib.fileCount != cache.fileCount;
+    for(int i = 0; !changed && i < lib.fileCount; i++)
+      changed = fileHashes[i] != cache.fileHashes[i];
+
+    for(int i = 0; changed && i < lib.header.globalSymbolCount; i++)
+    {
+      _ObjectFileRename* rename = _objectFileFindRename(functionCount, renames, _staticLibSymbolName(&lib, &lib.globalSymbols[i]));
+      if(rename) _staticLibRenameSymbol(&lib, &lib.globalSymbols[i], rename->to);
+    }
+
+    // The previous mockable lib may still be mapped, so the new one replaces it only once complete
+    if(changed)
+    {
+      char temporaryPath[strlen(mockableLibPath) + 16];
+      sprintf(temporaryPath, "%s.tmp", mockableLibPath);
+      ret &= _staticLibWrite(&lib, temporaryPath);
+      _staticLibFree(&previous);
+      if(ret && rename(temporaryPath, mockableLibPath) != 0)
+        ret = remove(mockableLibPath) == 0 && rename(temporaryPath, mockableLibPath) == 0;
+      // A partial or unused temporary lib is not left behind
+      if(!ret) remove(temporaryPath);
     }
-    
-    ret = _staticLibWrite(&lib, mockableLibPath);
-    ret &= _createMockFile(mockFilePath, functionCount, functions);
+
+    FILE* mockFile = cached ? fopen(mockFilePath, "rb") : 0;
+    if(mockFile) fclose(mockFile);
+    else if(ret) ret = _createMockFile(mockFilePath, functionCount, functions, _MOCK_FILE_MODE_ARCHIVE | mockFileOptions);
+
+    if(ret) _writeMockCache(cachePath, descriptorsHash, lib.fileCount, fileHashes);
+    else remove(cachePath);
+    if(cache.fileHashes) free(cache.fileHashes);
+    free(renames);
+    free(mockedNames);
+    freeFunctionDescriptors(debugFunctionCount, debugFunctions);
+    free(described);
   }
   else
     ret = false;
 
   _staticLibFree(&lib);
+  _staticLibFree(&previous);
+
+  return ret;
+}
+
+int _compareNames(const void* a, const void* b)
+{
+  return strcmp(*(const char**)a, *(const char**)b);
+}
 
+// Mocks every global function defined in a static lib. C mock files need the lib compiled with debug info (-g) for
+// describing the functions and the ones that can not be described are left unmocked, object mock files need no types
+bool createAllMocks(char* libPath, char* mockableLibPath, char* mockFilePath)
+{
+  _StaticLib lib;
+  if(!_staticLibRead(&lib, libPath)) return false;
+
+  int nameCount = 0;
+  const char** names = 0;
+  for(int i = 0; i < lib.fileCount; i++)
+  {
+    const char** fileNames;
+    int fileNameCount = _objectFileGlobalFunctions(&lib.files[i], &fileNames, 0);
+    names = (const char**)realloc(names, sizeof(char*)*(nameCount + fileNameCount + 1));
+    memcpy(names + nameCount, fileNames, sizeof(char*)*fileNameCount);
+    nameCount += fileNameCount;
+    free(fileNames);
+  }
+  qsort(names, nameCount, sizeof(char*), _compareNames);
+
+  FunctionDescriptor* debugFunctions = 0;
+  bool needsTypes = !_isObjectFilePath(mockFilePath);
+  int debugFunctionCount = needsTypes ? _debugInfoReadLibFunctions(&lib, &debugFunctions) : 0;
+  FunctionDescriptor* functions = (FunctionDescriptor*)malloc(sizeof(FunctionDescriptor)*(nameCount + 1));
+  int functionCount = 0, skipped = 0;
+  for(int i = 0; i < nameCount; i++)
+  {
+    // Weak functions may be defined by several objects
+    if(i && strcmp(names[i - 1], names[i]) == 0) continue;
+    FunctionDescriptor function = {0, names[i], 0, 0};
+    FunctionDescriptor* found = needsTypes ?
+      (FunctionDescriptor*)bsearch(&function, debugFunctions, debugFunctionCount, sizeof(FunctionDescriptor), _compareFunctionDescriptors) : 0;
+    if(found) function = *found;
+    if(needsTypes && !found) skipped++;
+    else functions[functionCount++] = function;
+  }
+  if(skipped)
+    printf("%i functions of %s could not be described from its debug info and are left unmocked\n", skipped, libPath);
+
+  bool ret = createMocks(libPath, mockableLibPath, mockFilePath, functionCount, functions);
+  freeFunctionDescriptors(debugFunctionCount, debugFunctions);
+  free(functions);
+  free(names);
+  _staticLibFree(&lib);
   return ret;
 }
+
+typedef struct _ObjectMockJob _ObjectMockJob;
+
+struct _ObjectMockJob
+{
+  char** objectPaths;
+  char* objectsPath;
+  char* outputPath;
+  int renameCount;
+  _ObjectFileRename* renames;
+  bool* succeeded;
+};
+
+int _findObjectFiles(char* path, char*** output, int count)
+{
+  if(!_isDirectory(path))
+  {
+    int length = strlen(path);
+    if(length > 2 && strcmp(path + length - 2, ".o") == 0)
+    {
+      *output = (char**)realloc(*output, sizeof(char*)*(count + 1));
+      (*output)[count] = (char*)malloc(length + 1);
+      strcpy((*output)[count++], path);
+    }
+    return count;
+  }
+
+  int entryCount = _listFiles(path, 0);
+  char* entries[entryCount + 1];
+  _listFiles(path, entries);
+  for(int i = 0; i < entryCount; i++)
+  {
+    count = _findObjectFiles(entries[i], output, count);
+    free(entries[i]);
+  }
+  return count;
+}
+
+// Rewrites one object into the same relative path under the output, objects without mocked functions are copied as they are
+void _createObjectMocksForFile(void* data, int index)
+{
+  _ObjectMockJob* job = (_ObjectMockJob*)data;
+  char* objectPath = job->objectPaths[index];
+  char* relativePath = objectPath + strlen(job->objectsPath);
+  char outputPath[strlen(job->outputPath) + strlen(relativePath) + 2];
+  strcpy(outputPath, job->outputPath);
+  if(*relativePath && *relativePath != '/' && outputPath[strlen(outputPath)-1] != '/') strcat(outputPath, "/");
+  strcat(outputPath, relativePath);
+
+  _MappedFile source;
+  job->succeeded[index] = false;
+  if(!_mapFile(objectPath, &source)) return;
+
+  _StaticLibFile object;
+  memset(&object, 0, sizeof(_StaticLibFile));
+  object.content = source.data;
+  object.contentSize = source.size;
+  if(_objectFileMockFunctions(&object, job->renameCount, job->renames) && _makeParentDirectories(outputPath))
+  {
+    FILE* file = fopen(outputPath, "wb");
+    if(file)
+    {
+      job->succeeded[index] = fwrite(object.content, 1, object.contentSize, file) == (size_t)object.contentSize;
+      job->succeeded[index] &= fclose(file) == 0;
+    }
+  }
+
+  if(object.ownsContent) free(object.content);
+  _unmapFile(&source);
+}
+
+// Tells whether path is directory or somewhere under it, comparing the paths as written
+bool _isPathInside(char* path, char* directory)
+{
+  int length = strlen(directory);
+  while(length > 1 && directory[length - 1] == '/') length--;
+  return strncmp(path, directory, length) == 0 && (path[length] == '/' || path[length] == '\0');
+}
+
+// Mocks the functions directly on relocatable objects, without an archive
+// objectsPath is either a single .o file written to outputPath or a directory whose .o files are rewritten recursively
+// into the same relative paths under outputPath, which can not be inside it
+bool createObjectMocks(char* objectsPath, char* outputPath, char* mockFilePath, int functionCount, FunctionDescriptor* functions)
+{
+  if(_isDirectory(objectsPath) && _isPathInside(outputPath, objectsPath))
+  {
+    printf("Could not mock the objects of %s, the output %s is inside it and would be mocked again\n", objectsPath, outputPath);
+    return false;
+  }
+
+  char** objectPaths = 0;
+  int objectCount = _findObjectFiles(objectsPath, &objectPaths, 0);
+
+  char* mockedNames;
+  _ObjectFileRename* renames = _createMockRenames(functionCount, functions, &mockedNames);
+  bool succeeded[objectCount + 1];
+  _ObjectMockJob job = {objectPaths, objectsPath, outputPath, functionCount, renames, succeeded};
+  _runInParallel(objectCount, _createObjectMocksForFile, &job);
+
+  bool ret = objectCount > 0;
+  for(int i = 0; i < objectCount; i++)
+  {
+    if(!succeeded[i])
+      printf("Could not mock object file %s. Supported formats are ELF64. Symbols must be relocatable. Maybe try adding --fPIC to your compiler flags?\n",
+            objectPaths[i]);
+    ret &= succeeded[i];
+    free(objectPaths[i]);
+  }
+  if(objectPaths) free(objectPaths);
+  free(renames);
+  free(mockedNames);
+
+  return ret && _createMockFile(mockFilePath, functionCount, functions, _MOCK_FILE_MODE_ARCHIVE | mockFileOptions);
+}
+
+// Mocks functions of a shared library without rewriting it
+// The generated mock file defines the functions in the test binary, interposing the library ones, and reaches the
+// originals through dlsym(RTLD_NEXT, ...) when loaded or on their first call. Tests link the mock file and the original
+// shared library.
+bool createSharedMocks(char* mockFilePath, int functionCount, FunctionDescriptor* functions)
+{
+  return _createMockFile(mockFilePath, functionCount, functions, _MOCK_FILE_MODE_INTERPOSE);
+}
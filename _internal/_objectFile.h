@@ -7,6 +7,8 @@ typedef struct _ElfRela _ElfRela;
 typedef struct _ElfHeader _ElfHeader;
 typedef struct _ElfSectionHeader _ElfSectionHeader;
 typedef struct _ElfSymbol _ElfSymbol;
+typedef struct _ElfProgramHeader _ElfProgramHeader;
+typedef struct _ObjectFileRename _ObjectFileRename;
 
 struct _ElfRel
 {
@@ -63,6 +65,36 @@ struct _ElfSymbol
   uint64_t st_size;
 };
 
+struct _ElfProgramHeader
+{
+  uint32_t p_type;
+  uint32_t p_flags;
+  uint64_t p_offset;
+  uint64_t p_vaddr;
+  uint64_t p_paddr;
+  uint64_t p_filesz;
+  uint64_t p_memsz;
+  uint64_t p_align;
+};
+
+// Symbol renames applied to object files, arrays of them are kept sorted by from
+struct _ObjectFileRename
+{
+  const char* from;
+  const char* to;
+};
+
+int _objectFileCompareRenames(const void* a, const void* b)
+{
+  return strcmp(((_ObjectFileRename*)a)->from, ((_ObjectFileRename*)b)->from);
+}
+
+_ObjectFileRename* _objectFileFindRename(int renameCount, _ObjectFileRename* renames, const char* from)
+{
+  _ObjectFileRename key = {from, 0};
+  return (_ObjectFileRename*)bsearch(&key, renames, renameCount, sizeof(_ObjectFileRename), _objectFileCompareRenames);
+}
+
 bool _objectFileIsSupportedElf64(_ElfHeader* header)
 {
   if(header->e_ident[0] == 0x7f && header->e_ident[1] == 'E' && header->e_ident[2] == 'L' && header->e_ident[3] == 'F' && header->e_ident[4] == 2 &&
@@ -96,117 +128,338 @@ bool _objectFileElfIsGlobalFunctionDefinedHere(_ElfSymbol* symbol)
   return binding != 0 && type == 2 && symbol->st_shndx != 0;
 }
 
-void _objectFileMockElfSymbol(_StaticLibFile* libFile, _ElfHeader header, _ElfSectionHeader* sections, _ElfSectionHeader* symbolTable, _ElfSymbol* symbol, char* to)
+// Rewrites an object so every global function named as a rename "from" is only referenced there and defined as "to" instead
+// New string and symbol tables are appended at the end of the object and only their section headers are patched,
+// every other section keeps its bytes and offset. Objects defining none of the functions are left untouched.
+bool _objectFileMockElfFunctions(_StaticLibFile* libFile, _ElfHeader header, int renameCount, _ObjectFileRename* renames)
 {
-  int offset = sizeof(_ElfHeader), addedBytes = 0;
-  char* newContent = (char*)malloc(libFile->contentSize*2);
-  memset(newContent, 0, libFile->contentSize*2);
-  _ElfSectionHeader* stringTable = &sections[symbolTable->sh_link];
-  _ElfSectionHeader* orderedSections[header.e_shnum];
-  memset(orderedSections, 0, sizeof(orderedSections));
-  int lastMin = -1;
-  int lastIndex = -1;
+  if(header.e_shoff + (long long)sizeof(_ElfSectionHeader)*header.e_shnum > (unsigned long long)libFile->contentSize)
+    return false;
+
+  _ElfSectionHeader sections[header.e_shnum];
+  for(int i = 0; i < header.e_shnum; i++)
+    memcpy(&sections[i], libFile->content + header.e_shoff + sizeof(_ElfSectionHeader)*i, sizeof(_ElfSectionHeader));
+
+  int symbolTableIndex = -1;
   for(int i = 0; i < header.e_shnum; i++)
+    if(sections[i].sh_type == 2) symbolTableIndex = i;
+  if(symbolTableIndex < 0) return true;
+
+  _ElfSectionHeader symbolTable = sections[symbolTableIndex];
+  int stringTableIndex = symbolTable.sh_link;
+  if(stringTableIndex >= header.e_shnum) return false;
+  _ElfSectionHeader stringTable = sections[stringTableIndex];
+  if(symbolTable.sh_offset + symbolTable.sh_size > (unsigned long long)libFile->contentSize ||
+     stringTable.sh_offset + stringTable.sh_size > (unsigned long long)libFile->contentSize)
+    return false;
+  int symbolCount = symbolTable.sh_size/sizeof(_ElfSymbol);
+
+  int mockedCount = 0;
+  long long addedNamesSize = 0;
+  int* mockedSymbols = (int*)malloc(sizeof(int)*(symbolCount + 1));
+  _ObjectFileRename** mockedRenames = (_ObjectFileRename**)malloc(sizeof(_ObjectFileRename*)*(symbolCount + 1));
+  for(int i = 1; i < symbolCount; i++)
   {
-    int minIndex;
-    for(int j = 0; j < header.e_shnum; j++)
-    {
-      long long off = sections[j].sh_offset;
-    
-      if(off < lastMin || (off == lastMin && j <= lastIndex)) continue;
-      if(!orderedSections[i] || off < (long long)orderedSections[i]->sh_offset)
-      {
-        minIndex = j;
-        orderedSections[i] = &sections[j];
-      }
-    }
+    _ElfSymbol* symbol = _objectFileElfGetSymbol(libFile, &symbolTable, i);
+    if(!_objectFileElfIsGlobalFunctionDefinedHere(symbol)) continue;
+    _ObjectFileRename* rename = _objectFileFindRename(renameCount, renames, _objectFileElfGetString(libFile, &stringTable, symbol->st_name));
+    if(!rename) continue;
+    mockedSymbols[mockedCount] = i;
+    mockedRenames[mockedCount++] = rename;
+    addedNamesSize += strlen(rename->to) + 1;
+  }
+  if(!mockedCount)
+  {
+    free(mockedSymbols);
+    free(mockedRenames);
+    return true;
+  }
+
+  long long stringTableOffset = libFile->contentSize + (8 - libFile->contentSize % 8) % 8;
+  long long stringTableSize = stringTable.sh_size + addedNamesSize;
+  long long symbolTableOffset = stringTableOffset + stringTableSize + (8 - (stringTableOffset + stringTableSize) % 8) % 8;
+  long long symbolTableSize = symbolTable.sh_size + sizeof(_ElfSymbol)*mockedCount;
+  long long contentSize = symbolTableOffset + symbolTableSize;
 
-    lastIndex = minIndex;
-    lastMin = orderedSections[i]->sh_offset;
+  char* content;
+  if(libFile->ownsContent)
+    content = (char*)realloc(libFile->content, contentSize);
+  else
+  {
+    content = (char*)malloc(contentSize);
+    memcpy(content, libFile->content, libFile->contentSize);
   }
+  memset(content + libFile->contentSize, 0, contentSize - libFile->contentSize);
+  memcpy(content + stringTableOffset, content + stringTable.sh_offset, stringTable.sh_size);
+  memcpy(content + symbolTableOffset, content + symbolTable.sh_offset, symbolTable.sh_size);
 
-  _ElfSymbol aux = *symbol;
-  _ElfSymbol* newSymbol = &aux;
-  symbol->st_value = 0;
-  symbol->st_size = 0;
-  symbol->st_shndx = 0;
-  symbol->st_info &= 0xF0;
+  // The original symbol becomes an undefined reference, so calls inside the object reach the mock trampoline
+  long long nameOffset = stringTable.sh_size;
+  _ElfSymbol* symbols = (_ElfSymbol*)(content + symbolTableOffset);
+  for(int i = 0; i < mockedCount; i++)
+  {
+    _ElfSymbol* symbol = &symbols[mockedSymbols[i]];
+    _ElfSymbol* newSymbol = &symbols[symbolCount + i];
+    *newSymbol = *symbol;
+    newSymbol->st_name = nameOffset;
+    int size = strlen(mockedRenames[i]->to) + 1;
+    memcpy(content + stringTableOffset + nameOffset, mockedRenames[i]->to, size);
+    nameOffset += size;
 
-  for(int i = 0; i < header.e_shnum; i++)
+    symbol->st_value = 0;
+    symbol->st_size = 0;
+    symbol->st_shndx = 0;
+    symbol->st_info &= 0xF0;
+  }
+
+  sections[stringTableIndex].sh_offset = stringTableOffset;
+  sections[stringTableIndex].sh_size = stringTableSize;
+  sections[symbolTableIndex].sh_offset = symbolTableOffset;
+  sections[symbolTableIndex].sh_size = symbolTableSize;
+  memcpy(content + header.e_shoff + sizeof(_ElfSectionHeader)*stringTableIndex, &sections[stringTableIndex], sizeof(_ElfSectionHeader));
+  memcpy(content + header.e_shoff + sizeof(_ElfSectionHeader)*symbolTableIndex, &sections[symbolTableIndex], sizeof(_ElfSectionHeader));
+
+  libFile->content = content;
+  libFile->contentSize = contentSize;
+  libFile->ownsContent = true;
+  free(mockedSymbols);
+  free(mockedRenames);
+  return true;
+}
+
+bool _objectFileMockFunctions(_StaticLibFile* libFile, int renameCount, _ObjectFileRename* renames)
+{
+  _ElfHeader elfHeader;
+  if(libFile->contentSize < (long long)sizeof(_ElfHeader)) return false;
+  memcpy(&elfHeader, libFile->content, sizeof(_ElfHeader));
+  if(_objectFileIsSupportedElf64(&elfHeader))
+    return _objectFileMockElfFunctions(libFile, elfHeader, renameCount, renames);
+  return false;
+}
+
+// Minimal x86-64 ELF64 relocatable objects built in memory, used for emitting mock trampolines without a compiler
+// Sections and their section symbols share indices, every added symbol is global and comes after the section symbols.
+// Symbols referenced but not defined here are added to _ELF_OBJECT_UNDEFINED
+typedef struct _ObjectFileBuffer _ObjectFileBuffer;
+typedef struct _ElfObject _ElfObject;
+
+enum _ElfObjectSection
+{
+  _ELF_OBJECT_UNDEFINED = 0,
+  _ELF_OBJECT_TEXT = 1,
+  _ELF_OBJECT_DATA = 2,
+  _ELF_OBJECT_RODATA = 3,
+  _ELF_OBJECT_SECTION_SYMBOLS = 4
+};
+
+enum _ElfRelocationType
+{
+  _ELF_R_X86_64_64 = 1,
+  _ELF_R_X86_64_PC32 = 2,
+  _ELF_R_X86_64_PLT32 = 4
+};
+
+struct _ObjectFileBuffer
+{
+  char* data;
+  long long size;
+  long long capacity;
+};
+
+struct _ElfObject
+{
+  _ObjectFileBuffer text;
+  _ObjectFileBuffer data;
+  _ObjectFileBuffer rodata;
+  _ObjectFileBuffer textRelocations;
+  _ObjectFileBuffer dataRelocations;
+  _ObjectFileBuffer symbols;
+  _ObjectFileBuffer strings;
+};
+
+long long _objectFileBufferAppend(_ObjectFileBuffer* buffer, const void* data, long long size)
+{
+  if(buffer->size + size > buffer->capacity)
   {
-    _ElfSectionHeader* current = orderedSections[i];
-    if(current->sh_addralign > 1 && offset % current->sh_addralign)
-      offset += current->sh_addralign - (offset % current->sh_addralign);
-    memcpy(newContent + offset, libFile->content + current->sh_offset, current->sh_size);
-    current->sh_offset = offset;
-    offset += current->sh_size;
-    
-    if(current == stringTable)
-    {
-      int size = strlen(to) + 1;
-      newSymbol->st_name = offset-current->sh_offset;
-      memcpy(newContent + offset, to, size);
-      offset += size;
-      addedBytes += size;
-      current->sh_size += size;
-    }
-    else if(current == symbolTable)
-    {
-      int size = sizeof(_ElfSymbol);
-      memcpy(newContent + offset, newSymbol, size);
-      newSymbol = (_ElfSymbol*)(newContent + offset);
-      offset += size;
-      addedBytes += size;
-      current->sh_size += size;
-    }
+    buffer->capacity = buffer->capacity*2 + size + 256;
+    buffer->data = (char*)realloc(buffer->data, buffer->capacity);
+  }
+  if(data) memcpy(buffer->data + buffer->size, data, size);
+  else memset(buffer->data + buffer->size, 0, size);
+  buffer->size += size;
+  return buffer->size - size;
+}
+
+void _objectFileBufferAlign(_ObjectFileBuffer* buffer, int alignment, char fill)
+{
+  while(buffer->size % alignment)
+    _objectFileBufferAppend(buffer, &fill, 1);
+}
+
+int _elfObjectAddSymbol(_ElfObject* object, const char* name, int section, int type, long long value, long long size)
+{
+  _ElfSymbol symbol = {0};
+  symbol.st_name = _objectFileBufferAppend(&object->strings, name, strlen(name) + 1);
+  symbol.st_info = (1 << 4) | type; // global
+  symbol.st_shndx = section;
+  symbol.st_value = value;
+  symbol.st_size = size;
+  return _objectFileBufferAppend(&object->symbols, &symbol, sizeof(_ElfSymbol))/sizeof(_ElfSymbol);
+}
+
+void _elfObjectInit(_ElfObject* object)
+{
+  memset(object, 0, sizeof(_ElfObject));
+  _objectFileBufferAppend(&object->strings, "", 1);
+  _objectFileBufferAppend(&object->symbols, 0, sizeof(_ElfSymbol));
+  for(int i = _ELF_OBJECT_TEXT; i < _ELF_OBJECT_SECTION_SYMBOLS; i++)
+  {
+    _ElfSymbol symbol = {0, 3, 0, (uint16_t)i, 0, 0}; // local section symbol
+    _objectFileBufferAppend(&object->symbols, &symbol, sizeof(_ElfSymbol));
   }
+}
 
-  if(offset % 8) offset += 8 - (offset % 8);
+void _elfObjectAddRelocation(_ElfObject* object, int section, long long offset, int symbol, int type, long long addend)
+{
+  _ElfRela relocation = {(uint64_t)offset, ((uint64_t)symbol << 32) | (uint32_t)type, addend};
+  _objectFileBufferAppend(section == _ELF_OBJECT_TEXT ? &object->textRelocations : &object->dataRelocations, &relocation, sizeof(_ElfRela));
+}
+
+bool _elfObjectWrite(_ElfObject* object, char* path)
+{
+  const char sectionNames[] = "\0.text\0.data\0.rodata\0.rela.text\0.rela.data\0.symtab\0.strtab\0.shstrtab\0.note.GNU-stack";
+  enum {TEXT = 1, DATA, RODATA, RELA_TEXT, RELA_DATA, SYMTAB, STRTAB, SHSTRTAB, NOTE, SECTION_COUNT};
+  _ObjectFileBuffer* contents[SECTION_COUNT] = {0, &object->text, &object->data, &object->rodata, &object->textRelocations,
+                                                &object->dataRelocations, &object->symbols, &object->strings, 0, 0};
+  _ObjectFileBuffer names = {(char*)sectionNames, sizeof(sectionNames), sizeof(sectionNames)};
+  contents[SHSTRTAB] = &names;
 
+  _ElfSectionHeader sections[SECTION_COUNT];
+  memset(sections, 0, sizeof(sections));
+  const int nameOffsets[SECTION_COUNT] = {0, 1, 7, 13, 21, 32, 43, 51, 59, 69};
+  const int types[SECTION_COUNT] = {0, 1, 1, 1, 4, 4, 2, 3, 3, 1};
+  const int flags[SECTION_COUNT] = {0, 0x6, 0x3, 0x2, 0x40, 0x40, 0, 0, 0, 0};
+  const int alignments[SECTION_COUNT] = {0, 16, 8, 8, 8, 8, 8, 1, 1, 1};
+  long long offset = sizeof(_ElfHeader);
+  for(int i = 1; i < SECTION_COUNT; i++)
+  {
+    offset += (alignments[i] - offset % alignments[i]) % alignments[i];
+    sections[i].sh_name = nameOffsets[i];
+    sections[i].sh_type = types[i];
+    sections[i].sh_flags = flags[i];
+    sections[i].sh_offset = offset;
+    sections[i].sh_size = contents[i] ? contents[i]->size : 0;
+    sections[i].sh_addralign = alignments[i];
+    offset += sections[i].sh_size;
+  }
+  sections[RELA_TEXT].sh_link = sections[RELA_DATA].sh_link = SYMTAB;
+  sections[RELA_TEXT].sh_info = TEXT;
+  sections[RELA_DATA].sh_info = DATA;
+  sections[RELA_TEXT].sh_entsize = sections[RELA_DATA].sh_entsize = sizeof(_ElfRela);
+  sections[SYMTAB].sh_link = STRTAB;
+  sections[SYMTAB].sh_info = _ELF_OBJECT_SECTION_SYMBOLS;
+  sections[SYMTAB].sh_entsize = sizeof(_ElfSymbol);
+  offset += (8 - offset % 8) % 8;
+
+  _ElfHeader header;
+  memset(&header, 0, sizeof(_ElfHeader));
+  memcpy(header.e_ident, "\x7f" "ELF\x02\x01\x01", 7);
+  header.e_type = 1;
+  header.e_machine = 62; // x86-64
+  header.e_version = 1;
   header.e_shoff = offset;
-  for(int i = 0; i < header.e_shnum; i++)
+  header.e_ehsize = sizeof(_ElfHeader);
+  header.e_shentsize = sizeof(_ElfSectionHeader);
+  header.e_shnum = SECTION_COUNT;
+  header.e_shstrndx = SHSTRTAB;
+
+  FILE* file = fopen(path, "wb");
+  if(!file) return false;
+  bool ret = fwrite(&header, sizeof(_ElfHeader), 1, file) == 1;
+  for(int i = 1; i < SECTION_COUNT; i++)
   {
-    memcpy(newContent + offset, &sections[i], sizeof(_ElfSectionHeader));
-    offset += sizeof(_ElfSectionHeader);
+    while(ret && ftell(file) < (long)sections[i].sh_offset) ret = fputc(0, file) != EOF;
+    if(ret && sections[i].sh_size) ret = fwrite(contents[i]->data, sections[i].sh_size, 1, file) == 1;
   }
+  while(ret && ftell(file) < (long)offset) ret = fputc(0, file) != EOF;
+  ret = ret && fwrite(sections, sizeof(sections), 1, file) == 1;
+  return fclose(file) == 0 && ret;
+}
 
-  memcpy(newContent, &header, sizeof(_ElfHeader));
-  free(libFile->content);
-  libFile->contentSize = offset;
-  libFile->content = newContent;
+void _elfObjectFree(_ElfObject* object)
+{
+  _ObjectFileBuffer* buffers[] = {&object->text, &object->data, &object->rodata, &object->textRelocations,
+                                  &object->dataRelocations, &object->symbols, &object->strings};
+  for(unsigned int i = 0; i < sizeof(buffers)/sizeof(buffers[0]); i++)
+    free(buffers[i]->data);
+  memset(object, 0, sizeof(_ElfObject));
 }
 
-bool _objectFileMockElfFunction(_StaticLibFile* libFile, _ElfHeader header, char* from, char* to)
+// Lists the global functions defined in an ELF64 object, the names point into its content.
+// Their symbols are listed in the same order when symbols is given, both outputs must be freed
+int _objectFileGlobalFunctions(_StaticLibFile* libFile, const char*** output, _ElfSymbol** symbols)
 {
-  _ElfSectionHeader sections[header.e_shnum];
+  *output = 0;
+  if(symbols) *symbols = 0;
+  _ElfHeader header;
+  if(libFile->contentSize < (long long)sizeof(_ElfHeader)) return 0;
+  memcpy(&header, libFile->content, sizeof(_ElfHeader));
+  if(!_objectFileIsSupportedElf64(&header) ||
+     header.e_shoff + (long long)sizeof(_ElfSectionHeader)*header.e_shnum > (unsigned long long)libFile->contentSize)
+    return 0;
 
-  for(int i = 0; i < header.e_shnum; i++)
-    memcpy(&sections[i], libFile->content + header.e_shoff + sizeof(_ElfSectionHeader)*i, sizeof(_ElfSectionHeader));
+  _ElfSectionHeader symbolTable, stringTable;
+  int symbolTableIndex = -1;
+  for(int i = 0; i < header.e_shnum && symbolTableIndex < 0; i++)
+  {
+    memcpy(&symbolTable, libFile->content + header.e_shoff + sizeof(_ElfSectionHeader)*i, sizeof(_ElfSectionHeader));
+    if(symbolTable.sh_type == 2) symbolTableIndex = i;
+  }
+  if(symbolTableIndex < 0 || symbolTable.sh_link >= header.e_shnum) return 0;
+  memcpy(&stringTable, libFile->content + header.e_shoff + sizeof(_ElfSectionHeader)*symbolTable.sh_link, sizeof(_ElfSectionHeader));
+  if(symbolTable.sh_offset + symbolTable.sh_size > (unsigned long long)libFile->contentSize ||
+     stringTable.sh_offset + stringTable.sh_size > (unsigned long long)libFile->contentSize)
+    return 0;
 
-  _ElfSectionHeader* symbolTable = 0;
-  for(int i = 0; i < header.e_shnum; i++)
-    if(sections[i].sh_type == 2) symbolTable = &sections[i];
-  
-  if(!symbolTable) return true;
-  for(unsigned int i = 1; i < symbolTable->sh_size/sizeof(_ElfSymbol); i++)
+  int count = 0;
+  int symbolCount = symbolTable.sh_size/sizeof(_ElfSymbol);
+  *output = (const char**)malloc(sizeof(char*)*(symbolCount + 1));
+  if(symbols) *symbols = (_ElfSymbol*)malloc(sizeof(_ElfSymbol)*(symbolCount + 1));
+  for(int i = 1; i < symbolCount; i++)
   {
-    _ElfSymbol* symbol = _objectFileElfGetSymbol(libFile, symbolTable, i);
-    char* name = _objectFileElfGetString(libFile, &sections[symbolTable->sh_link], symbol->st_name);
-    if(name && strcmp(name, from) == 0 && _objectFileElfIsGlobalFunctionDefinedHere(symbol))
-    {
-      _objectFileMockElfSymbol(libFile, header, sections, symbolTable, symbol, to);
-      break;
-    }
+    _ElfSymbol symbol;
+    memcpy(&symbol, libFile->content + symbolTable.sh_offset + sizeof(_ElfSymbol)*i, sizeof(_ElfSymbol));
+    if(!_objectFileElfIsGlobalFunctionDefinedHere(&symbol) || symbol.st_name >= stringTable.sh_size ||
+       !memchr(libFile->content + stringTable.sh_offset + symbol.st_name, 0, stringTable.sh_size - symbol.st_name))
+      continue;
+    if(symbols) (*symbols)[count] = symbol;
+    (*output)[count++] = _objectFileElfGetString(libFile, &stringTable, symbol.st_name);
   }
-  
-  return true;
+  return count;
 }
 
-bool _objectFileMockFunction(_StaticLibFile* libFile, char* from, char* to)
+// Size of the function whose symbol has the given value in an ELF64 file of any type, -1 when none has it
+long long _objectFileFunctionSize(const char* content, long long contentSize, unsigned long long value)
 {
-  _ElfHeader elfHeader;
-  memcpy(&elfHeader, libFile->content, sizeof(_ElfHeader));
-  if(_objectFileIsSupportedElf64(&elfHeader))
-    return _objectFileMockElfFunction(libFile, elfHeader, from, to);
-  return false;
+  _ElfHeader header;
+  if(contentSize < (long long)sizeof(_ElfHeader)) return -1;
+  memcpy(&header, content, sizeof(_ElfHeader));
+  if(memcmp(header.e_ident, "\177ELF", 4) != 0 || header.e_ident[4] != 2 || header.e_shentsize != sizeof(_ElfSectionHeader) ||
+     header.e_shoff + (long long)sizeof(_ElfSectionHeader)*header.e_shnum > (unsigned long long)contentSize)
+    return -1;
+
+  for(int s = 0; s < header.e_shnum; s++)
+  {
+    _ElfSectionHeader table;
+    memcpy(&table, content + header.e_shoff + sizeof(_ElfSectionHeader)*s, sizeof(_ElfSectionHeader));
+    // Static functions are only in the symbol table (2), stripped files keep the dynamic one (11)
+    if((table.sh_type != 2 && table.sh_type != 11) || table.sh_offset + table.sh_size > (unsigned long long)contentSize) continue;
+    for(unsigned long long i = 1; i < table.sh_size/sizeof(_ElfSymbol); i++)
+    {
+      _ElfSymbol symbol;
+      memcpy(&symbol, content + table.sh_offset + sizeof(_ElfSymbol)*i, sizeof(_ElfSymbol));
+      if((symbol.st_info & 0xF) == 2 && symbol.st_shndx != 0 && symbol.st_value == value) return symbol.st_size;
+    }
+  }
+  return -1;
 }
@@ -42,11 +42,191 @@ int _listFiles(char* path, char** output)
 
 	return fileCount;
 }
+
+bool _mapFile(char* path, _MappedFile* out)
+{
+  memset(out, 0, sizeof(_MappedFile));
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+  if(file == INVALID_HANDLE_VALUE) return false;
+
+  LARGE_INTEGER size;
+  HANDLE mapping = 0;
+  if(GetFileSizeEx(file, &size) && size.QuadPart > 0)
+    mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+  if(mapping)
+    out->data = (char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if(!out->data)
+  {
+    if(mapping) CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+
+  out->size = size.QuadPart;
+  out->handle = (intptr_t)file;
+  out->mapping = (intptr_t)mapping;
+  return true;
+}
+
+void _unmapFile(_MappedFile* file)
+{
+  if(file->data) UnmapViewOfFile(file->data);
+  if(file->mapping) CloseHandle((HANDLE)file->mapping);
+  if(file->handle) CloseHandle((HANDLE)file->handle);
+  memset(file, 0, sizeof(_MappedFile));
+}
+
+bool _copyFileRange(FILE* output, _MappedFile* source, long long offset, long long size)
+{
+  return fwrite(source->data + offset, 1, size, output) == (size_t)size;
+}
+
+bool _makeParentDirectories(char* path)
+{
+  char directory[strlen(path) + 1];
+  strcpy(directory, path);
+  for(char* separator = directory + 1; *separator; separator++)
+  {
+    if(*separator != '/' && *separator != '\\') continue;
+    char aux = *separator;
+    *separator = '\0';
+    if(!CreateDirectoryA(directory, 0) && GetLastError() != ERROR_ALREADY_EXISTS) return false;
+    *separator = aux;
+  }
+  return true;
+}
+
+bool _writeCode(void* address, const void* code, int size)
+{
+  DWORD protection;
+  if(!VirtualProtect(address, size, PAGE_EXECUTE_READWRITE, &protection)) return false;
+  memcpy(address, code, size);
+  VirtualProtect(address, size, protection, &protection);
+  FlushInstructionCache(GetCurrentProcess(), address, size);
+  return true;
+}
+
+long long _functionSize(void* address)
+{
+  return -1;
+}
+
+typedef struct
+{
+  volatile LONG next;
+  int jobCount;
+  void (*job)(void* data, int index);
+  void* data;
+} _ParallelJobs;
+
+DWORD WINAPI _parallelWorker(LPVOID parameter)
+{
+  _ParallelJobs* jobs = (_ParallelJobs*)parameter;
+  for(int index; (index = InterlockedIncrement(&jobs->next) - 1) < jobs->jobCount;)
+    jobs->job(jobs->data, index);
+  return 0;
+}
+
+unsigned long long _monotonicTime()
+{
+  LARGE_INTEGER counter, frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  return counter.QuadPart/frequency.QuadPart*1000000000ULL + counter.QuadPart%frequency.QuadPart*1000000000ULL/frequency.QuadPart;
+}
+
+unsigned long long _currentThreadId()
+{
+  return GetCurrentThreadId();
+}
+
+void _runInParallel(int jobCount, void (*job)(void* data, int index), void* data)
+{
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  int threadCount = info.dwNumberOfProcessors < (DWORD)jobCount ? (int)info.dwNumberOfProcessors : jobCount;
+  _ParallelJobs jobs = {0, jobCount, job, data};
+  HANDLE threads[threadCount > 1 ? threadCount : 1];
+  int started = 0;
+  for(int i = 1; i < threadCount; i++)
+    if((threads[started] = CreateThread(0, 0, _parallelWorker, &jobs, 0, 0))) started++;
+  _parallelWorker(&jobs);
+  WaitForMultipleObjects(started, threads, TRUE, INFINITE);
+  for(int i = 0; i < started; i++)
+    CloseHandle(threads[i]);
+}
+
+typedef struct
+{
+  void (*job)(void* data, int index);
+  void* data;
+  int index;
+  HANDLE handle;
+} _Thread;
+
+DWORD WINAPI _threadMain(LPVOID parameter)
+{
+  _Thread* thread = (_Thread*)parameter;
+  thread->job(thread->data, thread->index);
+  return 0;
+}
+
+// Runs the job on a new thread for each index from 1 to count - 1, index 0 being left for the caller
+// startedCount gets the number of threads running the job, counting the caller
+void* _startThreads(int count, void (*job)(void* data, int index), void* data, int* startedCount)
+{
+  *startedCount = 1;
+  _Thread* threads = (_Thread*)calloc(count, sizeof(_Thread));
+  for(int i = 1; i < count; i++)
+  {
+    threads[i] = (_Thread){job, data, i, 0};
+    threads[i].handle = CreateThread(0, 0, _threadMain, &threads[i], 0, 0);
+    if(threads[i].handle) (*startedCount)++;
+  }
+  return threads;
+}
+
+void _joinThreads(void* threads, int count)
+{
+  _Thread* started = (_Thread*)threads;
+  for(int i = 1; i < count; i++)
+    if(started[i].handle)
+    {
+      WaitForSingleObject(started[i].handle, INFINITE);
+      CloseHandle(started[i].handle);
+    }
+  free(started);
+}
+
+void _exitThread()
+{
+  ExitThread(0);
+}
+
+bool _startProfiler(char* path)
+{
+  printf("--profile is not supported on this platform\n");
+  free(path);
+  return false;
+}
 #else
 #include <dirent.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#endif
 #include <unistd.h>
+#include <signal.h>
+#include <sys/time.h>
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#define _BTR_HAS_BACKTRACE
+#endif
 
 bool _isDirectory(char* path)
 {
@@ -87,4 +267,378 @@ int _listFiles(char* path, char** output)
   
   return fileCount;
 }
+
+bool _mapFile(char* path, _MappedFile* out)
+{
+  memset(out, 0, sizeof(_MappedFile));
+  int file = open(path, O_RDONLY);
+  if(file < 0) return false;
+
+  struct stat stats;
+  void* data = MAP_FAILED;
+  if(fstat(file, &stats) == 0 && stats.st_size > 0)
+    data = mmap(0, stats.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+  if(data == MAP_FAILED)
+  {
+    close(file);
+    return false;
+  }
+
+  out->data = (char*)data;
+  out->size = stats.st_size;
+  out->handle = file;
+  return true;
+}
+
+void _unmapFile(_MappedFile* file)
+{
+  if(file->data)
+  {
+    munmap(file->data, file->size);
+    close((int)file->handle);
+  }
+  memset(file, 0, sizeof(_MappedFile));
+}
+
+bool _copyFileRange(FILE* output, _MappedFile* source, long long offset, long long size)
+{
+#ifdef __linux__
+  // Buffered stdio data must reach the descriptor before the kernel appends after it
+  if(fflush(output) != 0) return false;
+  off_t sourceOffset = offset;
+  long long remaining = size;
+  while(remaining > 0)
+  {
+    ssize_t copied = sendfile(fileno(output), (int)source->handle, &sourceOffset, remaining);
+    if(copied <= 0) break;
+    remaining -= copied;
+  }
+  offset += size - remaining;
+  size = remaining;
+#endif
+  return fwrite(source->data + offset, 1, size, output) == (size_t)size;
+}
+
+bool _makeParentDirectories(char* path)
+{
+  char directory[strlen(path) + 1];
+  strcpy(directory, path);
+  for(char* separator = directory + 1; *separator; separator++)
+  {
+    if(*separator != '/') continue;
+    *separator = '\0';
+    if(mkdir(directory, 0755) != 0 && !_isDirectory(directory)) return false;
+    *separator = '/';
+  }
+  return true;
+}
+
+bool _writeCode(void* address, const void* code, int size)
+{
+  uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+  uintptr_t begin = (uintptr_t)address & ~(pageSize - 1);
+  uintptr_t end = (uintptr_t)address + size;
+  if(mprotect((void*)begin, end - begin, PROT_READ | PROT_WRITE | PROT_EXEC) != 0) return false;
+  memcpy(address, code, size);
+  mprotect((void*)begin, end - begin, PROT_READ | PROT_EXEC);
+  __builtin___clear_cache((char*)address, (char*)address + size);
+  return true;
+}
+
+#if defined(__ELF__) && defined(__LP64__)
+// dl_iterate_phdr and its struct are only declared with _GNU_SOURCE by glibc, the start of the struct is the same everywhere
+struct _LoadedObjectInfo
+{
+  uintptr_t base;
+  const char* path;
+  const _ElfProgramHeader* headers;
+  uint16_t headerCount;
+};
+
+int _iterateLoadedObjects(int (*callback)(struct _LoadedObjectInfo* info, size_t size, void* data), void* data) __asm__("dl_iterate_phdr");
+
+typedef struct
+{
+  uintptr_t address;
+  const char* path;
+  uintptr_t base;
+} _LoadedObject;
+
+int _findLoadedObject(struct _LoadedObjectInfo* info, size_t size, void* data)
+{
+  _LoadedObject* object = (_LoadedObject*)data;
+  for(int i = 0; i < info->headerCount; i++)
+  {
+    uintptr_t start = info->base + info->headers[i].p_vaddr;
+    // 1 is a loadable segment
+    if(info->headers[i].p_type == 1 && object->address >= start && object->address < start + info->headers[i].p_memsz)
+    {
+      object->path = info->path;
+      object->base = info->base;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Reads the size of a loaded function from the symbols of the file it was loaded from, -1 when it is not found
+long long _functionSize(void* address)
+{
+  _LoadedObject object = {(uintptr_t)address, 0, 0};
+  if(!_iterateLoadedObjects(_findLoadedObject, &object)) return -1;
+  // The executable itself has no name
+  char* path = (char*)(object.path && *object.path ? object.path : "/proc/self/exe");
+  _MappedFile file;
+  if(!_mapFile(path, &file)) return -1;
+  long long size = _objectFileFunctionSize(file.data, file.size, (uintptr_t)address - object.base);
+  _unmapFile(&file);
+  return size;
+}
+#else
+long long _functionSize(void* address)
+{
+  return -1;
+}
+#endif
+
+typedef struct
+{
+  int next;
+  int jobCount;
+  void (*job)(void* data, int index);
+  void* data;
+} _ParallelJobs;
+
+void* _parallelWorker(void* parameter)
+{
+  _ParallelJobs* jobs = (_ParallelJobs*)parameter;
+  for(int index; (index = __sync_fetch_and_add(&jobs->next, 1)) < jobs->jobCount;)
+    jobs->job(jobs->data, index);
+  return 0;
+}
+
+unsigned long long _monotonicTime()
+{
+  struct timespec now;
+  _clockGettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec*1000000000ULL + now.tv_nsec;
+}
+
+unsigned long long _currentThreadId()
+{
+#ifdef __linux__
+  return syscall(SYS_gettid);
+#else
+  return (unsigned long long)(uintptr_t)pthread_self();
+#endif
+}
+
+void _runInParallel(int jobCount, void (*job)(void* data, int index), void* data)
+{
+  long processors = sysconf(_SC_NPROCESSORS_ONLN);
+  int threadCount = processors < jobCount ? (int)processors : jobCount;
+  _ParallelJobs jobs = {0, jobCount, job, data};
+  pthread_t threads[threadCount > 1 ? threadCount : 1];
+  int started = 0;
+  for(int i = 1; i < threadCount; i++)
+    if(pthread_create(&threads[started], 0, _parallelWorker, &jobs) == 0) started++;
+  _parallelWorker(&jobs);
+  for(int i = 0; i < started; i++)
+    pthread_join(threads[i], 0);
+}
+
+typedef struct
+{
+  void (*job)(void* data, int index);
+  void* data;
+  int index;
+  bool started;
+  pthread_t handle;
+} _Thread;
+
+void* _threadMain(void* parameter)
+{
+  _Thread* thread = (_Thread*)parameter;
+  thread->job(thread->data, thread->index);
+  return 0;
+}
+
+// Runs the job on a new thread for each index from 1 to count - 1, index 0 being left for the caller
+// startedCount gets the number of threads running the job, counting the caller
+void* _startThreads(int count, void (*job)(void* data, int index), void* data, int* startedCount)
+{
+  *startedCount = 1;
+  _Thread* threads = (_Thread*)calloc(count, sizeof(_Thread));
+  for(int i = 1; i < count; i++)
+  {
+    threads[i].job = job;
+    threads[i].data = data;
+    threads[i].index = i;
+    threads[i].started = pthread_create(&threads[i].handle, 0, _threadMain, &threads[i]) == 0;
+    if(threads[i].started) (*startedCount)++;
+  }
+  return threads;
+}
+
+void _joinThreads(void* threads, int count)
+{
+  _Thread* started = (_Thread*)threads;
+  for(int i = 1; i < count; i++)
+    if(started[i].started) pthread_join(started[i].handle, 0);
+  free(started);
+}
+
+void _exitThread()
+{
+  pthread_exit(0);
+}
+
+#ifdef _BTR_HAS_BACKTRACE
+#define _PROFILE_MAX_DEPTH 64
+#define _PROFILE_MAX_SAMPLES 32768
+#define _PROFILE_INTERVAL_US 1000
+// Frames of the signal handler and the kernel trampoline on top of every sample
+#define _PROFILE_SKIPPED_FRAMES 2
+
+typedef struct
+{
+  int depth;
+  void* frames[_PROFILE_MAX_DEPTH];
+} _ProfileSample;
+
+_ProfileSample* _profileSamples;
+int _profileSampleCount;
+char* _profilePath;
+
+// Runs on SIGPROF, only touching memory reserved before the timer started
+void _profileSignalHandler(int signum)
+{
+  int index = __sync_fetch_and_add(&_profileSampleCount, 1);
+  if(index < _PROFILE_MAX_SAMPLES)
+    _profileSamples[index].depth = backtrace(_profileSamples[index].frames, _PROFILE_MAX_DEPTH);
+}
+
+// Writes a frame as its function name, or as <module>+<offset> when the symbol is not exported
+void _profileWriteFrame(FILE* file, char* symbol)
+{
+  char* open = strchr(symbol, '(');
+  char* end = open ? strpbrk(open, "+)") : 0;
+  if(open && end && end > open + 1)
+  {
+    fwrite(open + 1, 1, end - open - 1, file);
+    return;
+  }
+  char* module = symbol;
+  for(char* c = symbol; *c && c != open; c++)
+    if(*c == '/') module = c + 1;
+  char* offset = open ? strchr(open, ')') : 0;
+  if(open && offset) fprintf(file, "%.*s%.*s", (int)(open - module), module, (int)(offset - open - 1), open + 1);
+  else fprintf(file, "%.*s", (int)strcspn(module, " "), module);
+}
+
+int _compareProfileSamples(const void* a, const void* b)
+{
+  const _ProfileSample* sampleA = (const _ProfileSample*)a;
+  const _ProfileSample* sampleB = (const _ProfileSample*)b;
+  if(sampleA->depth != sampleB->depth) return sampleA->depth - sampleB->depth;
+  return memcmp(sampleA->frames, sampleB->frames, sampleA->depth*sizeof(void*));
+}
+
+typedef struct
+{
+  char* line;
+  int count;
+} _ProfileStack;
+
+int _compareProfileStacks(const void* a, const void* b)
+{
+  return strcmp(((const _ProfileStack*)a)->line, ((const _ProfileStack*)b)->line);
+}
+
+// Stops sampling and writes the samples as folded stacks, one "root;...;leaf count" line per distinct stack
+void _writeProfile()
+{
+  struct itimerval stop = {{0, 0}, {0, 0}};
+  setitimer(ITIMER_PROF, &stop, 0);
+  signal(SIGPROF, SIG_IGN);
+
+  int count = _profileSampleCount < _PROFILE_MAX_SAMPLES ? _profileSampleCount : _PROFILE_MAX_SAMPLES;
+  for(int i = 0; i < count; i++)
+  {
+    _ProfileSample* sample = &_profileSamples[i];
+    sample->depth = sample->depth > _PROFILE_SKIPPED_FRAMES ? sample->depth - _PROFILE_SKIPPED_FRAMES : 0;
+    memmove(sample->frames, sample->frames + _PROFILE_SKIPPED_FRAMES, sample->depth*sizeof(void*));
+  }
+  qsort(_profileSamples, count, sizeof(_ProfileSample), _compareProfileSamples);
+
+  // Stacks sampled at different instructions of the same functions fold into a single line
+  _ProfileStack* stacks = (_ProfileStack*)malloc((count ? count : 1)*sizeof(_ProfileStack));
+  int stackCount = 0;
+  for(int i = 0, next; i < count; i = next)
+  {
+    for(next = i + 1; next < count && _compareProfileSamples(&_profileSamples[i], &_profileSamples[next]) == 0; next++);
+    _ProfileSample* sample = &_profileSamples[i];
+    char** symbols = sample->depth ? backtrace_symbols(sample->frames, sample->depth) : 0;
+    if(!symbols) continue;
+    size_t size;
+    FILE* line = open_memstream(&stacks[stackCount].line, &size);
+    for(int frame = sample->depth - 1; frame >= 0; frame--)
+    {
+      _profileWriteFrame(line, symbols[frame]);
+      if(frame) fputc(';', line);
+    }
+    fclose(line);
+    stacks[stackCount++].count = next - i;
+    free(symbols);
+  }
+  qsort(stacks, stackCount, sizeof(_ProfileStack), _compareProfileStacks);
+
+  FILE* file = _makeParentDirectories(_profilePath) ? fopen(_profilePath, "w") : 0;
+  if(!file) printf("Could not write profile %s\n", _profilePath);
+  for(int i = 0, next; i < stackCount; i = next)
+  {
+    int samples = stacks[i].count;
+    for(next = i + 1; next < stackCount && strcmp(stacks[i].line, stacks[next].line) == 0; next++)
+      samples += stacks[next].count;
+    if(file) fprintf(file, "%s %i\n", stacks[i].line, samples);
+  }
+  for(int i = 0; i < stackCount; i++)
+    free(stacks[i].line);
+  free(stacks);
+  if(file) fclose(file);
+}
+
+// Samples the process on CPU time with SIGPROF, which the failure handlers leave alone, until it exits
+bool _startProfiler(char* path)
+{
+  _profileSamples = (_ProfileSample*)calloc(_PROFILE_MAX_SAMPLES, sizeof(_ProfileSample));
+  if(!_profileSamples)
+  {
+    free(path);
+    return false;
+  }
+  _profilePath = path;
+  // The first backtrace loads the unwinder, which must not happen inside the handler
+  void* warmup[1];
+  backtrace(warmup, 1);
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = _profileSignalHandler;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGPROF, &action, 0);
+  atexit(_writeProfile);
+
+  struct itimerval interval = {{0, _PROFILE_INTERVAL_US}, {0, _PROFILE_INTERVAL_US}};
+  return setitimer(ITIMER_PROF, &interval, 0) == 0;
+}
+#else
+bool _startProfiler(char* path)
+{
+  printf("--profile is not supported on this platform\n");
+  free(path);
+  return false;
+}
+#endif
 #endif
@@ -0,0 +1,282 @@
+// This content is part of test.h
+// Property based tests: the body runs in process over generated inputs, drawn inside it with the any* functions.
+// Every drawn value comes from a sequence of choices, a failing sequence is shrunk by deleting and lowering choices
+// while the body keeps failing, so the reported counterexample is small
+
+#define _PROPERTY_MAX_CHOICES 4096
+#define _PROPERTY_MAX_SHRINKS 10000
+
+enum _PropertyPhase
+{
+  _PROPERTY_GENERATING,
+  _PROPERTY_SHRINKING,
+  _PROPERTY_DONE
+};
+
+enum _PropertyShrink
+{
+  _PROPERTY_SHRINK_DELETE,
+  _PROPERTY_SHRINK_ZERO,
+  _PROPERTY_SHRINK_HALVE,
+  // The lowest bit is the sign of anyInt values, these lower the magnitude without flipping it
+  _PROPERTY_SHRINK_HALVE_KEEPING_SIGN,
+  _PROPERTY_SHRINK_DECREMENT_KEEPING_SIGN,
+  _PROPERTY_SHRINK_DECREMENT,
+  _PROPERTY_SHRINK_KINDS
+};
+
+typedef struct
+{
+  _BTR_JMP_BUF jump;
+  int phase;
+  int iterations;
+  int iteration;
+  int line;
+  bool ran;
+  int mockChangesCount, runtimeMocksCount;
+  unsigned long long seed;
+  unsigned long long random;
+  void (*onFail)(char* file, int line, char* expr);
+  // Choices of the running case, replayed up to choiceCount and drawn past it
+  unsigned long long choices[_PROPERTY_MAX_CHOICES];
+  long long values[_PROPERTY_MAX_CHOICES];
+  int choiceCount, drawn, valueCount;
+  bool failed;
+  char* failFile;
+  int failLine;
+  char* failExpr;
+  // Smallest failing case found so far
+  unsigned long long best[_PROPERTY_MAX_CHOICES];
+  long long bestValues[_PROPERTY_MAX_CHOICES];
+  int bestCount, bestValueCount;
+  char* bestFile;
+  int bestLine;
+  char* bestExpr;
+  int shrinkIndex, shrinkKind, shrinks, shrinkRuns;
+  bool improved;
+} _Property;
+
+_Property _property;
+
+// splitmix64, the state is the seed and goes on from there
+unsigned long long _nextRandom(unsigned long long* state)
+{
+  unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27))*0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// Fails the running case, jumping back to the property loop
+void _propertyFailure(char* file, int line, char* expr)
+{
+  _property.failed = true;
+  _property.failFile = file;
+  _property.failLine = line;
+  _property.failExpr = expr;
+  _btrLongjmp(_property.jump);
+}
+
+void _startProperty(int line, int iterations)
+{
+  _property.line = line;
+  _property.ran = false;
+  _property.mockChangesCount = _mockChangesCount;
+  _property.runtimeMocksCount = _runtimeMocksCount;
+  _property.phase = _PROPERTY_GENERATING;
+  _property.iterations = iterations > 0 ? iterations : 1;
+  _property.iteration = -1;
+  _property.seed = _testOptions.hasSeed ? _testOptions.seed : _monotonicTime();
+  _property.random = _property.seed;
+  _property.onFail = onFail;
+  _property.failed = false;
+}
+
+// Every case starts like a test, with the mocks of its context and a fresh setup
+void _startPropertyCase(int choiceCount)
+{
+  if(_property.ran)
+  {
+    cleanFunction();
+    setupFunction();
+  }
+  _property.ran = true;
+  _property.choiceCount = choiceCount;
+  _property.drawn = 0;
+  _property.valueCount = 0;
+  _property.failed = false;
+  onFail = _propertyFailure;
+}
+
+void _keepPropertyFailure()
+{
+  memcpy(_property.best, _property.choices, _property.drawn*sizeof(unsigned long long));
+  memcpy(_property.bestValues, _property.values, _property.valueCount*sizeof(long long));
+  _property.bestCount = _property.drawn;
+  _property.bestValueCount = _property.valueCount;
+  _property.bestFile = _property.failFile;
+  _property.bestLine = _property.failLine;
+  _property.bestExpr = _property.failExpr;
+}
+
+// Cases only get replaced by shorter ones, or by ones as long and with lower choices, so shrinking always ends
+bool _isSmallerPropertyCase()
+{
+  if(_property.drawn != _property.bestCount) return _property.drawn < _property.bestCount;
+  for(int i = 0; i < _property.drawn; i++)
+    if(_property.choices[i] != _property.best[i]) return _property.choices[i] < _property.best[i];
+  return false;
+}
+
+// Writes into the choices the next variation of the best failing case, returns false when all have been tried
+bool _nextPropertyShrink()
+{
+  for(; _property.shrinkIndex < _property.bestCount; _property.shrinkIndex++, _property.shrinkKind = 0)
+    for(; _property.shrinkKind < _PROPERTY_SHRINK_KINDS; _property.shrinkKind++)
+    {
+      int index = _property.shrinkIndex, count = _property.bestCount;
+      unsigned long long value = _property.best[index];
+      if(_property.shrinkKind != _PROPERTY_SHRINK_DELETE && value == 0) continue;
+      memcpy(_property.choices, _property.best, count*sizeof(unsigned long long));
+      switch(_property.shrinkKind)
+      {
+        case _PROPERTY_SHRINK_DELETE:
+          memmove(_property.choices + index, _property.choices + index + 1, (count - index - 1)*sizeof(unsigned long long));
+          count--;
+          break;
+        case _PROPERTY_SHRINK_ZERO: _property.choices[index] = 0; break;
+        case _PROPERTY_SHRINK_HALVE: _property.choices[index] = value/2; break;
+        case _PROPERTY_SHRINK_HALVE_KEEPING_SIGN: _property.choices[index] = ((value/2) & ~1ULL) | (value & 1); break;
+        case _PROPERTY_SHRINK_DECREMENT_KEEPING_SIGN: _property.choices[index] = value >= 2 ? value - 2 : value; break;
+        case _PROPERTY_SHRINK_DECREMENT: _property.choices[index] = value - 1; break;
+      }
+      if(_property.shrinkKind != _PROPERTY_SHRINK_DELETE && _property.choices[index] == value) continue;
+      _startPropertyCase(count);
+      return true;
+    }
+  return false;
+}
+
+void _reportPropertyFailure()
+{
+  static char message[2048];
+  int length = snprintf(message, sizeof(message), "%.500s with seed %llu, case %i shrunk %i times to", _property.bestExpr,
+    _property.seed, _property.iteration, _property.shrinks);
+  for(int i = 0; i < _property.bestValueCount && length < (int)sizeof(message) - 32; i++)
+    length += snprintf(message + length, sizeof(message) - length, "%s %lli", i ? "," : "", _property.bestValues[i]);
+  if(_property.bestValueCount == 0) snprintf(message + length, sizeof(message) - length, " no values");
+  _property.phase = _PROPERTY_DONE;
+  _property.onFail(_property.bestFile, _property.bestLine, message);
+}
+
+// Decides what the body runs with next, from the outcome of the last case. Returns false once the property is done
+bool _nextPropertyCase()
+{
+  onFail = _property.onFail;
+  _restoreMocks(_property.mockChangesCount);
+  _restoreRuntimeMocks(_property.runtimeMocksCount);
+  if(_property.phase == _PROPERTY_GENERATING)
+  {
+    if(_property.failed)
+    {
+      _keepPropertyFailure();
+      _property.phase = _PROPERTY_SHRINKING;
+      _property.shrinkIndex = _property.shrinkKind = _property.shrinks = _property.shrinkRuns = 0;
+      _property.improved = false;
+    }
+    else if(++_property.iteration < _property.iterations)
+    {
+      _startPropertyCase(0);
+      return true;
+    }
+    else
+    {
+      _property.phase = _PROPERTY_DONE;
+      return false;
+    }
+  }
+  else if(_property.phase == _PROPERTY_SHRINKING)
+  {
+    // Stays on the same variation after a success, so repeated halving works as a search
+    if(_property.failed && _isSmallerPropertyCase())
+    {
+      _keepPropertyFailure();
+      _property.shrinks++;
+      _property.improved = true;
+    }
+    else
+      _property.shrinkKind++;
+  }
+  if(_property.phase != _PROPERTY_SHRINKING) return false;
+
+  while(_property.shrinkRuns < _PROPERTY_MAX_SHRINKS)
+  {
+    if(_nextPropertyShrink())
+    {
+      _property.shrinkRuns++;
+      return true;
+    }
+    if(!_property.improved) break;
+    _property.improved = false;
+    _property.shrinkIndex = _property.shrinkKind = 0;
+  }
+  _reportPropertyFailure();
+  return false;
+}
+
+// The next choice: replayed while shrinking, random while generating, mostly small but covering every bit width
+unsigned long long _propertyChoice()
+{
+  if(_property.drawn >= _PROPERTY_MAX_CHOICES)
+  {
+    // Can not be shrunk or replayed, so the property fails as a whole
+    _property.phase = _PROPERTY_DONE;
+    onFail = _property.onFail;
+    onFail(_sourceFile, _property.line, _C_STRING_LITERAL("a case of the property drew more than 4096 choices"));
+    _btrLongjmp(_property.jump);
+  }
+  if(_property.drawn >= _property.choiceCount)
+  {
+    unsigned long long choice = 0;
+    if(_property.phase == _PROPERTY_GENERATING)
+    {
+      int bits = (int)(_nextRandom(&_property.random) % 65);
+      choice = bits == 64 ? _nextRandom(&_property.random) : _nextRandom(&_property.random) & ((1ULL << bits) - 1);
+    }
+    _property.choices[_property.choiceCount++] = choice;
+  }
+  return _property.choices[_property.drawn++];
+}
+
+long long _propertyValue(long long value)
+{
+  if(_property.valueCount < _PROPERTY_MAX_CHOICES) _property.values[_property.valueCount++] = value;
+  return value;
+}
+
+// An int, shrinking towards 0 through a zigzag mapping of the choice: 0, -1, 1, -2, 2...
+int anyInt()
+{
+  unsigned int choice = (unsigned int)_propertyChoice();
+  return (int)_propertyValue((int)((choice >> 1) ^ (0u - (choice & 1))));
+}
+
+// A value from min to max, both included, shrinking towards min
+long long anyIntBetween(long long min, long long max)
+{
+  unsigned long long range = (unsigned long long)max - (unsigned long long)min + 1;
+  unsigned long long choice = _propertyChoice();
+  return _propertyValue((long long)((unsigned long long)min + (range ? choice % range : choice)));
+}
+
+bool anyBool()
+{
+  return (bool)_propertyValue(_propertyChoice() & 1);
+}
+
+// Fills a buffer with random bytes, shrinking towards zeros. Each byte is a choice, a case fails past 4096 of them
+void anyBytes(void* buffer, int size)
+{
+  for(int i = 0; i < size; i++)
+    ((unsigned char*)buffer)[i] = (unsigned char)(_propertyChoice() & 0xFF);
+}
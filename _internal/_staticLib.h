@@ -1,37 +1,60 @@
 // This content is part of test.h
 // Static libraries management
+// Follows the GNU ar layout: optional "/" or "/SYM64/" symbol index, optional "//" long names table and then the members
 
 typedef struct _StaticLib _StaticLib;
 typedef struct _GlobalSymbol _GlobalSymbol;
 typedef struct _StaticLibFile _StaticLibFile;
 typedef struct _StaticLibHeader _StaticLibHeader;
+typedef struct _MappedFile _MappedFile;
+typedef struct _StringPool _StringPool;
+
+#define _STATIC_LIB_SIGNATURE "!<arch>\n"
+#define _STATIC_LIB_SIGNATURE_SIZE 8
+#define _STATIC_LIB_MEMBER_HEADER_SIZE 60
+#define _STATIC_LIB_MAX_SHORT_NAME 15
+
+struct _MappedFile
+{
+  char* data;
+  long long size;
+  intptr_t handle;
+  intptr_t mapping;
+};
+
+// Null terminated strings packed one after another, referenced by offset so the block may grow
+struct _StringPool
+{
+  char* data;
+  long long size;
+  long long capacity;
+};
 
 struct _GlobalSymbol
 {
-  char name[_BTR_MAX_NAME_SIZE];
-  int fileOffset;
+  long long nameOffset;
+  int nameLength;
+  long long fileOffset;
   int fileIndex;
 };
 
+// Content either points inside the archive mapping or, once rewritten, to a heap block owned by the file
+// The member name is resolved from the long names table when needed and kept in the library string pool
 struct _StaticLibFile
 {
-  char fileInfo[60];
+  char fileInfo[_STATIC_LIB_MEMBER_HEADER_SIZE];
+  long long nameOffset;
   char* content;
   long long contentSize;
+  bool ownsContent;
 };
 
+// fileInfo holds the member header of the symbol index, is64 tells whether it was stored as "/SYM64/"
 struct _StaticLibHeader
 {
-  char sig[8];
-  char name[16];
-  char date[12];
-  char uid[6];
-  char gid[6];
-  char mode[8];
-  char size[10];
-  char end[2];
-
+  char fileInfo[_STATIC_LIB_MEMBER_HEADER_SIZE];
   int globalSymbolCount;
+  bool is64;
 };
 
 struct _StaticLib
@@ -40,140 +63,338 @@ struct _StaticLib
   _GlobalSymbol* globalSymbols;
   int fileCount;
   _StaticLibFile* files;
+  _MappedFile source;
+  _StringPool strings;
 };
 
-bool _staticLibAmILittleEndian()
+// Maps a whole file read only into memory, implemented by the platform specific section
+bool _mapFile(char* path, _MappedFile* out);
+void _unmapFile(_MappedFile* file);
+// Appends a range of a mapped file to output, letting the kernel do the copy when the platform allows it
+bool _copyFileRange(FILE* output, _MappedFile* source, long long offset, long long size);
+
+// Symbol index numbers are big endian words of 4 bytes ("/") or 8 bytes ("/SYM64/")
+unsigned long long _staticLibReadWord(const char* data, int wordSize)
+{
+  unsigned long long value = 0;
+  for(int i = 0; i < wordSize; i++)
+    value = (value << 8) | (unsigned char)data[i];
+  return value;
+}
+
+void _staticLibWriteWord(FILE* file, unsigned long long value, int wordSize)
+{
+  for(int i = wordSize - 1; i >= 0; i--)
+    fputc((value >> (8*i)) & 0xFF, file);
+}
+
+// Appends a string to the pool returning its offset
+long long _stringPoolAdd(_StringPool* pool, const char* string, long long length)
 {
-  int a = 1;
-  return ((char*)&a)[0] == 1;
+  if(pool->size + length + 1 > pool->capacity)
+  {
+    pool->capacity = pool->capacity ? pool->capacity*2 : 256;
+    if(pool->capacity < pool->size + length + 1) pool->capacity = pool->size + length + 1;
+    pool->data = (char*)realloc(pool->data, pool->capacity);
+  }
+  long long offset = pool->size;
+  memcpy(pool->data + offset, string, length);
+  pool->data[offset + length] = '\0';
+  pool->size += length + 1;
+  return offset;
 }
 
-unsigned int _staticLibSwapBytes(unsigned int number)
+char* _staticLibSymbolName(_StaticLib* lib, _GlobalSymbol* symbol)
 {
-  return ((number & 0x000000FF) << 24) |
-          ((number & 0x0000FF00) << 8) |
-          ((number & 0x00FF0000) >> 8) |
-          ((number & 0xFF000000) >> 24);
+  return lib->strings.data + symbol->nameOffset;
 }
 
-void _staticLibSwapIfLittleEndian(int* bigEndian)
+char* _staticLibFileName(_StaticLib* lib, _StaticLibFile* libFile)
 {
-  if(_staticLibAmILittleEndian())
-    *bigEndian = _staticLibSwapBytes(*bigEndian);
+  return lib->strings.data + libFile->nameOffset;
+}
+
+void _staticLibRenameSymbol(_StaticLib* lib, _GlobalSymbol* symbol, const char* name)
+{
+  symbol->nameLength = strlen(name);
+  symbol->nameOffset = _stringPoolAdd(&lib->strings, name, symbol->nameLength);
+}
+
+// Replaces the content of a member, releasing the previous one if it was not a slice of the mapping
+void _staticLibFileSetContent(_StaticLibFile* libFile, char* content, long long contentSize)
+{
+  if(libFile->ownsContent && libFile->content != content) free(libFile->content);
+  libFile->content = content;
+  libFile->contentSize = contentSize;
+  libFile->ownsContent = true;
+}
+
+// Finds the member whose header starts at the given archive offset, -1 if none does
+int _staticLibFindFileByOffset(long long* fileOffsets, int fileCount, long long offset)
+{
+  int begin = 0, end = fileCount;
+  while(begin < end)
+  {
+    int middle = begin + (end - begin)/2;
+    if(fileOffsets[middle] < offset) begin = middle + 1;
+    else end = middle;
+  }
+  return begin < fileCount && fileOffsets[begin] == offset ? begin : -1;
+}
+
+bool _staticLibIsMember(char* fileInfo, const char* name)
+{
+  int length = strlen(name);
+  if(memcmp(fileInfo, name, length) != 0) return false;
+  for(int i = length; i < 16; i++)
+    if(fileInfo[i] != ' ') return false;
+  return true;
+}
+
+// Member names are "name/" when short or "/offset" into the long names table, where they end with "/\n"
+long long _staticLibAddMemberName(_StaticLib* lib, char* fileInfo, char* longNames, long long longNamesSize)
+{
+  char* name = fileInfo;
+  long long length = 0;
+  if(fileInfo[0] == '/' && isdigit((unsigned char)fileInfo[1]) && longNames)
+  {
+    long long offset = atoll(&fileInfo[1]);
+    if(offset < longNamesSize)
+    {
+      name = &longNames[offset];
+      while(offset + length < longNamesSize && name[length] != '/' && name[length] != '\n') length++;
+    }
+  }
+  else
+  {
+    while(length < 16 && name[length] != '/' && name[length] != ' ') length++;
+  }
+  return _stringPoolAdd(&lib->strings, name, length);
 }
 
 bool _staticLibRead(_StaticLib* out, char* path)
 {
   memset(out, 0, sizeof(_StaticLib));
-  FILE *file = fopen(path, "rb");
-  if(!file) return false;
-  
-  bool ok = true;
-  fseek(file, 0, SEEK_SET);
-  ok = fread(out, sizeof(_StaticLibHeader), 1, file) == 1;
-  ok = ok && memcmp(out->header.sig, "!<arch>\n", 6) == 0;
+  if(!_mapFile(path, &out->source)) return false;
 
-  if(ok)
-  {
-    _staticLibSwapIfLittleEndian(&out->header.globalSymbolCount);
-    int size = sizeof(_GlobalSymbol)*out->header.globalSymbolCount;
+  char* data = out->source.data;
+  long long dataSize = out->source.size;
+  if(dataSize < _STATIC_LIB_SIGNATURE_SIZE || memcmp(data, _STATIC_LIB_SIGNATURE, _STATIC_LIB_SIGNATURE_SIZE) != 0)
+    return false;
 
-    out->globalSymbols = (_GlobalSymbol*)malloc(size);
-    memset(out->globalSymbols, 0, size);
+  char* symbolIndex = 0, *longNames = 0;
+  long long symbolIndexSize = 0, longNamesSize = 0;
+  bool ok = true;
 
-    for(int i = 0; i < out->header.globalSymbolCount; i++)
+  for(long long position = _STATIC_LIB_SIGNATURE_SIZE; position + _STATIC_LIB_MEMBER_HEADER_SIZE <= dataSize;)
+  {
+    char* fileInfo = &data[position];
+    long long contentSize = atoll(&fileInfo[48]);
+    char* content = &data[position + _STATIC_LIB_MEMBER_HEADER_SIZE];
+    if(position + _STATIC_LIB_MEMBER_HEADER_SIZE + contentSize > dataSize)
     {
-      _GlobalSymbol* symbol = &out->globalSymbols[i];
-      symbol->fileIndex = 0;
-      fread(&symbol->fileOffset, sizeof(int), 1, file);
-      _staticLibSwapIfLittleEndian(&symbol->fileOffset);
+      ok = false;
+      break;
     }
 
-    for(int i = 0; i < out->header.globalSymbolCount; i++)
+    if(_staticLibIsMember(fileInfo, "/") || _staticLibIsMember(fileInfo, "/SYM64/"))
     {
-      char* name = out->globalSymbols[i].name;
-      int c;
-      while((c = fgetc(file))) *(name++) = c;
+      memcpy(out->header.fileInfo, fileInfo, _STATIC_LIB_MEMBER_HEADER_SIZE);
+      out->header.is64 = fileInfo[1] == 'S';
+      symbolIndex = content;
+      symbolIndexSize = contentSize;
     }
+    else if(_staticLibIsMember(fileInfo, "//"))
+    {
+      longNames = content;
+      longNamesSize = contentSize;
+    }
+    else
+      out->fileCount++;
 
-    fseek(file, sizeof(_StaticLibHeader) -sizeof(int) + atoi(out->header.size), SEEK_SET);
-    int c;
-    while((c = getc(file)) != EOF)
+    position += _STATIC_LIB_MEMBER_HEADER_SIZE + contentSize + (contentSize & 1);
+  }
+
+  long long* fileOffsets = (long long*)malloc(sizeof(long long)*(out->fileCount + 1));
+  out->files = (_StaticLibFile*)malloc(sizeof(_StaticLibFile)*(out->fileCount + 1));
+  memset(out->files, 0, sizeof(_StaticLibFile)*out->fileCount);
+
+  long long position = _STATIC_LIB_SIGNATURE_SIZE;
+  for(int i = 0; i < out->fileCount;)
+  {
+    char* fileInfo = &data[position];
+    long long contentSize = atoll(&fileInfo[48]);
+    char* content = &data[position + _STATIC_LIB_MEMBER_HEADER_SIZE];
+    if(content != symbolIndex && content != longNames)
     {
-      ungetc(c, file);
-      for(int i = 0; i < out->header.globalSymbolCount; i++)
-        if(out->globalSymbols[i].fileOffset == ftell(file))
-          out->globalSymbols[i].fileIndex = out->fileCount;
-      int i = out->fileCount++;
-      out->files = (_StaticLibFile*)realloc(out->files, sizeof(_StaticLibFile)*out->fileCount);
       _StaticLibFile* libFile = &out->files[i];
-      memset(libFile, 0, sizeof(_StaticLibFile));
-      fread(libFile->fileInfo, sizeof(libFile->fileInfo), 1, file);
-      libFile->contentSize = atoi(&libFile->fileInfo[48]);
-      libFile->content = (char*)malloc(libFile->contentSize);
-      ok = fread(libFile->content, libFile->contentSize, 1, file) == 1;
+      memcpy(libFile->fileInfo, fileInfo, sizeof(libFile->fileInfo));
+      libFile->nameOffset = _staticLibAddMemberName(out, fileInfo, longNames, longNamesSize);
+      libFile->content = content;
+      libFile->contentSize = contentSize;
+      fileOffsets[i++] = position;
     }
+    position += _STATIC_LIB_MEMBER_HEADER_SIZE + contentSize + (contentSize & 1);
+  }
+
+  int wordSize = out->header.is64 ? 8 : 4;
+  long long globalSymbolCount = symbolIndexSize >= wordSize ? _staticLibReadWord(symbolIndex, wordSize) : 0;
+  if(globalSymbolCount < 0 || globalSymbolCount > symbolIndexSize || wordSize*(globalSymbolCount + 1) > symbolIndexSize)
+  {
+    globalSymbolCount = 0;
+    ok = false;
+  }
+  out->header.globalSymbolCount = globalSymbolCount;
+
+  int size = sizeof(_GlobalSymbol)*out->header.globalSymbolCount;
+  out->globalSymbols = (_GlobalSymbol*)malloc(size ? size : 1);
+  memset(out->globalSymbols, 0, size);
+
+  // All names are copied to the pool at once, each symbol only keeps its offset and length
+  long long namesSize = symbolIndexSize - wordSize*(globalSymbolCount + 1);
+  long long nameOffset = namesSize > 0 ? _stringPoolAdd(&out->strings, symbolIndex + wordSize*(globalSymbolCount + 1), namesSize) : 0;
+  long long namesEnd = nameOffset + namesSize;
+  for(int i = 0; i < out->header.globalSymbolCount; i++)
+  {
+    _GlobalSymbol* symbol = &out->globalSymbols[i];
+    symbol->fileOffset = _staticLibReadWord(symbolIndex + wordSize*(i + 1), wordSize);
+    symbol->fileIndex = _staticLibFindFileByOffset(fileOffsets, out->fileCount, symbol->fileOffset);
+    if(symbol->fileIndex < 0) symbol->fileIndex = 0;
+
+    symbol->nameOffset = nameOffset;
+    symbol->nameLength = strlen(&out->strings.data[nameOffset]);
+    nameOffset += symbol->nameLength;
+    if(nameOffset < namesEnd) nameOffset++;
   }
 
-  fclose(file);
+  free(fileOffsets);
 
   return ok;
 }
 
+// Fills a member header keeping date, owner and mode of the given template
+void _staticLibFormatFileInfo(char* fileInfo, char* templateInfo, const char* name, long long contentSize)
+{
+  char aux[32];
+  memset(fileInfo, ' ', _STATIC_LIB_MEMBER_HEADER_SIZE);
+  if(templateInfo && memcmp(&templateInfo[58], "`\n", 2) == 0)
+    memcpy(&fileInfo[16], &templateInfo[16], 32);
+  else
+  {
+    memcpy(&fileInfo[16], "0", 1);
+    memcpy(&fileInfo[28], "0", 1);
+    memcpy(&fileInfo[34], "0", 1);
+    memcpy(&fileInfo[40], "644", 3);
+  }
+  memcpy(fileInfo, name, strlen(name) < 16 ? strlen(name) : 16);
+  int length = sprintf(aux, "%lli", contentSize);
+  memcpy(&fileInfo[48], aux, length);
+  memcpy(&fileInfo[58], "`\n", 2);
+}
+
 bool _staticLibWrite(_StaticLib* lib, char* path)
 {
   FILE *file = fopen(path, "wb");
   if(!file) return false;
-  
-  char auxNum[32];
+
+  char fileInfo[_STATIC_LIB_MEMBER_HEADER_SIZE];
+  char aux[32];
   int globalSymbolCount = lib->header.globalSymbolCount;
-  unsigned int size = sizeof(int)*(globalSymbolCount+1);
-  for(int i = 0; i < globalSymbolCount; i++)
-    size += strlen(lib->globalSymbols[i].name) + 1;
-
-  _StaticLibHeader header = lib->header;
-  memset(header.size, ' ', sizeof(header.size));
-  sprintf(auxNum, "%u", size);
-  memcpy(header.size, auxNum, strlen(auxNum));
-  
-  fseek(file, 0, SEEK_SET);
-  _staticLibSwapIfLittleEndian(&header.globalSymbolCount);
-  fwrite(&header, sizeof(_StaticLibHeader), 1, file);
-  
+
+  // Names that do not fit the header go to the "//" table, each one followed by "/\n"
+  long long longNamesSize = 0;
+  for(int i = 0; i < lib->fileCount; i++)
+  {
+    long long length = strlen(_staticLibFileName(lib, &lib->files[i]));
+    if(length > _STATIC_LIB_MAX_SHORT_NAME) longNamesSize += length + 2;
+  }
+  // GNU ar counts the padding of this table as part of its content
+  longNamesSize += longNamesSize & 1;
+
+  long long namesSize = 0;
   for(int i = 0; i < globalSymbolCount; i++)
+    namesSize += lib->globalSymbols[i].nameLength + 1;
+
+  // Members are aligned to even offsets, so the offset of each one is a prefix sum of the padded sizes
+  // The 64 bit index is kept when the lib was read with it, otherwise only used when a member does not fit 32 bit
+  // offsets, like GNU ar does
+  long long* fileOffsets = (long long*)malloc(sizeof(long long)*(lib->fileCount + 1));
+  int wordSize = 4;
+  long long size = 0;
+  for(int attempt = lib->header.is64 ? 1 : 0; attempt < 2; attempt++)
   {
-    _GlobalSymbol symbol = lib->globalSymbols[i];
-    symbol.fileOffset = sizeof(_StaticLibHeader) - sizeof(int) + size + symbol.fileIndex*60;
-    for(int j = 0; j < symbol.fileIndex; j++)
-      symbol.fileOffset += lib->files[j].contentSize;
-    _staticLibSwapIfLittleEndian(&symbol.fileOffset);
-    fwrite(&symbol.fileOffset, sizeof(int), 1, file);
+    wordSize = attempt ? 8 : 4;
+    size = wordSize*(globalSymbolCount + 1) + namesSize;
+    fileOffsets[0] = _STATIC_LIB_SIGNATURE_SIZE + _STATIC_LIB_MEMBER_HEADER_SIZE + size + (size & 1);
+    if(longNamesSize) fileOffsets[0] += _STATIC_LIB_MEMBER_HEADER_SIZE + longNamesSize;
+    for(int i = 0; i < lib->fileCount; i++)
+      fileOffsets[i+1] = fileOffsets[i] + _STATIC_LIB_MEMBER_HEADER_SIZE + lib->files[i].contentSize + (lib->files[i].contentSize & 1);
+    if(!lib->fileCount || fileOffsets[lib->fileCount - 1] <= 0xFFFFFFFFll) break;
   }
 
+  fwrite(_STATIC_LIB_SIGNATURE, _STATIC_LIB_SIGNATURE_SIZE, 1, file);
+  _staticLibFormatFileInfo(fileInfo, lib->header.fileInfo, wordSize == 8 ? "/SYM64/" : "/", size);
+  fwrite(fileInfo, sizeof(fileInfo), 1, file);
+  _staticLibWriteWord(file, globalSymbolCount, wordSize);
   for(int i = 0; i < globalSymbolCount; i++)
-    fwrite(lib->globalSymbols[i].name, strlen(lib->globalSymbols[i].name) + 1, 1, file);
+    _staticLibWriteWord(file, fileOffsets[lib->globalSymbols[i].fileIndex], wordSize);
 
+  for(int i = 0; i < globalSymbolCount; i++)
+    fwrite(_staticLibSymbolName(lib, &lib->globalSymbols[i]), lib->globalSymbols[i].nameLength + 1, 1, file);
+  if(size & 1) fputc('\n', file);
+
+  if(longNamesSize)
+  {
+    _staticLibFormatFileInfo(fileInfo, 0, "//", longNamesSize);
+    memset(&fileInfo[16], ' ', 32);
+    fwrite(fileInfo, sizeof(fileInfo), 1, file);
+    for(int i = 0; i < lib->fileCount; i++)
+    {
+      char* name = _staticLibFileName(lib, &lib->files[i]);
+      if(strlen(name) > _STATIC_LIB_MAX_SHORT_NAME) fprintf(file, "%s/\n", name);
+    }
+    if(ftell(file) & 1) fputc('\n', file);
+  }
+
+  bool ok = true;
+  long long longNameOffset = 0;
   for(int i = 0; i < lib->fileCount; i++)
   {
-    char fileInfo[60];
     _StaticLibFile* libFile = &lib->files[i];
-    memcpy(fileInfo, libFile->fileInfo, sizeof(fileInfo));
-    memset(fileInfo + 48, ' ', 10);
-    sprintf(auxNum, "%lli", libFile->contentSize);
-    memcpy(fileInfo + 48, auxNum, strlen(auxNum));
-    fwrite(fileInfo, sizeof(libFile->fileInfo), 1, file);
-    fwrite(libFile->content, libFile->contentSize, 1, file);
+    char* name = _staticLibFileName(lib, libFile);
+    long long nameLength = strlen(name);
+    if(nameLength > _STATIC_LIB_MAX_SHORT_NAME)
+    {
+      sprintf(aux, "/%lli", longNameOffset);
+      longNameOffset += nameLength + 2;
+    }
+    else
+      sprintf(aux, "%s/", name);
+    _staticLibFormatFileInfo(fileInfo, libFile->fileInfo, aux, libFile->contentSize);
+    fwrite(fileInfo, sizeof(fileInfo), 1, file);
+
+    // Untouched members are still slices of the source archive and can be copied file to file
+    if(libFile->ownsContent || libFile->content < lib->source.data || libFile->content >= lib->source.data + lib->source.size)
+      fwrite(libFile->content, libFile->contentSize, 1, file);
+    else
+      ok &= _copyFileRange(file, &lib->source, libFile->content - lib->source.data, libFile->contentSize);
+    if(libFile->contentSize & 1) fputc('\n', file);
   }
 
-  fclose(file);
+  ok &= !ferror(file);
+  ok &= fclose(file) == 0;
+  free(fileOffsets);
 
-  return true;
+  return ok;
 }
 
 void _staticLibFree(_StaticLib* lib)
 {
   for(int i = 0; i < lib->fileCount; i++)
-    if(lib->files[i].content) free(lib->files[i].content);
+    if(lib->files[i].ownsContent) free(lib->files[i].content);
   if(lib->files) free(lib->files);
   if(lib->globalSymbols) free(lib->globalSymbols);
+  if(lib->strings.data) free(lib->strings.data);
+  _unmapFile(&lib->source);
+  memset(lib, 0, sizeof(_StaticLib));
 }
@@ -0,0 +1,172 @@
+// This content is part of test.h
+// Virtual clock, enabled by defining BTR_VIRTUAL_CLOCK before including test.h
+// The test binary replaces the sleep and clock functions so that during a test sleeping advances the clock instantly.
+// Every test starts from the real time and only moves with sleeps and virtualClockAdvance. The clock is real again once
+// the test passes or fails, so cleanFunction and the atexit handlers sleep and read the time for real
+
+#if defined(BTR_VIRTUAL_CLOCK) || defined(BTR_MEMORY_FILES)
+#include <dlfcn.h>
+#ifndef RTLD_NEXT
+// Only declared with _GNU_SOURCE by glibc, the value is the same everywhere
+#define RTLD_NEXT ((void*)-1l)
+#endif
+
+// The libc function hidden by a replacement defined in the test binary
+void* _realFunction(const char* name)
+{
+  return dlsym(RTLD_NEXT, name);
+}
+#endif
+
+#ifdef BTR_VIRTUAL_CLOCK
+#ifdef _WIN32
+#error "BTR_VIRTUAL_CLOCK is not supported on Windows"
+#endif
+#include <unistd.h>
+#include <sys/time.h>
+
+bool _virtualClockRunning = false;
+unsigned long long _virtualClockElapsed = 0;
+struct timespec _virtualClockMonotonicStart, _virtualClockRealStart;
+int (*_realClockGettime)(clockid_t clock, struct timespec* time) = 0;
+
+// The framework keeps measuring with the real clock through this
+int _clockGettime(clockid_t clock, struct timespec* time)
+{
+  if(!_realClockGettime)
+    *(void**)&_realClockGettime = _realFunction("clock_gettime");
+  return _realClockGettime(clock, time);
+}
+
+void _startVirtualClock()
+{
+  _clockGettime(CLOCK_MONOTONIC, &_virtualClockMonotonicStart);
+  _clockGettime(CLOCK_REALTIME, &_virtualClockRealStart);
+  _virtualClockElapsed = 0;
+  _virtualClockRunning = true;
+}
+
+void _stopVirtualClock()
+{
+  _virtualClockRunning = false;
+}
+
+void virtualClockAdvance(unsigned long long nanoseconds)
+{
+  __sync_fetch_and_add(&_virtualClockElapsed, nanoseconds);
+}
+
+unsigned long long virtualClockElapsed()
+{
+  return __sync_fetch_and_add(&_virtualClockElapsed, 0);
+}
+
+struct timespec _virtualClockTime(struct timespec start)
+{
+  unsigned long long nanoseconds = start.tv_nsec + virtualClockElapsed();
+  struct timespec now = {(time_t)(start.tv_sec + nanoseconds/1000000000ULL), (long)(nanoseconds%1000000000ULL)};
+  return now;
+}
+
+bool _isVirtualClock(clockid_t clock)
+{
+  if(!_virtualClockRunning) return false;
+  switch(clock)
+  {
+    case CLOCK_REALTIME: case CLOCK_MONOTONIC:
+#ifdef __linux__
+    case CLOCK_REALTIME_COARSE: case CLOCK_MONOTONIC_COARSE: case CLOCK_MONOTONIC_RAW: case CLOCK_BOOTTIME:
+#endif
+      return true;
+    default:
+      // CPU time clocks keep running for real
+      return false;
+  }
+}
+
+bool _isRealtimeClock(clockid_t clock)
+{
+#ifdef __linux__
+  if(clock == CLOCK_REALTIME_COARSE) return true;
+#endif
+  return clock == CLOCK_REALTIME;
+}
+
+int clock_gettime(clockid_t clock, struct timespec* time) _BTR_NOTHROW
+{
+  if(!_isVirtualClock(clock)) return _clockGettime(clock, time);
+  *time = _virtualClockTime(_isRealtimeClock(clock) ? _virtualClockRealStart : _virtualClockMonotonicStart);
+  return 0;
+}
+
+int gettimeofday(struct timeval* time, void* timezone) _BTR_NOTHROW
+{
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  time->tv_sec = now.tv_sec;
+  time->tv_usec = now.tv_nsec/1000;
+  return 0;
+}
+
+time_t time(time_t* output) _BTR_NOTHROW
+{
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  if(output) *output = now.tv_sec;
+  return now.tv_sec;
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const struct timespec* request, struct timespec* remaining)
+{
+  if(!_isVirtualClock(clock))
+  {
+    static int (*realSleep)(clockid_t, int, const struct timespec*, struct timespec*) = 0;
+    if(!realSleep) *(void**)&realSleep = _realFunction("clock_nanosleep");
+    return realSleep(clock, flags, request, remaining);
+  }
+  unsigned long long duration = request->tv_sec*1000000000ULL + request->tv_nsec;
+  if(flags & TIMER_ABSTIME)
+  {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    unsigned long long current = now.tv_sec*1000000000ULL + now.tv_nsec;
+    duration = duration > current ? duration - current : 0;
+  }
+  virtualClockAdvance(duration);
+  if(remaining && !(flags & TIMER_ABSTIME)) remaining->tv_sec = remaining->tv_nsec = 0;
+  return 0;
+}
+
+int nanosleep(const struct timespec* request, struct timespec* remaining)
+{
+  if(!_virtualClockRunning)
+  {
+    static int (*realSleep)(const struct timespec*, struct timespec*) = 0;
+    if(!realSleep) *(void**)&realSleep = _realFunction("nanosleep");
+    return realSleep(request, remaining);
+  }
+  return clock_nanosleep(CLOCK_MONOTONIC, 0, request, remaining);
+}
+
+int usleep(useconds_t microseconds)
+{
+  struct timespec request = {(time_t)(microseconds/1000000), (long)(microseconds%1000000)*1000};
+  return nanosleep(&request, 0);
+}
+
+unsigned int sleep(unsigned int seconds)
+{
+  struct timespec request = {(time_t)seconds, 0}, remaining = {0, 0};
+  if(nanosleep(&request, &remaining) == 0) return 0;
+  return (unsigned int)remaining.tv_sec + (remaining.tv_nsec > 0);
+}
+#else
+void _startVirtualClock(){}
+void _stopVirtualClock(){}
+#ifndef _WIN32
+int _clockGettime(clockid_t clock, struct timespec* time)
+{
+  return clock_gettime(clock, time);
+}
+#endif
+#endif
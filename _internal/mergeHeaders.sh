@@ -6,6 +6,12 @@ cat _internal/_macros.h > "$OUTPUT"
 cat _internal/_staticLib.h >> "$OUTPUT"
 cat _internal/_objectFile.h >> "$OUTPUT"
 cat _internal/_framework.h >> "$OUTPUT"
+cat _internal/_property.h >> "$OUTPUT"
+cat _internal/_fuzz.h >> "$OUTPUT"
+cat _internal/_debugInfo.h >> "$OUTPUT"
 cat _internal/_mock.h >> "$OUTPUT"
+cat _internal/_allocations.h >> "$OUTPUT"
+cat _internal/_virtualClock.h >> "$OUTPUT"
+cat _internal/_memoryFiles.h >> "$OUTPUT"
 cat _internal/_platforms.h >> "$OUTPUT"
 cat _internal/_tail.h >> "$OUTPUT"
\ No newline at end of file
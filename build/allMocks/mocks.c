@@ -0,0 +1,73 @@
+// This file was generated by BugTestsRocket test framework
+// Link it when building your tests for implementing the mocks
+#ifdef __cplusplus
+extern "C"{
+#define _BTR_CONVERT(what, to) reinterpret_cast<to>(what)
+#else
+#define _BTR_CONVERT(what, to) ((to)(what))
+#endif
+#include <stdbool.h>
+typedef struct {int count; const char* names; const unsigned int* nameOffsets; int* calls; void** slots; void** originals;} MockTable;
+extern int _mockCalls[];
+extern void* _mockSlots[];
+void 🐛_ZN7MyClass15internalProcessEv🚀(void*);
+int 🐛_ZN7MyClass17getProcessedValueEv🚀(void*);
+void 🐛_ZN7MyClassC1Ei🚀(void*, int);
+void 🐛_ZN7MyClassC2Ei🚀(void*, int);
+int 🐛average🚀(void*, int);
+bool 🐛divRemainder🚀(int, int, void*);
+bool 🐛divide🚀(int, int, void*);
+int 🐛getRandomInput🚀();
+int 🐛multiply🚀(int, int);
+int 🐛subtract🚀(int, int);
+int 🐛sum🚀(int, int);
+int 🐛takeDecision🚀();
+void _ZN7MyClass15internalProcessEv(void* a0){ _mockCalls[0]++; return _BTR_CONVERT(_mockSlots[0], void (*)(void*))(a0); }
+int _ZN7MyClass17getProcessedValueEv(void* a0){ _mockCalls[1]++; return _BTR_CONVERT(_mockSlots[1], int (*)(void*))(a0); }
+void _ZN7MyClassC1Ei(void* a0,int a1){ _mockCalls[2]++; return _BTR_CONVERT(_mockSlots[2], void (*)(void*, int))(a0, a1); }
+void _ZN7MyClassC2Ei(void* a0,int a1){ _mockCalls[3]++; return _BTR_CONVERT(_mockSlots[3], void (*)(void*, int))(a0, a1); }
+int average(void* a0,int a1){ _mockCalls[4]++; return _BTR_CONVERT(_mockSlots[4], int (*)(void*, int))(a0, a1); }
+bool divRemainder(int a0,int a1,void* a2){ _mockCalls[5]++; return _BTR_CONVERT(_mockSlots[5], bool (*)(int, int, void*))(a0, a1, a2); }
+bool divide(int a0,int a1,void* a2){ _mockCalls[6]++; return _BTR_CONVERT(_mockSlots[6], bool (*)(int, int, void*))(a0, a1, a2); }
+int getRandomInput(){ _mockCalls[7]++; return _BTR_CONVERT(_mockSlots[7], int (*)())(); }
+int multiply(int a0,int a1){ _mockCalls[8]++; return _BTR_CONVERT(_mockSlots[8], int (*)(int, int))(a0, a1); }
+int subtract(int a0,int a1){ _mockCalls[9]++; return _BTR_CONVERT(_mockSlots[9], int (*)(int, int))(a0, a1); }
+int sum(int a0,int a1){ _mockCalls[10]++; return _BTR_CONVERT(_mockSlots[10], int (*)(int, int))(a0, a1); }
+int takeDecision(){ _mockCalls[11]++; return _BTR_CONVERT(_mockSlots[11], int (*)())(); }
+const char _mockNames[] = "_ZN7MyClass15internalProcessEv\0" "_ZN7MyClass17getProcessedValueEv\0" "_ZN7MyClassC1Ei\0" "_ZN7MyClassC2Ei\0" "average\0" "divRemainder\0" "divide\0" "getRandomInput\0" "multiply\0" "subtract\0" "sum\0" "takeDecision\0" "";
+const unsigned int _mockNameOffsets[] = {0, 31, 64, 80, 96, 104, 117, 124, 139, 148, 157, 161, 174, };
+int _mockCalls[13] = {0};
+void* _mockSlots[] = {
+  _BTR_CONVERT(🐛_ZN7MyClass15internalProcessEv🚀, void*),
+  _BTR_CONVERT(🐛_ZN7MyClass17getProcessedValueEv🚀, void*),
+  _BTR_CONVERT(🐛_ZN7MyClassC1Ei🚀, void*),
+  _BTR_CONVERT(🐛_ZN7MyClassC2Ei🚀, void*),
+  _BTR_CONVERT(🐛average🚀, void*),
+  _BTR_CONVERT(🐛divRemainder🚀, void*),
+  _BTR_CONVERT(🐛divide🚀, void*),
+  _BTR_CONVERT(🐛getRandomInput🚀, void*),
+  _BTR_CONVERT(🐛multiply🚀, void*),
+  _BTR_CONVERT(🐛subtract🚀, void*),
+  _BTR_CONVERT(🐛sum🚀, void*),
+  _BTR_CONVERT(🐛takeDecision🚀, void*),
+  (void*)0
+};
+void* _mockOriginals[] = {
+  _BTR_CONVERT(🐛_ZN7MyClass15internalProcessEv🚀, void*),
+  _BTR_CONVERT(🐛_ZN7MyClass17getProcessedValueEv🚀, void*),
+  _BTR_CONVERT(🐛_ZN7MyClassC1Ei🚀, void*),
+  _BTR_CONVERT(🐛_ZN7MyClassC2Ei🚀, void*),
+  _BTR_CONVERT(🐛average🚀, void*),
+  _BTR_CONVERT(🐛divRemainder🚀, void*),
+  _BTR_CONVERT(🐛divide🚀, void*),
+  _BTR_CONVERT(🐛getRandomInput🚀, void*),
+  _BTR_CONVERT(🐛multiply🚀, void*),
+  _BTR_CONVERT(🐛subtract🚀, void*),
+  _BTR_CONVERT(🐛sum🚀, void*),
+  _BTR_CONVERT(🐛takeDecision🚀, void*),
+  (void*)0
+};
+MockTable _mocks = {12, _mockNames, _mockNameOffsets, _mockCalls, _mockSlots, _mockOriginals};
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,34 @@
+// This file was generated by BugTestsRocket test framework
+// Link it when building your tests for implementing the mocks
+#ifdef __cplusplus
+extern "C"{
+#define _BTR_CONVERT(what, to) reinterpret_cast<to>(what)
+#else
+#define _BTR_CONVERT(what, to) ((to)(what))
+#endif
+#include <stdbool.h>
+typedef struct {int count; const char* names; const unsigned int* nameOffsets; int* calls; void** slots; void** originals;} MockTable;
+extern int _mockCalls[];
+extern void* _mockSlots[];
+int 🐛sum🚀(int, int);
+#if defined(__x86_64__) && defined(__ELF__)
+int _counted_sum(int a0,int a1){ _mockCalls[0]++; return _BTR_CONVERT(_mockSlots[0], int (*)(int, int))(a0, a1); }
+__asm__(".pushsection .text\n.globl sum\n.type sum, @function\nsum:\n  leaq \"🐛sum🚀\"(%rip), %r11\n  cmpq %r11, _mockSlots+0(%rip)\n  jne _counted_sum\n  incl _mockCalls+0(%rip)\n  jmp \"🐛sum🚀\"\n.size sum, .-sum\n.popsection\n");
+#else
+int sum(int a0,int a1){ _mockCalls[0]++; return _BTR_CONVERT(_mockSlots[0], int (*)(int, int))(a0, a1); }
+#endif
+const char _mockNames[] = "sum\0" "";
+const unsigned int _mockNameOffsets[] = {0, 4, };
+int _mockCalls[2] = {0};
+void* _mockSlots[] = {
+  _BTR_CONVERT(🐛sum🚀, void*),
+  (void*)0
+};
+void* _mockOriginals[] = {
+  _BTR_CONVERT(🐛sum🚀, void*),
+  (void*)0
+};
+MockTable _mocks = {1, _mockNames, _mockNameOffsets, _mockCalls, _mockSlots, _mockOriginals};
+#ifdef __cplusplus
+}
+#endif
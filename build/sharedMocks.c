@@ -0,0 +1,48 @@
+// This file was generated by BugTestsRocket test framework
+// Link it when building your tests for implementing the mocks
+// Functions are interposed, link the tests against the original shared library
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <dlfcn.h>
+#ifdef __cplusplus
+extern "C"{
+#define _BTR_CONVERT(what, to) reinterpret_cast<to>(what)
+#else
+#define _BTR_CONVERT(what, to) ((to)(what))
+#endif
+#include <stdbool.h>
+typedef struct {int count; const char* names; const unsigned int* nameOffsets; int* calls; void** slots; void** originals;} MockTable;
+extern int _mockCalls[];
+extern void* _mockSlots[];
+static void _resolveInterposedMock(int index);
+int getRandomInput(){ _mockCalls[0]++; if(!_mockSlots[0]) _resolveInterposedMock(0); return _BTR_CONVERT(_mockSlots[0], int (*)())(); }
+int sum(int a0,int a1){ _mockCalls[1]++; if(!_mockSlots[1]) _resolveInterposedMock(1); return _BTR_CONVERT(_mockSlots[1], int (*)(int, int))(a0, a1); }
+const char _mockNames[] = "getRandomInput\0" "sum\0" "";
+const unsigned int _mockNameOffsets[] = {0, 15, 19, };
+int _mockCalls[3] = {0};
+void* _mockSlots[] = {
+  (void*)0,
+  (void*)0,
+  (void*)0
+};
+void* _mockOriginals[] = {
+  (void*)0,
+  (void*)0,
+  (void*)0
+};
+MockTable _mocks = {2, _mockNames, _mockNameOffsets, _mockCalls, _mockSlots, _mockOriginals};
+static void _resolveInterposedMock(int index)
+{
+  void* original = dlsym(RTLD_NEXT, _mocks.names + _mocks.nameOffsets[index]);
+  _mocks.originals[index] = original;
+  if(!_mocks.slots[index]) _mocks.slots[index] = original;
+}
+__attribute__((constructor)) static void _resolveInterposedMocks()
+{
+  for(int i = 0; i < _mocks.count; i++)
+    if(!_mocks.originals[i]) _resolveInterposedMock(i);
+}
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,33 @@
+// This file was generated by BugTestsRocket test framework
+// Link it when building your tests for implementing the mocks
+#ifdef __cplusplus
+extern "C"{
+#define _BTR_CONVERT(what, to) reinterpret_cast<to>(what)
+#else
+#define _BTR_CONVERT(what, to) ((to)(what))
+#endif
+#include <stdbool.h>
+typedef struct {int count; const char* names; const unsigned int* nameOffsets; int* calls; void** slots; void** originals;} MockTable;
+extern int _mockCalls[];
+extern void* _mockSlots[];
+extern MockTable _mocks;
+void _traceMockCall(MockTable* mocks, int index);
+unsigned long long _latencyStart();
+void _latencyEnd(MockTable* mocks, int index, unsigned long long start);
+int 🐛sum🚀(int, int);
+int sum(int a0,int a1){ _mockCalls[0]++; _traceMockCall(&_mocks, 0); return _BTR_CONVERT(_mockSlots[0], int (*)(int, int))(a0, a1); }
+const char _mockNames[] = "sum\0" "";
+const unsigned int _mockNameOffsets[] = {0, 4, };
+int _mockCalls[2] = {0};
+void* _mockSlots[] = {
+  _BTR_CONVERT(🐛sum🚀, void*),
+  (void*)0
+};
+void* _mockOriginals[] = {
+  _BTR_CONVERT(🐛sum🚀, void*),
+  (void*)0
+};
+MockTable _mocks = {1, _mockNames, _mockNameOffsets, _mockCalls, _mockSlots, _mockOriginals};
+#ifdef __cplusplus
+}
+#endif
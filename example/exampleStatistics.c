@@ -0,0 +1,12 @@
+#include "exampleStatistics.h"
+#include "exampleCalc.h"
+
+// The member name of this file does not fit the ar header, so it is stored in the long names table
+int average(const int* values, int count)
+{
+  if(count <= 0) return 0;
+  int total = 0;
+  for(int i = 0; i < count; i++)
+    total = sum(total, values[i]);
+  return total/count;
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+#ifndef EXAMPLE_STATISTICS
+#define EXAMPLE_STATISTICS
+
+int average(const int* values, int count);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,30 @@
+#include "test.h"
+#include "exampleCalc.h"
+
+// Built against mocks of every function of the lib, none of these functions is listed in a descriptor
+int sumInstead(int a, int b)
+{
+  return a + b;
+}
+
+🐛
+context("createAllMocks")
+{
+  test("mocks a function no descriptor lists")
+  {
+    mock(multiply, sumInstead);
+    assert(multiply(2, 3) == 5);
+    assert(mockCalls(multiply) == 1);
+  }
+
+  test("keeps the other functions real")
+  {
+    int result = 0;
+    assert(divide(6, 3, &result) && result == 2);
+    assert(sum(6, 3) == 9);
+    assert_called(divide);
+    assert_called(sum);
+    refute_called(multiply);
+  }
+}
+🚀
@@ -0,0 +1,59 @@
+#define BTR_TRACK_ALLOCATIONS
+#include "test.h"
+#include "exampleStatistics.h"
+
+🐛
+context("allocationStats")
+{
+  test("counts the bytes requested by the test")
+  {
+    char* block = (char*)malloc(10);
+    assert(allocationStats.allocations == 1);
+    assert(allocationStats.bytes == 10);
+    assert(allocationStats.liveBytes == 10);
+    free(block);
+    assert(allocationStats.frees == 1);
+    assert(allocationStats.liveBlocks == 0);
+    assert(allocationStats.liveBytes == 0);
+    assert(allocationStats.peakLiveBytes == 10);
+  }
+
+  test("counts aligned allocations")
+  {
+    void* aligned = aligned_alloc(64, 128);
+    void* posixAligned = 0;
+    assert(posix_memalign(&posixAligned, 64, 100) == 0);
+    assert(((uintptr_t)aligned & 63) == 0);
+    assert(((uintptr_t)posixAligned & 63) == 0);
+    assert(allocationStats.liveBlocks == 2);
+    assert(allocationStats.liveBytes == 228);
+    free(aligned);
+    free(posixAligned);
+    assert(allocationStats.liveBlocks == 0);
+  }
+
+  test("keeps tracking a block when realloc fails")
+  {
+    char* block = (char*)malloc(10);
+    volatile size_t hugeSize = SIZE_MAX/2;
+    char* moved = (char*)realloc(block, hugeSize);
+    refute(moved);
+    assert(allocationStats.liveBlocks == 1);
+    assert(allocationStats.liveBytes == 10);
+    if(!moved) moved = (char*)realloc(block, 20);
+    assert(allocationStats.liveBytes == 20);
+    free(moved);
+    assert(allocationStats.liveBlocks == 0);
+    assert(allocationStats.frees == allocationStats.allocations);
+  }
+}
+
+context("average")
+{
+  test("does not allocate")
+  {
+    int values[] = {1, 2, 3};
+    assert_no_allocations(average(values, 3));
+  }
+}
+🚀
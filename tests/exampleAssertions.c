@@ -0,0 +1,140 @@
+#include "test.h"
+
+static int failures = 0;
+static char lastFailure[4096];
+void countFailure(char* file, int line, char* expr)
+{
+  failures++;
+  snprintf(lastFailure, sizeof(lastFailure), "%s", expr);
+}
+
+// Counts the failures of the asserts in between instead of failing the test
+void (*savedOnFail)(char* file, int line, char* expr);
+#define beginExpectedFailures() (failures = 0, savedOnFail = onFail, onFail = countFailure)
+#define endExpectedFailures() (onFail = savedOnFail, failures)
+
+// Long enough to go through the 64 and 16 byte blocks and a tail shorter than one SSE2 vector
+static unsigned char bytes[130], otherBytes[130];
+void fillBytes()
+{
+  for(int i = 0; i < 130; i++)
+    bytes[i] = otherBytes[i] = (unsigned char)(i*7);
+}
+
+🐛
+context("assert_mem_eq")
+{
+  setupFunction = fillBytes;
+
+  test("accepts equal buffers")
+  {
+    assert_mem_eq(bytes, otherBytes, 130);
+    assert_mem_eq(bytes, otherBytes, 7);
+    assert_mem_eq(bytes, otherBytes, 0);
+  }
+
+  test("reports the first differing byte past the first 16 bytes")
+  {
+    otherBytes[40] = 1;
+    otherBytes[100] = 1;
+    beginExpectedFailures();
+    assert_mem_eq(bytes, otherBytes, 130);
+    assert(endExpectedFailures() == 1);
+    assert(strstr(lastFailure, "differ at byte 40 of 130"));
+    assert(strstr(lastFailure, "[01]"));
+
+    beginExpectedFailures();
+    assert_mem_eq(bytes + 64, otherBytes + 64, 66);
+    assert(endExpectedFailures() == 1);
+    assert(strstr(lastFailure, "differ at byte 36 of 66"));
+  }
+
+  test("reports a difference in the tail shorter than one vector")
+  {
+    otherBytes[129] = 1;
+    otherBytes[5] = 1;
+    beginExpectedFailures();
+    assert_mem_eq(bytes, otherBytes, 130);
+    assert(endExpectedFailures() == 1);
+    assert(strstr(lastFailure, "differ at byte 5 of 130"));
+
+    beginExpectedFailures();
+    assert_mem_eq(bytes + 6, otherBytes + 6, 124);
+    assert(endExpectedFailures() == 1);
+    assert(strstr(lastFailure, "differ at byte 123 of 124"));
+
+    beginExpectedFailures();
+    assert_mem_eq(bytes, otherBytes, 7);
+    assert(endExpectedFailures() == 1);
+    assert(strstr(lastFailure, "differ at byte 5 of 7"));
+  }
+}
+
+context("assert_array_eq")
+{
+  test("accepts equal arrays")
+  {
+    int ints[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}, sameInts[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+    double doubles[] = {1, 2, 3}, sameDoubles[] = {1, 2, 3};
+    assert_array_eq(ints, sameInts, 11);
+    assert_array_eq(doubles, sameDoubles, 3);
+  }
+
+  test("reports the index of the first differing element")
+  {
+    int ints[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}, otherInts[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 0, 11};
+    long long longs[] = {1, 2, 3}, otherLongs[] = {1, 2, 1LL << 40};
+    beginExpectedFailures();
+    assert_array_eq(ints, otherInts, 11);
+    assert(endExpectedFailures() == 1);
+    assert(strstr(lastFailure, "differ at element 9 (byte 36 of 44)"));
+
+    beginExpectedFailures();
+    assert_array_eq(longs, otherLongs, 3);
+    assert(endExpectedFailures() == 1);
+    assert(strstr(lastFailure, "differ at element 2 (byte 16 of 24)"));
+  }
+}
+
+context("assert_array_near")
+{
+  test("accepts float and double arrays within the tolerance")
+  {
+    float floats[] = {1, 2, 3, 4, 5}, nearFloats[] = {1.01f, 2, 2.99f, 4, 5};
+    double doubles[] = {1, 2, 3}, nearDoubles[] = {1, 2.001, 3};
+    assert_array_near(floats, nearFloats, 5, 0.02);
+    assert_array_near(doubles, nearDoubles, 3, 0.01);
+  }
+
+  test("fails on elements further apart than the tolerance")
+  {
+    float floats[] = {1, 2, 3, 4, 5}, farFloats[] = {1, 2, 3, 4, 6};
+    double doubles[] = {1, 2, 3}, nanDoubles[] = {1, 0.0/0.0, 3};
+    beginExpectedFailures();
+    assert_array_near(floats, farFloats, 5, 0.5);
+    assert_array_near(doubles, nanDoubles, 3, 0.5);
+    assert(endExpectedFailures() == 2);
+  }
+
+  test("takes equal infinities as near")
+  {
+    float floats[] = {1.0f/0.0f, 2, -1.0f/0.0f, 4, 5};
+    double doubles[] = {1, 1.0/0.0, 3};
+    assert_array_near(floats, floats, 5, 0.5);
+    assert_array_near(doubles, doubles, 3, 0.5);
+  }
+
+  test("rejects arrays that are not of float or double")
+  {
+    int ints[] = {1, 2, 3}, otherInts[] = {1, 2, 4};
+    long longs[] = {1, 2, 3};
+    float floats[] = {1, 2, 3};
+    double doubles[] = {1, 2, 3};
+    beginExpectedFailures();
+    assert_array_near(ints, otherInts, 3, 0.5);
+    assert_array_near(longs, longs, 3, 0.5);
+    assert_array_near(floats, doubles, 3, 0.5);
+    assert(endExpectedFailures() == 3);
+  }
+}
+🚀
@@ -6,6 +6,8 @@ void simulateProcess(MyClass* myClass)
   myClass->internalValue *= 10;
 }
 
+static bool arrayNearFailed = false;
+
 🐛
 context("MyClass::getProcessedValue")
 {
@@ -22,4 +24,19 @@ context("MyClass::getProcessedValue")
     assert(instance.getProcessedValue() == 50);
   }
 }
+
+context("assert_array_near")
+{
+  test("takes the element type from the arrays")
+  {
+    double doubles[] = {1, 2, 3}, nearDoubles[] = {1, 2.001, 3};
+    int ints[] = {1, 2, 3};
+    assert_array_near(doubles, nearDoubles, 3, 0.01);
+    void (*fail)(char* file, int line, char* expr) = onFail;
+    onFail = [](char* file, int line, char* expr){ arrayNearFailed = true; };
+    assert_array_near(ints, ints, 3, 0.5);
+    onFail = fail;
+    assert(arrayNearFailed);
+  }
+}
 🚀
\ No newline at end of file
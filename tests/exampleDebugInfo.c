@@ -0,0 +1,51 @@
+#include "test.h"
+
+// Finds a function by name in the output of readFunctionDescriptors
+FunctionDescriptor* findFunction(int count, FunctionDescriptor* functions, const char* name)
+{
+  for(int i = 0; i < count; i++)
+    if(strcmp(functions[i].name, name) == 0) return &functions[i];
+  return 0;
+}
+
+🐛
+context("readFunctionDescriptors")
+{
+  test("describes the functions defined by the lib from its debug info")
+  {
+    FunctionDescriptor* functions;
+    int count = readFunctionDescriptors(_C_STRING_LITERAL("build/libExample.a"), &functions);
+    FunctionDescriptor* sum = findFunction(count, functions, "sum");
+    assert(sum);
+    assert(strcmp(sum->returnType, "int") == 0);
+    assert(strcmp(sum->args, "int, int") == 0);
+    freeFunctionDescriptors(count, functions);
+  }
+
+  test("lists the defined constructors of a class and not its abstract one")
+  {
+    FunctionDescriptor* functions;
+    int count = readFunctionDescriptors(_C_STRING_LITERAL("build/libExample.a"), &functions);
+    assert(findFunction(count, functions, "_ZN7MyClassC1Ei"));
+    assert(findFunction(count, functions, "_ZN7MyClassC2Ei"));
+    refute(findFunction(count, functions, "_ZN7MyClassC4Ei"));
+    freeFunctionDescriptors(count, functions);
+  }
+
+  test("does not follow declarations pointing to each other forever")
+  {
+    // A function whose parameter and its origin point to each other
+    _DebugInfoEntry entries[] = {
+      {10, _DW_TAG_SUBPROGRAM, 0, "cyclic", 0, -1, -1, -1, -1, -1, true, false, true},
+      {20, _DW_TAG_FORMAL_PARAMETER, 1, 0, 0, -1, 30, -1, -1, -1, false, false, false},
+      {30, _DW_TAG_FORMAL_PARAMETER, 0, 0, 0, -1, -1, 20, -1, -1, false, false, false}
+    };
+    _DebugInfo info;
+    memset(&info, 0, sizeof(info));
+    info.entries = entries;
+    info.entryCount = 3;
+    char args[64];
+    refute(_debugInfoFunctionArgs(&info, 0, args));
+  }
+}
+🚀
@@ -0,0 +1,26 @@
+#include "test.h"
+#include "exampleStatistics.h"
+
+🐛
+context("average")
+{
+  // Inputs found while fuzzing are kept with the other build outputs
+  fuzzInputsPath = _C_STRING_LITERAL("build/fuzz");
+
+  fuzz_target("average")
+  {
+    int values[64];
+    int count = fuzzSize < 64 ? (int)fuzzSize : 64;
+    int min = 255, max = 0;
+    for(int i = 0; i < count; i++)
+    {
+      values[i] = fuzzData[i];
+      if(values[i] < min) min = values[i];
+      if(values[i] > max) max = values[i];
+    }
+    int result = average(values, count);
+    if(count) assert(result >= min && result <= max);
+    else assert(result == 0);
+  }
+}
+🚀
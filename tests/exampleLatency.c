@@ -0,0 +1,22 @@
+#include "test.h"
+
+🐛
+context("_latencyPercentile")
+{
+  test("gives the upper bound of the bucket holding the percentile")
+  {
+    unsigned int buckets[_LATENCY_BUCKETS] = {0};
+    buckets[3] = 50;
+    buckets[10] = 50;
+    assert(_latencyPercentile(buckets, 100, 0.5, 1) == 16);
+    assert(_latencyPercentile(buckets, 100, 0.99, 2) == 4096);
+  }
+
+  test("gives 2^64 ticks for the last bucket")
+  {
+    unsigned int buckets[_LATENCY_BUCKETS] = {0};
+    buckets[_LATENCY_BUCKETS - 1] = 1;
+    assert(_latencyPercentile(buckets, 1, 0.5, 1) == 18446744073709551616.0);
+  }
+}
+🚀
@@ -0,0 +1,56 @@
+#define BTR_MEMORY_FILES
+#include "test.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+🐛
+context("memory files")
+{
+  test("write, stat, read and unlink a file")
+  {
+    FILE* file = fopen("/memory/data/numbers.txt", "w");
+    assert(file);
+    fprintf(file, "1 2 3");
+    fclose(file);
+
+    struct stat status;
+    assert(stat("/memory/data/numbers.txt", &status) == 0);
+    assert(status.st_size == 5);
+    assert(stat("/memory/data", &status) == 0 && S_ISDIR(status.st_mode));
+
+    char content[16] = {0};
+    int descriptor = open("/memory/data/numbers.txt", O_RDONLY);
+    assert(descriptor >= 0);
+    assert(read(descriptor, content, sizeof(content)) == 5);
+    close(descriptor);
+    assert(strcmp(content, "1 2 3") == 0);
+
+    assert(unlink("/memory/data/numbers.txt") == 0);
+    assert(stat("/memory/data/numbers.txt", &status) < 0 && errno == ENOENT);
+    assert(access("/memory/data", F_OK) < 0);
+  }
+
+  test("renames and removes files")
+  {
+    int descriptor = openat(AT_FDCWD, "/memory/old.txt", O_CREAT | O_WRONLY, 0644);
+    assert(descriptor >= 0);
+    assert(write(descriptor, "abc", 3) == 3);
+    close(descriptor);
+
+    assert(mkdir("/memory/new", 0755) == 0);
+    assert(rename("/memory/old.txt", "/memory/new/file.txt") == 0);
+    assert(access("/memory/old.txt", F_OK) < 0);
+    assert(access("/memory/new/file.txt", R_OK) == 0);
+    assert(remove("/memory/new") < 0 && errno == ENOTEMPTY);
+    assert(remove("/memory/new/file.txt") == 0);
+    assert(access("/memory/new/file.txt", F_OK) < 0);
+  }
+
+  test("does not touch files on disk")
+  {
+    assert(access("/memory/", F_OK) < 0);
+    assert(access("build", F_OK) == 0);
+  }
+}
+🚀
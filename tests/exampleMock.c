@@ -30,4 +30,13 @@ context("takeDecision")
     assert(takeDecision() == DECISION_PANIC);
   }
 }
+
+context("getRandomInput")
+{
+  test("is counted when called without a mock")
+  {
+    takeDecision();
+    assert_called(getRandomInput);
+  }
+}
 🚀
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "test.h"
+
+FunctionDescriptor sumDescriptor[] = {{"int", "sum", "int, int", 0}};
+
+// Copies the example lib, replacing the content of one member by the content of another when both are given
+bool writeExampleLib(char* path, const char* replaced, const char* replacement)
+{
+  _StaticLib lib;
+  if(!_staticLibRead(&lib, _C_STRING_LITERAL("build/libExample.a"))) return false;
+  _StaticLibFile* to = 0, *from = 0;
+  for(int i = 0; i < lib.fileCount; i++)
+  {
+    char* name = _staticLibFileName(&lib, &lib.files[i]);
+    if(replaced && strcmp(name, replaced) == 0) to = &lib.files[i];
+    if(replacement && strcmp(name, replacement) == 0) from = &lib.files[i];
+  }
+  if(to && from)
+  {
+    char* content = (char*)malloc(from->contentSize);
+    memcpy(content, from->content, from->contentSize);
+    _staticLibFileSetContent(to, content, from->contentSize);
+  }
+  bool ret = _makeParentDirectories(path) && _staticLibWrite(&lib, path);
+  _staticLibFree(&lib);
+  return ret;
+}
+
+// Tells whether the member of a lib contains the given bytes
+bool memberContains(char* libPath, const char* member, const char* bytes)
+{
+  _StaticLib lib;
+  if(!_staticLibRead(&lib, libPath)) return false;
+  bool found = false;
+  long long length = strlen(bytes);
+  for(int i = 0; i < lib.fileCount; i++)
+  {
+    if(strcmp(_staticLibFileName(&lib, &lib.files[i]), member) != 0) continue;
+    for(long long offset = 0; !found && offset + length <= lib.files[i].contentSize; offset++)
+      found = memcmp(lib.files[i].content + offset, bytes, length) == 0;
+  }
+  _staticLibFree(&lib);
+  return found;
+}
+
+bool fileStartsWith(const char* path, const char* start)
+{
+  char content[16] = {0};
+  FILE* file = fopen(path, "rb");
+  if(!file) return false;
+  size_t read = fread(content, 1, strlen(start), file);
+  fclose(file);
+  return read == strlen(start) && memcmp(content, start, read) == 0;
+}
+
+🐛
+context("createMocks cache")
+{
+  test("regenerates a member of the mockable lib when only that member changed")
+  {
+    assert(writeExampleLib(_C_STRING_LITERAL("build/mockCache/members/lib.a"), 0, 0));
+    assert(createMocks(_C_STRING_LITERAL("build/mockCache/members/lib.a"), _C_STRING_LITERAL("build/mockCache/members/libTest.a"),
+      _C_STRING_LITERAL("build/mockCache/members/mocks.o"), 1, sumDescriptor));
+    refute(memberContains(_C_STRING_LITERAL("build/mockCache/members/libTest.a"), "exampleStatistics.o", "🐛sum🚀"));
+
+    // The member now defines sum, which the mockable lib must rename
+    assert(writeExampleLib(_C_STRING_LITERAL("build/mockCache/members/lib.a"), "exampleStatistics.o", "exampleCalc.o"));
+    assert(createMocks(_C_STRING_LITERAL("build/mockCache/members/lib.a"), _C_STRING_LITERAL("build/mockCache/members/libTest.a"),
+      _C_STRING_LITERAL("build/mockCache/members/mocks.o"), 1, sumDescriptor));
+    assert(memberContains(_C_STRING_LITERAL("build/mockCache/members/libTest.a"), "exampleStatistics.o", "🐛sum🚀"));
+    assert(memberContains(_C_STRING_LITERAL("build/mockCache/members/libTest.a"), "exampleCalc.o", "🐛sum🚀"));
+  }
+
+  test("does not reuse a mock file written for another path")
+  {
+    assert(writeExampleLib(_C_STRING_LITERAL("build/mockCache/paths/lib.a"), 0, 0));
+    assert(createMocks(_C_STRING_LITERAL("build/mockCache/paths/lib.a"), _C_STRING_LITERAL("build/mockCache/paths/libTest.a"),
+      _C_STRING_LITERAL("build/mockCache/paths/mocks.c"), 1, sumDescriptor));
+
+    // Left behind by an older generator
+    FILE* stale = fopen("build/mockCache/paths/mocks.o", "wb");
+    assert(stale);
+    fprintf(stale, "stale");
+    fclose(stale);
+
+    assert(createMocks(_C_STRING_LITERAL("build/mockCache/paths/lib.a"), _C_STRING_LITERAL("build/mockCache/paths/libTest.a"),
+      _C_STRING_LITERAL("build/mockCache/paths/mocks.o"), 1, sumDescriptor));
+    assert(fileStartsWith("build/mockCache/paths/mocks.o", "\177ELF"));
+  }
+
+  test("does not leave the temporary mockable lib behind when failing")
+  {
+    assert(writeExampleLib(_C_STRING_LITERAL("build/mockCache/failure/lib.a"), 0, 0));
+
+    // A non empty directory where the mockable lib goes can not be replaced
+    assert(_makeParentDirectories(_C_STRING_LITERAL("build/mockCache/failure/libTest.a/keep")));
+    FILE* keep = fopen("build/mockCache/failure/libTest.a/keep", "wb");
+    assert(keep);
+    fclose(keep);
+
+    refute(createMocks(_C_STRING_LITERAL("build/mockCache/failure/lib.a"), _C_STRING_LITERAL("build/mockCache/failure/libTest.a"),
+      _C_STRING_LITERAL("build/mockCache/failure/mocks.o"), 1, sumDescriptor));
+    refute(fopen("build/mockCache/failure/libTest.a.tmp", "rb"));
+  }
+}
+🚀
@@ -0,0 +1,28 @@
+#include "test.h"
+#include "exampleStatistics.h"
+
+int subtractInstead(int a, int b)
+{
+  return a - b;
+}
+
+🐛
+context("createObjectMocks")
+{
+  test("mocks functions of objects rewritten without an archive")
+  {
+    int values[] = {4, 2};
+    assert(average(values, 2) == 3);
+    mock(sum, subtractInstead);
+    assert(average(values, 2) == -3);
+    assert(mockCalls(sum) == 4);
+  }
+
+  test("refuses an output directory inside the objects directory")
+  {
+    FunctionDescriptor functions[] = {{0, "sum", 0, 0}};
+    refute(createObjectMocks("build/objectMocks", "build/objectMocks/again", "build/objectMocks/again/mocks.o", 1, functions));
+    refute(_isDirectory("build/objectMocks/again"));
+  }
+}
+🚀
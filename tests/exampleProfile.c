@@ -0,0 +1,19 @@
+#include "test.h"
+#include "exampleStatistics.h"
+#include <time.h>
+
+🐛
+context("average")
+{
+  // Keeps the CPU busy long enough for the profiler of make test-profile to take samples
+  test("averages many values")
+  {
+    int values[1000];
+    for(int i = 0; i < 1000; i++)
+      values[i] = 2;
+    clock_t start = clock();
+    while(clock() - start < CLOCKS_PER_SEC/20)
+      assert(average(values, 1000) == 2);
+  }
+}
+🚀
@@ -0,0 +1,82 @@
+#include "test.h"
+#include "exampleCalc.h"
+
+int sumTwice(int a, int b)
+{
+  return a + 2*b;
+}
+
+static int setups = 0, cleans = 0;
+void countSetup()
+{
+  setups++;
+}
+
+void countClean()
+{
+  cleans++;
+}
+
+static char failure[2048];
+void captureFailure(char* file, int line, char* expr)
+{
+  snprintf(failure, sizeof(failure), "%s", expr);
+}
+
+🐛
+context("sum")
+{
+  property("is commutative", 200)
+  {
+    int a = anyIntBetween(-1000000, 1000000), b = anyIntBetween(-1000000, 1000000);
+    assert(sum(a, b) == sum(b, a));
+  }
+}
+
+context("property cases")
+{
+  setupFunction = countSetup;
+  cleanFunction = countClean;
+
+  property("start with the mocks of the context and a fresh setup", 50)
+  {
+    assert(setups == cleans + 1);
+    assert(sum(2, 3) == 5);
+    mock(sum, sumTwice);
+    assert(sum(2, 3) == 8);
+  }
+}
+
+context("property failures")
+{
+  test("are shrunk to a small counterexample")
+  {
+    // The loop of the property macro, so the report can be checked
+    void (*fail)(char* file, int line, char* expr) = onFail;
+    onFail = captureFailure;
+    for(_startProperty(__LINE__, 1000); _nextPropertyCase();)
+      if(_btrSetjmp(_property.jump) == 0)
+      {
+        int a = anyInt(), b = anyInt();
+        assert(a < 1000 || b < 0);
+      }
+    onFail = fail;
+    assert(strstr(failure, "shrunk"));
+    assert(strstr(failure, "to 1000, 0"));
+  }
+
+  test("fail when a case draws too many choices")
+  {
+    void (*fail)(char* file, int line, char* expr) = onFail;
+    onFail = captureFailure;
+    for(_startProperty(__LINE__, 10); _nextPropertyCase();)
+      if(_btrSetjmp(_property.jump) == 0)
+      {
+        unsigned char bytes[5000];
+        anyBytes(bytes, sizeof(bytes));
+      }
+    onFail = fail;
+    assert(strstr(failure, "more than 4096 choices"));
+  }
+}
+🚀
@@ -0,0 +1,57 @@
+#include "test.h"
+#include "exampleCalc.h"
+
+// Runtime mocks patch machine code, so these only run where the patching is known to work
+#if defined(__x86_64__) && defined(__ELF__)
+int multiplyByTen(int a, int b)
+{
+  return a * 10;
+}
+
+// What optimized builds emit for sum, too short for the absolute jump of runtime mocks
+int shortSum(int a, int b);
+int tinySum(int a, int b);
+__asm__(".pushsection .text\n"
+        ".globl shortSum\n.type shortSum, @function\nshortSum:\n  movl %edi, %eax\n  addl %esi, %eax\n  ret\n.size shortSum, .-shortSum\n"
+        ".globl tinySum\n.type tinySum, @function\ntinySum:\n  leal (%rdi,%rsi), %eax\n  ret\n.size tinySum, .-tinySum\n"
+        ".popsection\n");
+
+static bool patchFailed = false;
+void capturePatchFailure(char* file, int line, char* expr)
+{
+  patchFailed = true;
+}
+#endif
+
+🐛
+#if defined(__x86_64__) && defined(__ELF__)
+context("mockRuntime")
+{
+  test("replaces a function at runtime")
+  {
+    mockRuntime(multiply, multiplyByTen);
+    assert(multiply(5, 3) == 50);
+    mockRuntimeReset(multiply);
+    assert(multiply(5, 3) == 15);
+  }
+
+  test("replaces a function shorter than an absolute jump")
+  {
+    mockRuntime(shortSum, multiplyByTen);
+    assert(shortSum(5, 3) == 50);
+    mockRuntimeReset(shortSum);
+    assert(shortSum(5, 3) == 8);
+  }
+
+  test("does not patch a function shorter than any jump")
+  {
+    void (*fail)(char* file, int line, char* expr) = onFail;
+    onFail = capturePatchFailure;
+    mockRuntime(tinySum, multiplyByTen);
+    onFail = fail;
+    assert(patchFailed);
+    assert(tinySum(5, 3) == 8);
+  }
+}
+#endif
+🚀
@@ -0,0 +1,33 @@
+#include "test.h"
+#include "exampleMock.h"
+#include "exampleCalc.h"
+
+// Linked before the mock file, so it runs before the mock file constructor resolves the originals
+static int earlySum = 0;
+__attribute__((constructor)) static void sumEarly()
+{
+  earlySum = sum(1, 2);
+}
+
+int alwaysOne()
+{
+  return 1;
+}
+
+🐛
+context("createSharedMocks")
+{
+  test("interposes the functions the shared library calls")
+  {
+    mock(getRandomInput, alwaysOne);
+    assert(takeDecision() == DECISION_B);
+    assert(mockCalls(getRandomInput) == 1);
+  }
+
+  test("reaches the originals before the mock file is initialized")
+  {
+    assert(earlySum == 3);
+    assert(sum(2, 2) == 4);
+  }
+}
+🚀
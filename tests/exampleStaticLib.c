@@ -0,0 +1,69 @@
+#include "test.h"
+
+// Tells whether two libs have the same members and symbols
+bool sameLibs(_StaticLib* a, _StaticLib* b)
+{
+  if(a->fileCount != b->fileCount || a->header.globalSymbolCount != b->header.globalSymbolCount) return false;
+  for(int i = 0; i < a->fileCount; i++)
+    if(strcmp(_staticLibFileName(a, &a->files[i]), _staticLibFileName(b, &b->files[i])) != 0 ||
+       a->files[i].contentSize != b->files[i].contentSize ||
+       memcmp(a->files[i].content, b->files[i].content, a->files[i].contentSize) != 0)
+      return false;
+  for(int i = 0; i < a->header.globalSymbolCount; i++)
+    if(strcmp(_staticLibSymbolName(a, &a->globalSymbols[i]), _staticLibSymbolName(b, &b->globalSymbols[i])) != 0 ||
+       a->globalSymbols[i].fileIndex != b->globalSymbols[i].fileIndex)
+      return false;
+  return true;
+}
+
+bool startsWithMember(const char* path, const char* name)
+{
+  char content[_STATIC_LIB_SIGNATURE_SIZE + 16];
+  FILE* file = fopen(path, "rb");
+  if(!file) return false;
+  size_t read = fread(content, 1, sizeof(content), file);
+  fclose(file);
+  return read == sizeof(content) && _staticLibIsMember(content + _STATIC_LIB_SIGNATURE_SIZE, name);
+}
+
+🐛
+context("static libs")
+{
+  test("round trip with the 32 bit symbol index")
+  {
+    _StaticLib lib, copy;
+    assert(_staticLibRead(&lib, _C_STRING_LITERAL("build/libExample.a")));
+    refute(lib.header.is64);
+    assert(lib.header.globalSymbolCount > 0);
+    assert(_makeParentDirectories(_C_STRING_LITERAL("build/staticLib/lib32.a")));
+    assert(_staticLibWrite(&lib, _C_STRING_LITERAL("build/staticLib/lib32.a")));
+    assert(startsWithMember("build/staticLib/lib32.a", "/"));
+    assert(_staticLibRead(&copy, _C_STRING_LITERAL("build/staticLib/lib32.a")));
+    assert(sameLibs(&lib, &copy));
+    _staticLibFree(&copy);
+    _staticLibFree(&lib);
+  }
+
+  test("round trip with the 64 bit symbol index")
+  {
+    _StaticLib lib, copy, again;
+    assert(_staticLibRead(&lib, _C_STRING_LITERAL("build/libExample.a")));
+    lib.header.is64 = true;
+    assert(_makeParentDirectories(_C_STRING_LITERAL("build/staticLib/lib64.a")));
+    assert(_staticLibWrite(&lib, _C_STRING_LITERAL("build/staticLib/lib64.a")));
+    assert(startsWithMember("build/staticLib/lib64.a", "/SYM64/"));
+    assert(_staticLibRead(&copy, _C_STRING_LITERAL("build/staticLib/lib64.a")));
+    assert(copy.header.is64);
+    assert(sameLibs(&lib, &copy));
+
+    // A lib read with the 64 bit index keeps it
+    assert(_staticLibWrite(&copy, _C_STRING_LITERAL("build/staticLib/lib64Again.a")));
+    assert(startsWithMember("build/staticLib/lib64Again.a", "/SYM64/"));
+    assert(_staticLibRead(&again, _C_STRING_LITERAL("build/staticLib/lib64Again.a")));
+    assert(sameLibs(&lib, &again));
+    _staticLibFree(&again);
+    _staticLibFree(&copy);
+    _staticLibFree(&lib);
+  }
+}
+🚀
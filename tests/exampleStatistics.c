@@ -0,0 +1,28 @@
+#include "test.h"
+#include "exampleStatistics.h"
+
+int sumTwice(int a, int b)
+{
+  return a + 2*b;
+}
+
+🐛
+context("average")
+{
+  test("averages the values")
+  {
+    int values[] = {1, 2, 3, 6};
+    assert(average(values, 4) == 3);
+    assert(average(values, 0) == 0);
+    assert(mockCalls(sum) == 4);
+  }
+
+  test("calls sum from a member with a long name")
+  {
+    mock(sum, sumTwice);
+    int values[] = {1, 2, 3};
+    assert(average(values, 3) == 4);
+    assert(mockCalls(sum) == 3);
+  }
+}
+🚀
@@ -0,0 +1,30 @@
+#include "test.h"
+#include "exampleMock.h"
+#include "exampleStatistics.h"
+
+int alwaysOne()
+{
+  return 1;
+}
+
+🐛
+context("takeDecision")
+{
+  // Set once by thread 0, every thread calls the mock
+  mock(getRandomInput, alwaysOne);
+
+  stress_test("decides B from every thread", 4, 1000)
+  {
+    assert(takeDecision() == DECISION_B);
+  }
+}
+
+context("average")
+{
+  stress_test("averages from every thread", 4, 1000)
+  {
+    int values[] = {1, 2, 3, 6};
+    assert(average(values, 4) == 3);
+  }
+}
+🚀
@@ -0,0 +1,38 @@
+#include "test.h"
+#include "exampleCalc.h"
+
+// Volatile inputs keep the compiler from hoisting the timed calls out of their batch loop
+static volatile int first = 1, second = 2;
+
+static bool overBudget = false;
+void captureOverBudget(char* file, int line, char* expr)
+{
+  overBudget = true;
+}
+
+int sumMany(int count)
+{
+  int total = 0;
+  for(int i = 0; i < count; i++)
+    total = sum(total, first);
+  return total;
+}
+
+🐛
+context("assert_faster_than")
+{
+  test("passes when the median run is within the budget")
+  {
+    assert_faster_than(sum(first, second), 1000000);
+  }
+
+  test("fails when the median run is over the budget")
+  {
+    void (*fail)(char* file, int line, char* expr) = onFail;
+    onFail = captureOverBudget;
+    assert_faster_than(sumMany(1000), 0);
+    onFail = fail;
+    assert(overBudget);
+  }
+}
+🚀
@@ -0,0 +1,38 @@
+#define BTR_VIRTUAL_CLOCK
+#include "test.h"
+
+unsigned long long realNanoseconds()
+{
+  struct timespec now;
+  _clockGettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec*1000000000ULL + now.tv_nsec;
+}
+
+time_t sleptFrom = 0;
+void checkRealTime()
+{
+  // The 100 seconds slept by the test are not seen after it
+  assert(time(0) - sleptFrom < 50);
+}
+
+🐛
+context("virtual clock")
+{
+  test("sleeps at once and moves time forward")
+  {
+    unsigned long long realStart = realNanoseconds();
+    time_t start = time(0);
+    assert(sleep(100) == 0);
+    assert(time(0) - start == 100);
+    assert(virtualClockElapsed() == 100000000000ULL);
+    assert(realNanoseconds() - realStart < 1000000000ULL);
+  }
+
+  test("gives the real time back when the test ends")
+  {
+    sleptFrom = time(0);
+    sleep(100);
+    cleanFunction = checkRealTime;
+  }
+}
+🚀
@@ -2,15 +2,107 @@
 
 int doCreateMocks()
 {
+  // Leaving the return type out reads it and the arguments from the debug info of the lib
   FunctionDescriptor functions[] = {
-      {"int", "getRandomInput", "", 0},
+      {0, "getRandomInput", 0, 0},
+      {0, "sum", 0, 0},
       {"void", "_ZN7MyClass15internalProcessEv", "void*", 0}
   };
 
   return !createMocks(
     "build/libExample.a",
     "build/libExampleTest.a",
-    "build/mocks.c",
+    "build/mocks.o",
+    sizeof(functions)/sizeof(FunctionDescriptor), functions
+  );
+}
+
+int doCreateTracedMocks()
+{
+  // Traces are recorded by the wrappers of a C mock file, which is compiled with the tests using it
+  FunctionDescriptor functions[] = {
+      {0, "sum", 0, 0}
+  };
+
+  mockFileOptions = MOCK_FILE_TRACE;
+
+  return !createMocks(
+    "build/libExample.a",
+    "build/traced/libExampleTest.a",
+    "build/traced/mocks.c",
+    sizeof(functions)/sizeof(FunctionDescriptor), functions
+  );
+}
+
+int doCreateLatencyMocks()
+{
+  // Latencies are timed by the wrappers of a C mock file, like traces
+  FunctionDescriptor functions[] = {
+      {0, "sum", 0, 0}
+  };
+
+  mockFileOptions = MOCK_FILE_LATENCY;
+
+  return !createMocks(
+    "build/libExample.a",
+    "build/latency/libExampleTest.a",
+    "build/latency/mocks.c",
+    sizeof(functions)/sizeof(FunctionDescriptor), functions
+  );
+}
+
+int doCreatePassThroughMocks()
+{
+  // Unmocked functions jump straight to the original, so tests linked with these run close to the real cost
+  FunctionDescriptor functions[] = {
+      {0, "sum", 0, 0}
+  };
+
+  mockFileOptions = MOCK_FILE_PASS_THROUGH;
+
+  return !createMocks(
+    "build/libExample.a",
+    "build/passThrough/libExampleTest.a",
+    "build/passThrough/mocks.c",
+    sizeof(functions)/sizeof(FunctionDescriptor), functions
+  );
+}
+
+int doCreateAllMocks()
+{
+  // Every function of the lib is mocked, described from its debug info
+  return !createAllMocks(
+    "build/libExample.a",
+    "build/allMocks/libExampleTest.a",
+    "build/allMocks/mocks.c"
+  );
+}
+
+int doCreateObjectMocks()
+{
+  // Rewrites the objects of the lib into another directory, no archive is needed
+  FunctionDescriptor functions[] = {
+      {0, "sum", 0, 0}
+  };
+
+  return !createObjectMocks(
+    "build/example",
+    "build/objectMocks",
+    "build/objectMocks/mocks.o",
+    sizeof(functions)/sizeof(FunctionDescriptor), functions
+  );
+}
+
+int doCreateSharedMocks()
+{
+  // Interposed functions are not read from any debug info, so their types are written here
+  FunctionDescriptor functions[] = {
+      {"int", "getRandomInput", "", 0},
+      {"int", "sum", "int, int", 0}
+  };
+
+  return !createSharedMocks(
+    "build/sharedMocks.c",
     sizeof(functions)/sizeof(FunctionDescriptor), functions
   );
 }
@@ -19,6 +111,18 @@ int main(int numArgs, char** args)
 {
   if(numArgs > 1 && strcmp(args[1], "--generate-mocks") == 0)
     return doCreateMocks();
+  else if(numArgs > 1 && strcmp(args[1], "--generate-traced-mocks") == 0)
+    return doCreateTracedMocks();
+  else if(numArgs > 1 && strcmp(args[1], "--generate-latency-mocks") == 0)
+    return doCreateLatencyMocks();
+  else if(numArgs > 1 && strcmp(args[1], "--generate-pass-through-mocks") == 0)
+    return doCreatePassThroughMocks();
+  else if(numArgs > 1 && strcmp(args[1], "--generate-all-mocks") == 0)
+    return doCreateAllMocks();
+  else if(numArgs > 1 && strcmp(args[1], "--generate-object-mocks") == 0)
+    return doCreateObjectMocks();
+  else if(numArgs > 1 && strcmp(args[1], "--generate-shared-mocks") == 0)
+    return doCreateSharedMocks();
   else
     return runAllTests(numArgs, args);
 }
\ No newline at end of file
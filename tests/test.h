@@ -37,13 +37,43 @@ extern "C"
 #define _C_STRING_LITERAL(literal) literal
 #endif
 
+#ifdef _MSC_VER
+#define _BTR_THREAD_LOCAL __declspec(thread)
+#else
+#define _BTR_THREAD_LOCAL __thread
+#endif
+
+// Jumps that also restore the signal mask, as failures may come from a signal handler
+#ifdef _WIN32
+#define _BTR_JMP_BUF jmp_buf
+#define _btrSetjmp(buffer) setjmp(buffer)
+#define _btrLongjmp(buffer) longjmp(buffer, 1)
+#else
+#define _BTR_JMP_BUF sigjmp_buf
+#define _btrSetjmp(buffer) sigsetjmp(buffer, 1)
+#define _btrLongjmp(buffer) siglongjmp(buffer, 1)
+#endif
+
+// Replacements of libc functions must repeat the exception specification of their C++ declarations
+#ifdef __cplusplus
+#define _BTR_NOTHROW __THROW
+#else
+#define _BTR_NOTHROW
+#endif
+
 #include <stdio.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <signal.h>
+#include <time.h>
+#include <setjmp.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define 🐛 beginTests
 #define 🚀 endTests
@@ -54,6 +84,24 @@ extern "C"
 #define refute(boolean) _assert(_C_STRING_LITERAL(__FILE__), __LINE__, !(boolean), _C_STRING_LITERAL(#boolean))
 #define refute_called(mockedFunction) assert(mockCalls(mockedFunction) == 0)
 
+// Compare buffers of size bytes, arrays of count elements, and float or double arrays within a tolerance
+#define assert_mem_eq(actual, expected, size) _assertMemEq(_C_STRING_LITERAL(__FILE__), __LINE__, actual, expected, size, 1,\
+  _C_STRING_LITERAL(#actual " and " #expected))
+#define assert_array_eq(actual, expected, count) _assertMemEq(_C_STRING_LITERAL(__FILE__), __LINE__, actual, expected,\
+  (count)*sizeof(*(actual)), sizeof(*(actual)), _C_STRING_LITERAL(#actual " and " #expected))
+#define assert_array_near(actual, expected, count, tolerance) _assertArrayNear(_C_STRING_LITERAL(__FILE__), __LINE__, actual,\
+  expected, count, _arrayNearType(actual), _arrayNearType(expected), tolerance, _C_STRING_LITERAL(#actual " and " #expected))
+
+#define _TIMING_SAMPLES 31
+#define _TIMING_MIN_BATCH_NS 20000
+// Fails when the median time of the expression is above the budget, given in nanoseconds
+#define assert_faster_than(expression, budgetNanoseconds) do{\
+    _TimingRun _timingRun = _startTiming();\
+    do{ for(int _timingIndex = 0; _timingIndex < _timingRun.batchSize; _timingIndex++){ expression; } }\
+    while(_nextTimingBatch(&_timingRun));\
+    _assertTiming(_C_STRING_LITERAL(__FILE__), __LINE__, &_timingRun, budgetNanoseconds, _C_STRING_LITERAL(#expression));\
+  }while(0)
+
 #define beginTests \
   int _allTests(){ int _testCount = 0; int _testRunning = 0; int _testDefinition = 0; {
 
@@ -71,56 +119,122 @@ extern "C"
     _testRunning++;\
     setupFunction();
 
-#define mock(function, newFunction) _mock(_C_STRING_LITERAL(__FILE__), __LINE__, _C_STRING_LITERAL(#function), (void*)newFunction, _mocks)
+// Like test, but the body runs for iterationCount generated cases, drawing its inputs with anyInt and the other any*
+// functions. A failure is shrunk to a small counterexample and reported with the seed, which --seed replays.
+// Every case runs with the mocks of the context and its own setupFunction and cleanFunction calls
+#define property(description, iterationCount) \
+  _finishLastScope()\
+  _testDefinition++;\
+  if(_shouldRunTest(_testCount++, __LINE__, testEnv->_candidateContext)){\
+    _initializeTest(_testCount-1, __LINE__, _C_STRING_LITERAL(description));\
+    _testRunning++;\
+    setupFunction();\
+    for(_startProperty(__LINE__, iterationCount); _nextPropertyCase();)\
+      if(_btrSetjmp(_property.jump) == 0)
+
+// Like test, but the body runs in process for every input, given by fuzzData and fuzzSize. See _internal/_fuzz.h
+#define fuzz_target(name) \
+  _finishLastScope()\
+  _testDefinition++;\
+  if(_shouldRunFuzzTarget(_testCount++, __LINE__, _C_STRING_LITERAL(name))){\
+    _testRunning += !_fuzzOneInput;\
+    for(_startFuzz(); _nextFuzzInput();)\
+      if(_btrSetjmp(_fuzz.jump) == 0)
+
+// Runs the body iterations times on each of the threads, which start together, the calling thread being thread 0.
+// The other threads reach the body by running the file from the start, skipping tests, setup and mock calls, so the
+// rest of the code at the scope of contexts runs once per thread and must not have side effects
+#define stress_test(description, threadCount, iterationCount) \
+  _finishLastScope()\
+  _testDefinition++;\
+  if(_shouldRunStressTest(_testCount++, __LINE__, _C_STRING_LITERAL(description), threadCount, iterationCount)){\
+    _testRunning++;\
+    for(long long _stressIteration = _startStress(); _stressIteration < _stressTest.iterations || _endStress(); _stressIteration++)
+
+#define mock(function, newFunction) _mock(_C_STRING_LITERAL(__FILE__), __LINE__, _C_STRING_LITERAL(#function), (void*)newFunction, &_mocks)
+
+#define mockReset(function) _mockReset(_C_STRING_LITERAL(__FILE__), __LINE__, _C_STRING_LITERAL(#function), &_mocks)
 
-#define mockReset(function) _mockReset(_C_STRING_LITERAL(__FILE__), __LINE__, _C_STRING_LITERAL(#function), _mocks)
+#define mockCalls(function) _mocks.calls[_getMock(_C_STRING_LITERAL(__FILE__), __LINE__, _C_STRING_LITERAL(#function), &_mocks)]
 
-#define mockCalls(function) _getMock(_C_STRING_LITERAL(__FILE__), __LINE__, _C_STRING_LITERAL(#function), _mocks)->calls
+#define mockRuntime(function, newFunction) _mockRuntime(_C_STRING_LITERAL(__FILE__), __LINE__, _C_STRING_LITERAL(#function), (void*)function, (void*)newFunction)
 
-#define mockGetOrginal(function) _getMock(_C_STRING_LITERAL(__FILE__), __LINE__, _C_STRING_LITERAL(#function), _mocks)->original
+#define mockRuntimeReset(function) _mockRuntimeReset(_C_STRING_LITERAL(__FILE__), __LINE__, _C_STRING_LITERAL(#function))
+
+#define mockGetOrginal(function) _mocks.originals[_getMock(_C_STRING_LITERAL(__FILE__), __LINE__, _C_STRING_LITERAL(#function), &_mocks)]
 
 #define testAlloc(type) (type*)(testEnv->_helperBlockIndex += sizeof(type), testEnv->_helperBlockIndex - sizeof(type))
 
+#ifdef BTR_LIBFUZZER
+#define endTests _finishLastScope() return _testCount; }\
+  int LLVMFuzzerTestOneInput(const unsigned char* data, size_t size){\
+    _sourceFile = _C_STRING_LITERAL(__FILE__);\
+    return _runFuzzInput(data, size, _allTests);\
+  }
+#else
 #define endTests _finishLastScope() return _testCount; }\
   int main(int numArgs, char** args){\
     _sourceFile = _C_STRING_LITERAL(__FILE__);\
     return _testFileMain(numArgs, args, _allTests);\
   }
-
-#define _BTR_MAX_NAME_SIZE 512// This content is part of test.h
+#endif
+// This content is part of test.h
 // Static libraries management
+// Follows the GNU ar layout: optional "/" or "/SYM64/" symbol index, optional "//" long names table and then the members
 
 typedef struct _StaticLib _StaticLib;
 typedef struct _GlobalSymbol _GlobalSymbol;
 typedef struct _StaticLibFile _StaticLibFile;
 typedef struct _StaticLibHeader _StaticLibHeader;
+typedef struct _MappedFile _MappedFile;
+typedef struct _StringPool _StringPool;
+
+#define _STATIC_LIB_SIGNATURE "!<arch>\n"
+#define _STATIC_LIB_SIGNATURE_SIZE 8
+#define _STATIC_LIB_MEMBER_HEADER_SIZE 60
+#define _STATIC_LIB_MAX_SHORT_NAME 15
+
+struct _MappedFile
+{
+  char* data;
+  long long size;
+  intptr_t handle;
+  intptr_t mapping;
+};
+
+// Null terminated strings packed one after another, referenced by offset so the block may grow
+struct _StringPool
+{
+  char* data;
+  long long size;
+  long long capacity;
+};
 
 struct _GlobalSymbol
 {
-  char name[_BTR_MAX_NAME_SIZE];
-  int fileOffset;
+  long long nameOffset;
+  int nameLength;
+  long long fileOffset;
   int fileIndex;
 };
 
+// Content either points inside the archive mapping or, once rewritten, to a heap block owned by the file
+// The member name is resolved from the long names table when needed and kept in the library string pool
 struct _StaticLibFile
 {
-  char fileInfo[60];
+  char fileInfo[_STATIC_LIB_MEMBER_HEADER_SIZE];
+  long long nameOffset;
   char* content;
   long long contentSize;
+  bool ownsContent;
 };
 
+// fileInfo holds the member header of the symbol index, is64 tells whether it was stored as "/SYM64/"
 struct _StaticLibHeader
 {
-  char sig[8];
-  char name[16];
-  char date[12];
-  char uid[6];
-  char gid[6];
-  char mode[8];
-  char size[10];
-  char end[2];
-
+  char fileInfo[_STATIC_LIB_MEMBER_HEADER_SIZE];
   int globalSymbolCount;
+  bool is64;
 };
 
 struct _StaticLib
@@ -129,142 +243,340 @@ struct _StaticLib
   _GlobalSymbol* globalSymbols;
   int fileCount;
   _StaticLibFile* files;
+  _MappedFile source;
+  _StringPool strings;
 };
 
-bool _staticLibAmILittleEndian()
+// Maps a whole file read only into memory, implemented by the platform specific section
+bool _mapFile(char* path, _MappedFile* out);
+void _unmapFile(_MappedFile* file);
+// Appends a range of a mapped file to output, letting the kernel do the copy when the platform allows it
+bool _copyFileRange(FILE* output, _MappedFile* source, long long offset, long long size);
+
+// Symbol index numbers are big endian words of 4 bytes ("/") or 8 bytes ("/SYM64/")
+unsigned long long _staticLibReadWord(const char* data, int wordSize)
+{
+  unsigned long long value = 0;
+  for(int i = 0; i < wordSize; i++)
+    value = (value << 8) | (unsigned char)data[i];
+  return value;
+}
+
+void _staticLibWriteWord(FILE* file, unsigned long long value, int wordSize)
+{
+  for(int i = wordSize - 1; i >= 0; i--)
+    fputc((value >> (8*i)) & 0xFF, file);
+}
+
+// Appends a string to the pool returning its offset
+long long _stringPoolAdd(_StringPool* pool, const char* string, long long length)
+{
+  if(pool->size + length + 1 > pool->capacity)
+  {
+    pool->capacity = pool->capacity ? pool->capacity*2 : 256;
+    if(pool->capacity < pool->size + length + 1) pool->capacity = pool->size + length + 1;
+    pool->data = (char*)realloc(pool->data, pool->capacity);
+  }
+  long long offset = pool->size;
+  memcpy(pool->data + offset, string, length);
+  pool->data[offset + length] = '\0';
+  pool->size += length + 1;
+  return offset;
+}
+
+char* _staticLibSymbolName(_StaticLib* lib, _GlobalSymbol* symbol)
+{
+  return lib->strings.data + symbol->nameOffset;
+}
+
+char* _staticLibFileName(_StaticLib* lib, _StaticLibFile* libFile)
+{
+  return lib->strings.data + libFile->nameOffset;
+}
+
+void _staticLibRenameSymbol(_StaticLib* lib, _GlobalSymbol* symbol, const char* name)
+{
+  symbol->nameLength = strlen(name);
+  symbol->nameOffset = _stringPoolAdd(&lib->strings, name, symbol->nameLength);
+}
+
+// Replaces the content of a member, releasing the previous one if it was not a slice of the mapping
+void _staticLibFileSetContent(_StaticLibFile* libFile, char* content, long long contentSize)
+{
+  if(libFile->ownsContent && libFile->content != content) free(libFile->content);
+  libFile->content = content;
+  libFile->contentSize = contentSize;
+  libFile->ownsContent = true;
+}
+
+// Finds the member whose header starts at the given archive offset, -1 if none does
+int _staticLibFindFileByOffset(long long* fileOffsets, int fileCount, long long offset)
 {
-  int a = 1;
-  return ((char*)&a)[0] == 1;
+  int begin = 0, end = fileCount;
+  while(begin < end)
+  {
+    int middle = begin + (end - begin)/2;
+    if(fileOffsets[middle] < offset) begin = middle + 1;
+    else end = middle;
+  }
+  return begin < fileCount && fileOffsets[begin] == offset ? begin : -1;
 }
 
-unsigned int _staticLibSwapBytes(unsigned int number)
+bool _staticLibIsMember(char* fileInfo, const char* name)
 {
-  return ((number & 0x000000FF) << 24) |
-          ((number & 0x0000FF00) << 8) |
-          ((number & 0x00FF0000) >> 8) |
-          ((number & 0xFF000000) >> 24);
+  int length = strlen(name);
+  if(memcmp(fileInfo, name, length) != 0) return false;
+  for(int i = length; i < 16; i++)
+    if(fileInfo[i] != ' ') return false;
+  return true;
 }
 
-void _staticLibSwapIfLittleEndian(int* bigEndian)
+// Member names are "name/" when short or "/offset" into the long names table, where they end with "/\n"
+long long _staticLibAddMemberName(_StaticLib* lib, char* fileInfo, char* longNames, long long longNamesSize)
 {
-  if(_staticLibAmILittleEndian())
-    *bigEndian = _staticLibSwapBytes(*bigEndian);
+  char* name = fileInfo;
+  long long length = 0;
+  if(fileInfo[0] == '/' && isdigit((unsigned char)fileInfo[1]) && longNames)
+  {
+    long long offset = atoll(&fileInfo[1]);
+    if(offset < longNamesSize)
+    {
+      name = &longNames[offset];
+      while(offset + length < longNamesSize && name[length] != '/' && name[length] != '\n') length++;
+    }
+  }
+  else
+  {
+    while(length < 16 && name[length] != '/' && name[length] != ' ') length++;
+  }
+  return _stringPoolAdd(&lib->strings, name, length);
 }
 
 bool _staticLibRead(_StaticLib* out, char* path)
 {
   memset(out, 0, sizeof(_StaticLib));
-  FILE *file = fopen(path, "rb");
-  if(!file) return false;
-  
-  bool ok = true;
-  fseek(file, 0, SEEK_SET);
-  ok = fread(out, sizeof(_StaticLibHeader), 1, file) == 1;
-  ok = ok && memcmp(out->header.sig, "!<arch>\n", 6) == 0;
+  if(!_mapFile(path, &out->source)) return false;
 
-  if(ok)
-  {
-    _staticLibSwapIfLittleEndian(&out->header.globalSymbolCount);
-    int size = sizeof(_GlobalSymbol)*out->header.globalSymbolCount;
+  char* data = out->source.data;
+  long long dataSize = out->source.size;
+  if(dataSize < _STATIC_LIB_SIGNATURE_SIZE || memcmp(data, _STATIC_LIB_SIGNATURE, _STATIC_LIB_SIGNATURE_SIZE) != 0)
+    return false;
 
-    out->globalSymbols = (_GlobalSymbol*)malloc(size);
-    memset(out->globalSymbols, 0, size);
+  char* symbolIndex = 0, *longNames = 0;
+  long long symbolIndexSize = 0, longNamesSize = 0;
+  bool ok = true;
 
-    for(int i = 0; i < out->header.globalSymbolCount; i++)
+  for(long long position = _STATIC_LIB_SIGNATURE_SIZE; position + _STATIC_LIB_MEMBER_HEADER_SIZE <= dataSize;)
+  {
+    char* fileInfo = &data[position];
+    long long contentSize = atoll(&fileInfo[48]);
+    char* content = &data[position + _STATIC_LIB_MEMBER_HEADER_SIZE];
+    if(position + _STATIC_LIB_MEMBER_HEADER_SIZE + contentSize > dataSize)
     {
-      _GlobalSymbol* symbol = &out->globalSymbols[i];
-      symbol->fileIndex = 0;
-      fread(&symbol->fileOffset, sizeof(int), 1, file);
-      _staticLibSwapIfLittleEndian(&symbol->fileOffset);
+      ok = false;
+      break;
     }
 
-    for(int i = 0; i < out->header.globalSymbolCount; i++)
+    if(_staticLibIsMember(fileInfo, "/") || _staticLibIsMember(fileInfo, "/SYM64/"))
+    {
+      memcpy(out->header.fileInfo, fileInfo, _STATIC_LIB_MEMBER_HEADER_SIZE);
+      out->header.is64 = fileInfo[1] == 'S';
+      symbolIndex = content;
+      symbolIndexSize = contentSize;
+    }
+    else if(_staticLibIsMember(fileInfo, "//"))
     {
-      char* name = out->globalSymbols[i].name;
-      int c;
-      while((c = fgetc(file))) *(name++) = c;
+      longNames = content;
+      longNamesSize = contentSize;
     }
+    else
+      out->fileCount++;
 
-    fseek(file, sizeof(_StaticLibHeader) -sizeof(int) + atoi(out->header.size), SEEK_SET);
-    int c;
-    while((c = getc(file)) != EOF)
+    position += _STATIC_LIB_MEMBER_HEADER_SIZE + contentSize + (contentSize & 1);
+  }
+
+  long long* fileOffsets = (long long*)malloc(sizeof(long long)*(out->fileCount + 1));
+  out->files = (_StaticLibFile*)malloc(sizeof(_StaticLibFile)*(out->fileCount + 1));
+  memset(out->files, 0, sizeof(_StaticLibFile)*out->fileCount);
+
+  long long position = _STATIC_LIB_SIGNATURE_SIZE;
+  for(int i = 0; i < out->fileCount;)
+  {
+    char* fileInfo = &data[position];
+    long long contentSize = atoll(&fileInfo[48]);
+    char* content = &data[position + _STATIC_LIB_MEMBER_HEADER_SIZE];
+    if(content != symbolIndex && content != longNames)
     {
-      ungetc(c, file);
-      for(int i = 0; i < out->header.globalSymbolCount; i++)
-        if(out->globalSymbols[i].fileOffset == ftell(file))
-          out->globalSymbols[i].fileIndex = out->fileCount;
-      int i = out->fileCount++;
-      out->files = (_StaticLibFile*)realloc(out->files, sizeof(_StaticLibFile)*out->fileCount);
       _StaticLibFile* libFile = &out->files[i];
-      memset(libFile, 0, sizeof(_StaticLibFile));
-      fread(libFile->fileInfo, sizeof(libFile->fileInfo), 1, file);
-      libFile->contentSize = atoi(&libFile->fileInfo[48]);
-      libFile->content = (char*)malloc(libFile->contentSize);
-      ok = fread(libFile->content, libFile->contentSize, 1, file) == 1;
+      memcpy(libFile->fileInfo, fileInfo, sizeof(libFile->fileInfo));
+      libFile->nameOffset = _staticLibAddMemberName(out, fileInfo, longNames, longNamesSize);
+      libFile->content = content;
+      libFile->contentSize = contentSize;
+      fileOffsets[i++] = position;
     }
+    position += _STATIC_LIB_MEMBER_HEADER_SIZE + contentSize + (contentSize & 1);
   }
 
-  fclose(file);
+  int wordSize = out->header.is64 ? 8 : 4;
+  long long globalSymbolCount = symbolIndexSize >= wordSize ? _staticLibReadWord(symbolIndex, wordSize) : 0;
+  if(globalSymbolCount < 0 || globalSymbolCount > symbolIndexSize || wordSize*(globalSymbolCount + 1) > symbolIndexSize)
+  {
+    globalSymbolCount = 0;
+    ok = false;
+  }
+  out->header.globalSymbolCount = globalSymbolCount;
+
+  int size = sizeof(_GlobalSymbol)*out->header.globalSymbolCount;
+  out->globalSymbols = (_GlobalSymbol*)malloc(size ? size : 1);
+  memset(out->globalSymbols, 0, size);
+
+  // All names are copied to the pool at once, each symbol only keeps its offset and length
+  long long namesSize = symbolIndexSize - wordSize*(globalSymbolCount + 1);
+  long long nameOffset = namesSize > 0 ? _stringPoolAdd(&out->strings, symbolIndex + wordSize*(globalSymbolCount + 1), namesSize) : 0;
+  long long namesEnd = nameOffset + namesSize;
+  for(int i = 0; i < out->header.globalSymbolCount; i++)
+  {
+    _GlobalSymbol* symbol = &out->globalSymbols[i];
+    symbol->fileOffset = _staticLibReadWord(symbolIndex + wordSize*(i + 1), wordSize);
+    symbol->fileIndex = _staticLibFindFileByOffset(fileOffsets, out->fileCount, symbol->fileOffset);
+    if(symbol->fileIndex < 0) symbol->fileIndex = 0;
+
+    symbol->nameOffset = nameOffset;
+    symbol->nameLength = strlen(&out->strings.data[nameOffset]);
+    nameOffset += symbol->nameLength;
+    if(nameOffset < namesEnd) nameOffset++;
+  }
+
+  free(fileOffsets);
 
   return ok;
 }
 
+// Fills a member header keeping date, owner and mode of the given template
+void _staticLibFormatFileInfo(char* fileInfo, char* templateInfo, const char* name, long long contentSize)
+{
+  char aux[32];
+  memset(fileInfo, ' ', _STATIC_LIB_MEMBER_HEADER_SIZE);
+  if(templateInfo && memcmp(&templateInfo[58], "`\n", 2) == 0)
+    memcpy(&fileInfo[16], &templateInfo[16], 32);
+  else
+  {
+    memcpy(&fileInfo[16], "0", 1);
+    memcpy(&fileInfo[28], "0", 1);
+    memcpy(&fileInfo[34], "0", 1);
+    memcpy(&fileInfo[40], "644", 3);
+  }
+  memcpy(fileInfo, name, strlen(name) < 16 ? strlen(name) : 16);
+  int length = sprintf(aux, "%lli", contentSize);
+  memcpy(&fileInfo[48], aux, length);
+  memcpy(&fileInfo[58], "`\n", 2);
+}
+
 bool _staticLibWrite(_StaticLib* lib, char* path)
 {
   FILE *file = fopen(path, "wb");
   if(!file) return false;
-  
-  char auxNum[32];
+
+  char fileInfo[_STATIC_LIB_MEMBER_HEADER_SIZE];
+  char aux[32];
   int globalSymbolCount = lib->header.globalSymbolCount;
-  unsigned int size = sizeof(int)*(globalSymbolCount+1);
-  for(int i = 0; i < globalSymbolCount; i++)
-    size += strlen(lib->globalSymbols[i].name) + 1;
 
-  _StaticLibHeader header = lib->header;
-  memset(header.size, ' ', sizeof(header.size));
-  sprintf(auxNum, "%u", size);
-  memcpy(header.size, auxNum, strlen(auxNum));
-  
-  fseek(file, 0, SEEK_SET);
-  _staticLibSwapIfLittleEndian(&header.globalSymbolCount);
-  fwrite(&header, sizeof(_StaticLibHeader), 1, file);
-  
+  // Names that do not fit the header go to the "//" table, each one followed by "/\n"
+  long long longNamesSize = 0;
+  for(int i = 0; i < lib->fileCount; i++)
+  {
+    long long length = strlen(_staticLibFileName(lib, &lib->files[i]));
+    if(length > _STATIC_LIB_MAX_SHORT_NAME) longNamesSize += length + 2;
+  }
+  // GNU ar counts the padding of this table as part of its content
+  longNamesSize += longNamesSize & 1;
+
+  long long namesSize = 0;
   for(int i = 0; i < globalSymbolCount; i++)
+    namesSize += lib->globalSymbols[i].nameLength + 1;
+
+  // Members are aligned to even offsets, so the offset of each one is a prefix sum of the padded sizes
+  // The 64 bit index is kept when the lib was read with it, otherwise only used when a member does not fit 32 bit
+  // offsets, like GNU ar does
+  long long* fileOffsets = (long long*)malloc(sizeof(long long)*(lib->fileCount + 1));
+  int wordSize = 4;
+  long long size = 0;
+  for(int attempt = lib->header.is64 ? 1 : 0; attempt < 2; attempt++)
   {
-    _GlobalSymbol symbol = lib->globalSymbols[i];
-    symbol.fileOffset = sizeof(_StaticLibHeader) - sizeof(int) + size + symbol.fileIndex*60;
-    for(int j = 0; j < symbol.fileIndex; j++)
-      symbol.fileOffset += lib->files[j].contentSize;
-    _staticLibSwapIfLittleEndian(&symbol.fileOffset);
-    fwrite(&symbol.fileOffset, sizeof(int), 1, file);
+    wordSize = attempt ? 8 : 4;
+    size = wordSize*(globalSymbolCount + 1) + namesSize;
+    fileOffsets[0] = _STATIC_LIB_SIGNATURE_SIZE + _STATIC_LIB_MEMBER_HEADER_SIZE + size + (size & 1);
+    if(longNamesSize) fileOffsets[0] += _STATIC_LIB_MEMBER_HEADER_SIZE + longNamesSize;
+    for(int i = 0; i < lib->fileCount; i++)
+      fileOffsets[i+1] = fileOffsets[i] + _STATIC_LIB_MEMBER_HEADER_SIZE + lib->files[i].contentSize + (lib->files[i].contentSize & 1);
+    if(!lib->fileCount || fileOffsets[lib->fileCount - 1] <= 0xFFFFFFFFll) break;
   }
 
+  fwrite(_STATIC_LIB_SIGNATURE, _STATIC_LIB_SIGNATURE_SIZE, 1, file);
+  _staticLibFormatFileInfo(fileInfo, lib->header.fileInfo, wordSize == 8 ? "/SYM64/" : "/", size);
+  fwrite(fileInfo, sizeof(fileInfo), 1, file);
+  _staticLibWriteWord(file, globalSymbolCount, wordSize);
+  for(int i = 0; i < globalSymbolCount; i++)
+    _staticLibWriteWord(file, fileOffsets[lib->globalSymbols[i].fileIndex], wordSize);
+
   for(int i = 0; i < globalSymbolCount; i++)
-    fwrite(lib->globalSymbols[i].name, strlen(lib->globalSymbols[i].name) + 1, 1, file);
+    fwrite(_staticLibSymbolName(lib, &lib->globalSymbols[i]), lib->globalSymbols[i].nameLength + 1, 1, file);
+  if(size & 1) fputc('\n', file);
+
+  if(longNamesSize)
+  {
+    _staticLibFormatFileInfo(fileInfo, 0, "//", longNamesSize);
+    memset(&fileInfo[16], ' ', 32);
+    fwrite(fileInfo, sizeof(fileInfo), 1, file);
+    for(int i = 0; i < lib->fileCount; i++)
+    {
+      char* name = _staticLibFileName(lib, &lib->files[i]);
+      if(strlen(name) > _STATIC_LIB_MAX_SHORT_NAME) fprintf(file, "%s/\n", name);
+    }
+    if(ftell(file) & 1) fputc('\n', file);
+  }
 
+  bool ok = true;
+  long long longNameOffset = 0;
   for(int i = 0; i < lib->fileCount; i++)
   {
-    char fileInfo[60];
     _StaticLibFile* libFile = &lib->files[i];
-    memcpy(fileInfo, libFile->fileInfo, sizeof(fileInfo));
-    memset(fileInfo + 48, ' ', 10);
-    sprintf(auxNum, "%lli", libFile->contentSize);
-    memcpy(fileInfo + 48, auxNum, strlen(auxNum));
-    fwrite(fileInfo, sizeof(libFile->fileInfo), 1, file);
-    fwrite(libFile->content, libFile->contentSize, 1, file);
+    char* name = _staticLibFileName(lib, libFile);
+    long long nameLength = strlen(name);
+    if(nameLength > _STATIC_LIB_MAX_SHORT_NAME)
+    {
+      sprintf(aux, "/%lli", longNameOffset);
+      longNameOffset += nameLength + 2;
+    }
+    else
+      sprintf(aux, "%s/", name);
+    _staticLibFormatFileInfo(fileInfo, libFile->fileInfo, aux, libFile->contentSize);
+    fwrite(fileInfo, sizeof(fileInfo), 1, file);
+
+    // Untouched members are still slices of the source archive and can be copied file to file
+    if(libFile->ownsContent || libFile->content < lib->source.data || libFile->content >= lib->source.data + lib->source.size)
+      fwrite(libFile->content, libFile->contentSize, 1, file);
+    else
+      ok &= _copyFileRange(file, &lib->source, libFile->content - lib->source.data, libFile->contentSize);
+    if(libFile->contentSize & 1) fputc('\n', file);
   }
 
-  fclose(file);
+  ok &= !ferror(file);
+  ok &= fclose(file) == 0;
+  free(fileOffsets);
 
-  return true;
+  return ok;
 }
 
 void _staticLibFree(_StaticLib* lib)
 {
   for(int i = 0; i < lib->fileCount; i++)
-    if(lib->files[i].content) free(lib->files[i].content);
+    if(lib->files[i].ownsContent) free(lib->files[i].content);
   if(lib->files) free(lib->files);
   if(lib->globalSymbols) free(lib->globalSymbols);
+  if(lib->strings.data) free(lib->strings.data);
+  _unmapFile(&lib->source);
+  memset(lib, 0, sizeof(_StaticLib));
 }
 // This content is part of test.h
 // Object files and symbol management
@@ -275,6 +587,8 @@ typedef struct _ElfRela _ElfRela;
 typedef struct _ElfHeader _ElfHeader;
 typedef struct _ElfSectionHeader _ElfSectionHeader;
 typedef struct _ElfSymbol _ElfSymbol;
+typedef struct _ElfProgramHeader _ElfProgramHeader;
+typedef struct _ObjectFileRename _ObjectFileRename;
 
 struct _ElfRel
 {
@@ -331,6 +645,36 @@ struct _ElfSymbol
   uint64_t st_size;
 };
 
+struct _ElfProgramHeader
+{
+  uint32_t p_type;
+  uint32_t p_flags;
+  uint64_t p_offset;
+  uint64_t p_vaddr;
+  uint64_t p_paddr;
+  uint64_t p_filesz;
+  uint64_t p_memsz;
+  uint64_t p_align;
+};
+
+// Symbol renames applied to object files, arrays of them are kept sorted by from
+struct _ObjectFileRename
+{
+  const char* from;
+  const char* to;
+};
+
+int _objectFileCompareRenames(const void* a, const void* b)
+{
+  return strcmp(((_ObjectFileRename*)a)->from, ((_ObjectFileRename*)b)->from);
+}
+
+_ObjectFileRename* _objectFileFindRename(int renameCount, _ObjectFileRename* renames, const char* from)
+{
+  _ObjectFileRename key = {from, 0};
+  return (_ObjectFileRename*)bsearch(&key, renames, renameCount, sizeof(_ObjectFileRename), _objectFileCompareRenames);
+}
+
 bool _objectFileIsSupportedElf64(_ElfHeader* header)
 {
   if(header->e_ident[0] == 0x7f && header->e_ident[1] == 'E' && header->e_ident[2] == 'L' && header->e_ident[3] == 'F' && header->e_ident[4] == 2 &&
@@ -364,126 +708,350 @@ bool _objectFileElfIsGlobalFunctionDefinedHere(_ElfSymbol* symbol)
   return binding != 0 && type == 2 && symbol->st_shndx != 0;
 }
 
-void _objectFileMockElfSymbol(_StaticLibFile* libFile, _ElfHeader header, _ElfSectionHeader* sections, _ElfSectionHeader* symbolTable, _ElfSymbol* symbol, char* to)
+// Rewrites an object so every global function named as a rename "from" is only referenced there and defined as "to" instead
+// New string and symbol tables are appended at the end of the object and only their section headers are patched,
+// every other section keeps its bytes and offset. Objects defining none of the functions are left untouched.
+bool _objectFileMockElfFunctions(_StaticLibFile* libFile, _ElfHeader header, int renameCount, _ObjectFileRename* renames)
 {
-  int offset = sizeof(_ElfHeader), addedBytes = 0;
-  char* newContent = (char*)malloc(libFile->contentSize*2);
-  memset(newContent, 0, libFile->contentSize*2);
-  _ElfSectionHeader* stringTable = &sections[symbolTable->sh_link];
-  _ElfSectionHeader* orderedSections[header.e_shnum];
-  memset(orderedSections, 0, sizeof(orderedSections));
-  int lastMin = -1;
-  int lastIndex = -1;
+  if(header.e_shoff + (long long)sizeof(_ElfSectionHeader)*header.e_shnum > (unsigned long long)libFile->contentSize)
+    return false;
+
+  _ElfSectionHeader sections[header.e_shnum];
+  for(int i = 0; i < header.e_shnum; i++)
+    memcpy(&sections[i], libFile->content + header.e_shoff + sizeof(_ElfSectionHeader)*i, sizeof(_ElfSectionHeader));
+
+  int symbolTableIndex = -1;
   for(int i = 0; i < header.e_shnum; i++)
+    if(sections[i].sh_type == 2) symbolTableIndex = i;
+  if(symbolTableIndex < 0) return true;
+
+  _ElfSectionHeader symbolTable = sections[symbolTableIndex];
+  int stringTableIndex = symbolTable.sh_link;
+  if(stringTableIndex >= header.e_shnum) return false;
+  _ElfSectionHeader stringTable = sections[stringTableIndex];
+  if(symbolTable.sh_offset + symbolTable.sh_size > (unsigned long long)libFile->contentSize ||
+     stringTable.sh_offset + stringTable.sh_size > (unsigned long long)libFile->contentSize)
+    return false;
+  int symbolCount = symbolTable.sh_size/sizeof(_ElfSymbol);
+
+  int mockedCount = 0;
+  long long addedNamesSize = 0;
+  int* mockedSymbols = (int*)malloc(sizeof(int)*(symbolCount + 1));
+  _ObjectFileRename** mockedRenames = (_ObjectFileRename**)malloc(sizeof(_ObjectFileRename*)*(symbolCount + 1));
+  for(int i = 1; i < symbolCount; i++)
   {
-    int minIndex;
-    for(int j = 0; j < header.e_shnum; j++)
-    {
-      long long off = sections[j].sh_offset;
-    
-      if(off < lastMin || (off == lastMin && j <= lastIndex)) continue;
-      if(!orderedSections[i] || off < (long long)orderedSections[i]->sh_offset)
-      {
-        minIndex = j;
-        orderedSections[i] = &sections[j];
-      }
-    }
+    _ElfSymbol* symbol = _objectFileElfGetSymbol(libFile, &symbolTable, i);
+    if(!_objectFileElfIsGlobalFunctionDefinedHere(symbol)) continue;
+    _ObjectFileRename* rename = _objectFileFindRename(renameCount, renames, _objectFileElfGetString(libFile, &stringTable, symbol->st_name));
+    if(!rename) continue;
+    mockedSymbols[mockedCount] = i;
+    mockedRenames[mockedCount++] = rename;
+    addedNamesSize += strlen(rename->to) + 1;
+  }
+  if(!mockedCount)
+  {
+    free(mockedSymbols);
+    free(mockedRenames);
+    return true;
+  }
+
+  long long stringTableOffset = libFile->contentSize + (8 - libFile->contentSize % 8) % 8;
+  long long stringTableSize = stringTable.sh_size + addedNamesSize;
+  long long symbolTableOffset = stringTableOffset + stringTableSize + (8 - (stringTableOffset + stringTableSize) % 8) % 8;
+  long long symbolTableSize = symbolTable.sh_size + sizeof(_ElfSymbol)*mockedCount;
+  long long contentSize = symbolTableOffset + symbolTableSize;
 
-    lastIndex = minIndex;
-    lastMin = orderedSections[i]->sh_offset;
+  char* content;
+  if(libFile->ownsContent)
+    content = (char*)realloc(libFile->content, contentSize);
+  else
+  {
+    content = (char*)malloc(contentSize);
+    memcpy(content, libFile->content, libFile->contentSize);
+  }
+  memset(content + libFile->contentSize, 0, contentSize - libFile->contentSize);
+  memcpy(content + stringTableOffset, content + stringTable.sh_offset, stringTable.sh_size);
+  memcpy(content + symbolTableOffset, content + symbolTable.sh_offset, symbolTable.sh_size);
+
+  // The original symbol becomes an undefined reference, so calls inside the object reach the mock trampoline
+  long long nameOffset = stringTable.sh_size;
+  _ElfSymbol* symbols = (_ElfSymbol*)(content + symbolTableOffset);
+  for(int i = 0; i < mockedCount; i++)
+  {
+    _ElfSymbol* symbol = &symbols[mockedSymbols[i]];
+    _ElfSymbol* newSymbol = &symbols[symbolCount + i];
+    *newSymbol = *symbol;
+    newSymbol->st_name = nameOffset;
+    int size = strlen(mockedRenames[i]->to) + 1;
+    memcpy(content + stringTableOffset + nameOffset, mockedRenames[i]->to, size);
+    nameOffset += size;
+
+    symbol->st_value = 0;
+    symbol->st_size = 0;
+    symbol->st_shndx = 0;
+    symbol->st_info &= 0xF0;
   }
 
-  _ElfSymbol aux = *symbol;
-  _ElfSymbol* newSymbol = &aux;
-  symbol->st_value = 0;
-  symbol->st_size = 0;
-  symbol->st_shndx = 0;
-  symbol->st_info &= 0xF0;
+  sections[stringTableIndex].sh_offset = stringTableOffset;
+  sections[stringTableIndex].sh_size = stringTableSize;
+  sections[symbolTableIndex].sh_offset = symbolTableOffset;
+  sections[symbolTableIndex].sh_size = symbolTableSize;
+  memcpy(content + header.e_shoff + sizeof(_ElfSectionHeader)*stringTableIndex, &sections[stringTableIndex], sizeof(_ElfSectionHeader));
+  memcpy(content + header.e_shoff + sizeof(_ElfSectionHeader)*symbolTableIndex, &sections[symbolTableIndex], sizeof(_ElfSectionHeader));
+
+  libFile->content = content;
+  libFile->contentSize = contentSize;
+  libFile->ownsContent = true;
+  free(mockedSymbols);
+  free(mockedRenames);
+  return true;
+}
 
-  for(int i = 0; i < header.e_shnum; i++)
+bool _objectFileMockFunctions(_StaticLibFile* libFile, int renameCount, _ObjectFileRename* renames)
+{
+  _ElfHeader elfHeader;
+  if(libFile->contentSize < (long long)sizeof(_ElfHeader)) return false;
+  memcpy(&elfHeader, libFile->content, sizeof(_ElfHeader));
+  if(_objectFileIsSupportedElf64(&elfHeader))
+    return _objectFileMockElfFunctions(libFile, elfHeader, renameCount, renames);
+  return false;
+}
+
+// Minimal x86-64 ELF64 relocatable objects built in memory, used for emitting mock trampolines without a compiler
+// Sections and their section symbols share indices, every added symbol is global and comes after the section symbols.
+// Symbols referenced but not defined here are added to _ELF_OBJECT_UNDEFINED
+typedef struct _ObjectFileBuffer _ObjectFileBuffer;
+typedef struct _ElfObject _ElfObject;
+
+enum _ElfObjectSection
+{
+  _ELF_OBJECT_UNDEFINED = 0,
+  _ELF_OBJECT_TEXT = 1,
+  _ELF_OBJECT_DATA = 2,
+  _ELF_OBJECT_RODATA = 3,
+  _ELF_OBJECT_SECTION_SYMBOLS = 4
+};
+
+enum _ElfRelocationType
+{
+  _ELF_R_X86_64_64 = 1,
+  _ELF_R_X86_64_PC32 = 2,
+  _ELF_R_X86_64_PLT32 = 4
+};
+
+struct _ObjectFileBuffer
+{
+  char* data;
+  long long size;
+  long long capacity;
+};
+
+struct _ElfObject
+{
+  _ObjectFileBuffer text;
+  _ObjectFileBuffer data;
+  _ObjectFileBuffer rodata;
+  _ObjectFileBuffer textRelocations;
+  _ObjectFileBuffer dataRelocations;
+  _ObjectFileBuffer symbols;
+  _ObjectFileBuffer strings;
+};
+
+long long _objectFileBufferAppend(_ObjectFileBuffer* buffer, const void* data, long long size)
+{
+  if(buffer->size + size > buffer->capacity)
   {
-    _ElfSectionHeader* current = orderedSections[i];
-    if(current->sh_addralign > 1 && offset % current->sh_addralign)
-      offset += current->sh_addralign - (offset % current->sh_addralign);
-    memcpy(newContent + offset, libFile->content + current->sh_offset, current->sh_size);
-    current->sh_offset = offset;
-    offset += current->sh_size;
-    
-    if(current == stringTable)
-    {
-      int size = strlen(to) + 1;
-      newSymbol->st_name = offset-current->sh_offset;
-      memcpy(newContent + offset, to, size);
-      offset += size;
-      addedBytes += size;
-      current->sh_size += size;
-    }
-    else if(current == symbolTable)
-    {
-      int size = sizeof(_ElfSymbol);
-      memcpy(newContent + offset, newSymbol, size);
-      newSymbol = (_ElfSymbol*)(newContent + offset);
-      offset += size;
-      addedBytes += size;
-      current->sh_size += size;
-    }
+    buffer->capacity = buffer->capacity*2 + size + 256;
+    buffer->data = (char*)realloc(buffer->data, buffer->capacity);
   }
+  if(data) memcpy(buffer->data + buffer->size, data, size);
+  else memset(buffer->data + buffer->size, 0, size);
+  buffer->size += size;
+  return buffer->size - size;
+}
 
-  if(offset % 8) offset += 8 - (offset % 8);
+void _objectFileBufferAlign(_ObjectFileBuffer* buffer, int alignment, char fill)
+{
+  while(buffer->size % alignment)
+    _objectFileBufferAppend(buffer, &fill, 1);
+}
 
-  header.e_shoff = offset;
-  for(int i = 0; i < header.e_shnum; i++)
+int _elfObjectAddSymbol(_ElfObject* object, const char* name, int section, int type, long long value, long long size)
+{
+  _ElfSymbol symbol = {0};
+  symbol.st_name = _objectFileBufferAppend(&object->strings, name, strlen(name) + 1);
+  symbol.st_info = (1 << 4) | type; // global
+  symbol.st_shndx = section;
+  symbol.st_value = value;
+  symbol.st_size = size;
+  return _objectFileBufferAppend(&object->symbols, &symbol, sizeof(_ElfSymbol))/sizeof(_ElfSymbol);
+}
+
+void _elfObjectInit(_ElfObject* object)
+{
+  memset(object, 0, sizeof(_ElfObject));
+  _objectFileBufferAppend(&object->strings, "", 1);
+  _objectFileBufferAppend(&object->symbols, 0, sizeof(_ElfSymbol));
+  for(int i = _ELF_OBJECT_TEXT; i < _ELF_OBJECT_SECTION_SYMBOLS; i++)
   {
-    memcpy(newContent + offset, &sections[i], sizeof(_ElfSectionHeader));
-    offset += sizeof(_ElfSectionHeader);
+    _ElfSymbol symbol = {0, 3, 0, (uint16_t)i, 0, 0}; // local section symbol
+    _objectFileBufferAppend(&object->symbols, &symbol, sizeof(_ElfSymbol));
   }
+}
 
-  memcpy(newContent, &header, sizeof(_ElfHeader));
-  free(libFile->content);
-  libFile->contentSize = offset;
-  libFile->content = newContent;
+void _elfObjectAddRelocation(_ElfObject* object, int section, long long offset, int symbol, int type, long long addend)
+{
+  _ElfRela relocation = {(uint64_t)offset, ((uint64_t)symbol << 32) | (uint32_t)type, addend};
+  _objectFileBufferAppend(section == _ELF_OBJECT_TEXT ? &object->textRelocations : &object->dataRelocations, &relocation, sizeof(_ElfRela));
 }
 
-bool _objectFileMockElfFunction(_StaticLibFile* libFile, _ElfHeader header, char* from, char* to)
+bool _elfObjectWrite(_ElfObject* object, char* path)
 {
-  _ElfSectionHeader sections[header.e_shnum];
+  const char sectionNames[] = "\0.text\0.data\0.rodata\0.rela.text\0.rela.data\0.symtab\0.strtab\0.shstrtab\0.note.GNU-stack";
+  enum {TEXT = 1, DATA, RODATA, RELA_TEXT, RELA_DATA, SYMTAB, STRTAB, SHSTRTAB, NOTE, SECTION_COUNT};
+  _ObjectFileBuffer* contents[SECTION_COUNT] = {0, &object->text, &object->data, &object->rodata, &object->textRelocations,
+                                                &object->dataRelocations, &object->symbols, &object->strings, 0, 0};
+  _ObjectFileBuffer names = {(char*)sectionNames, sizeof(sectionNames), sizeof(sectionNames)};
+  contents[SHSTRTAB] = &names;
+
+  _ElfSectionHeader sections[SECTION_COUNT];
+  memset(sections, 0, sizeof(sections));
+  const int nameOffsets[SECTION_COUNT] = {0, 1, 7, 13, 21, 32, 43, 51, 59, 69};
+  const int types[SECTION_COUNT] = {0, 1, 1, 1, 4, 4, 2, 3, 3, 1};
+  const int flags[SECTION_COUNT] = {0, 0x6, 0x3, 0x2, 0x40, 0x40, 0, 0, 0, 0};
+  const int alignments[SECTION_COUNT] = {0, 16, 8, 8, 8, 8, 8, 1, 1, 1};
+  long long offset = sizeof(_ElfHeader);
+  for(int i = 1; i < SECTION_COUNT; i++)
+  {
+    offset += (alignments[i] - offset % alignments[i]) % alignments[i];
+    sections[i].sh_name = nameOffsets[i];
+    sections[i].sh_type = types[i];
+    sections[i].sh_flags = flags[i];
+    sections[i].sh_offset = offset;
+    sections[i].sh_size = contents[i] ? contents[i]->size : 0;
+    sections[i].sh_addralign = alignments[i];
+    offset += sections[i].sh_size;
+  }
+  sections[RELA_TEXT].sh_link = sections[RELA_DATA].sh_link = SYMTAB;
+  sections[RELA_TEXT].sh_info = TEXT;
+  sections[RELA_DATA].sh_info = DATA;
+  sections[RELA_TEXT].sh_entsize = sections[RELA_DATA].sh_entsize = sizeof(_ElfRela);
+  sections[SYMTAB].sh_link = STRTAB;
+  sections[SYMTAB].sh_info = _ELF_OBJECT_SECTION_SYMBOLS;
+  sections[SYMTAB].sh_entsize = sizeof(_ElfSymbol);
+  offset += (8 - offset % 8) % 8;
+
+  _ElfHeader header;
+  memset(&header, 0, sizeof(_ElfHeader));
+  memcpy(header.e_ident, "\x7f" "ELF\x02\x01\x01", 7);
+  header.e_type = 1;
+  header.e_machine = 62; // x86-64
+  header.e_version = 1;
+  header.e_shoff = offset;
+  header.e_ehsize = sizeof(_ElfHeader);
+  header.e_shentsize = sizeof(_ElfSectionHeader);
+  header.e_shnum = SECTION_COUNT;
+  header.e_shstrndx = SHSTRTAB;
 
-  for(int i = 0; i < header.e_shnum; i++)
-    memcpy(&sections[i], libFile->content + header.e_shoff + sizeof(_ElfSectionHeader)*i, sizeof(_ElfSectionHeader));
+  FILE* file = fopen(path, "wb");
+  if(!file) return false;
+  bool ret = fwrite(&header, sizeof(_ElfHeader), 1, file) == 1;
+  for(int i = 1; i < SECTION_COUNT; i++)
+  {
+    while(ret && ftell(file) < (long)sections[i].sh_offset) ret = fputc(0, file) != EOF;
+    if(ret && sections[i].sh_size) ret = fwrite(contents[i]->data, sections[i].sh_size, 1, file) == 1;
+  }
+  while(ret && ftell(file) < (long)offset) ret = fputc(0, file) != EOF;
+  ret = ret && fwrite(sections, sizeof(sections), 1, file) == 1;
+  return fclose(file) == 0 && ret;
+}
 
-  _ElfSectionHeader* symbolTable = 0;
-  for(int i = 0; i < header.e_shnum; i++)
-    if(sections[i].sh_type == 2) symbolTable = &sections[i];
-  
-  if(!symbolTable) return true;
-  for(unsigned int i = 1; i < symbolTable->sh_size/sizeof(_ElfSymbol); i++)
+void _elfObjectFree(_ElfObject* object)
+{
+  _ObjectFileBuffer* buffers[] = {&object->text, &object->data, &object->rodata, &object->textRelocations,
+                                  &object->dataRelocations, &object->symbols, &object->strings};
+  for(unsigned int i = 0; i < sizeof(buffers)/sizeof(buffers[0]); i++)
+    free(buffers[i]->data);
+  memset(object, 0, sizeof(_ElfObject));
+}
+
+// Lists the global functions defined in an ELF64 object, the names point into its content.
+// Their symbols are listed in the same order when symbols is given, both outputs must be freed
+int _objectFileGlobalFunctions(_StaticLibFile* libFile, const char*** output, _ElfSymbol** symbols)
+{
+  *output = 0;
+  if(symbols) *symbols = 0;
+  _ElfHeader header;
+  if(libFile->contentSize < (long long)sizeof(_ElfHeader)) return 0;
+  memcpy(&header, libFile->content, sizeof(_ElfHeader));
+  if(!_objectFileIsSupportedElf64(&header) ||
+     header.e_shoff + (long long)sizeof(_ElfSectionHeader)*header.e_shnum > (unsigned long long)libFile->contentSize)
+    return 0;
+
+  _ElfSectionHeader symbolTable, stringTable;
+  int symbolTableIndex = -1;
+  for(int i = 0; i < header.e_shnum && symbolTableIndex < 0; i++)
   {
-    _ElfSymbol* symbol = _objectFileElfGetSymbol(libFile, symbolTable, i);
-    char* name = _objectFileElfGetString(libFile, &sections[symbolTable->sh_link], symbol->st_name);
-    if(name && strcmp(name, from) == 0 && _objectFileElfIsGlobalFunctionDefinedHere(symbol))
-    {
-      _objectFileMockElfSymbol(libFile, header, sections, symbolTable, symbol, to);
-      break;
-    }
+    memcpy(&symbolTable, libFile->content + header.e_shoff + sizeof(_ElfSectionHeader)*i, sizeof(_ElfSectionHeader));
+    if(symbolTable.sh_type == 2) symbolTableIndex = i;
   }
-  
-  return true;
+  if(symbolTableIndex < 0 || symbolTable.sh_link >= header.e_shnum) return 0;
+  memcpy(&stringTable, libFile->content + header.e_shoff + sizeof(_ElfSectionHeader)*symbolTable.sh_link, sizeof(_ElfSectionHeader));
+  if(symbolTable.sh_offset + symbolTable.sh_size > (unsigned long long)libFile->contentSize ||
+     stringTable.sh_offset + stringTable.sh_size > (unsigned long long)libFile->contentSize)
+    return 0;
+
+  int count = 0;
+  int symbolCount = symbolTable.sh_size/sizeof(_ElfSymbol);
+  *output = (const char**)malloc(sizeof(char*)*(symbolCount + 1));
+  if(symbols) *symbols = (_ElfSymbol*)malloc(sizeof(_ElfSymbol)*(symbolCount + 1));
+  for(int i = 1; i < symbolCount; i++)
+  {
+    _ElfSymbol symbol;
+    memcpy(&symbol, libFile->content + symbolTable.sh_offset + sizeof(_ElfSymbol)*i, sizeof(_ElfSymbol));
+    if(!_objectFileElfIsGlobalFunctionDefinedHere(&symbol) || symbol.st_name >= stringTable.sh_size ||
+       !memchr(libFile->content + stringTable.sh_offset + symbol.st_name, 0, stringTable.sh_size - symbol.st_name))
+      continue;
+    if(symbols) (*symbols)[count] = symbol;
+    (*output)[count++] = _objectFileElfGetString(libFile, &stringTable, symbol.st_name);
+  }
+  return count;
 }
 
-bool _objectFileMockFunction(_StaticLibFile* libFile, char* from, char* to)
+// Size of the function whose symbol has the given value in an ELF64 file of any type, -1 when none has it
+long long _objectFileFunctionSize(const char* content, long long contentSize, unsigned long long value)
 {
-  _ElfHeader elfHeader;
-  memcpy(&elfHeader, libFile->content, sizeof(_ElfHeader));
-  if(_objectFileIsSupportedElf64(&elfHeader))
-    return _objectFileMockElfFunction(libFile, elfHeader, from, to);
-  return false;
+  _ElfHeader header;
+  if(contentSize < (long long)sizeof(_ElfHeader)) return -1;
+  memcpy(&header, content, sizeof(_ElfHeader));
+  if(memcmp(header.e_ident, "\177ELF", 4) != 0 || header.e_ident[4] != 2 || header.e_shentsize != sizeof(_ElfSectionHeader) ||
+     header.e_shoff + (long long)sizeof(_ElfSectionHeader)*header.e_shnum > (unsigned long long)contentSize)
+    return -1;
+
+  for(int s = 0; s < header.e_shnum; s++)
+  {
+    _ElfSectionHeader table;
+    memcpy(&table, content + header.e_shoff + sizeof(_ElfSectionHeader)*s, sizeof(_ElfSectionHeader));
+    // Static functions are only in the symbol table (2), stripped files keep the dynamic one (11)
+    if((table.sh_type != 2 && table.sh_type != 11) || table.sh_offset + table.sh_size > (unsigned long long)contentSize) continue;
+    for(unsigned long long i = 1; i < table.sh_size/sizeof(_ElfSymbol); i++)
+    {
+      _ElfSymbol symbol;
+      memcpy(&symbol, content + table.sh_offset + sizeof(_ElfSymbol)*i, sizeof(_ElfSymbol));
+      if((symbol.st_info & 0xF) == 2 && symbol.st_shndx != 0 && symbol.st_value == value) return symbol.st_size;
+    }
+  }
+  return -1;
 }
 // This content is part of test.h
 // Main testing functionalities
 typedef struct _TestSelect _TestSelect;
+typedef struct _TestOptions _TestOptions;
 typedef struct _TestContext _TestContext;
+typedef struct _TimingRun _TimingRun;
+typedef struct _StressTest _StressTest;
 typedef struct TestEnvironment TestEnvironment;
-typedef struct FunctionMock FunctionMock;
+typedef struct MockTable MockTable;
 typedef struct FunctionDescriptor FunctionDescriptor;
 
 enum _TestSelectMode
@@ -501,11 +1069,21 @@ struct _TestSelect
   char* name;
 };
 
+// Runner flags that are passed on to every test process
+struct _TestOptions
+{
+  char* tracePath;
+  char* profilePath;
+  bool hasSeed;
+  unsigned long long seed;
+  long long fuzzRuns;
+};
+
 struct _TestContext
 {
   bool set;
-  FunctionMock* mocksPointer;
-  void** mocksSnapshot;
+  int mockChangesCount;
+  int runtimeMocksCount;
   void (*setupFunction)();
   void (*cleanFunction)();
   void (*onFail)(char* file, int line, char* expr);
@@ -513,6 +1091,26 @@ struct _TestContext
   void (*onRaise)(int);
 };
 
+// Samples of an assert_faster_than, each one the mean time of a batch of runs long enough for the clock resolution
+struct _TimingRun
+{
+  int batchSize;
+  int sampleCount;
+  bool calibrated;
+  unsigned long long batchStart;
+  unsigned long long samples[_TIMING_SAMPLES];
+};
+
+struct _StressTest
+{
+  int testIndex;
+  int threadCount;
+  long long iterations;
+  int arrived;
+  void* threads;
+  unsigned long long* elapsed;
+};
+
 struct TestEnvironment
 {
   _TestContext globalContext;
@@ -528,24 +1126,58 @@ struct TestEnvironment
   void* helperMemoryBlock[_TEST_HELPER_BLOCK_SIZE];
 };
 
-struct FunctionMock
+// The mock table generated with the mock file, every array is indexed by the position of the name in sorted order
+// and has one extra entry, used as target when a name is not found
+struct MockTable
 {
-  bool set;
-  int calls;
-  void* mockPointer;
-  const char* name;
-  void* original;
+  int count;
+  const char* names;
+  const unsigned int* nameOffsets;
+  int* calls;
+  void** slots;
+  void** originals;
 };
 
 struct FunctionDescriptor
 {
-  char returnType[32];
-  char name[_BTR_MAX_NAME_SIZE];
-  char args[_BTR_MAX_NAME_SIZE];
-  char* implementation;
+  const char* returnType;
+  const char* name;
+  const char* args;
+  const char* implementation;
+};
+
+// Options for the generated mock files, combined in mockFileOptions before calling createMocks or createObjectMocks
+// MOCK_FILE_PASS_THROUGH: on x86-64 ELF targets unmocked functions are counted and jump straight to the original, so
+// code running against the mockable lib keeps close to its real cost. Not set by default
+// MOCK_FILE_TRACE: every call is recorded when the runner is given --trace <directory>, which gets a Chrome trace
+// event file per test. Needs a C mock file and takes precedence over MOCK_FILE_PASS_THROUGH
+// MOCK_FILE_LATENCY: wrappers time every call into a log2 histogram per function, each test prints the call counts
+// and p50/p99 latencies when it ends. Needs a C mock file and takes precedence over MOCK_FILE_PASS_THROUGH
+enum MockFileOption
+{
+  MOCK_FILE_DEFAULT = 0,
+  MOCK_FILE_PASS_THROUGH = 0b0010,
+  MOCK_FILE_TRACE = 0b0100,
+  MOCK_FILE_LATENCY = 0b1000
 };
 
+int mockFileOptions = MOCK_FILE_DEFAULT;
+
 void _ignore();
+void _restoreMocks(int count);
+void _startTrace(char* path, int testIndex);
+bool _startProfiler(char* path);
+void _startAllocationTracking(char* context, char* description);
+void _nameLatencySummary(char* context, char* description);
+void _startVirtualClock();
+void _stopVirtualClock();
+void _resetMemoryFiles();
+void _restoreRuntimeMocks(int count);
+unsigned long long _monotonicTime();
+unsigned long long _currentThreadId();
+void* _startThreads(int count, void (*job)(void* data, int index), void* data, int* startedCount);
+void _joinThreads(void* threads, int count);
+void _exitThread();
 void _defaultTestPass();
 void _defaultFailure(char* file, int line, char* expr);
 
@@ -558,31 +1190,20 @@ void (*onRaise)(int) = (void(*)(int))_ignore;
 int __numArgsCopy;
 char** _argsCopy;
 char* _sourceFile;
+int _mockChangesCount = 0;
+int _runtimeMocksCount = 0;
 TestEnvironment* testEnv = 0;
-extern FunctionMock _mocks[];
+// Nonzero while the framework allocates for itself inside a test, so allocation tracking leaves it out
+_BTR_THREAD_LOCAL int _untrackedAllocations = 0;
+_TestOptions _testOptions = {0};
+int (*_allTestsFunction)() = 0;
+_StressTest _stressTest = {0};
+// Index of the thread running the body of a stress test, -1 outside of one. Threads other than 0 only run that body
+_BTR_THREAD_LOCAL int _stressThread = -1;
+unsigned long long _failingThread = 0;
+extern MockTable _mocks;
 
-void _snapShotGlobalMocks()
-{
-  if(!testEnv->globalContext.mocksPointer || testEnv->globalContext.mocksSnapshot) return;
-  int count = 0;  
-  while(testEnv->globalContext.mocksPointer[count].set){count++;}
-  count++;
-  testEnv->globalContext.mocksSnapshot = (void**)malloc(sizeof(void*)*(count));
-  for(int i = 0; i < count-1; i++)
-    testEnv->globalContext.mocksSnapshot[i] = *((void**)testEnv->globalContext.mocksPointer[i].mockPointer);
-}
-
-void _recoverGlobalMocksSnapShot()
-{
-  if(!testEnv->globalContext.mocksSnapshot || !testEnv->globalContext.mocksPointer) return;
-  int count = 0;  
-  while(testEnv->globalContext.mocksPointer[count].set){count++;}
-  count++;
-  for(int i = 0; i < count-1; i++)
-    *((void**)testEnv->globalContext.mocksPointer[i].mockPointer) = testEnv->globalContext.mocksSnapshot[i];
-}
-
-void _maybeSetGlobalContext()
+void _maybeSetGlobalContext()
 {
   if(!testEnv->globalContext.set)
   {
@@ -593,12 +1214,14 @@ void _maybeSetGlobalContext()
     testEnv->globalContext.onTestPass = onTestPass;
     testEnv->globalContext.onRaise = onRaise;
 
-    _snapShotGlobalMocks();
+    testEnv->globalContext.mockChangesCount = _mockChangesCount;
+    testEnv->globalContext.runtimeMocksCount = _runtimeMocksCount;
   }
 }
 
 void _setContext(char* contextName)
 {
+  if(_stressThread > 0) return;
   _maybeSetGlobalContext();
   setupFunction = testEnv->globalContext.setupFunction;
   cleanFunction = testEnv->globalContext.cleanFunction;
@@ -606,7 +1229,8 @@ void _setContext(char* contextName)
   onTestPass = testEnv->globalContext.onTestPass;
   onRaise = testEnv->globalContext.onRaise;
   testEnv->_candidateContext = contextName;
-  _recoverGlobalMocksSnapShot();
+  _restoreMocks(testEnv->globalContext.mockChangesCount);
+  _restoreRuntimeMocks(testEnv->globalContext.runtimeMocksCount);
 }
 
 void _initializeTest(int index, int line, char* description)
@@ -616,6 +1240,10 @@ void _initializeTest(int index, int line, char* description)
   testEnv->testDescription = description;
   testEnv->testLine = __LINE__;
   testEnv->testContext = testEnv->_candidateContext;
+  _startAllocationTracking(testEnv->testContext, description);
+  _nameLatencySummary(testEnv->testContext, description);
+  _startVirtualClock();
+  _resetMemoryFiles();
 }
 
 char** _copyArgs(int numArgs, char** args)
@@ -649,7 +1277,7 @@ void _ignore(){}
 bool _shouldRunTest(int index, int line, char* context)
 {
   int mode = testEnv->selection.mode;
-  if(mode == _TEST_SELECT_MODE_NONE) return false;
+  if(mode == _TEST_SELECT_MODE_NONE || _stressThread > 0) return false;
   if(!((mode & _TEST_SELECT_MODE_INDEX) || (mode & _TEST_SELECT_MODE_LINE)))
     return false;
   if((mode & _TEST_SELECT_MODE_INDEX) && index != testEnv->selection.index)
@@ -665,13 +1293,21 @@ bool _shouldRunTest(int index, int line, char* context)
 void _defaultTestPass()
 {
   printf(".");
+  _stopVirtualClock();
   cleanFunction();
 }
 
 void _defaultFailure(char* file, int line, char* expr)
 {
-  printf("\n[FAIL] on \"%s\" test \"%s\" failed %s:%i (%s)\n", testEnv->testContext, testEnv->testDescription, file, line, expr);
+  // Only the first thread to fail reports, the others stop where they are while it exits
+  unsigned long long thread = _currentThreadId();
+  unsigned long long failing = __sync_val_compare_and_swap(&_failingThread, 0, thread);
+  if(failing != 0 && failing != thread) _exitThread();
+  printf("\n[FAIL] on \"%s\" test \"%s\" failed %s:%i (%s)", testEnv->testContext, testEnv->testDescription, file, line, expr);
+  if(_stressThread >= 0) printf(" on stress thread %i", _stressThread);
+  printf("\n");
   
+  _stopVirtualClock();
   void (*noLoopClean)() = cleanFunction;
   cleanFunction = _ignore;
   noLoopClean();
@@ -700,6 +1336,243 @@ void _assert(char* file, int line, bool assertion, char* expr)
   if(!assertion) onFail(file, line, expr);
 }
 
+_TimingRun _startTiming()
+{
+  _TimingRun run = {0};
+  run.batchSize = 1;
+  run.batchStart = _monotonicTime();
+  return run;
+}
+
+// Ends the batch that just ran and tells whether another one is needed. Batches double in size until one lasts
+// _TIMING_MIN_BATCH_NS, which also warms up caches and branch predictors, then _TIMING_SAMPLES batches are measured
+bool _nextTimingBatch(_TimingRun* run)
+{
+  unsigned long long elapsed = _monotonicTime() - run->batchStart;
+  if(!run->calibrated)
+  {
+    if(elapsed >= _TIMING_MIN_BATCH_NS || run->batchSize >= (1 << 24)) run->calibrated = true;
+    else run->batchSize *= 2;
+  }
+  else
+    run->samples[run->sampleCount++] = elapsed/run->batchSize;
+  run->batchStart = _monotonicTime();
+  return run->sampleCount < _TIMING_SAMPLES;
+}
+
+int _compareTimingSamples(const void* a, const void* b)
+{
+  unsigned long long sampleA = *(const unsigned long long*)a, sampleB = *(const unsigned long long*)b;
+  return sampleA < sampleB ? -1 : sampleA > sampleB;
+}
+
+// Compares the median sample with the budget, failing with the measured distribution
+void _assertTiming(char* file, int line, _TimingRun* run, unsigned long long budget, char* expr)
+{
+  qsort(run->samples, _TIMING_SAMPLES, sizeof(unsigned long long), _compareTimingSamples);
+  unsigned long long median = run->samples[_TIMING_SAMPLES/2];
+  if(median <= budget) return;
+  static char message[1024];
+  snprintf(message, sizeof(message), "%.700s took %lluns, budget %lluns (min %llu, p25 %llu, median %llu, p75 %llu, max %llu ns "
+    "over %i samples of %i runs)", expr, median, budget, run->samples[0], run->samples[_TIMING_SAMPLES/4], median,
+    run->samples[_TIMING_SAMPLES*3/4], run->samples[_TIMING_SAMPLES - 1], _TIMING_SAMPLES, run->batchSize);
+  onFail(file, line, message);
+}
+
+// Offset of the first differing byte of two buffers, or size when they are equal
+size_t _firstMismatch(const unsigned char* a, const unsigned char* b, size_t size)
+{
+  size_t offset = 0;
+#ifdef __SSE2__
+  for(; offset + 64 <= size; offset += 64)
+  {
+    __m128i equal = _mm_and_si128(
+      _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + offset)), _mm_loadu_si128((const __m128i*)(b + offset))),
+        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + offset + 16)), _mm_loadu_si128((const __m128i*)(b + offset + 16)))),
+      _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + offset + 32)), _mm_loadu_si128((const __m128i*)(b + offset + 32))),
+        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + offset + 48)), _mm_loadu_si128((const __m128i*)(b + offset + 48)))));
+    if(_mm_movemask_epi8(equal) != 0xFFFF) break;
+  }
+  for(; offset + 16 <= size; offset += 16)
+  {
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + offset)), _mm_loadu_si128((const __m128i*)(b + offset))));
+    if(mask != 0xFFFF) return offset + __builtin_ctz(~mask);
+  }
+#else
+  for(; offset + 8 <= size; offset += 8)
+  {
+    unsigned long long wordA, wordB;
+    memcpy(&wordA, a + offset, 8);
+    memcpy(&wordB, b + offset, 8);
+    if(wordA != wordB) break;
+  }
+#endif
+  while(offset < size && a[offset] == b[offset]) offset++;
+  return offset;
+}
+
+// Writes the rows around the mismatch as hex, one line for each buffer
+int _writeHexWindow(char* output, int capacity, const unsigned char* a, const unsigned char* b, size_t size, size_t mismatch)
+{
+  int length = 0;
+  size_t first = mismatch/16 > 0 ? (mismatch/16 - 1)*16 : 0;
+  for(size_t row = first; row < size && row <= first + 32 && length < capacity; row += 16)
+    for(int buffer = 0; buffer < 2 && length < capacity; buffer++)
+    {
+      const unsigned char* data = buffer ? b : a;
+      if(buffer) length += snprintf(output + length, capacity - length, "\n              expected:");
+      else length += snprintf(output + length, capacity - length, "\n  0x%08llx    actual:", (unsigned long long)row);
+      for(size_t i = row; i < row + 16 && i < size && length < capacity; i++)
+        length += snprintf(output + length, capacity - length, i == mismatch ? "[%02x]" : " %02x ", data[i]);
+    }
+  return length;
+}
+
+void _assertMemEq(char* file, int line, const void* actual, const void* expected, size_t size, size_t elementSize, char* expr)
+{
+  size_t mismatch = _firstMismatch((const unsigned char*)actual, (const unsigned char*)expected, size);
+  if(mismatch == size) return;
+  static char message[4096];
+  int length = elementSize > 1 ?
+    snprintf(message, sizeof(message), "%.500s differ at element %llu (byte %llu of %llu)", expr,
+      (unsigned long long)(mismatch/elementSize), (unsigned long long)mismatch, (unsigned long long)size) :
+    snprintf(message, sizeof(message), "%.500s differ at byte %llu of %llu", expr, (unsigned long long)mismatch, (unsigned long long)size);
+  _writeHexWindow(message + length, sizeof(message) - length, (const unsigned char*)actual, (const unsigned char*)expected, size, mismatch);
+  onFail(file, line, message);
+}
+
+// Index of the first pair of floats or doubles further apart than the tolerance, or count when there is none
+size_t _firstFarElement(const void* a, const void* b, size_t count, size_t elementSize, double tolerance)
+{
+  size_t index = 0;
+#ifdef __SSE2__
+  if(elementSize == sizeof(float))
+  {
+    __m128 limit = _mm_set1_ps((float)tolerance), absolute = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    for(; index + 4 <= count; index += 4)
+    {
+      __m128 difference = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps((const float*)a + index), _mm_loadu_ps((const float*)b + index)), absolute);
+      if(_mm_movemask_ps(_mm_cmple_ps(difference, limit)) != 0xF) break;
+    }
+  }
+  else
+  {
+    __m128d limit = _mm_set1_pd(tolerance), absolute = _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+    for(; index + 2 <= count; index += 2)
+    {
+      __m128d difference = _mm_and_pd(_mm_sub_pd(_mm_loadu_pd((const double*)a + index), _mm_loadu_pd((const double*)b + index)), absolute);
+      if(_mm_movemask_pd(_mm_cmple_pd(difference, limit)) != 0x3) break;
+    }
+  }
+#endif
+  for(; index < count; index++)
+  {
+    // Equal infinities are near, though their difference is NaN
+    if(memcmp((const char*)a + index*elementSize, (const char*)b + index*elementSize, elementSize) == 0) continue;
+    double valueA = elementSize == sizeof(float) ? ((const float*)a)[index] : ((const double*)a)[index];
+    double valueB = elementSize == sizeof(float) ? ((const float*)b)[index] : ((const double*)b)[index];
+    // Written so that NaN never counts as near
+    if(!(valueA - valueB <= tolerance && valueB - valueA <= tolerance)) break;
+  }
+  return index;
+}
+
+// Element types of assert_array_near, taken from the type of the arrays as other types have the same sizes
+enum _ArrayNearType
+{
+  _ARRAY_NEAR_UNSUPPORTED = 0,
+  _ARRAY_NEAR_FLOAT,
+  _ARRAY_NEAR_DOUBLE
+};
+
+#ifdef __cplusplus
+extern "C++"
+{
+int _arrayNearType(const float* array){ return _ARRAY_NEAR_FLOAT; }
+int _arrayNearType(const double* array){ return _ARRAY_NEAR_DOUBLE; }
+template<typename Type> int _arrayNearType(const Type* array){ return _ARRAY_NEAR_UNSUPPORTED; }
+}
+#else
+#define _arrayNearType(array) _Generic(*(array), float: _ARRAY_NEAR_FLOAT, double: _ARRAY_NEAR_DOUBLE,\
+  default: _ARRAY_NEAR_UNSUPPORTED)
+#endif
+
+void _assertArrayNear(char* file, int line, const void* actual, const void* expected, size_t count, int actualType,
+  int expectedType, double tolerance, char* expr)
+{
+  if(actualType == _ARRAY_NEAR_UNSUPPORTED || actualType != expectedType)
+  {
+    onFail(file, line, _C_STRING_LITERAL("assert_array_near needs two float or two double arrays"));
+    return;
+  }
+  size_t elementSize = actualType == _ARRAY_NEAR_FLOAT ? sizeof(float) : sizeof(double);
+  size_t mismatch = _firstFarElement(actual, expected, count, elementSize, tolerance);
+  if(mismatch == count) return;
+  static char message[4096];
+  int length = snprintf(message, sizeof(message), "%.500s differ by more than %g at element %llu of %llu", expr, tolerance,
+    (unsigned long long)mismatch, (unsigned long long)count);
+  size_t first = mismatch > 3 ? mismatch - 3 : 0;
+  for(size_t i = first; i < count && i <= mismatch + 3 && length < (int)sizeof(message); i++)
+  {
+    double valueA = elementSize == sizeof(float) ? ((const float*)actual)[i] : ((const double*)actual)[i];
+    double valueB = elementSize == sizeof(float) ? ((const float*)expected)[i] : ((const double*)expected)[i];
+    length += snprintf(message + length, sizeof(message) - length, "\n  %s[%llu] actual %.9g expected %.9g",
+      i == mismatch ? ">" : " ", (unsigned long long)i, valueA, valueB);
+  }
+  onFail(file, line, message);
+}
+
+void _stressWorker(void* data, int index)
+{
+  _stressThread = index;
+  _allTestsFunction();
+}
+
+bool _shouldRunStressTest(int index, int line, char* description, int threadCount, long long iterations)
+{
+  if(_stressThread > 0) return index == _stressTest.testIndex;
+  if(!_shouldRunTest(index, line, testEnv->_candidateContext)) return false;
+  _initializeTest(index, line, description);
+  setupFunction();
+  _stressTest.testIndex = index;
+  _stressTest.threadCount = threadCount > 0 ? threadCount : 1;
+  _stressTest.iterations = iterations;
+  _stressTest.arrived = 0;
+  _stressTest.elapsed = (unsigned long long*)calloc(_stressTest.threadCount, sizeof(unsigned long long));
+  _stressThread = 0;
+  int started;
+  _stressTest.threads = _startThreads(_stressTest.threadCount, _stressWorker, 0, &started);
+  // Threads that could not start are counted as arrived so the others are not kept waiting
+  __sync_fetch_and_add(&_stressTest.arrived, _stressTest.threadCount - started);
+  return true;
+}
+
+// Waits for every thread to arrive so the iterations overlap as much as possible
+long long _startStress()
+{
+  __sync_fetch_and_add(&_stressTest.arrived, 1);
+  while(__sync_fetch_and_add(&_stressTest.arrived, 0) < _stressTest.threadCount);
+  _stressTest.elapsed[_stressThread] = _monotonicTime();
+  return 0;
+}
+
+// Ends the stress test body of a thread. Thread 0 waits for the others and prints their throughput
+bool _endStress()
+{
+  _stressTest.elapsed[_stressThread] = _monotonicTime() - _stressTest.elapsed[_stressThread];
+  if(_stressThread > 0) _exitThread();
+  _joinThreads(_stressTest.threads, _stressTest.threadCount);
+  printf("\n[STRESS] on \"%s\" test \"%s\" %i threads x %lli iterations\n", testEnv->testContext, testEnv->testDescription,
+    _stressTest.threadCount, _stressTest.iterations);
+  for(int i = 0; i < _stressTest.threadCount; i++)
+    printf("  thread %i: %.0f iterations/s (%.3f ms)\n", i, _stressTest.elapsed[i] ? _stressTest.iterations*1e9/_stressTest.elapsed[i] : 0.0,
+      _stressTest.elapsed[i]/1e6);
+  free(_stressTest.elapsed);
+  _stressTest.elapsed = 0;
+  _stressThread = -1;
+  return false;
+}
+
 _TestSelect _getArgsSelection(int numArgs, char** args)
 {
   _TestSelect ret = {0};
@@ -723,6 +1596,30 @@ _TestSelect _getArgsSelection(int numArgs, char** args)
       }
       i++;
     }
+    else if(strcmp(args[i], "--trace") == 0)
+    {
+      if(i+1 < numArgs) _testOptions.tracePath = args[i+1];
+      i++;
+    }
+    else if(strcmp(args[i], "--profile") == 0)
+    {
+      if(i+1 < numArgs) _testOptions.profilePath = args[i+1];
+      i++;
+    }
+    else if(strcmp(args[i], "--fuzz") == 0)
+    {
+      if(i+1 < numArgs) _testOptions.fuzzRuns = strtoll(args[i+1], 0, 10);
+      i++;
+    }
+    else if(strcmp(args[i], "--seed") == 0)
+    {
+      if(i+1 < numArgs)
+      {
+        _testOptions.hasSeed = true;
+        _testOptions.seed = strtoull(args[i+1], 0, 10);
+      }
+      i++;
+    }
     else if(strcmp(args[i], "--line") == 0)
     {
       if(i+1 < numArgs)
@@ -840,8 +1737,16 @@ int runTestsForFile(int numArgs, char** args, char* file)
     sprintf(fixedParams, " --line %i", selection.line);
   if((selection.mode & _TEST_SELECT_MODE_MODULE))
     sprintf(fixedParams + strlen(fixedParams), " --module \"%s\"", selection.name);
-
-  char program[(strlen(file)+64)*4];
+  if(_testOptions.tracePath && strlen(_testOptions.tracePath) < 256)
+    sprintf(fixedParams + strlen(fixedParams), " --trace \"%s\"", _testOptions.tracePath);
+  if(_testOptions.profilePath && strlen(_testOptions.profilePath) < 256)
+    sprintf(fixedParams + strlen(fixedParams), " --profile \"%s\"", _testOptions.profilePath);
+  if(_testOptions.hasSeed)
+    sprintf(fixedParams + strlen(fixedParams), " --seed %llu", _testOptions.seed);
+  if(_testOptions.fuzzRuns > 0)
+    sprintf(fixedParams + strlen(fixedParams), " --fuzz %lli", _testOptions.fuzzRuns);
+
+  char program[strlen(file) + sizeof(fixedParams) + 64];
   strcpy(program, file);
   int count = _doRunTest(program);
   for(int j = 0; j < count; j++)
@@ -880,230 +1785,3184 @@ int runAllTests(int numArgs, char** args)
   return failures;
 }
 
+// Names the file a test process writes in a directory given to the runner: <directory>/<test file>.<index>.<extension>
+char* _testOutputPath(char* directory, int testIndex, const char* extension)
+{
+  char* sourceName = _sourceFile;
+  for(char* c = _sourceFile; *c; c++)
+    if(*c == '/' || *c == '\\') sourceName = c + 1;
+  char* path = (char*)malloc(strlen(directory) + strlen(sourceName) + strlen(extension) + 32);
+  sprintf(path, "%s/%s.%i.%s", directory, sourceName, testIndex, extension);
+  return path;
+}
+
 int _testFileMain(int numArgs, char** args, int (*_allTests)())
 {
   args = _copyArgs(numArgs, args);
   TestEnvironment _testEnv;
   testEnv = &_testEnv;
-  void** snapShot;
 
   int signals[] = {SIGABRT, SIGFPE, SIGILL, SIGINT, SIGSEGV, SIGTERM};
   for(unsigned int i = 0; i < sizeof(signals)/sizeof(int); i++)
     signal(signals[i], _defaultRaiseHandler);
 
+  _allTestsFunction = _allTests;
   _testEnv = (TestEnvironment){0};
   _testEnv._helperBlockIndex = &_testEnv.helperMemoryBlock[0];
   _testEnv.testContext = _C_STRING_LITERAL("global");
   _testEnv.testDescription = _C_STRING_LITERAL("setup");
   int _testCount = _allTests();
-  _recoverGlobalMocksSnapShot();
-  snapShot = _testEnv.globalContext.mocksSnapshot;
-  if(snapShot) free(snapShot);
+  _restoreMocks(0);
+  _restoreRuntimeMocks(0);
   
   _testEnv = (TestEnvironment){0};
   _testEnv._helperBlockIndex = &_testEnv.helperMemoryBlock[0];
   _testEnv.testContext = _C_STRING_LITERAL("global");
   _testEnv.testDescription = _C_STRING_LITERAL("setup");
   _testEnv.selection = _getArgsSelection(numArgs, args);
+  if(_testOptions.tracePath && (_testEnv.selection.mode & _TEST_SELECT_MODE_INDEX))
+    _startTrace(_testOutputPath(_testOptions.tracePath, _testEnv.selection.index, "trace.json"), _testEnv.selection.index);
+  if(_testOptions.profilePath && (_testEnv.selection.mode & _TEST_SELECT_MODE_INDEX))
+    _startProfiler(_testOutputPath(_testOptions.profilePath, _testEnv.selection.index, "folded"));
   _allTests();
-  snapShot = _testEnv.globalContext.mocksSnapshot;
-  if(snapShot) free(snapShot);
 
   _freeArgsCopy();
   
   return _testCount;
 }
 // This content is part of test.h
-// Mock functionalities
+// Property based tests: the body runs in process over generated inputs, drawn inside it with the any* functions.
+// Every drawn value comes from a sequence of choices, a failing sequence is shrunk by deleting and lowering choices
+// while the body keeps failing, so the reported counterexample is small
+
+#define _PROPERTY_MAX_CHOICES 4096
+#define _PROPERTY_MAX_SHRINKS 10000
 
-int _writeArgs(FILE* file, char* args)
+enum _PropertyPhase
 {
-  int argsCount = 0;
-  int argsSize = strlen(args);
-  char arg[argsSize + 1];
-  int a = 0;
-  for(int i = 0; i <= argsSize; i++)
-  {
-    if((!isspace(args[i]) || a) || !args[i])
-    {
-      if(args[i] == '\0' || args[i] == ',')
-      {
-        if(a > 0)
-        {
-          arg[a] = '\0';
-          if(argsCount > 0) fprintf(file, ",");
-          if(arg[0] != '.') fprintf(file, "%s a%i", arg, argsCount++);
-          else fprintf(file, "%s", arg);
-        }
-        a = 0;
-      }
-      else
-        arg[a++] = args[i];
-    }
-  }
-  return argsCount;
+  _PROPERTY_GENERATING,
+  _PROPERTY_SHRINKING,
+  _PROPERTY_DONE
+};
+
+enum _PropertyShrink
+{
+  _PROPERTY_SHRINK_DELETE,
+  _PROPERTY_SHRINK_ZERO,
+  _PROPERTY_SHRINK_HALVE,
+  // The lowest bit is the sign of anyInt values, these lower the magnitude without flipping it
+  _PROPERTY_SHRINK_HALVE_KEEPING_SIGN,
+  _PROPERTY_SHRINK_DECREMENT_KEEPING_SIGN,
+  _PROPERTY_SHRINK_DECREMENT,
+  _PROPERTY_SHRINK_KINDS
+};
+
+typedef struct
+{
+  _BTR_JMP_BUF jump;
+  int phase;
+  int iterations;
+  int iteration;
+  int line;
+  bool ran;
+  int mockChangesCount, runtimeMocksCount;
+  unsigned long long seed;
+  unsigned long long random;
+  void (*onFail)(char* file, int line, char* expr);
+  // Choices of the running case, replayed up to choiceCount and drawn past it
+  unsigned long long choices[_PROPERTY_MAX_CHOICES];
+  long long values[_PROPERTY_MAX_CHOICES];
+  int choiceCount, drawn, valueCount;
+  bool failed;
+  char* failFile;
+  int failLine;
+  char* failExpr;
+  // Smallest failing case found so far
+  unsigned long long best[_PROPERTY_MAX_CHOICES];
+  long long bestValues[_PROPERTY_MAX_CHOICES];
+  int bestCount, bestValueCount;
+  char* bestFile;
+  int bestLine;
+  char* bestExpr;
+  int shrinkIndex, shrinkKind, shrinks, shrinkRuns;
+  bool improved;
+} _Property;
+
+_Property _property;
+
+// splitmix64, the state is the seed and goes on from there
+unsigned long long _nextRandom(unsigned long long* state)
+{
+  unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27))*0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
 }
 
-void _getMockedName(char* output, char* functioName)
+// Fails the running case, jumping back to the property loop
+void _propertyFailure(char* file, int line, char* expr)
 {
-  strcpy(output, "🐛");
-  strcat(output, functioName);
-  strcat(output, "🚀");
+  _property.failed = true;
+  _property.failFile = file;
+  _property.failLine = line;
+  _property.failExpr = expr;
+  _btrLongjmp(_property.jump);
 }
 
-FunctionMock* _getMock(char* file, int line, char* functionName, FunctionMock* mocks)
+void _startProperty(int line, int iterations)
 {
-  if(!testEnv->globalContext.mocksSnapshot)
-  {
-    testEnv->globalContext.mocksPointer = mocks;
-    if(testEnv->globalContext.set)
-      _snapShotGlobalMocks();
-  }
-  
-  FunctionMock* mock = 0;
-  for(int i = 0; mocks[i].set; i++)
+  _property.line = line;
+  _property.ran = false;
+  _property.mockChangesCount = _mockChangesCount;
+  _property.runtimeMocksCount = _runtimeMocksCount;
+  _property.phase = _PROPERTY_GENERATING;
+  _property.iterations = iterations > 0 ? iterations : 1;
+  _property.iteration = -1;
+  _property.seed = _testOptions.hasSeed ? _testOptions.seed : _monotonicTime();
+  _property.random = _property.seed;
+  _property.onFail = onFail;
+  _property.failed = false;
+}
+
+// Every case starts like a test, with the mocks of its context and a fresh setup
+void _startPropertyCase(int choiceCount)
+{
+  if(_property.ran)
   {
-    if(strcmp(mocks[i].name, functionName) == 0)
-    {
-      mock = &mocks[i];
-      break;
-    }
+    cleanFunction();
+    setupFunction();
   }
-
-  char message[_BTR_MAX_NAME_SIZE];
-  strcpy(message, "Could not mock function ");
-  strcat(message, functionName);
-  if(!mock) onFail(file, line, message);
-
-  return mock;
+  _property.ran = true;
+  _property.choiceCount = choiceCount;
+  _property.drawn = 0;
+  _property.valueCount = 0;
+  _property.failed = false;
+  onFail = _propertyFailure;
 }
 
-void _mock(char* file, int line, char* functionName, void* function, FunctionMock* mocks)
+void _keepPropertyFailure()
 {
-  FunctionMock* mock = _getMock(file, line, functionName, mocks);
-  if(mock) *((void**)mock->mockPointer) = function;
+  memcpy(_property.best, _property.choices, _property.drawn*sizeof(unsigned long long));
+  memcpy(_property.bestValues, _property.values, _property.valueCount*sizeof(long long));
+  _property.bestCount = _property.drawn;
+  _property.bestValueCount = _property.valueCount;
+  _property.bestFile = _property.failFile;
+  _property.bestLine = _property.failLine;
+  _property.bestExpr = _property.failExpr;
 }
 
-void _mockReset(char* file, int line, char* functionName, FunctionMock* mocks)
+// Cases only get replaced by shorter ones, or by ones as long and with lower choices, so shrinking always ends
+bool _isSmallerPropertyCase()
 {
-  FunctionMock* mock = _getMock(file, line, functionName, mocks);
-  if(mock) *((void**)mock->mockPointer) = mock->original;
+  if(_property.drawn != _property.bestCount) return _property.drawn < _property.bestCount;
+  for(int i = 0; i < _property.drawn; i++)
+    if(_property.choices[i] != _property.best[i]) return _property.choices[i] < _property.best[i];
+  return false;
 }
 
-bool _createMockFile(char* mockFilePath, int functionCount, FunctionDescriptor* functions)
+// Writes into the choices the next variation of the best failing case, returns false when all have been tried
+bool _nextPropertyShrink()
 {
-  FILE* file = fopen(mockFilePath, "wb");
-  if(!file) return false;
+  for(; _property.shrinkIndex < _property.bestCount; _property.shrinkIndex++, _property.shrinkKind = 0)
+    for(; _property.shrinkKind < _PROPERTY_SHRINK_KINDS; _property.shrinkKind++)
+    {
+      int index = _property.shrinkIndex, count = _property.bestCount;
+      unsigned long long value = _property.best[index];
+      if(_property.shrinkKind != _PROPERTY_SHRINK_DELETE && value == 0) continue;
+      memcpy(_property.choices, _property.best, count*sizeof(unsigned long long));
+      switch(_property.shrinkKind)
+      {
+        case _PROPERTY_SHRINK_DELETE:
+          memmove(_property.choices + index, _property.choices + index + 1, (count - index - 1)*sizeof(unsigned long long));
+          count--;
+          break;
+        case _PROPERTY_SHRINK_ZERO: _property.choices[index] = 0; break;
+        case _PROPERTY_SHRINK_HALVE: _property.choices[index] = value/2; break;
+        case _PROPERTY_SHRINK_HALVE_KEEPING_SIGN: _property.choices[index] = ((value/2) & ~1ULL) | (value & 1); break;
+        case _PROPERTY_SHRINK_DECREMENT_KEEPING_SIGN: _property.choices[index] = value >= 2 ? value - 2 : value; break;
+        case _PROPERTY_SHRINK_DECREMENT: _property.choices[index] = value - 1; break;
+      }
+      if(_property.shrinkKind != _PROPERTY_SHRINK_DELETE && _property.choices[index] == value) continue;
+      _startPropertyCase(count);
+      return true;
+    }
+  return false;
+}
 
-  fprintf(file, "// This file was generated by BugTestsRocket test framework\n");
-  fprintf(file, "// Link it when building your tests for implementing the mocks\n");
-  fprintf(file, "#ifdef __cplusplus\nextern \"C\"{\n"
-                "#define _BTR_CONVERT(what, to) reinterpret_cast<to>(what)\n"
-                "#else\n"
-                "#define _BTR_CONVERT(what, to) ((to)(what))\n"
-                "#endif\n");
-  fprintf(file, "#include <stdbool.h>\n");
-  fprintf(file, "typedef struct {bool set; int calls; void* mockPointer; const char* name; void* original; } FunctionMock;\n");
-  fprintf(file, "extern FunctionMock _mocks[];\n");
+void _reportPropertyFailure()
+{
+  static char message[2048];
+  int length = snprintf(message, sizeof(message), "%.500s with seed %llu, case %i shrunk %i times to", _property.bestExpr,
+    _property.seed, _property.iteration, _property.shrinks);
+  for(int i = 0; i < _property.bestValueCount && length < (int)sizeof(message) - 32; i++)
+    length += snprintf(message + length, sizeof(message) - length, "%s %lli", i ? "," : "", _property.bestValues[i]);
+  if(_property.bestValueCount == 0) snprintf(message + length, sizeof(message) - length, " no values");
+  _property.phase = _PROPERTY_DONE;
+  _property.onFail(_property.bestFile, _property.bestLine, message);
+}
 
-  for(int i = 0; i < functionCount; i++)
+// Decides what the body runs with next, from the outcome of the last case. Returns false once the property is done
+bool _nextPropertyCase()
+{
+  onFail = _property.onFail;
+  _restoreMocks(_property.mockChangesCount);
+  _restoreRuntimeMocks(_property.runtimeMocksCount);
+  if(_property.phase == _PROPERTY_GENERATING)
   {
-    char mockedName[_BTR_MAX_NAME_SIZE];
-    _getMockedName(mockedName, functions[i].name);
-    char* implementation = _C_STRING_LITERAL(";");
-    if(functions[i].implementation) implementation = functions[i].implementation;
-    fprintf(file, "%s %s(%s)%s\n", functions[i].returnType, mockedName, functions[i].args, implementation);
-    fprintf(file, "void* _mocked_%s = _BTR_CONVERT(%s, void*);\n", functions[i].name, mockedName);
+    if(_property.failed)
+    {
+      _keepPropertyFailure();
+      _property.phase = _PROPERTY_SHRINKING;
+      _property.shrinkIndex = _property.shrinkKind = _property.shrinks = _property.shrinkRuns = 0;
+      _property.improved = false;
+    }
+    else if(++_property.iteration < _property.iterations)
+    {
+      _startPropertyCase(0);
+      return true;
+    }
+    else
+    {
+      _property.phase = _PROPERTY_DONE;
+      return false;
+    }
   }
-  for(int i = 0; i < functionCount; i++)
+  else if(_property.phase == _PROPERTY_SHRINKING)
   {
-    fprintf(file, "%s %s(", functions[i].returnType, functions[i].name);
-    int argsCount = _writeArgs(file, functions[i].args);
-    fprintf(file, "){ _mocks[%i].calls++; return _BTR_CONVERT(_mocked_%s, %s (*)(%s))(",
-      i, functions[i].name, functions[i].returnType, functions[i].args);
-    for(int a = 0; a < argsCount; a++)
-      if(a)
-        fprintf(file, ", a%i", a);
-      else
-        fprintf(file, "a%i", a);
-    fprintf(file, "); }\n");
+    // Stays on the same variation after a success, so repeated halving works as a search
+    if(_property.failed && _isSmallerPropertyCase())
+    {
+      _keepPropertyFailure();
+      _property.shrinks++;
+      _property.improved = true;
+    }
+    else
+      _property.shrinkKind++;
   }
-  fprintf(file, "FunctionMock _mocks[] = {\n");
-  for(int i = 0; i < functionCount; i++)
+  if(_property.phase != _PROPERTY_SHRINKING) return false;
+
+  while(_property.shrinkRuns < _PROPERTY_MAX_SHRINKS)
   {
-    char mockedName[_BTR_MAX_NAME_SIZE];
-    _getMockedName(mockedName, functions[i].name);
-    fprintf(file, "  {true, (int)0, (void*)&_mocked_%s, \"%s\", _BTR_CONVERT(%s, void*)},\n", functions[i].name, functions[i].name, mockedName);
+    if(_nextPropertyShrink())
+    {
+      _property.shrinkRuns++;
+      return true;
+    }
+    if(!_property.improved) break;
+    _property.improved = false;
+    _property.shrinkIndex = _property.shrinkKind = 0;
   }
-  fprintf(file, "  {false, (int)0, (void*)0, \"\", (void*)0}\n};\n");
-  fprintf(file, "#ifdef __cplusplus\n}\n#endif\n"); 
-
-  fclose(file);
-  return true;
+  _reportPropertyFailure();
+  return false;
 }
 
-bool createMocks(char* libPath, char* mockableLibPath, char* mockFilePath, int functionCount, FunctionDescriptor* functions)
+// The next choice: replayed while shrinking, random while generating, mostly small but covering every bit width
+unsigned long long _propertyChoice()
 {
-  bool ret = true;
- 
-  _StaticLib lib;
-
-  if(_staticLibRead(&lib, libPath))
+  if(_property.drawn >= _PROPERTY_MAX_CHOICES)
+  {
+    // Can not be shrunk or replayed, so the property fails as a whole
+    _property.phase = _PROPERTY_DONE;
+    onFail = _property.onFail;
+    onFail(_sourceFile, _property.line, _C_STRING_LITERAL("a case of the property drew more than 4096 choices"));
+    _btrLongjmp(_property.jump);
+  }
+  if(_property.drawn >= _property.choiceCount)
   {
-    for(int f = 0; f < functionCount; f++)
+    unsigned long long choice = 0;
+    if(_property.phase == _PROPERTY_GENERATING)
     {
-      char mockedName[strlen(functions[f].name)+64];
-      _getMockedName(mockedName, functions[f].name);
-    
-      for(int i = 0; i < lib.header.globalSymbolCount; i++)
-        if(strcmp(lib.globalSymbols[i].name, functions[f].name) == 0)
-          strcpy(lib.globalSymbols[i].name, mockedName);
-    
-      for(int i = 0; i < lib.fileCount; i++)
-      {
-        if(memcmp(lib.files[i].fileInfo, "//", 2) != 0)
-          if(!_objectFileMockFunction(&lib.files[i], functions[f].name, mockedName))
-              printf("Could not mock object file %s. Supported formats are ELF64. Symbols must be relocatable. Maybe try adding --fPIC to your compiler flags?\n",
-                    lib.files[i].fileInfo);
-      }
+      int bits = (int)(_nextRandom(&_property.random) % 65);
+      choice = bits == 64 ? _nextRandom(&_property.random) : _nextRandom(&_property.random) & ((1ULL << bits) - 1);
     }
-    
-    ret = _staticLibWrite(&lib, mockableLibPath);
-    ret &= _createMockFile(mockFilePath, functionCount, functions);
+    _property.choices[_property.choiceCount++] = choice;
   }
-  else
-    ret = false;
+  return _property.choices[_property.drawn++];
+}
 
-  _staticLibFree(&lib);
+long long _propertyValue(long long value)
+{
+  if(_property.valueCount < _PROPERTY_MAX_CHOICES) _property.values[_property.valueCount++] = value;
+  return value;
+}
 
-  return ret;
+// An int, shrinking towards 0 through a zigzag mapping of the choice: 0, -1, 1, -2, 2...
+int anyInt()
+{
+  unsigned int choice = (unsigned int)_propertyChoice();
+  return (int)_propertyValue((int)((choice >> 1) ^ (0u - (choice & 1))));
+}
+
+// A value from min to max, both included, shrinking towards min
+long long anyIntBetween(long long min, long long max)
+{
+  unsigned long long range = (unsigned long long)max - (unsigned long long)min + 1;
+  unsigned long long choice = _propertyChoice();
+  return _propertyValue((long long)((unsigned long long)min + (range ? choice % range : choice)));
+}
+
+bool anyBool()
+{
+  return (bool)_propertyValue(_propertyChoice() & 1);
+}
+
+// Fills a buffer with random bytes, shrinking towards zeros. Each byte is a choice, a case fails past 4096 of them
+void anyBytes(void* buffer, int size)
+{
+  for(int i = 0; i < size; i++)
+    ((unsigned char*)buffer)[i] = (unsigned char)(_propertyChoice() & 0xFF);
 }
 // This content is part of test.h
-// Platform specific functions
+// Fuzz targets: the body runs in process for every input, reading it from fuzzData and fuzzSize.
+// A normal run replays the inputs saved in <fuzzInputsPath>/<test file>.<target name>/, --fuzz RUNS mutates them
+// for that many runs, keeping the ones that reach new code when built with -fsanitize-coverage=trace-pc-guard (clang)
+// or trace-pc (gcc). Failing inputs are saved there as crash-<hash>, so the next normal run replays them.
+// With BTR_LIBFUZZER defined the test file becomes a libFuzzer target running the fuzz target named by the
+// BTR_FUZZ_TARGET environment variable, or the first one
 
-#ifdef _WIN32
-#include <windows.h>
+#define _FUZZ_MAX_INPUT 4096
+#define _FUZZ_EDGES 65536
 
-int _listFiles(char* path, char** output)
+// Relative to the working directory of the test run
+char* fuzzInputsPath = _C_STRING_LITERAL("fuzz");
+
+enum _FuzzMode
 {
-  char basePath[MAX_PATH];
-	char wildPath[MAX_PATH];
-	int fileCount = 0;
-	WIN32_FIND_DATA ffd;
-	HANDLE hFind = INVALID_HANDLE_VALUE;
+  _FUZZ_REPLAY,
+  _FUZZ_MUTATE,
+  _FUZZ_ONE_INPUT
+};
 
-	strcpy(basePath, path);
-  if(path[strlen(path-1)] != '/')
-    strcat(basePath, "/");
-  strcpy(wildPath, basePath);
-	strcat(wildPath,"*");
+typedef struct
+{
+  unsigned char* data;
+  size_t size;
+} _FuzzInput;
 
-	int basePathLength = strlen(basePath);
-	hFind = FindFirstFile(wildPath, &ffd);
-	if (INVALID_HANDLE_VALUE == hFind)
-	  return 0;
+typedef struct
+{
+  _BTR_JMP_BUF jump;
+  int mode;
+  char* name;
+  char* directory;
+  void (*onFail)(char* file, int line, char* expr);
+  int mockChangesCount, runtimeMocksCount;
+  bool running, failed, ranEmpty;
+  char* failFile;
+  int failLine;
+  char* failExpr;
+  // The running input and the file it was read from, if any
+  unsigned char* data;
+  size_t size;
+  char* inputPath;
+  unsigned char* buffer;
+  char** files;
+  int fileCount, fileIndex;
+  _FuzzInput* corpus;
+  int corpusCount, corpusCapacity;
+  long long runs, run;
+  unsigned long long random, startTime;
+  int edgesFound;
+  // Only for libFuzzer
+  bool targetFound;
+  const char* target;
+} _Fuzz;
+
+_Fuzz _fuzz;
+bool _fuzzOneInput = false;
+
+#define fuzzData ((const unsigned char*)_fuzz.data)
+#define fuzzSize (_fuzz.size)
+
+bool _makeParentDirectories(char* path);
+
+// Code reached from the coverage callbacks or handling the edges must not be instrumented too
+#if defined(__clang__)
+#define _BTR_NO_COVERAGE __attribute__((no_sanitize("coverage")))
+#elif defined(__GNUC__) && __GNUC__ >= 12
+#define _BTR_NO_COVERAGE __attribute__((no_sanitize_coverage))
+#else
+#define _BTR_NO_COVERAGE
+#endif
 
-	do
+#ifndef BTR_LIBFUZZER
+// Edges hit by the running input, also listed so merging them does not scan the whole map
+unsigned char _fuzzEdges[_FUZZ_EDGES];
+unsigned int _fuzzHitEdges[_FUZZ_EDGES];
+int _fuzzHitCount = 0;
+unsigned char _fuzzSeenEdges[_FUZZ_EDGES];
+unsigned int _fuzzGuards = 0;
+
+_BTR_NO_COVERAGE void _hitFuzzEdge(unsigned int edge)
+{
+  if(_fuzzEdges[edge] || _fuzzHitCount >= _FUZZ_EDGES) return;
+  _fuzzEdges[edge] = 1;
+  _fuzzHitEdges[_fuzzHitCount++] = edge;
+}
+
+// Coverage callbacks of the sanitizer instrumentation
+_BTR_NO_COVERAGE void __sanitizer_cov_trace_pc_guard_init(uint32_t* start, uint32_t* stop)
+{
+  if(start == stop || *start) return;
+  for(uint32_t* guard = start; guard < stop; guard++)
+    *guard = ++_fuzzGuards;
+}
+
+_BTR_NO_COVERAGE void __sanitizer_cov_trace_pc_guard(uint32_t* guard)
+{
+  _hitFuzzEdge(*guard % _FUZZ_EDGES);
+}
+
+_BTR_NO_COVERAGE void __sanitizer_cov_trace_pc()
+{
+  uintptr_t pc = (uintptr_t)__builtin_return_address(0);
+  _hitFuzzEdge((pc ^ (pc >> 16)) % _FUZZ_EDGES);
+}
+#endif
+
+// Merges the edges of the last run, telling whether any was new
+_BTR_NO_COVERAGE bool _fuzzFoundEdges()
+{
+#ifndef BTR_LIBFUZZER
+  bool found = false;
+  for(int i = 0; i < _fuzzHitCount; i++)
+  {
+    unsigned int edge = _fuzzHitEdges[i];
+    _fuzzEdges[edge] = 0;
+    if(_fuzzSeenEdges[edge]) continue;
+    _fuzzSeenEdges[edge] = 1;
+    _fuzz.edgesFound++;
+    found = true;
+  }
+  _fuzzHitCount = 0;
+  return found;
+#else
+  return false;
+#endif
+}
+
+void _fuzzFailure(char* file, int line, char* expr)
+{
+  _fuzz.failed = true;
+  _fuzz.failFile = file;
+  _fuzz.failLine = line;
+  _fuzz.failExpr = expr;
+  _btrLongjmp(_fuzz.jump);
+}
+
+bool _shouldRunFuzzTarget(int index, int line, char* name)
+{
+  if(_fuzzOneInput)
+  {
+    if(_fuzz.targetFound || (_fuzz.target && strcmp(_fuzz.target, name) != 0)) return false;
+    _fuzz.targetFound = true;
+  }
+  else
+  {
+    if(!_shouldRunTest(index, line, testEnv->_candidateContext)) return false;
+    _initializeTest(index, line, name);
+  }
+  _fuzz.name = name;
+  setupFunction();
+  return true;
+}
+
+void _addFuzzCorpus(const unsigned char* data, size_t size)
+{
+  _untrackedAllocations++;
+  if(_fuzz.corpusCount == _fuzz.corpusCapacity)
+  {
+    _fuzz.corpusCapacity = _fuzz.corpusCapacity ? _fuzz.corpusCapacity*2 : 64;
+    _fuzz.corpus = (_FuzzInput*)realloc(_fuzz.corpus, sizeof(_FuzzInput)*_fuzz.corpusCapacity);
+  }
+  _FuzzInput* input = &_fuzz.corpus[_fuzz.corpusCount++];
+  input->data = (unsigned char*)malloc(size + 1);
+  memcpy(input->data, data, size);
+  input->size = size;
+  _untrackedAllocations--;
+}
+
+void _startFuzz()
+{
+  _fuzz.onFail = onFail;
+  _fuzz.mockChangesCount = _mockChangesCount;
+  _fuzz.runtimeMocksCount = _runtimeMocksCount;
+  _fuzz.running = _fuzz.failed = false;
+  if(_fuzzOneInput)
+  {
+    _fuzz.mode = _FUZZ_ONE_INPUT;
+    return;
+  }
+  _fuzz.mode = _testOptions.fuzzRuns > 0 ? _FUZZ_MUTATE : _FUZZ_REPLAY;
+  _fuzz.runs = _testOptions.fuzzRuns;
+  _fuzz.random = _testOptions.hasSeed ? _testOptions.seed : _monotonicTime();
+
+  _untrackedAllocations++;
+  char* sourceName = _sourceFile;
+  for(char* c = _sourceFile; *c; c++)
+    if(*c == '/' || *c == '\\') sourceName = c + 1;
+  _fuzz.directory = (char*)malloc(strlen(fuzzInputsPath) + strlen(sourceName) + strlen(_fuzz.name) + 8);
+  sprintf(_fuzz.directory, "%s/%s.%s", fuzzInputsPath, sourceName, _fuzz.name);
+  _fuzz.fileCount = _isDirectory(_fuzz.directory) ? _listFiles(_fuzz.directory, 0) : 0;
+  _fuzz.files = (char**)malloc(sizeof(char*)*(_fuzz.fileCount + 1));
+  _listFiles(_fuzz.directory, _fuzz.files);
+  _fuzz.buffer = (unsigned char*)malloc(_FUZZ_MAX_INPUT);
+  _untrackedAllocations--;
+  _addFuzzCorpus(0, 0);
+}
+
+// Reads a saved input into the buffer, inputs longer than _FUZZ_MAX_INPUT are cut
+bool _loadFuzzInput(char* path)
+{
+  FILE* file = fopen(path, "rb");
+  if(!file) return false;
+  _fuzz.size = fread(_fuzz.buffer, 1, _FUZZ_MAX_INPUT, file);
+  fclose(file);
+  _fuzz.data = _fuzz.buffer;
+  _fuzz.inputPath = path;
+  return true;
+}
+
+void _mutateFuzzInput()
+{
+  static const unsigned char interesting[] = {0, 1, 2, 0x7F, 0x80, 0xFE, 0xFF, 16, 32, 64, 100};
+  _FuzzInput* base = &_fuzz.corpus[_nextRandom(&_fuzz.random) % _fuzz.corpusCount];
+  unsigned char* input = _fuzz.buffer;
+  size_t size = base->size;
+  memcpy(input, base->data, size);
+  for(int mutations = 1 + _nextRandom(&_fuzz.random) % 4; mutations > 0; mutations--)
+  {
+    unsigned long long random = _nextRandom(&_fuzz.random);
+    size_t position = size ? (random >> 8) % size : 0;
+    size_t length = 1 + (random >> 40) % 8;
+    switch(random % 7)
+    {
+      case 0: if(size) input[position] ^= 1 << ((random >> 32) % 8); break;
+      case 1: if(size) input[position] = (unsigned char)(random >> 32); break;
+      case 2: if(size) input[position] = interesting[(random >> 32) % sizeof(interesting)]; break;
+      case 3: if(size) input[position] += (unsigned char)((random >> 32) % 35 - 17); break;
+      case 4:
+        // Inserts random bytes
+        if(size + length > _FUZZ_MAX_INPUT) break;
+        position = (random >> 8) % (size + 1);
+        memmove(input + position + length, input + position, size - position);
+        for(size_t i = 0; i < length; i++)
+          input[position + i] = (unsigned char)_nextRandom(&_fuzz.random);
+        size += length;
+        break;
+      case 5:
+        // Deletes bytes
+        if(!size) break;
+        if(length > size - position) length = size - position;
+        memmove(input + position, input + position + length, size - position - length);
+        size -= length;
+        break;
+      case 6:
+      {
+        // Copies in part of another input
+        _FuzzInput* other = &_fuzz.corpus[(random >> 32) % _fuzz.corpusCount];
+        if(!other->size) break;
+        size_t start = _nextRandom(&_fuzz.random) % other->size;
+        length = 1 + _nextRandom(&_fuzz.random) % (other->size - start);
+        position = (random >> 8) % (size + 1);
+        if(position + length > _FUZZ_MAX_INPUT) length = _FUZZ_MAX_INPUT - position;
+        memcpy(input + position, other->data + start, length);
+        if(position + length > size) size = position + length;
+        break;
+      }
+    }
+  }
+  _fuzz.data = input;
+  _fuzz.size = size;
+  _fuzz.inputPath = 0;
+}
+
+unsigned long long _fuzzInputHash(const unsigned char* data, size_t size)
+{
+  unsigned long long hash = 0xCBF29CE484222325ULL;
+  for(size_t i = 0; i < size; i++)
+    hash = (hash ^ data[i])*0x100000001B3ULL;
+  return hash;
+}
+
+void _reportFuzzFailure()
+{
+  static char message[1024];
+  if(_fuzz.mode == _FUZZ_ONE_INPUT)
+  {
+    printf("\n[FAIL] on fuzz target \"%s\" failed %s:%i (%s)\n", _fuzz.name, _fuzz.failFile, _fuzz.failLine, _fuzz.failExpr);
+    fflush(stdout);
+    // Lets libFuzzer save the input
+    abort();
+  }
+  if(_fuzz.inputPath)
+    snprintf(message, sizeof(message), "%.500s with input %.400s", _fuzz.failExpr, _fuzz.inputPath);
+  else
+  {
+    char path[1024];
+    snprintf(path, sizeof(path), "%.900s/crash-%016llx", _fuzz.directory, _fuzzInputHash(_fuzz.data, _fuzz.size));
+    FILE* file = _makeParentDirectories(path) ? fopen(path, "wb") : 0;
+    if(file)
+    {
+      fwrite(_fuzz.data, 1, _fuzz.size, file);
+      fclose(file);
+    }
+    snprintf(message, sizeof(message), "%.500s after %lli runs, input saved to %.400s", _fuzz.failExpr, _fuzz.run,
+      file ? path : "nowhere");
+  }
+  _fuzz.onFail(_fuzz.failFile, _fuzz.failLine, message);
+}
+
+void _finishFuzz()
+{
+  if(_fuzz.mode == _FUZZ_MUTATE)
+  {
+    unsigned long long elapsed = _monotonicTime() - _fuzz.startTime;
+    printf("\n[FUZZ] on \"%s\" test \"%s\" %lli runs in %.3f s (%.0f runs/s), corpus of %i inputs, %i edges\n",
+      testEnv->testContext, _fuzz.name, _fuzz.run, elapsed/1e9, elapsed ? _fuzz.run*1e9/elapsed : 0.0, _fuzz.corpusCount,
+      _fuzz.edgesFound);
+  }
+  _untrackedAllocations++;
+  for(int i = 0; i < _fuzz.fileCount; i++)
+    free(_fuzz.files[i]);
+  for(int i = 0; i < _fuzz.corpusCount; i++)
+    free(_fuzz.corpus[i].data);
+  free(_fuzz.files);
+  free(_fuzz.corpus);
+  free(_fuzz.buffer);
+  free(_fuzz.directory);
+  _untrackedAllocations--;
+  _fuzz.files = 0;
+  _fuzz.corpus = 0;
+  _fuzz.corpusCount = _fuzz.corpusCapacity = _fuzz.fileCount = _fuzz.fileIndex = 0;
+  _fuzz.run = 0;
+  _fuzz.ranEmpty = false;
+}
+
+// Picks the input for the next run, after looking at the outcome of the last one. Returns false once done
+bool _nextFuzzInput()
+{
+  onFail = _fuzz.onFail;
+  if(_fuzz.running)
+  {
+    _fuzz.running = false;
+    _restoreMocks(_fuzz.mockChangesCount);
+    _restoreRuntimeMocks(_fuzz.runtimeMocksCount);
+    if(_fuzz.failed)
+    {
+      _reportFuzzFailure();
+      return false;
+    }
+    if(_fuzzFoundEdges() && _fuzz.mode == _FUZZ_MUTATE && !_fuzz.inputPath)
+      _addFuzzCorpus(_fuzz.data, _fuzz.size);
+    if(_fuzz.mode == _FUZZ_ONE_INPUT)
+    {
+      cleanFunction();
+      return false;
+    }
+  }
+  else if(_fuzz.mode != _FUZZ_ONE_INPUT)
+    _fuzz.startTime = _monotonicTime();
+
+  bool next = false;
+  if(_fuzz.mode == _FUZZ_ONE_INPUT)
+    next = true;
+  while(!next && _fuzz.fileIndex < _fuzz.fileCount)
+    if(_loadFuzzInput(_fuzz.files[_fuzz.fileIndex++]))
+    {
+      if(_fuzz.mode == _FUZZ_MUTATE) _addFuzzCorpus(_fuzz.data, _fuzz.size);
+      next = true;
+    }
+  if(!next && _fuzz.mode == _FUZZ_REPLAY && !_fuzz.ranEmpty && _fuzz.fileCount == 0)
+  {
+    _fuzz.data = _fuzz.buffer;
+    _fuzz.size = 0;
+    _fuzz.inputPath = 0;
+    _fuzz.ranEmpty = next = true;
+  }
+  if(!next && _fuzz.mode == _FUZZ_MUTATE && _fuzz.run < _fuzz.runs)
+  {
+    _mutateFuzzInput();
+    _fuzz.run++;
+    next = true;
+  }
+  if(!next)
+  {
+    _finishFuzz();
+    return false;
+  }
+  _fuzz.running = true;
+  _fuzz.failed = false;
+  onFail = _fuzzFailure;
+  return true;
+}
+
+// Runs the selected fuzz target with one input given by libFuzzer
+int _runFuzzInput(const unsigned char* data, size_t size, int (*allTests)())
+{
+  static TestEnvironment environment;
+  if(!testEnv)
+  {
+    testEnv = &environment;
+    environment._helperBlockIndex = &environment.helperMemoryBlock[0];
+    environment.testContext = _C_STRING_LITERAL("global");
+    environment.testDescription = _C_STRING_LITERAL("setup");
+    _allTestsFunction = allTests;
+    _fuzz.target = getenv("BTR_FUZZ_TARGET");
+  }
+  _fuzzOneInput = true;
+  _fuzz.targetFound = false;
+  _fuzz.data = (unsigned char*)data;
+  _fuzz.size = size;
+  _fuzz.inputPath = 0;
+  allTests();
+  _restoreMocks(0);
+  _restoreRuntimeMocks(0);
+  return 0;
+}
+// This content is part of test.h
+// DWARF debug info, used for deriving mock descriptors from the objects of a static lib
+// Based on https://dwarfstd.org/doc/DWARF5.pdf
+
+typedef struct _DebugInfo _DebugInfo;
+typedef struct _DebugInfoReader _DebugInfoReader;
+typedef struct _DebugInfoUnit _DebugInfoUnit;
+typedef struct _DebugInfoAbbrev _DebugInfoAbbrev;
+typedef struct _DebugInfoEntry _DebugInfoEntry;
+typedef struct _DebugInfoFunctions _DebugInfoFunctions;
+
+enum _DebugInfoTag
+{
+  _DW_TAG_ENUMERATION_TYPE = 0x04,
+  _DW_TAG_FORMAL_PARAMETER = 0x05,
+  _DW_TAG_POINTER_TYPE = 0x0f,
+  _DW_TAG_REFERENCE_TYPE = 0x10,
+  _DW_TAG_TYPEDEF = 0x16,
+  _DW_TAG_UNSPECIFIED_PARAMETERS = 0x18,
+  _DW_TAG_BASE_TYPE = 0x24,
+  _DW_TAG_CONST_TYPE = 0x26,
+  _DW_TAG_SUBPROGRAM = 0x2e,
+  _DW_TAG_VOLATILE_TYPE = 0x35,
+  _DW_TAG_RESTRICT_TYPE = 0x37,
+  _DW_TAG_RVALUE_REFERENCE_TYPE = 0x42,
+  _DW_TAG_ATOMIC_TYPE = 0x47
+};
+
+enum _DebugInfoAttribute
+{
+  _DW_AT_NAME = 0x03,
+  _DW_AT_BYTE_SIZE = 0x0b,
+  _DW_AT_LOW_PC = 0x11,
+  _DW_AT_ABSTRACT_ORIGIN = 0x31,
+  _DW_AT_DECLARATION = 0x3c,
+  _DW_AT_ENCODING = 0x3e,
+  _DW_AT_EXTERNAL = 0x3f,
+  _DW_AT_SPECIFICATION = 0x47,
+  _DW_AT_TYPE = 0x49,
+  _DW_AT_RANGES = 0x55,
+  _DW_AT_LINKAGE_NAME = 0x6e,
+  _DW_AT_MIPS_LINKAGE_NAME = 0x2007
+};
+
+enum _DebugInfoEncoding
+{
+  _DW_ATE_BOOLEAN = 0x02,
+  _DW_ATE_FLOAT = 0x04,
+  _DW_ATE_SIGNED = 0x05,
+  _DW_ATE_SIGNED_CHAR = 0x06,
+  _DW_ATE_UNSIGNED = 0x07,
+  _DW_ATE_UNSIGNED_CHAR = 0x08,
+  _DW_ATE_UTF = 0x10
+};
+
+struct _DebugInfoReader
+{
+  const unsigned char* data;
+  long long size;
+  long long position;
+  bool failed;
+};
+
+struct _DebugInfoUnit
+{
+  long long offset;
+  int version;
+  int offsetSize;
+  int addressSize;
+};
+
+struct _DebugInfoAbbrev
+{
+  unsigned long long code;
+  int tag;
+  bool hasChildren;
+  long long specPosition;
+};
+
+// Only the attributes needed for describing functions are kept, offsets are relative to .debug_info and -1 when missing
+struct _DebugInfoEntry
+{
+  long long offset;
+  int tag;
+  int depth;
+  const char* name;
+  const char* linkageName;
+  long long type;
+  long long specification;
+  long long abstractOrigin;
+  long long encoding;
+  long long byteSize;
+  bool external;
+  bool declaration;
+  bool hasCode;
+};
+
+struct _DebugInfo
+{
+  _DebugInfoReader info;
+  _DebugInfoReader abbrev;
+  _DebugInfoReader strings;
+  _DebugInfoReader lineStrings;
+  unsigned char* relocated;
+  _DebugInfoEntry* entries;
+  int entryCount;
+  int entryCapacity;
+};
+
+struct _DebugInfoFunctions
+{
+  FunctionDescriptor* items;
+  int count;
+  int capacity;
+};
+
+unsigned long long _debugInfoRead(_DebugInfoReader* reader, int size)
+{
+  if(size < 0 || reader->position + size > reader->size)
+  {
+    reader->failed = true;
+    reader->position = reader->size;
+    return 0;
+  }
+  unsigned long long value = 0;
+  for(int i = 0; i < size && i < 8; i++)
+    value |= (unsigned long long)reader->data[reader->position + i] << (8*i);
+  reader->position += size;
+  return value;
+}
+
+unsigned long long _debugInfoReadLeb(_DebugInfoReader* reader, bool isSigned)
+{
+  unsigned long long value = 0;
+  int shift = 0;
+  unsigned char byte;
+  do
+  {
+    if(reader->position >= reader->size)
+    {
+      reader->failed = true;
+      return 0;
+    }
+    byte = reader->data[reader->position++];
+    if(shift < 64) value |= (unsigned long long)(byte & 0x7f) << shift;
+    shift += 7;
+  }
+  while(byte & 0x80);
+  if(isSigned && shift < 64 && (byte & 0x40)) value |= ~0ULL << shift;
+  return value;
+}
+
+const char* _debugInfoString(_DebugInfoReader* strings, unsigned long long offset)
+{
+  if(offset >= (unsigned long long)strings->size || !memchr(strings->data + offset, 0, strings->size - offset)) return 0;
+  return (const char*)strings->data + offset;
+}
+
+// Reads an attribute value in any form, setting string for the string forms
+unsigned long long _debugInfoReadValue(_DebugInfo* info, _DebugInfoUnit* unit, unsigned long long form, long long implicitConst, const char** string)
+{
+  _DebugInfoReader* reader = &info->info;
+  *string = 0;
+  switch(form)
+  {
+    case 0x01: return _debugInfoRead(reader, unit->addressSize);
+    case 0x03: return _debugInfoRead(reader, _debugInfoRead(reader, 2));
+    case 0x04: return _debugInfoRead(reader, _debugInfoRead(reader, 4));
+    case 0x09: case 0x18: return _debugInfoRead(reader, _debugInfoReadLeb(reader, false));
+    case 0x0a: return _debugInfoRead(reader, _debugInfoRead(reader, 1));
+    case 0x0b: case 0x0c: case 0x11: case 0x25: case 0x29: return _debugInfoRead(reader, 1);
+    case 0x05: case 0x12: case 0x26: case 0x2a: return _debugInfoRead(reader, 2);
+    case 0x27: case 0x2b: return _debugInfoRead(reader, 3);
+    case 0x06: case 0x13: case 0x1c: case 0x28: case 0x2c: return _debugInfoRead(reader, 4);
+    case 0x07: case 0x14: case 0x20: case 0x24: return _debugInfoRead(reader, 8);
+    case 0x1e: return _debugInfoRead(reader, 16);
+    case 0x0d: return _debugInfoReadLeb(reader, true);
+    case 0x0f: case 0x15: case 0x1a: case 0x1b: case 0x22: case 0x23: case 0x1f01: case 0x1f02:
+      return _debugInfoReadLeb(reader, false);
+    case 0x10: return _debugInfoRead(reader, unit->version == 2 ? unit->addressSize : unit->offsetSize);
+    case 0x17: case 0x1d: case 0x1f20: case 0x1f21: return _debugInfoRead(reader, unit->offsetSize);
+    case 0x19: return 1;
+    case 0x21: return implicitConst;
+    case 0x16: return _debugInfoReadValue(info, unit, _debugInfoReadLeb(reader, false), 0, string);
+    case 0x08:
+      *string = _debugInfoString(reader, reader->position);
+      if(!*string) reader->failed = true;
+      else reader->position += strlen(*string) + 1;
+      return 0;
+    case 0x0e: case 0x1f:
+    {
+      unsigned long long offset = _debugInfoRead(reader, unit->offsetSize);
+      *string = _debugInfoString(form == 0x0e ? &info->strings : &info->lineStrings, offset);
+      return offset;
+    }
+  }
+  reader->failed = true;
+  return 0;
+}
+
+bool _debugInfoIsUnitReference(unsigned long long form)
+{
+  return form >= 0x11 && form <= 0x15;
+}
+
+int _debugInfoReadAbbrevs(_DebugInfo* info, unsigned long long offset, _DebugInfoAbbrev** output)
+{
+  _DebugInfoReader reader = info->abbrev;
+  reader.position = offset;
+  int count = 0, capacity = 0;
+  *output = 0;
+  while(!reader.failed)
+  {
+    unsigned long long code = _debugInfoReadLeb(&reader, false);
+    if(!code) break;
+    if(count == capacity)
+    {
+      capacity = capacity*2 + 64;
+      *output = (_DebugInfoAbbrev*)realloc(*output, sizeof(_DebugInfoAbbrev)*capacity);
+    }
+    _DebugInfoAbbrev* abbrev = &(*output)[count++];
+    abbrev->code = code;
+    abbrev->tag = _debugInfoReadLeb(&reader, false);
+    abbrev->hasChildren = _debugInfoRead(&reader, 1);
+    abbrev->specPosition = reader.position;
+    while(!reader.failed)
+    {
+      unsigned long long attribute = _debugInfoReadLeb(&reader, false);
+      unsigned long long form = _debugInfoReadLeb(&reader, false);
+      if(form == 0x21) _debugInfoReadLeb(&reader, true);
+      if(!attribute && !form) break;
+    }
+  }
+  return reader.failed ? -1 : count;
+}
+
+_DebugInfoAbbrev* _debugInfoFindAbbrev(int count, _DebugInfoAbbrev* abbrevs, unsigned long long code)
+{
+  // Codes are usually numbered from 1 in order
+  if(code >= 1 && code <= (unsigned long long)count && abbrevs[code - 1].code == code) return &abbrevs[code - 1];
+  for(int i = 0; i < count; i++)
+    if(abbrevs[i].code == code) return &abbrevs[i];
+  return 0;
+}
+
+bool _debugInfoReadEntries(_DebugInfo* info, _DebugInfoUnit* unit, long long end, int abbrevCount, _DebugInfoAbbrev* abbrevs)
+{
+  _DebugInfoReader* reader = &info->info;
+  int depth = 0;
+  while(reader->position < end && !reader->failed)
+  {
+    long long offset = reader->position;
+    unsigned long long code = _debugInfoReadLeb(reader, false);
+    if(!code)
+    {
+      depth--;
+      continue;
+    }
+    _DebugInfoAbbrev* abbrev = _debugInfoFindAbbrev(abbrevCount, abbrevs, code);
+    if(!abbrev) return false;
+
+    _DebugInfoEntry entry = {offset, abbrev->tag, depth, 0, 0, -1, -1, -1, -1, -1, false, false, false};
+    _DebugInfoReader spec = info->abbrev;
+    spec.position = abbrev->specPosition;
+    while(!spec.failed && !reader->failed)
+    {
+      unsigned long long attribute = _debugInfoReadLeb(&spec, false);
+      unsigned long long form = _debugInfoReadLeb(&spec, false);
+      long long implicitConst = form == 0x21 ? (long long)_debugInfoReadLeb(&spec, true) : 0;
+      if(!attribute && !form) break;
+      const char* string;
+      long long value = _debugInfoReadValue(info, unit, form, implicitConst, &string);
+      if(_debugInfoIsUnitReference(form)) value += unit->offset;
+      switch(attribute)
+      {
+        case _DW_AT_NAME: entry.name = string; break;
+        case _DW_AT_LINKAGE_NAME: case _DW_AT_MIPS_LINKAGE_NAME: entry.linkageName = string; break;
+        case _DW_AT_TYPE: entry.type = value; break;
+        case _DW_AT_SPECIFICATION: entry.specification = value; break;
+        case _DW_AT_ABSTRACT_ORIGIN: entry.abstractOrigin = value; break;
+        case _DW_AT_ENCODING: entry.encoding = value; break;
+        case _DW_AT_BYTE_SIZE: entry.byteSize = value; break;
+        case _DW_AT_EXTERNAL: entry.external = value; break;
+        case _DW_AT_DECLARATION: entry.declaration = value; break;
+        case _DW_AT_LOW_PC: case _DW_AT_RANGES: entry.hasCode = true; break;
+      }
+    }
+    if(spec.failed) return false;
+
+    if(info->entryCount == info->entryCapacity)
+    {
+      info->entryCapacity = info->entryCapacity*2 + 256;
+      info->entries = (_DebugInfoEntry*)realloc(info->entries, sizeof(_DebugInfoEntry)*info->entryCapacity);
+    }
+    info->entries[info->entryCount++] = entry;
+    if(abbrev->hasChildren) depth++;
+  }
+  return !reader->failed;
+}
+
+// Every unit of .debug_info is read into one array of entries, sorted by offset
+bool _debugInfoReadUnits(_DebugInfo* info)
+{
+  _DebugInfoReader* reader = &info->info;
+  while(reader->position < reader->size && !reader->failed)
+  {
+    _DebugInfoUnit unit = {reader->position, 0, 4, 8};
+    long long length = _debugInfoRead(reader, 4);
+    if(length == 0xffffffff)
+    {
+      unit.offsetSize = 8;
+      length = _debugInfoRead(reader, 8);
+    }
+    long long end = reader->position + length;
+    if(reader->failed || length < 0 || end > reader->size) return false;
+
+    unit.version = _debugInfoRead(reader, 2);
+    unsigned long long abbrevOffset;
+    if(unit.version >= 5)
+    {
+      int unitType = _debugInfoRead(reader, 1);
+      unit.addressSize = _debugInfoRead(reader, 1);
+      abbrevOffset = _debugInfoRead(reader, unit.offsetSize);
+      if(unitType == 2 || unitType == 6) _debugInfoRead(reader, 8 + unit.offsetSize); // type signature and offset
+      else if(unitType == 4 || unitType == 5) _debugInfoRead(reader, 8); // dwo id
+    }
+    else
+    {
+      abbrevOffset = _debugInfoRead(reader, unit.offsetSize);
+      unit.addressSize = _debugInfoRead(reader, 1);
+    }
+    if(unit.version < 2 || unit.version > 5 || reader->failed) return false;
+
+    _DebugInfoAbbrev* abbrevs;
+    int abbrevCount = _debugInfoReadAbbrevs(info, abbrevOffset, &abbrevs);
+    bool ret = abbrevCount >= 0 && _debugInfoReadEntries(info, &unit, end, abbrevCount, abbrevs);
+    free(abbrevs);
+    if(!ret) return false;
+    reader->position = end;
+  }
+  return !reader->failed;
+}
+
+_DebugInfoEntry* _debugInfoFindEntry(_DebugInfo* info, long long offset)
+{
+  int low = 0, high = info->entryCount - 1;
+  while(low <= high)
+  {
+    int middle = (low + high)/2;
+    if(info->entries[middle].offset == offset) return &info->entries[middle];
+    if(info->entries[middle].offset < offset) low = middle + 1;
+    else high = middle - 1;
+  }
+  return 0;
+}
+
+// Relocatable objects leave offsets into other debug sections to relocations, only absolute ones are applied
+int _debugInfoRelocationSize(int machine, unsigned int type)
+{
+  if(machine == 62) return type == 1 ? 8 : (type == 10 || type == 11) ? 4 : 0; // x86-64
+  if(machine == 183) return type == 257 ? 8 : type == 258 ? 4 : 0; // AArch64
+  return 0;
+}
+
+void _debugInfoRelocate(_StaticLibFile* libFile, _ElfHeader* header, _ElfSectionHeader* sections, int infoIndex, unsigned char* content)
+{
+  long long size = sections[infoIndex].sh_size;
+  for(int i = 0; i < header->e_shnum; i++)
+  {
+    if(sections[i].sh_type != 4 || sections[i].sh_info != (uint32_t)infoIndex || sections[i].sh_link >= header->e_shnum) continue;
+    _ElfSectionHeader* symbolTable = &sections[sections[i].sh_link];
+    long long symbolCount = symbolTable->sh_size/sizeof(_ElfSymbol);
+    if(sections[i].sh_offset + sections[i].sh_size > (unsigned long long)libFile->contentSize ||
+       symbolTable->sh_offset + symbolTable->sh_size > (unsigned long long)libFile->contentSize) continue;
+    for(unsigned long long r = 0; r < sections[i].sh_size/sizeof(_ElfRela); r++)
+    {
+      _ElfRela relocation;
+      memcpy(&relocation, libFile->content + sections[i].sh_offset + sizeof(_ElfRela)*r, sizeof(_ElfRela));
+      int relocationSize = _debugInfoRelocationSize(header->e_machine, relocation.r_info & 0xffffffff);
+      long long symbolIndex = relocation.r_info >> 32;
+      if(!relocationSize || symbolIndex >= symbolCount || relocation.r_offset + relocationSize > (unsigned long long)size) continue;
+      _ElfSymbol symbol;
+      memcpy(&symbol, libFile->content + symbolTable->sh_offset + sizeof(_ElfSymbol)*symbolIndex, sizeof(_ElfSymbol));
+      unsigned long long value = symbol.st_value + relocation.r_addend;
+      for(int b = 0; b < relocationSize; b++)
+        content[relocation.r_offset + b] = (value >> (8*b)) & 0xff;
+    }
+  }
+}
+
+bool _debugInfoLoad(_DebugInfo* info, _StaticLibFile* libFile)
+{
+  memset(info, 0, sizeof(_DebugInfo));
+  _ElfHeader header;
+  if(libFile->contentSize < (long long)sizeof(_ElfHeader)) return false;
+  memcpy(&header, libFile->content, sizeof(_ElfHeader));
+  if(!_objectFileIsSupportedElf64(&header) || header.e_shstrndx >= header.e_shnum ||
+     header.e_shoff + (long long)sizeof(_ElfSectionHeader)*header.e_shnum > (unsigned long long)libFile->contentSize)
+    return false;
+
+  _ElfSectionHeader sections[header.e_shnum];
+  for(int i = 0; i < header.e_shnum; i++)
+    memcpy(&sections[i], libFile->content + header.e_shoff + sizeof(_ElfSectionHeader)*i, sizeof(_ElfSectionHeader));
+
+  const char* names[] = {".debug_info", ".debug_abbrev", ".debug_str", ".debug_line_str"};
+  _DebugInfoReader* readers[] = {&info->info, &info->abbrev, &info->strings, &info->lineStrings};
+  int infoIndex = -1;
+  _ElfSectionHeader* sectionNames = &sections[header.e_shstrndx];
+  for(int i = 0; i < header.e_shnum; i++)
+  {
+    // Compressed sections are not supported
+    if(sections[i].sh_type == 8 || (sections[i].sh_flags & 0x800) || sections[i].sh_name >= sectionNames->sh_size ||
+       sections[i].sh_offset + sections[i].sh_size > (unsigned long long)libFile->contentSize)
+      continue;
+    const char* name = _objectFileElfGetString(libFile, sectionNames, sections[i].sh_name);
+    for(int n = 0; n < 4; n++)
+      if(strcmp(name, names[n]) == 0)
+      {
+        readers[n]->data = (const unsigned char*)libFile->content + sections[i].sh_offset;
+        readers[n]->size = sections[i].sh_size;
+        if(n == 0) infoIndex = i;
+      }
+  }
+  if(infoIndex < 0 || !info->abbrev.data) return false;
+
+  info->relocated = (unsigned char*)malloc(info->info.size + 1);
+  memcpy(info->relocated, info->info.data, info->info.size);
+  _debugInfoRelocate(libFile, &header, sections, infoIndex, info->relocated);
+  info->info.data = info->relocated;
+  return _debugInfoReadUnits(info);
+}
+
+void _debugInfoFree(_DebugInfo* info)
+{
+  free(info->relocated);
+  free(info->entries);
+  memset(info, 0, sizeof(_DebugInfo));
+}
+
+const char* _debugInfoScalarName(long long encoding, long long byteSize)
+{
+  const char* signedNames[] = {"signed char", "short", 0, "int", 0, 0, 0, "long long"};
+  const char* unsignedNames[] = {"unsigned char", "unsigned short", 0, "unsigned int", 0, 0, 0, "unsigned long long"};
+  if(encoding == _DW_ATE_FLOAT) return byteSize == 4 ? "float" : byteSize == 8 ? "double" : byteSize == 16 ? "long double" : 0;
+  if(encoding == _DW_ATE_BOOLEAN) return byteSize == 1 ? "bool" : 0;
+  if(byteSize == 16) return encoding == _DW_ATE_SIGNED || encoding == _DW_ATE_SIGNED_CHAR ? "__int128" : "unsigned __int128";
+  if(byteSize < 1 || byteSize > 8) return 0;
+  if(encoding == _DW_ATE_SIGNED || encoding == _DW_ATE_SIGNED_CHAR) return signedNames[byteSize - 1];
+  if(encoding == _DW_ATE_UNSIGNED || encoding == _DW_ATE_UNSIGNED_CHAR || encoding == _DW_ATE_UTF) return unsignedNames[byteSize - 1];
+  return 0;
+}
+
+// Names a type the way the mock file can declare it without any header: qualifiers and typedefs are dropped,
+// every pointer or reference becomes void* and enums their underlying integer. Records passed by value are not supported
+const char* _debugInfoTypeName(_DebugInfo* info, long long offset)
+{
+  for(int i = 0; i < 64; i++)
+  {
+    if(offset < 0) return "void";
+    _DebugInfoEntry* entry = _debugInfoFindEntry(info, offset);
+    if(!entry) return 0;
+    switch(entry->tag)
+    {
+      case _DW_TAG_CONST_TYPE: case _DW_TAG_VOLATILE_TYPE: case _DW_TAG_RESTRICT_TYPE: case _DW_TAG_ATOMIC_TYPE: case _DW_TAG_TYPEDEF:
+        offset = entry->type;
+        break;
+      case _DW_TAG_POINTER_TYPE: case _DW_TAG_REFERENCE_TYPE: case _DW_TAG_RVALUE_REFERENCE_TYPE:
+        return "void*";
+      case _DW_TAG_ENUMERATION_TYPE:
+        if(entry->type < 0) return _debugInfoScalarName(_DW_ATE_UNSIGNED, entry->byteSize < 0 ? 4 : entry->byteSize);
+        offset = entry->type;
+        break;
+      case _DW_TAG_BASE_TYPE:
+        return _debugInfoScalarName(entry->encoding, entry->byteSize);
+      default:
+        return 0;
+    }
+  }
+  return 0;
+}
+
+// Longer chains of declarations are taken as malformed, so pointers in a cycle are not followed forever
+#define _DEBUG_INFO_MAX_ORIGINS 16
+
+// Definitions may only point to the declaration holding the name, type and linkage
+_DebugInfoEntry* _debugInfoOrigin(_DebugInfo* info, _DebugInfoEntry* entry)
+{
+  long long origin = entry->specification >= 0 ? entry->specification : entry->abstractOrigin;
+  _DebugInfoEntry* originEntry = origin >= 0 ? _debugInfoFindEntry(info, origin) : 0;
+  return originEntry != entry ? originEntry : 0;
+}
+
+char* _debugInfoCopyString(const char* string)
+{
+  char* copy = (char*)malloc(strlen(string) + 1);
+  strcpy(copy, string);
+  return copy;
+}
+
+// Builds the arguments from the parameters following a function entry, false if any of them can not be declared
+bool _debugInfoFunctionArgs(_DebugInfo* info, int index, char* args)
+{
+  _DebugInfoEntry* function = &info->entries[index];
+  args[0] = '\0';
+  for(int i = index + 1; i < info->entryCount && info->entries[i].depth > function->depth; i++)
+  {
+    _DebugInfoEntry* parameter = &info->entries[i];
+    if(parameter->depth != function->depth + 1) continue;
+    if(parameter->tag == _DW_TAG_UNSPECIFIED_PARAMETERS) return false; // variadic arguments can not be forwarded
+    if(parameter->tag != _DW_TAG_FORMAL_PARAMETER) continue;
+    long long type = parameter->type;
+    _DebugInfoEntry* origin = _debugInfoOrigin(info, parameter);
+    for(int depth = 0; type < 0 && origin && depth < _DEBUG_INFO_MAX_ORIGINS; depth++, origin = _debugInfoOrigin(info, origin))
+      type = origin->type;
+    const char* typeName = _debugInfoTypeName(info, type);
+    if(!typeName || type < 0) return false;
+    if(args[0]) strcat(args, ", ");
+    strcat(args, typeName);
+  }
+  return true;
+}
+
+void _debugInfoAppendFunction(_DebugInfoFunctions* functions, const char* returnType, const char* name, const char* args)
+{
+  if(functions->count == functions->capacity)
+  {
+    functions->capacity = functions->capacity*2 + 64;
+    functions->items = (FunctionDescriptor*)realloc(functions->items, sizeof(FunctionDescriptor)*functions->capacity);
+  }
+  FunctionDescriptor function = {_debugInfoCopyString(returnType), _debugInfoCopyString(name), _debugInfoCopyString(args), 0};
+  functions->items[functions->count++] = function;
+}
+
+// Appends the global functions defined in an object, skipping the ones whose types can not be declared.
+// Only entries with code whose name is a defined symbol are taken, along with the other symbols at the same address,
+// as a C++ constructor is described once but defined for both the complete and base object
+void _debugInfoReadFunctions(_StaticLibFile* libFile, _DebugInfoFunctions* functions)
+{
+  _DebugInfo info;
+  const char** symbolNames;
+  _ElfSymbol* symbols;
+  int symbolCount = _objectFileGlobalFunctions(libFile, &symbolNames, &symbols);
+  if(symbolCount && _debugInfoLoad(&info, libFile))
+    for(int i = 0; i < info.entryCount; i++)
+    {
+      _DebugInfoEntry entry = info.entries[i];
+      if(entry.tag != _DW_TAG_SUBPROGRAM || entry.declaration || !entry.hasCode) continue;
+      int parameterCount = 0;
+      for(int p = i + 1; p < info.entryCount && info.entries[p].depth > entry.depth; p++)
+        parameterCount++;
+
+      // Definitions may not have children, the declaration then lists the parameters
+      int parametersIndex = i;
+      _DebugInfoEntry* origin = _debugInfoOrigin(&info, &info.entries[i]);
+      for(int depth = 0; origin && depth < _DEBUG_INFO_MAX_ORIGINS; depth++, origin = _debugInfoOrigin(&info, origin))
+      {
+        if(!entry.name) entry.name = origin->name;
+        if(!entry.linkageName) entry.linkageName = origin->linkageName;
+        if(entry.type < 0) entry.type = origin->type;
+        entry.external |= origin->external;
+        if(!parameterCount)
+        {
+          parametersIndex = origin - info.entries;
+          for(int p = parametersIndex + 1; p < info.entryCount && info.entries[p].depth > origin->depth; p++)
+            parameterCount++;
+        }
+      }
+      const char* name = entry.linkageName ? entry.linkageName : entry.name;
+      const char* returnType = _debugInfoTypeName(&info, entry.type);
+      char args[parameterCount*24 + 1];
+      if(!entry.external || !name || !returnType || !_debugInfoFunctionArgs(&info, parametersIndex, args)) continue;
+
+      int symbol = 0;
+      while(symbol < symbolCount && strcmp(symbolNames[symbol], name) != 0) symbol++;
+      if(symbol == symbolCount) continue;
+      for(int alias = 0; alias < symbolCount; alias++)
+        if(symbols[alias].st_shndx == symbols[symbol].st_shndx && symbols[alias].st_value == symbols[symbol].st_value)
+          _debugInfoAppendFunction(functions, returnType, symbolNames[alias], args);
+    }
+  if(symbolCount) _debugInfoFree(&info);
+  free(symbolNames);
+  free(symbols);
+}
+
+int _compareFunctionDescriptors(const void* a, const void* b)
+{
+  return strcmp(((FunctionDescriptor*)a)->name, ((FunctionDescriptor*)b)->name);
+}
+
+void freeFunctionDescriptors(int functionCount, FunctionDescriptor* functions)
+{
+  for(int i = 0; i < functionCount; i++)
+  {
+    free((void*)functions[i].returnType);
+    free((void*)functions[i].name);
+    free((void*)functions[i].args);
+  }
+  free(functions);
+}
+
+int _debugInfoReadLibFunctions(_StaticLib* lib, FunctionDescriptor** output)
+{
+  _DebugInfoFunctions functions = {0, 0, 0};
+  for(int i = 0; i < lib->fileCount; i++)
+    _debugInfoReadFunctions(&lib->files[i], &functions);
+  if(functions.count)
+    qsort(functions.items, functions.count, sizeof(FunctionDescriptor), _compareFunctionDescriptors);
+
+  // Inline functions may be defined by several objects
+  int count = 0;
+  for(int i = 0; i < functions.count; i++)
+  {
+    FunctionDescriptor* function = &functions.items[i];
+    if(count && strcmp(functions.items[count - 1].name, function->name) == 0)
+    {
+      free((void*)function->returnType);
+      free((void*)function->name);
+      free((void*)function->args);
+    }
+    else
+      functions.items[count++] = *function;
+  }
+  *output = functions.items;
+  return count;
+}
+
+// Describes every global function of a static lib compiled with debug info (-g), sorted by name.
+// Returns the count or -1 if the lib can not be read, free the output with freeFunctionDescriptors
+int readFunctionDescriptors(char* libPath, FunctionDescriptor** output)
+{
+  _StaticLib lib;
+  *output = 0;
+  if(!_staticLibRead(&lib, libPath)) return -1;
+  int count = _debugInfoReadLibFunctions(&lib, output);
+  _staticLibFree(&lib);
+  return count;
+}
+// This content is part of test.h
+// Mock functionalities
+
+int _writeArgs(FILE* file, const char* args)
+{
+  int argsCount = 0;
+  int argsSize = strlen(args);
+  char arg[argsSize + 1];
+  int a = 0;
+  for(int i = 0; i <= argsSize; i++)
+  {
+    if((!isspace(args[i]) || a) || !args[i])
+    {
+      if(args[i] == '\0' || args[i] == ',')
+      {
+        if(a > 0)
+        {
+          arg[a] = '\0';
+          if(argsCount > 0) fprintf(file, ",");
+          if(arg[0] != '.') fprintf(file, "%s a%i", arg, argsCount++);
+          else fprintf(file, "%s", arg);
+        }
+        a = 0;
+      }
+      else
+        arg[a++] = args[i];
+    }
+  }
+  return argsCount;
+}
+
+void _getMockedName(char* output, const char* functioName)
+{
+  strcpy(output, "🐛");
+  strcat(output, functioName);
+  strcat(output, "🚀");
+}
+
+typedef struct _MockChange _MockChange;
+
+// Every mock slot write is pushed with the value it replaced, so contexts undo only what changed by popping back to a count
+struct _MockChange
+{
+  void** slot;
+  void* previous;
+};
+
+_MockChange* _mockChanges = 0;
+int _mockChangesCapacity = 0;
+
+void _setMockSlot(void** slot, void* function)
+{
+  if(_mockChangesCount == _mockChangesCapacity)
+  {
+    _mockChangesCapacity = _mockChangesCapacity ? _mockChangesCapacity*2 : 64;
+    _untrackedAllocations++;
+    _mockChanges = (_MockChange*)realloc(_mockChanges, sizeof(_MockChange)*_mockChangesCapacity);
+    _untrackedAllocations--;
+  }
+  _mockChanges[_mockChangesCount].slot = slot;
+  _mockChanges[_mockChangesCount++].previous = *slot;
+  *slot = function;
+}
+
+void _restoreMocks(int count)
+{
+  while(_mockChangesCount > count)
+  {
+    _MockChange* change = &_mockChanges[--_mockChangesCount];
+    *change->slot = change->previous;
+  }
+}
+
+// Returns the index of the function in the table, or count when it is not found
+int _getMock(char* file, int line, char* functionName, MockTable* mocks)
+{
+  int low = 0, high = mocks->count - 1;
+  while(low <= high)
+  {
+    int middle = (low + high)/2;
+    int comparison = strcmp(mocks->names + mocks->nameOffsets[middle], functionName);
+    if(comparison == 0) return middle;
+    if(comparison < 0) low = middle + 1;
+    else high = middle - 1;
+  }
+
+  char message[strlen(functionName) + 64];
+  strcpy(message, "Could not mock function ");
+  strcat(message, functionName);
+  onFail(file, line, message);
+  return mocks->count;
+}
+
+// Stress test threads other than 0 run the code of the contexts again on their way to the body, where mocking is left
+// to thread 0 so the mock tables are only changed by one thread
+void _mock(char* file, int line, char* functionName, void* function, MockTable* mocks)
+{
+  if(_stressThread > 0) return;
+  int index = _getMock(file, line, functionName, mocks);
+  if(index < mocks->count) _setMockSlot(&mocks->slots[index], function);
+}
+
+bool _runtimeMockReset(char* functionName);
+
+void _mockReset(char* file, int line, char* functionName, MockTable* mocks)
+{
+  if(_stressThread > 0) return;
+  if(_runtimeMockReset(functionName)) return;
+  int index = _getMock(file, line, functionName, mocks);
+  if(index < mocks->count) _setMockSlot(&mocks->slots[index], mocks->originals[index]);
+}
+
+typedef struct _RuntimeMock _RuntimeMock;
+
+#define _RUNTIME_MOCK_PATCH_SIZE 14
+#define _RUNTIME_MOCK_SHORT_PATCH_SIZE 5
+
+// Runtime mocks patch a jump into the prologue of the function, no mock file or mockable lib is needed
+// Every patch and reset is pushed with the bytes it overwrote, so contexts undo them by popping back to a count
+struct _RuntimeMock
+{
+  const char* name;
+  void* address;
+  int size;
+  unsigned char saved[_RUNTIME_MOCK_PATCH_SIZE];
+};
+
+_RuntimeMock* _runtimeMocks = 0;
+int _runtimeMocksCapacity = 0;
+
+// Overwrites executable code, implemented by the platform specific section
+bool _writeCode(void* address, const void* code, int size);
+// Size in bytes of the function starting at address, -1 when unknown, implemented by the platform specific section
+long long _functionSize(void* address);
+
+bool _pushRuntimeMock(const char* name, void* address, const unsigned char* code, int size)
+{
+  if(_runtimeMocksCount == _runtimeMocksCapacity)
+  {
+    _runtimeMocksCapacity = _runtimeMocksCapacity ? _runtimeMocksCapacity*2 : 16;
+    _untrackedAllocations++;
+    _runtimeMocks = (_RuntimeMock*)realloc(_runtimeMocks, sizeof(_RuntimeMock)*_runtimeMocksCapacity);
+    _untrackedAllocations--;
+  }
+  _RuntimeMock* runtimeMock = &_runtimeMocks[_runtimeMocksCount];
+  runtimeMock->name = name;
+  runtimeMock->address = address;
+  runtimeMock->size = size;
+  memcpy(runtimeMock->saved, address, size);
+  if(!_writeCode(address, code, size)) return false;
+  _runtimeMocksCount++;
+  return true;
+}
+
+void _restoreRuntimeMocks(int count)
+{
+  while(_runtimeMocksCount > count)
+  {
+    _RuntimeMock* runtimeMock = &_runtimeMocks[--_runtimeMocksCount];
+    _writeCode(runtimeMock->address, runtimeMock->saved, runtimeMock->size);
+  }
+}
+
+void _mockRuntime(char* file, int line, char* functionName, void* function, void* newFunction)
+{
+  if(_stressThread > 0) return;
+#if defined(__x86_64__) || defined(_M_X64)
+  // The patch size only depends on the function, so every patch and reset of it overwrites the same bytes
+  long long functionSize = _functionSize(function);
+  int size = functionSize >= _RUNTIME_MOCK_PATCH_SIZE ? _RUNTIME_MOCK_PATCH_SIZE : _RUNTIME_MOCK_SHORT_PATCH_SIZE;
+  long long distance = (long long)((char*)newFunction - ((char*)function + _RUNTIME_MOCK_SHORT_PATCH_SIZE));
+  unsigned char code[_RUNTIME_MOCK_PATCH_SIZE] = {0xFF, 0x25, 0, 0, 0, 0};
+  char message[strlen(functionName) + 128];
+  if(size == _RUNTIME_MOCK_PATCH_SIZE)
+    // jmp qword ptr [rip+0] followed by the absolute target, so no register is clobbered
+    memcpy(code + 6, &newFunction, sizeof(void*));
+  else if(functionSize >= 0 && functionSize < _RUNTIME_MOCK_SHORT_PATCH_SIZE)
+  {
+    sprintf(message, "Could not patch function %s, it is only %lli bytes long", functionName, functionSize);
+    onFail(file, line, message);
+    return;
+  }
+  else if(distance < INT32_MIN || distance > INT32_MAX)
+  {
+    sprintf(message, "Could not patch function %s, it is too short for a jump to a function that far", functionName);
+    onFail(file, line, message);
+    return;
+  }
+  else
+  {
+    // jmp rel32
+    int32_t relative = (int32_t)distance;
+    code[0] = 0xE9;
+    memcpy(code + 1, &relative, sizeof(relative));
+  }
+  sprintf(message, "Could not patch function %s", functionName);
+  if(!_pushRuntimeMock(functionName, function, code, size)) onFail(file, line, message);
+#else
+  onFail(file, line, _C_STRING_LITERAL("Runtime mocks are only supported on x86-64"));
+#endif
+}
+
+// The oldest patch of a function saved its original prologue
+bool _runtimeMockReset(char* functionName)
+{
+  for(int i = 0; i < _runtimeMocksCount; i++)
+    if(strcmp(_runtimeMocks[i].name, functionName) == 0)
+    {
+      unsigned char original[_RUNTIME_MOCK_PATCH_SIZE];
+      memcpy(original, _runtimeMocks[i].saved, _runtimeMocks[i].size);
+      return _pushRuntimeMock(functionName, _runtimeMocks[i].address, original, _runtimeMocks[i].size);
+    }
+  return false;
+}
+
+void _mockRuntimeReset(char* file, int line, char* functionName)
+{
+  if(_stressThread > 0) return;
+  char message[strlen(functionName) + 64];
+  strcpy(message, "Could not reset runtime mock of ");
+  strcat(message, functionName);
+  if(!_runtimeMockReset(functionName)) onFail(file, line, message);
+}
+
+typedef struct _TraceRecord _TraceRecord;
+typedef struct _TraceBuffer _TraceBuffer;
+
+#define _TRACE_BUFFER_SIZE 4096
+
+struct _TraceRecord
+{
+  unsigned long long timestamp;
+  int index;
+};
+
+// Each thread appends to its own buffer, new buffers are pushed to the global list without locking
+struct _TraceBuffer
+{
+  _TraceBuffer* next;
+  unsigned long long thread;
+  int count;
+  _TraceRecord records[_TRACE_BUFFER_SIZE];
+};
+
+_TraceBuffer* volatile _traceBuffers = 0;
+_BTR_THREAD_LOCAL _TraceBuffer* _traceBuffer = 0;
+MockTable* volatile _tracedMocks = 0;
+char* _tracePath = 0;
+int _traceTestIndex = 0;
+unsigned long long _traceStartClock = 0, _traceStartTime = 0;
+
+// Implemented by the platform specific section
+bool _makeParentDirectories(char* path);
+
+// Ticks are converted to time when the trace is written
+unsigned long long _traceClock()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc();
+#else
+  return _monotonicTime();
+#endif
+}
+
+_TraceBuffer* _pushTraceBuffer()
+{
+  _untrackedAllocations++;
+  _TraceBuffer* buffer = (_TraceBuffer*)malloc(sizeof(_TraceBuffer));
+  _untrackedAllocations--;
+  buffer->thread = _currentThreadId();
+  buffer->count = 0;
+  do
+    buffer->next = _traceBuffers;
+  while(!__sync_bool_compare_and_swap(&_traceBuffers, buffer->next, buffer));
+  return _traceBuffer = buffer;
+}
+
+// Called by the wrappers of mock files generated with MOCK_FILE_TRACE
+void _traceMockCall(MockTable* mocks, int index)
+{
+  if(!_tracePath) return;
+  if(_tracedMocks != mocks) _tracedMocks = mocks;
+  _TraceBuffer* buffer = _traceBuffer;
+  if(!buffer || buffer->count == _TRACE_BUFFER_SIZE) buffer = _pushTraceBuffer();
+  _TraceRecord* record = &buffer->records[buffer->count++];
+  record->timestamp = _traceClock();
+  record->index = index;
+}
+
+void _writeTrace()
+{
+  double nanosecondsPerTick = 1;
+  unsigned long long clock = _traceClock(), time = _monotonicTime();
+  if(clock != time && clock > _traceStartClock)
+    nanosecondsPerTick = (double)(time - _traceStartTime)/(clock - _traceStartClock);
+
+  FILE* file = _makeParentDirectories(_tracePath) ? fopen(_tracePath, "wb") : 0;
+  if(file) fprintf(file, "{\"traceEvents\":[");
+  const char* separator = "";
+  for(_TraceBuffer* buffer = _traceBuffers, *next; buffer; buffer = next)
+  {
+    for(int i = 0; file && i < buffer->count; i++)
+    {
+      _TraceRecord* record = &buffer->records[i];
+      fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"mock\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%i,\"tid\":%llu}",
+        separator, _tracedMocks->names + _tracedMocks->nameOffsets[record->index],
+        (long long)(record->timestamp - _traceStartClock)*nanosecondsPerTick/1000, _traceTestIndex, buffer->thread);
+      separator = ",";
+    }
+    next = buffer->next;
+    free(buffer);
+  }
+  if(file)
+  {
+    fprintf(file, "\n]}\n");
+    fclose(file);
+  }
+  _traceBuffers = 0;
+  free(_tracePath);
+  _tracePath = 0;
+}
+
+// Records the mock calls of a test into a file written when the process exits, which takes ownership of the path
+void _startTrace(char* path, int testIndex)
+{
+  _tracePath = path;
+  _traceTestIndex = testIndex;
+  _traceStartTime = _monotonicTime();
+  _traceStartClock = _traceClock();
+  atexit(_writeTrace);
+}
+
+#define _LATENCY_BUCKETS 64
+
+// Bucket b counts the calls that took from 2^b to 2^(b+1) clock ticks
+unsigned int (*_latencyBuckets)[_LATENCY_BUCKETS] = 0;
+MockTable* _latencyMocks = 0;
+char* _latencyTestContext = 0;
+char* _latencyTestDescription = 0;
+unsigned long long _latencyStartClock = 0, _latencyStartTime = 0;
+
+// The summary names the test that ran last, as calls may come before it from the code of its context
+void _nameLatencySummary(char* context, char* description)
+{
+  _latencyTestContext = context;
+  _latencyTestDescription = description;
+}
+
+// Called by the wrappers of mock files generated with MOCK_FILE_LATENCY
+unsigned long long _latencyStart()
+{
+  return _traceClock();
+}
+
+double _latencyPercentile(unsigned int* buckets, unsigned long long total, double percentile, double nanosecondsPerTick)
+{
+  unsigned long long count = 0;
+  for(int b = 0; b < _LATENCY_BUCKETS; b++)
+    if((count += buckets[b]) >= total*percentile) return 2.0*(1ULL << b)*nanosecondsPerTick;
+  return 0;
+}
+
+void _writeLatencySummary()
+{
+  double nanosecondsPerTick = 1;
+  unsigned long long clock = _traceClock(), time = _monotonicTime();
+  if(clock != time && clock > _latencyStartClock)
+    nanosecondsPerTick = (double)(time - _latencyStartTime)/(clock - _latencyStartClock);
+
+  printf("\n[LATENCY] on \"%s\" test \"%s\" (upper bounds)\n", _latencyTestContext, _latencyTestDescription);
+  for(int i = 0; i < _latencyMocks->count; i++)
+  {
+    unsigned long long total = 0;
+    for(int b = 0; b < _LATENCY_BUCKETS; b++)
+      total += _latencyBuckets[i][b];
+    if(total)
+      printf("  %s: %llu calls, p50 %.0fns, p99 %.0fns\n", _latencyMocks->names + _latencyMocks->nameOffsets[i], total,
+        _latencyPercentile(_latencyBuckets[i], total, 0.5, nanosecondsPerTick), _latencyPercentile(_latencyBuckets[i], total, 0.99, nanosecondsPerTick));
+  }
+  fflush(stdout);
+}
+
+void _latencyEnd(MockTable* mocks, int index, unsigned long long start)
+{
+  unsigned long long ticks = _traceClock() - start;
+  if(!_latencyBuckets)
+  {
+    _untrackedAllocations++;
+    unsigned int (*buckets)[_LATENCY_BUCKETS] = (unsigned int (*)[_LATENCY_BUCKETS])calloc(mocks->count + 1, sizeof(*buckets));
+    _untrackedAllocations--;
+    if(!__sync_bool_compare_and_swap(&_latencyBuckets, 0, buckets))
+      free(buckets);
+    else
+    {
+      _latencyMocks = mocks;
+      _latencyStartClock = start;
+      _latencyStartTime = _monotonicTime();
+      atexit(_writeLatencySummary);
+    }
+  }
+  int bucket = 0;
+  while(ticks >>= 1) bucket++;
+  __sync_fetch_and_add(&_latencyBuckets[index][bucket], 1);
+}
+
+// Mock files either wrap the renamed functions of a mockable lib or, when interposing, the functions of a shared library
+// that are found with dlsym(RTLD_NEXT, ...). Modes are combined with the public MockFileOption flags
+enum _MockFileMode
+{
+  _MOCK_FILE_MODE_ARCHIVE = 0,
+  _MOCK_FILE_MODE_INTERPOSE = 0b001
+};
+
+void _writeMockWrapper(FILE* file, int index, FunctionDescriptor* function, const char* prefix, int mode)
+{
+  bool timed = mode & MOCK_FILE_LATENCY;
+  bool returns = strcmp(function->returnType, "void") != 0;
+  fprintf(file, "%s %s%s(", function->returnType, prefix, function->name);
+  int argsCount = _writeArgs(file, function->args);
+  fprintf(file, "){ _mockCalls[%i]++; ", index);
+  // Constructors of other libraries may call it before the mock file constructor resolved the original
+  if((mode & _MOCK_FILE_MODE_INTERPOSE) && !function->implementation)
+    fprintf(file, "if(!_mockSlots[%i]) _resolveInterposedMock(%i); ", index, index);
+  if(mode & MOCK_FILE_TRACE) fprintf(file, "_traceMockCall(&_mocks, %i); ", index);
+  if(timed) fprintf(file, "unsigned long long start = _latencyStart(); ");
+  if(timed && returns) fprintf(file, "%s result = ", function->returnType);
+  else if(!timed) fprintf(file, "return ");
+  fprintf(file, "_BTR_CONVERT(_mockSlots[%i], %s (*)(%s))(", index, function->returnType, function->args);
+  for(int a = 0; a < argsCount; a++)
+    if(a)
+      fprintf(file, ", a%i", a);
+    else
+      fprintf(file, "a%i", a);
+  fprintf(file, "); ");
+  if(timed) fprintf(file, "_latencyEnd(&_mocks, %i, start); ", index);
+  if(timed && returns) fprintf(file, "return result; ");
+  fprintf(file, "}\n");
+}
+
+// Emits the trampolines and the mock table straight into an x86-64 ELF object, so they need no compilation.
+// Trampolines count the call and jump through their slot, pass-through ones jump straight to the original while the slot
+// holds it
+bool _createMockObject(char* mockFilePath, int functionCount, FunctionDescriptor* functions, int mode)
+{
+#if defined(__x86_64__) && defined(__ELF__)
+  for(int i = 0; i < functionCount; i++)
+    if(functions[i].implementation || (mode & (_MOCK_FILE_MODE_INTERPOSE | MOCK_FILE_TRACE | MOCK_FILE_LATENCY)))
+    {
+      printf("Could not emit %s as an object file, mocks with implementations, interposed or instrumented mocks need a C mock file\n", mockFilePath);
+      return false;
+    }
+
+  _ElfObject object;
+  _elfObjectInit(&object);
+  unsigned int offsets[functionCount + 1];
+  for(int i = 0; i < functionCount; i++)
+    offsets[i] = _objectFileBufferAppend(&object.rodata, functions[i].name, strlen(functions[i].name) + 1);
+  offsets[functionCount] = _objectFileBufferAppend(&object.rodata, "", 1);
+  _objectFileBufferAlign(&object.rodata, 8, 0);
+  long long nameOffsets = _objectFileBufferAppend(&object.rodata, offsets, sizeof(offsets));
+
+  long long table = _objectFileBufferAppend(&object.data, 0, sizeof(MockTable));
+  _objectFileBufferAlign(&object.data, 8, 0);
+  long long calls = _objectFileBufferAppend(&object.data, 0, sizeof(int)*(functionCount + 1));
+  _objectFileBufferAlign(&object.data, 8, 0);
+  long long slots = _objectFileBufferAppend(&object.data, 0, sizeof(void*)*(functionCount + 1));
+  long long originals = _objectFileBufferAppend(&object.data, 0, sizeof(void*)*(functionCount + 1));
+  memcpy(object.data.data + table + offsetof(MockTable, count), &functionCount, sizeof(int));
+  _elfObjectAddSymbol(&object, "_mocks", _ELF_OBJECT_DATA, 1, table, sizeof(MockTable));
+  _elfObjectAddSymbol(&object, "_mockCalls", _ELF_OBJECT_DATA, 1, calls, sizeof(int)*(functionCount + 1));
+  _elfObjectAddSymbol(&object, "_mockSlots", _ELF_OBJECT_DATA, 1, slots, sizeof(void*)*(functionCount + 1));
+  _elfObjectAddSymbol(&object, "_mockOriginals", _ELF_OBJECT_DATA, 1, originals, sizeof(void*)*(functionCount + 1));
+  _elfObjectAddRelocation(&object, _ELF_OBJECT_DATA, table + offsetof(MockTable, names), _ELF_OBJECT_RODATA, _ELF_R_X86_64_64, 0);
+  _elfObjectAddRelocation(&object, _ELF_OBJECT_DATA, table + offsetof(MockTable, nameOffsets), _ELF_OBJECT_RODATA, _ELF_R_X86_64_64, nameOffsets);
+  _elfObjectAddRelocation(&object, _ELF_OBJECT_DATA, table + offsetof(MockTable, calls), _ELF_OBJECT_DATA, _ELF_R_X86_64_64, calls);
+  _elfObjectAddRelocation(&object, _ELF_OBJECT_DATA, table + offsetof(MockTable, slots), _ELF_OBJECT_DATA, _ELF_R_X86_64_64, slots);
+  _elfObjectAddRelocation(&object, _ELF_OBJECT_DATA, table + offsetof(MockTable, originals), _ELF_OBJECT_DATA, _ELF_R_X86_64_64, originals);
+
+  bool passThrough = mode & MOCK_FILE_PASS_THROUGH;
+  for(int i = 0; i < functionCount; i++)
+  {
+    const char* name = functions[i].name;
+    char mockedName[strlen(name) + 64];
+    _getMockedName(mockedName, name);
+    long long callsEntry = calls + sizeof(int)*i;
+    long long slot = slots + sizeof(void*)*i;
+    int original = _elfObjectAddSymbol(&object, mockedName, _ELF_OBJECT_UNDEFINED, 0, 0, 0);
+    _elfObjectAddRelocation(&object, _ELF_OBJECT_DATA, slot, original, _ELF_R_X86_64_64, 0);
+    _elfObjectAddRelocation(&object, _ELF_OBJECT_DATA, originals + sizeof(void*)*i, original, _ELF_R_X86_64_64, 0);
+
+    // incl calls(%rip)
+    const unsigned char count[] = {0xFF, 0x05, 0, 0, 0, 0};
+    long long start = _objectFileBufferAppend(&object.text, count, sizeof(count));
+    _elfObjectAddRelocation(&object, _ELF_OBJECT_TEXT, start + 2, _ELF_OBJECT_DATA, _ELF_R_X86_64_PC32, callsEntry - 4);
+    if(passThrough)
+    {
+      // leaq original(%rip), %r11; cmpq %r11, slot(%rip); jne mocked; jmp original
+      const unsigned char check[] = {0x4C, 0x8D, 0x1D, 0, 0, 0, 0, 0x4C, 0x39, 0x1D, 0, 0, 0, 0, 0x0F, 0x85, 5, 0, 0, 0, 0xE9, 0, 0, 0, 0};
+      long long checked = _objectFileBufferAppend(&object.text, check, sizeof(check));
+      _elfObjectAddRelocation(&object, _ELF_OBJECT_TEXT, checked + 3, original, _ELF_R_X86_64_PC32, -4);
+      _elfObjectAddRelocation(&object, _ELF_OBJECT_TEXT, checked + 10, _ELF_OBJECT_DATA, _ELF_R_X86_64_PC32, slot - 4);
+      _elfObjectAddRelocation(&object, _ELF_OBJECT_TEXT, checked + 21, original, _ELF_R_X86_64_PLT32, -4);
+    }
+    // mocked: jmp *slot(%rip)
+    const unsigned char jump[] = {0xFF, 0x25, 0, 0, 0, 0};
+    long long mocked = _objectFileBufferAppend(&object.text, jump, sizeof(jump));
+    _elfObjectAddRelocation(&object, _ELF_OBJECT_TEXT, mocked + 2, _ELF_OBJECT_DATA, _ELF_R_X86_64_PC32, slot - 4);
+    // Padding keeps room for patching runtime mocks over the trampoline
+    _objectFileBufferAlign(&object.text, 16, (char)0xCC);
+    _elfObjectAddSymbol(&object, name, _ELF_OBJECT_TEXT, 2, start, object.text.size - start);
+  }
+
+  bool ret = _elfObjectWrite(&object, mockFilePath);
+  _elfObjectFree(&object);
+  return ret;
+#else
+  printf("Could not emit %s, mock object files are only supported on x86-64 ELF hosts\n", mockFilePath);
+  return false;
+#endif
+}
+
+bool _isObjectFilePath(const char* path)
+{
+  int length = strlen(path);
+  return length > 2 && strcmp(path + length - 2, ".o") == 0;
+}
+
+bool _writeMockFile(char* mockFilePath, int functionCount, FunctionDescriptor* functions, int mode)
+{
+  FILE* file = fopen(mockFilePath, "wb");
+  if(!file) return false;
+
+  bool interpose = mode & _MOCK_FILE_MODE_INTERPOSE;
+  fprintf(file, "// This file was generated by BugTestsRocket test framework\n");
+  fprintf(file, "// Link it when building your tests for implementing the mocks\n");
+  if(interpose)
+    fprintf(file, "// Functions are interposed, link the tests against the original shared library\n"
+                  "#ifndef _GNU_SOURCE\n#define _GNU_SOURCE\n#endif\n"
+                  "#include <dlfcn.h>\n");
+  fprintf(file, "#ifdef __cplusplus\nextern \"C\"{\n"
+                "#define _BTR_CONVERT(what, to) reinterpret_cast<to>(what)\n"
+                "#else\n"
+                "#define _BTR_CONVERT(what, to) ((to)(what))\n"
+                "#endif\n");
+  fprintf(file, "#include <stdbool.h>\n");
+  fprintf(file, "typedef struct {int count; const char* names; const unsigned int* nameOffsets; int* calls; void** slots; void** originals;} MockTable;\n");
+  fprintf(file, "extern int _mockCalls[];\nextern void* _mockSlots[];\n");
+  if(interpose) fprintf(file, "static void _resolveInterposedMock(int index);\n");
+  if(mode & (MOCK_FILE_TRACE | MOCK_FILE_LATENCY))
+    fprintf(file, "extern MockTable _mocks;\nvoid _traceMockCall(MockTable* mocks, int index);\n"
+                  "unsigned long long _latencyStart();\nvoid _latencyEnd(MockTable* mocks, int index, unsigned long long start);\n");
+
+  for(int i = 0; i < functionCount; i++)
+  {
+    if(interpose && !functions[i].implementation) continue;
+    char mockedName[strlen(functions[i].name) + 64];
+    _getMockedName(mockedName, functions[i].name);
+    const char* implementation = ";";
+    if(functions[i].implementation) implementation = functions[i].implementation;
+    fprintf(file, "%s %s(%s)%s\n", functions[i].returnType, mockedName, functions[i].args, implementation);
+  }
+  // The trampoline compares the slot with the original, only jumping to the wrapper when a mock is set. Unmocked calls
+  // are counted in place and jump straight to the original
+  bool passThrough = (mode & MOCK_FILE_PASS_THROUGH) && !(mode & (MOCK_FILE_TRACE | MOCK_FILE_LATENCY)) && !interpose;
+  if(passThrough)
+  {
+    fprintf(file, "#if defined(__x86_64__) && defined(__ELF__)\n");
+    for(int i = 0; i < functionCount; i++)
+    {
+      const char* name = functions[i].name;
+      char mockedName[strlen(name) + 64];
+      _getMockedName(mockedName, name);
+      _writeMockWrapper(file, i, &functions[i], "_counted_", mode);
+      fprintf(file, "__asm__(\".pushsection .text\\n.globl %s\\n.type %s, @function\\n%s:\\n"
+                    "  leaq \\\"%s\\\"(%%rip), %%r11\\n  cmpq %%r11, _mockSlots+%i(%%rip)\\n  jne _counted_%s\\n"
+                    "  incl _mockCalls+%i(%%rip)\\n  jmp \\\"%s\\\"\\n.size %s, .-%s\\n.popsection\\n\");\n",
+        name, name, name, mockedName, (int)sizeof(void*)*i, name, (int)sizeof(int)*i, mockedName, name, name);
+    }
+    fprintf(file, "#else\n");
+  }
+  for(int i = 0; i < functionCount; i++)
+    _writeMockWrapper(file, i, &functions[i], "", mode);
+  if(passThrough) fprintf(file, "#endif\n");
+
+  fprintf(file, "const char _mockNames[] =");
+  for(int i = 0; i < functionCount; i++)
+    fprintf(file, " \"%s\\0\"", functions[i].name);
+  fprintf(file, " \"\";\nconst unsigned int _mockNameOffsets[] = {");
+  unsigned int nameOffset = 0;
+  for(int i = 0; i <= functionCount; i++)
+  {
+    fprintf(file, "%u, ", nameOffset);
+    if(i < functionCount) nameOffset += strlen(functions[i].name) + 1;
+  }
+  fprintf(file, "};\nint _mockCalls[%i] = {0};\n", functionCount + 1);
+  const char* tables[] = {"_mockSlots", "_mockOriginals"};
+  for(int t = 0; t < 2; t++)
+  {
+    fprintf(file, "void* %s[] = {\n", tables[t]);
+    for(int i = 0; i < functionCount; i++)
+    {
+      char mockedName[strlen(functions[i].name) + 64];
+      _getMockedName(mockedName, functions[i].name);
+      if(interpose && !functions[i].implementation)
+        fprintf(file, "  (void*)0,\n");
+      else
+        fprintf(file, "  _BTR_CONVERT(%s, void*),\n", mockedName);
+    }
+    fprintf(file, "  (void*)0\n};\n");
+  }
+  fprintf(file, "MockTable _mocks = {%i, _mockNames, _mockNameOffsets, _mockCalls, _mockSlots, _mockOriginals};\n", functionCount);
+  if(interpose)
+    fprintf(file, "static void _resolveInterposedMock(int index)\n{\n"
+                  "  void* original = dlsym(RTLD_NEXT, _mocks.names + _mocks.nameOffsets[index]);\n"
+                  "  _mocks.originals[index] = original;\n"
+                  "  if(!_mocks.slots[index]) _mocks.slots[index] = original;\n"
+                  "}\n"
+                  "__attribute__((constructor)) static void _resolveInterposedMocks()\n{\n"
+                  "  for(int i = 0; i < _mocks.count; i++)\n"
+                  "    if(!_mocks.originals[i]) _resolveInterposedMock(i);\n"
+                  "}\n");
+  fprintf(file, "#ifdef __cplusplus\n}\n#endif\n"); 
+
+  fclose(file);
+  return true;
+}
+
+bool _createMockFile(char* mockFilePath, int functionCount, FunctionDescriptor* functions, int mode)
+{
+  // The table is sorted by name so _getMock can search it
+  FunctionDescriptor* sorted = (FunctionDescriptor*)malloc(sizeof(FunctionDescriptor)*(functionCount + 1));
+  memcpy(sorted, functions, sizeof(FunctionDescriptor)*functionCount);
+  qsort(sorted, functionCount, sizeof(FunctionDescriptor), _compareFunctionDescriptors);
+  bool ret;
+  if(_isObjectFilePath(mockFilePath))
+    ret = _createMockObject(mockFilePath, functionCount, sorted, mode);
+  else
+    ret = _writeMockFile(mockFilePath, functionCount, sorted, mode);
+  free(sorted);
+  return ret;
+}
+
+typedef struct _MockJob _MockJob;
+typedef struct _MockCache _MockCache;
+
+// Calls job once for every index spreading them over the available processors, implemented by the platform specific section
+void _runInParallel(int jobCount, void (*job)(void* data, int index), void* data);
+// Creates all missing parent directories of a file path, implemented by the platform specific section
+bool _makeParentDirectories(char* path);
+
+// Changes whenever the generator writes mockable libs or mock files differently, so older outputs are not reused
+#define _MOCK_FILE_FORMAT_VERSION 2
+
+// Remembers what produced the mockable lib, stored next to it as "<mockableLibPath>.cache"
+// A member is reused from the previous mockable lib when its content hash and the descriptors did not change
+struct _MockCache
+{
+  unsigned long long descriptorsHash;
+  int fileCount;
+  unsigned long long* fileHashes;
+};
+
+struct _MockJob
+{
+  _StaticLib* lib;
+  int renameCount;
+  _ObjectFileRename* renames;
+  bool* supported;
+  unsigned long long* fileHashes;
+  _MockCache* cache;
+  _StaticLib* previous;
+};
+
+// FNV-1a, chained through hash so several buffers can be combined
+unsigned long long _hashBytes(unsigned long long hash, const void* data, long long size)
+{
+  const unsigned char* bytes = (const unsigned char*)data;
+  if(!hash) hash = 0xcbf29ce484222325ull;
+  for(long long i = 0; i < size; i++)
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  return hash;
+}
+
+// Covers everything besides the lib that shapes the outputs: generator version, mock file path, mode and descriptors
+unsigned long long _hashDescriptors(int functionCount, FunctionDescriptor* functions, int mode, char* mockFilePath)
+{
+  int version = _MOCK_FILE_FORMAT_VERSION;
+  unsigned long long hash = _hashBytes(0, &version, sizeof(version));
+  hash = _hashBytes(hash, mockFilePath, strlen(mockFilePath) + 1);
+  hash = _hashBytes(hash, &functionCount, sizeof(functionCount));
+  hash = _hashBytes(hash, &mode, sizeof(mode));
+  for(int i = 0; i < functionCount; i++)
+  {
+    const char* fields[] = {functions[i].returnType, functions[i].name, functions[i].args, functions[i].implementation};
+    for(unsigned int f = 0; f < sizeof(fields)/sizeof(char*); f++)
+      hash = _hashBytes(hash, fields[f] ? fields[f] : "", fields[f] ? strlen(fields[f]) + 1 : 1);
+  }
+  return hash;
+}
+
+bool _readMockCache(char* cachePath, _MockCache* cache)
+{
+  memset(cache, 0, sizeof(_MockCache));
+  FILE* file = fopen(cachePath, "rb");
+  if(!file) return false;
+
+  bool ok = fscanf(file, "BugTestsRocket mock cache %llx %i", &cache->descriptorsHash, &cache->fileCount) == 2 && cache->fileCount >= 0;
+  if(ok)
+  {
+    cache->fileHashes = (unsigned long long*)malloc(sizeof(unsigned long long)*(cache->fileCount + 1));
+    for(int i = 0; ok && i < cache->fileCount; i++)
+      ok = fscanf(file, "%llx", &cache->fileHashes[i]) == 1;
+  }
+  fclose(file);
+
+  if(!ok)
+  {
+    if(cache->fileHashes) free(cache->fileHashes);
+    memset(cache, 0, sizeof(_MockCache));
+  }
+  return ok;
+}
+
+bool _writeMockCache(char* cachePath, unsigned long long descriptorsHash, int fileCount, unsigned long long* fileHashes)
+{
+  FILE* file = fopen(cachePath, "wb");
+  if(!file) return false;
+  fprintf(file, "BugTestsRocket mock cache %llx %i\n", descriptorsHash, fileCount);
+  for(int i = 0; i < fileCount; i++)
+    fprintf(file, "%llx\n", fileHashes[i]);
+  return fclose(file) == 0;
+}
+
+// Runs the object file rewrite of every function for one archive member, members are independent of each other
+void _createMocksForFile(void* data, int index)
+{
+  _MockJob* job = (_MockJob*)data;
+  _StaticLibFile* libFile = &job->lib->files[index];
+  job->supported[index] = true;
+  job->fileHashes[index] = _hashBytes(0, libFile->content, libFile->contentSize);
+
+  if(job->previous && index < job->cache->fileCount && job->cache->fileHashes[index] == job->fileHashes[index] &&
+     strcmp(_staticLibFileName(job->lib, libFile), _staticLibFileName(job->previous, &job->previous->files[index])) == 0)
+  {
+    libFile->content = job->previous->files[index].content;
+    libFile->contentSize = job->previous->files[index].contentSize;
+    return;
+  }
+
+  job->supported[index] = _objectFileMockFunctions(libFile, job->renameCount, job->renames);
+}
+
+// Builds the renames from every function to its mocked name, sorted for lookups. Names are kept in one block at *names
+_ObjectFileRename* _createMockRenames(int functionCount, FunctionDescriptor* functions, char** names)
+{
+  long long namesSize = 0;
+  for(int f = 0; f < functionCount; f++)
+    namesSize += strlen(functions[f].name) + 64;
+
+  _ObjectFileRename* renames = (_ObjectFileRename*)malloc(sizeof(_ObjectFileRename)*(functionCount + 1));
+  char* name = *names = (char*)malloc(namesSize + 1);
+  for(int f = 0; f < functionCount; f++)
+  {
+    _getMockedName(name, functions[f].name);
+    renames[f].from = functions[f].name;
+    renames[f].to = name;
+    name += strlen(name) + 1;
+  }
+  qsort(renames, functionCount, sizeof(_ObjectFileRename), _objectFileCompareRenames);
+  return renames;
+}
+
+// Descriptors given only a name (null returnType) are completed from the debug info of the lib
+int _describeMockFunctions(_StaticLib* lib, int functionCount, FunctionDescriptor* functions, FunctionDescriptor* output, FunctionDescriptor** debugFunctions, bool needsTypes)
+{
+  int debugFunctionCount = -1;
+  *debugFunctions = 0;
+  memcpy(output, functions, sizeof(FunctionDescriptor)*functionCount);
+  for(int i = 0; i < functionCount && needsTypes; i++)
+  {
+    if(output[i].returnType) continue;
+    if(debugFunctionCount < 0) debugFunctionCount = _debugInfoReadLibFunctions(lib, debugFunctions);
+    FunctionDescriptor* found = (FunctionDescriptor*)bsearch(&output[i], *debugFunctions, debugFunctionCount, sizeof(FunctionDescriptor), _compareFunctionDescriptors);
+    if(found)
+    {
+      output[i].returnType = found->returnType;
+      output[i].args = found->args;
+    }
+  }
+  return debugFunctionCount < 0 ? 0 : debugFunctionCount;
+}
+
+bool createMocks(char* libPath, char* mockableLibPath, char* mockFilePath, int functionCount, FunctionDescriptor* functions)
+{
+  bool ret = true;
+ 
+  _StaticLib lib, previous;
+  memset(&previous, 0, sizeof(_StaticLib));
+
+  if(_staticLibRead(&lib, libPath))
+  {
+    char cachePath[strlen(mockableLibPath) + 16];
+    sprintf(cachePath, "%s.cache", mockableLibPath);
+
+    // Object mock files do not need types, C mock files can not be written without them
+    FunctionDescriptor* described = (FunctionDescriptor*)malloc(sizeof(FunctionDescriptor)*(functionCount + 1));
+    FunctionDescriptor* debugFunctions;
+    int debugFunctionCount = _describeMockFunctions(&lib, functionCount, functions, described, &debugFunctions, !_isObjectFilePath(mockFilePath));
+    functions = described;
+    for(int i = 0; i < functionCount; i++)
+      if(!functions[i].returnType && !_isObjectFilePath(mockFilePath))
+      {
+        printf("Could not describe %s, compile %s with debug info (-g) or write its descriptor by hand\n", functions[i].name, libPath);
+        ret = false;
+      }
+
+    _MockCache cache;
+    unsigned long long descriptorsHash = _hashDescriptors(functionCount, functions, _MOCK_FILE_MODE_ARCHIVE | mockFileOptions, mockFilePath);
+    bool cached = _readMockCache(cachePath, &cache) && cache.descriptorsHash == descriptorsHash &&
+                  _staticLibRead(&previous, mockableLibPath) && previous.fileCount == cache.fileCount;
+
+    char* mockedNames;
+    _ObjectFileRename* renames = _createMockRenames(functionCount, functions, &mockedNames);
+    bool supported[lib.fileCount + 1];
+    unsigned long long fileHashes[lib.fileCount + 1];
+    _MockJob job = {&lib, functionCount, renames, supported, fileHashes, &cache, cached ? &previous : 0};
+    _runInParallel(lib.fileCount, _createMocksForFile, &job);
+
+    for(int i = 0; i < lib.fileCount; i++)
+      if(!supported[i])
+        printf("Could not mock object file %s. Supported formats are ELF64. Symbols must be relocatable. Maybe try adding --fPIC to your compiler flags?\n",
+              _staticLibFileName(&lib, &lib.files[i]));
+
+    bool changed = !cached || lib.fileCount != cache.fileCount;
+    for(int i = 0; !changed && i < lib.fileCount; i++)
+      changed = fileHashes[i] != cache.fileHashes[i];
+
+    for(int i = 0; changed && i < lib.header.globalSymbolCount; i++)
+    {
+      _ObjectFileRename* rename = _objectFileFindRename(functionCount, renames, _staticLibSymbolName(&lib, &lib.globalSymbols[i]));
+      if(rename) _staticLibRenameSymbol(&lib, &lib.globalSymbols[i], rename->to);
+    }
+
+    // The previous mockable lib may still be mapped, so the new one replaces it only once complete
+    if(changed)
+    {
+      char temporaryPath[strlen(mockableLibPath) + 16];
+      sprintf(temporaryPath, "%s.tmp", mockableLibPath);
+      ret &= _staticLibWrite(&lib, temporaryPath);
+      _staticLibFree(&previous);
+      if(ret && rename(temporaryPath, mockableLibPath) != 0)
+        ret = remove(mockableLibPath) == 0 && rename(temporaryPath, mockableLibPath) == 0;
+      // A partial or unused temporary lib is not left behind
+      if(!ret) remove(temporaryPath);
+    }
+
+    FILE* mockFile = cached ? fopen(mockFilePath, "rb") : 0;
+    if(mockFile) fclose(mockFile);
+    else if(ret) ret = _createMockFile(mockFilePath, functionCount, functions, _MOCK_FILE_MODE_ARCHIVE | mockFileOptions);
+
+    if(ret) _writeMockCache(cachePath, descriptorsHash, lib.fileCount, fileHashes);
+    else remove(cachePath);
+    if(cache.fileHashes) free(cache.fileHashes);
+    free(renames);
+    free(mockedNames);
+    freeFunctionDescriptors(debugFunctionCount, debugFunctions);
+    free(described);
+  }
+  else
+    ret = false;
+
+  _staticLibFree(&lib);
+  _staticLibFree(&previous);
+
+  return ret;
+}
+
+int _compareNames(const void* a, const void* b)
+{
+  return strcmp(*(const char**)a, *(const char**)b);
+}
+
+// Mocks every global function defined in a static lib. C mock files need the lib compiled with debug info (-g) for
+// describing the functions and the ones that can not be described are left unmocked, object mock files need no types
+bool createAllMocks(char* libPath, char* mockableLibPath, char* mockFilePath)
+{
+  _StaticLib lib;
+  if(!_staticLibRead(&lib, libPath)) return false;
+
+  int nameCount = 0;
+  const char** names = 0;
+  for(int i = 0; i < lib.fileCount; i++)
+  {
+    const char** fileNames;
+    int fileNameCount = _objectFileGlobalFunctions(&lib.files[i], &fileNames, 0);
+    names = (const char**)realloc(names, sizeof(char*)*(nameCount + fileNameCount + 1));
+    memcpy(names + nameCount, fileNames, sizeof(char*)*fileNameCount);
+    nameCount += fileNameCount;
+    free(fileNames);
+  }
+  qsort(names, nameCount, sizeof(char*), _compareNames);
+
+  FunctionDescriptor* debugFunctions = 0;
+  bool needsTypes = !_isObjectFilePath(mockFilePath);
+  int debugFunctionCount = needsTypes ? _debugInfoReadLibFunctions(&lib, &debugFunctions) : 0;
+  FunctionDescriptor* functions = (FunctionDescriptor*)malloc(sizeof(FunctionDescriptor)*(nameCount + 1));
+  int functionCount = 0, skipped = 0;
+  for(int i = 0; i < nameCount; i++)
+  {
+    // Weak functions may be defined by several objects
+    if(i && strcmp(names[i - 1], names[i]) == 0) continue;
+    FunctionDescriptor function = {0, names[i], 0, 0};
+    FunctionDescriptor* found = needsTypes ?
+      (FunctionDescriptor*)bsearch(&function, debugFunctions, debugFunctionCount, sizeof(FunctionDescriptor), _compareFunctionDescriptors) : 0;
+    if(found) function = *found;
+    if(needsTypes && !found) skipped++;
+    else functions[functionCount++] = function;
+  }
+  if(skipped)
+    printf("%i functions of %s could not be described from its debug info and are left unmocked\n", skipped, libPath);
+
+  bool ret = createMocks(libPath, mockableLibPath, mockFilePath, functionCount, functions);
+  freeFunctionDescriptors(debugFunctionCount, debugFunctions);
+  free(functions);
+  free(names);
+  _staticLibFree(&lib);
+  return ret;
+}
+
+typedef struct _ObjectMockJob _ObjectMockJob;
+
+struct _ObjectMockJob
+{
+  char** objectPaths;
+  char* objectsPath;
+  char* outputPath;
+  int renameCount;
+  _ObjectFileRename* renames;
+  bool* succeeded;
+};
+
+int _findObjectFiles(char* path, char*** output, int count)
+{
+  if(!_isDirectory(path))
+  {
+    int length = strlen(path);
+    if(length > 2 && strcmp(path + length - 2, ".o") == 0)
+    {
+      *output = (char**)realloc(*output, sizeof(char*)*(count + 1));
+      (*output)[count] = (char*)malloc(length + 1);
+      strcpy((*output)[count++], path);
+    }
+    return count;
+  }
+
+  int entryCount = _listFiles(path, 0);
+  char* entries[entryCount + 1];
+  _listFiles(path, entries);
+  for(int i = 0; i < entryCount; i++)
+  {
+    count = _findObjectFiles(entries[i], output, count);
+    free(entries[i]);
+  }
+  return count;
+}
+
+// Rewrites one object into the same relative path under the output, objects without mocked functions are copied as they are
+void _createObjectMocksForFile(void* data, int index)
+{
+  _ObjectMockJob* job = (_ObjectMockJob*)data;
+  char* objectPath = job->objectPaths[index];
+  char* relativePath = objectPath + strlen(job->objectsPath);
+  char outputPath[strlen(job->outputPath) + strlen(relativePath) + 2];
+  strcpy(outputPath, job->outputPath);
+  if(*relativePath && *relativePath != '/' && outputPath[strlen(outputPath)-1] != '/') strcat(outputPath, "/");
+  strcat(outputPath, relativePath);
+
+  _MappedFile source;
+  job->succeeded[index] = false;
+  if(!_mapFile(objectPath, &source)) return;
+
+  _StaticLibFile object;
+  memset(&object, 0, sizeof(_StaticLibFile));
+  object.content = source.data;
+  object.contentSize = source.size;
+  if(_objectFileMockFunctions(&object, job->renameCount, job->renames) && _makeParentDirectories(outputPath))
+  {
+    FILE* file = fopen(outputPath, "wb");
+    if(file)
+    {
+      job->succeeded[index] = fwrite(object.content, 1, object.contentSize, file) == (size_t)object.contentSize;
+      job->succeeded[index] &= fclose(file) == 0;
+    }
+  }
+
+  if(object.ownsContent) free(object.content);
+  _unmapFile(&source);
+}
+
+// Tells whether path is directory or somewhere under it, comparing the paths as written
+bool _isPathInside(char* path, char* directory)
+{
+  int length = strlen(directory);
+  while(length > 1 && directory[length - 1] == '/') length--;
+  return strncmp(path, directory, length) == 0 && (path[length] == '/' || path[length] == '\0');
+}
+
+// Mocks the functions directly on relocatable objects, without an archive
+// objectsPath is either a single .o file written to outputPath or a directory whose .o files are rewritten recursively
+// into the same relative paths under outputPath, which can not be inside it
+bool createObjectMocks(char* objectsPath, char* outputPath, char* mockFilePath, int functionCount, FunctionDescriptor* functions)
+{
+  if(_isDirectory(objectsPath) && _isPathInside(outputPath, objectsPath))
+  {
+    printf("Could not mock the objects of %s, the output %s is inside it and would be mocked again\n", objectsPath, outputPath);
+    return false;
+  }
+
+  char** objectPaths = 0;
+  int objectCount = _findObjectFiles(objectsPath, &objectPaths, 0);
+
+  char* mockedNames;
+  _ObjectFileRename* renames = _createMockRenames(functionCount, functions, &mockedNames);
+  bool succeeded[objectCount + 1];
+  _ObjectMockJob job = {objectPaths, objectsPath, outputPath, functionCount, renames, succeeded};
+  _runInParallel(objectCount, _createObjectMocksForFile, &job);
+
+  bool ret = objectCount > 0;
+  for(int i = 0; i < objectCount; i++)
+  {
+    if(!succeeded[i])
+      printf("Could not mock object file %s. Supported formats are ELF64. Symbols must be relocatable. Maybe try adding --fPIC to your compiler flags?\n",
+            objectPaths[i]);
+    ret &= succeeded[i];
+    free(objectPaths[i]);
+  }
+  if(objectPaths) free(objectPaths);
+  free(renames);
+  free(mockedNames);
+
+  return ret && _createMockFile(mockFilePath, functionCount, functions, _MOCK_FILE_MODE_ARCHIVE | mockFileOptions);
+}
+
+// Mocks functions of a shared library without rewriting it
+// The generated mock file defines the functions in the test binary, interposing the library ones, and reaches the
+// originals through dlsym(RTLD_NEXT, ...) when loaded or on their first call. Tests link the mock file and the original
+// shared library.
+bool createSharedMocks(char* mockFilePath, int functionCount, FunctionDescriptor* functions)
+{
+  return _createMockFile(mockFilePath, functionCount, functions, _MOCK_FILE_MODE_INTERPOSE);
+}
+// This content is part of test.h
+// Allocation tracking, enabled by defining BTR_TRACK_ALLOCATIONS before including test.h
+// The test binary replaces malloc, calloc, realloc, free and the aligned allocations, which glibc supports for the whole
+// process. Sizes are the ones requested, not the ones the allocator rounded the blocks up to
+
+typedef struct AllocationStats AllocationStats;
+
+// Counted from the start of the running test, blocks allocated before it are not part of liveBlocks or liveBytes
+struct AllocationStats
+{
+  long long allocations;
+  long long frees;
+  long long bytes;
+  long long liveBlocks;
+  long long liveBytes;
+  long long peakLiveBytes;
+};
+
+AllocationStats allocationStats = {0};
+
+#ifdef BTR_TRACK_ALLOCATIONS
+#ifndef __GLIBC__
+#error "BTR_TRACK_ALLOCATIONS is only supported with glibc"
+#endif
+#include <malloc.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define assert_allocations(expression, maxAllocations) do{\
+    long long _allocationsBefore = allocationStats.allocations;\
+    expression;\
+    _assert(_C_STRING_LITERAL(__FILE__), __LINE__, allocationStats.allocations - _allocationsBefore <= (maxAllocations),\
+      _C_STRING_LITERAL("at most " #maxAllocations " allocations in " #expression));\
+  }while(0)
+#define assert_no_allocations(expression) assert_allocations(expression, 0)
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* block, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* block);
+
+// The size the block was requested with, as the allocator may round it up
+typedef struct
+{
+  void* block;
+  size_t size;
+} _AllocationEntry;
+
+// Open addressing set of the blocks allocated by the running test
+typedef struct
+{
+  _AllocationEntry* entries;
+  size_t capacity;
+  size_t count;
+} _AllocationSet;
+
+_AllocationSet _testAllocations;
+bool _allocationTracking = false;
+int _allocationLock = 0;
+char* _allocationTestContext;
+char* _allocationTestDescription;
+char _stdoutBuffer[BUFSIZ];
+
+size_t _allocationSlot(_AllocationSet* set, void* block)
+{
+  size_t slot = ((uintptr_t)block >> 4)*0x9E3779B97F4A7C15ULL & (set->capacity - 1);
+  while(set->entries[slot].block && set->entries[slot].block != block)
+    slot = (slot + 1) & (set->capacity - 1);
+  return slot;
+}
+
+void _allocationSetAdd(_AllocationSet* set, void* block, size_t size)
+{
+  if((set->count + 1)*2 > set->capacity)
+  {
+    size_t capacity = set->capacity ? set->capacity*2 : 1024;
+    _AllocationSet grown = {(_AllocationEntry*)__libc_calloc(capacity, sizeof(_AllocationEntry)), capacity, set->count};
+    if(!grown.entries) return;
+    for(size_t i = 0; i < set->capacity; i++)
+      if(set->entries[i].block) grown.entries[_allocationSlot(&grown, set->entries[i].block)] = set->entries[i];
+    __libc_free(set->entries);
+    *set = grown;
+  }
+  size_t slot = _allocationSlot(set, block);
+  if(!set->entries[slot].block) set->count++;
+  set->entries[slot].block = block;
+  set->entries[slot].size = size;
+}
+
+// Gives the size the block was allocated with, or -1 when it is not in the set
+long long _allocationSetRemove(_AllocationSet* set, void* block)
+{
+  if(!set->count) return -1;
+  size_t slot = _allocationSlot(set, block);
+  if(!set->entries[slot].block) return -1;
+  long long size = set->entries[slot].size;
+  set->entries[slot].block = 0;
+  set->count--;
+  // Moves back the entries of the same probe sequence so lookups do not stop at the hole
+  for(size_t next = (slot + 1) & (set->capacity - 1); set->entries[next].block; next = (next + 1) & (set->capacity - 1))
+  {
+    _AllocationEntry moved = set->entries[next];
+    set->entries[next].block = 0;
+    set->entries[_allocationSlot(set, moved.block)] = moved;
+  }
+  return size;
+}
+
+bool _shouldTrackAllocation()
+{
+  return _allocationTracking && !_untrackedAllocations;
+}
+
+void _trackAllocation(void* block, size_t size)
+{
+  if(!block || !_shouldTrackAllocation()) return;
+  while(__sync_lock_test_and_set(&_allocationLock, 1));
+  _allocationSetAdd(&_testAllocations, block, size);
+  allocationStats.allocations++;
+  allocationStats.bytes += size;
+  allocationStats.liveBlocks++;
+  allocationStats.liveBytes += size;
+  if(allocationStats.liveBytes > allocationStats.peakLiveBytes) allocationStats.peakLiveBytes = allocationStats.liveBytes;
+  __sync_lock_release(&_allocationLock);
+}
+
+// Gives the size the freed block was allocated with, or -1 when the test did not allocate it
+long long _trackFree(void* block)
+{
+  if(!block || !_shouldTrackAllocation()) return -1;
+  while(__sync_lock_test_and_set(&_allocationLock, 1));
+  allocationStats.frees++;
+  long long size = _allocationSetRemove(&_testAllocations, block);
+  if(size >= 0)
+  {
+    allocationStats.liveBlocks--;
+    allocationStats.liveBytes -= size;
+  }
+  __sync_lock_release(&_allocationLock);
+  return size;
+}
+
+// Undoes _trackFree for a block that is still allocated
+void _untrackFree(void* block, long long size)
+{
+  if(!block || !_shouldTrackAllocation()) return;
+  while(__sync_lock_test_and_set(&_allocationLock, 1));
+  allocationStats.frees--;
+  if(size >= 0)
+  {
+    _allocationSetAdd(&_testAllocations, block, size);
+    allocationStats.liveBlocks++;
+    allocationStats.liveBytes += size;
+  }
+  __sync_lock_release(&_allocationLock);
+}
+
+void* malloc(size_t size) _BTR_NOTHROW
+{
+  void* block = __libc_malloc(size);
+  _trackAllocation(block, size);
+  return block;
+}
+
+void* calloc(size_t count, size_t size) _BTR_NOTHROW
+{
+  void* block = __libc_calloc(count, size);
+  _trackAllocation(block, count*size);
+  return block;
+}
+
+void* realloc(void* block, size_t size) _BTR_NOTHROW
+{
+  // Untracked first, as once moved another thread may be given the same address
+  long long previousSize = _trackFree(block);
+  void* moved = __libc_realloc(block, size);
+  // A failed realloc leaves the block allocated
+  if(moved || !size) _trackAllocation(moved, size);
+  else _untrackFree(block, previousSize);
+  return moved;
+}
+
+void* memalign(size_t alignment, size_t size) _BTR_NOTHROW
+{
+  void* block = __libc_memalign(alignment, size);
+  _trackAllocation(block, size);
+  return block;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) _BTR_NOTHROW
+{
+  return memalign(alignment, size);
+}
+
+int posix_memalign(void** output, size_t alignment, size_t size) _BTR_NOTHROW
+{
+  if(!alignment || alignment % sizeof(void*) || (alignment & (alignment - 1))) return EINVAL;
+  void* block = memalign(alignment, size);
+  if(!block) return ENOMEM;
+  *output = block;
+  return 0;
+}
+
+void free(void* block) _BTR_NOTHROW
+{
+  _trackFree(block);
+  __libc_free(block);
+}
+
+// Reports the blocks the test allocated and never freed
+void _writeLeakReport()
+{
+  _allocationTracking = false;
+  if(allocationStats.liveBlocks > 0)
+    printf("\n[LEAK] on \"%s\" test \"%s\" %lli blocks (%lli bytes) were not freed\n", _allocationTestContext,
+      _allocationTestDescription, allocationStats.liveBlocks, allocationStats.liveBytes);
+}
+
+void _startAllocationTracking(char* context, char* description)
+{
+  _allocationTestContext = context;
+  _allocationTestDescription = description;
+  static bool reportRegistered = false;
+  if(!reportRegistered)
+  {
+    reportRegistered = true;
+    atexit(_writeLeakReport);
+    // Otherwise stdio allocates its buffer on the first output of the test, which is never freed
+    setvbuf(stdout, _stdoutBuffer, isatty(fileno(stdout)) ? _IOLBF : _IOFBF, sizeof(_stdoutBuffer));
+  }
+  while(__sync_lock_test_and_set(&_allocationLock, 1));
+  memset(&allocationStats, 0, sizeof(allocationStats));
+  if(_testAllocations.entries) memset(_testAllocations.entries, 0, _testAllocations.capacity*sizeof(_AllocationEntry));
+  _testAllocations.count = 0;
+  _allocationTracking = true;
+  __sync_lock_release(&_allocationLock);
+}
+#else
+void _startAllocationTracking(char* context, char* description){}
+#endif
+// This content is part of test.h
+// Virtual clock, enabled by defining BTR_VIRTUAL_CLOCK before including test.h
+// The test binary replaces the sleep and clock functions so that during a test sleeping advances the clock instantly.
+// Every test starts from the real time and only moves with sleeps and virtualClockAdvance. The clock is real again once
+// the test passes or fails, so cleanFunction and the atexit handlers sleep and read the time for real
+
+#if defined(BTR_VIRTUAL_CLOCK) || defined(BTR_MEMORY_FILES)
+#include <dlfcn.h>
+#ifndef RTLD_NEXT
+// Only declared with _GNU_SOURCE by glibc, the value is the same everywhere
+#define RTLD_NEXT ((void*)-1l)
+#endif
+
+// The libc function hidden by a replacement defined in the test binary
+void* _realFunction(const char* name)
+{
+  return dlsym(RTLD_NEXT, name);
+}
+#endif
+
+#ifdef BTR_VIRTUAL_CLOCK
+#ifdef _WIN32
+#error "BTR_VIRTUAL_CLOCK is not supported on Windows"
+#endif
+#include <unistd.h>
+#include <sys/time.h>
+
+bool _virtualClockRunning = false;
+unsigned long long _virtualClockElapsed = 0;
+struct timespec _virtualClockMonotonicStart, _virtualClockRealStart;
+int (*_realClockGettime)(clockid_t clock, struct timespec* time) = 0;
+
+// The framework keeps measuring with the real clock through this
+int _clockGettime(clockid_t clock, struct timespec* time)
+{
+  if(!_realClockGettime)
+    *(void**)&_realClockGettime = _realFunction("clock_gettime");
+  return _realClockGettime(clock, time);
+}
+
+void _startVirtualClock()
+{
+  _clockGettime(CLOCK_MONOTONIC, &_virtualClockMonotonicStart);
+  _clockGettime(CLOCK_REALTIME, &_virtualClockRealStart);
+  _virtualClockElapsed = 0;
+  _virtualClockRunning = true;
+}
+
+void _stopVirtualClock()
+{
+  _virtualClockRunning = false;
+}
+
+void virtualClockAdvance(unsigned long long nanoseconds)
+{
+  __sync_fetch_and_add(&_virtualClockElapsed, nanoseconds);
+}
+
+unsigned long long virtualClockElapsed()
+{
+  return __sync_fetch_and_add(&_virtualClockElapsed, 0);
+}
+
+struct timespec _virtualClockTime(struct timespec start)
+{
+  unsigned long long nanoseconds = start.tv_nsec + virtualClockElapsed();
+  struct timespec now = {(time_t)(start.tv_sec + nanoseconds/1000000000ULL), (long)(nanoseconds%1000000000ULL)};
+  return now;
+}
+
+bool _isVirtualClock(clockid_t clock)
+{
+  if(!_virtualClockRunning) return false;
+  switch(clock)
+  {
+    case CLOCK_REALTIME: case CLOCK_MONOTONIC:
+#ifdef __linux__
+    case CLOCK_REALTIME_COARSE: case CLOCK_MONOTONIC_COARSE: case CLOCK_MONOTONIC_RAW: case CLOCK_BOOTTIME:
+#endif
+      return true;
+    default:
+      // CPU time clocks keep running for real
+      return false;
+  }
+}
+
+bool _isRealtimeClock(clockid_t clock)
+{
+#ifdef __linux__
+  if(clock == CLOCK_REALTIME_COARSE) return true;
+#endif
+  return clock == CLOCK_REALTIME;
+}
+
+int clock_gettime(clockid_t clock, struct timespec* time) _BTR_NOTHROW
+{
+  if(!_isVirtualClock(clock)) return _clockGettime(clock, time);
+  *time = _virtualClockTime(_isRealtimeClock(clock) ? _virtualClockRealStart : _virtualClockMonotonicStart);
+  return 0;
+}
+
+int gettimeofday(struct timeval* time, void* timezone) _BTR_NOTHROW
+{
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  time->tv_sec = now.tv_sec;
+  time->tv_usec = now.tv_nsec/1000;
+  return 0;
+}
+
+time_t time(time_t* output) _BTR_NOTHROW
+{
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  if(output) *output = now.tv_sec;
+  return now.tv_sec;
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const struct timespec* request, struct timespec* remaining)
+{
+  if(!_isVirtualClock(clock))
+  {
+    static int (*realSleep)(clockid_t, int, const struct timespec*, struct timespec*) = 0;
+    if(!realSleep) *(void**)&realSleep = _realFunction("clock_nanosleep");
+    return realSleep(clock, flags, request, remaining);
+  }
+  unsigned long long duration = request->tv_sec*1000000000ULL + request->tv_nsec;
+  if(flags & TIMER_ABSTIME)
+  {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    unsigned long long current = now.tv_sec*1000000000ULL + now.tv_nsec;
+    duration = duration > current ? duration - current : 0;
+  }
+  virtualClockAdvance(duration);
+  if(remaining && !(flags & TIMER_ABSTIME)) remaining->tv_sec = remaining->tv_nsec = 0;
+  return 0;
+}
+
+int nanosleep(const struct timespec* request, struct timespec* remaining)
+{
+  if(!_virtualClockRunning)
+  {
+    static int (*realSleep)(const struct timespec*, struct timespec*) = 0;
+    if(!realSleep) *(void**)&realSleep = _realFunction("nanosleep");
+    return realSleep(request, remaining);
+  }
+  return clock_nanosleep(CLOCK_MONOTONIC, 0, request, remaining);
+}
+
+int usleep(useconds_t microseconds)
+{
+  struct timespec request = {(time_t)(microseconds/1000000), (long)(microseconds%1000000)*1000};
+  return nanosleep(&request, 0);
+}
+
+unsigned int sleep(unsigned int seconds)
+{
+  struct timespec request = {(time_t)seconds, 0}, remaining = {0, 0};
+  if(nanosleep(&request, &remaining) == 0) return 0;
+  return (unsigned int)remaining.tv_sec + (remaining.tv_nsec > 0);
+}
+#else
+void _startVirtualClock(){}
+void _stopVirtualClock(){}
+#ifndef _WIN32
+int _clockGettime(clockid_t clock, struct timespec* time)
+{
+  return clock_gettime(clock, time);
+}
+#endif
+#endif
+// This content is part of test.h
+// In memory files, enabled by defining BTR_MEMORY_FILES before including test.h
+// The test binary replaces open, openat, fopen, stat, access, unlink, remove, rename and mkdir so that paths under
+// memoryFilesPrefix name memfd files instead of files on disk. They get real descriptors, so read, write, fread,
+// fwrite, lseek and close work unchanged. Directories only exist while they have files, so mkdir does nothing for them.
+// Other calls taking paths, such as the *at functions given a relative path, see the files on disk.
+// Every test starts with no files
+
+char* memoryFilesPrefix = _C_STRING_LITERAL("/memory/");
+
+#ifdef BTR_MEMORY_FILES
+#ifndef __linux__
+#error "BTR_MEMORY_FILES is only supported on Linux"
+#endif
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+// O_TMPFILE takes a mode too, glibc tells which flags do
+#ifdef __OPEN_NEEDS_MODE
+#define _openNeedsMode(flags) __OPEN_NEEDS_MODE(flags)
+#else
+#define _openNeedsMode(flags) ((flags) & O_CREAT)
+#endif
+
+typedef struct
+{
+  char* path;
+  int descriptor;
+} _MemoryFile;
+
+_MemoryFile* _memoryFiles = 0;
+int _memoryFilesCount = 0;
+int _memoryFilesCapacity = 0;
+int _memoryFilesLock = 0;
+
+bool _isMemoryFilePath(const char* path)
+{
+  return path && strncmp(path, memoryFilesPrefix, strlen(memoryFilesPrefix)) == 0;
+}
+
+_MemoryFile* _findMemoryFile(const char* path)
+{
+  for(int i = 0; i < _memoryFilesCount; i++)
+    if(strcmp(_memoryFiles[i].path, path) == 0) return &_memoryFiles[i];
+  return 0;
+}
+
+_MemoryFile* _createMemoryFile(const char* path)
+{
+  int descriptor = syscall(SYS_memfd_create, "btr", 0);
+  if(descriptor < 0) return 0;
+  _untrackedAllocations++;
+  if(_memoryFilesCount == _memoryFilesCapacity)
+  {
+    _memoryFilesCapacity = _memoryFilesCapacity ? _memoryFilesCapacity*2 : 16;
+    _memoryFiles = (_MemoryFile*)realloc(_memoryFiles, sizeof(_MemoryFile)*_memoryFilesCapacity);
+  }
+  _MemoryFile* file = &_memoryFiles[_memoryFilesCount++];
+  file->path = strdup(path);
+  file->descriptor = descriptor;
+  _untrackedAllocations--;
+  return file;
+}
+
+// Opens a new description of the memfd through /proc, so every open has its own offset and flags
+int _openMemoryFile(const char* path, int flags, mode_t mode)
+{
+  while(__sync_lock_test_and_set(&_memoryFilesLock, 1));
+  _MemoryFile* file = _findMemoryFile(path);
+  int error = 0;
+  if(file && (flags & O_CREAT) && (flags & O_EXCL)) error = EEXIST;
+  else if(!file && !(flags & O_CREAT)) error = ENOENT;
+  else if(!file && !(file = _createMemoryFile(path))) error = EMFILE;
+  int descriptor = -1;
+  if(!error)
+  {
+    char procPath[64];
+    sprintf(procPath, "/proc/self/fd/%i", file->descriptor);
+    descriptor = openat(AT_FDCWD, procPath, flags & ~(O_CREAT | O_EXCL), mode);
+  }
+  __sync_lock_release(&_memoryFilesLock);
+  if(error) errno = error;
+  return descriptor;
+}
+
+int _statMemoryFile(const char* path, struct stat* status)
+{
+  while(__sync_lock_test_and_set(&_memoryFilesLock, 1));
+  _MemoryFile* file = _findMemoryFile(path);
+  int result = file ? fstat(file->descriptor, status) : -1;
+  size_t length = strlen(path);
+  // Directories exist as long as there are files in them
+  for(int i = 0; !file && i < _memoryFilesCount; i++)
+    if(strncmp(_memoryFiles[i].path, path, length) == 0 && (path[length - 1] == '/' || _memoryFiles[i].path[length] == '/'))
+    {
+      memset(status, 0, sizeof(*status));
+      status->st_mode = S_IFDIR | 0755;
+      result = 0;
+      break;
+    }
+  __sync_lock_release(&_memoryFilesLock);
+  if(result < 0 && !file) errno = ENOENT;
+  return result;
+}
+
+void _removeMemoryFile(_MemoryFile* file)
+{
+  close(file->descriptor);
+  _untrackedAllocations++;
+  free(file->path);
+  _untrackedAllocations--;
+  *file = _memoryFiles[--_memoryFilesCount];
+}
+
+int _unlinkMemoryFile(const char* path)
+{
+  while(__sync_lock_test_and_set(&_memoryFilesLock, 1));
+  _MemoryFile* file = _findMemoryFile(path);
+  if(file) _removeMemoryFile(file);
+  __sync_lock_release(&_memoryFilesLock);
+  if(!file) errno = ENOENT;
+  return file ? 0 : -1;
+}
+
+// Replaces the file at the new path, if any, as rename does
+int _renameMemoryFile(const char* from, const char* to)
+{
+  while(__sync_lock_test_and_set(&_memoryFilesLock, 1));
+  _MemoryFile* file = _findMemoryFile(from);
+  _MemoryFile* replaced = _findMemoryFile(to);
+  if(file && replaced && replaced != file)
+  {
+    _removeMemoryFile(replaced);
+    file = _findMemoryFile(from);
+  }
+  if(file)
+  {
+    _untrackedAllocations++;
+    char* path = strdup(to);
+    _untrackedAllocations--;
+    if(path)
+    {
+      _untrackedAllocations++;
+      free(file->path);
+      _untrackedAllocations--;
+      file->path = path;
+    }
+    else
+      file = 0;
+  }
+  __sync_lock_release(&_memoryFilesLock);
+  if(!file) errno = ENOENT;
+  return file ? 0 : -1;
+}
+
+void _resetMemoryFiles()
+{
+  while(__sync_lock_test_and_set(&_memoryFilesLock, 1));
+  _untrackedAllocations++;
+  for(int i = 0; i < _memoryFilesCount; i++)
+  {
+    close(_memoryFiles[i].descriptor);
+    free(_memoryFiles[i].path);
+  }
+  _untrackedAllocations--;
+  _memoryFilesCount = 0;
+  __sync_lock_release(&_memoryFilesLock);
+}
+
+int _openFlagsForMode(const char* mode)
+{
+  int flags = strchr(mode, '+') ? O_RDWR : mode[0] == 'r' ? O_RDONLY : O_WRONLY;
+  if(mode[0] == 'w') flags |= O_CREAT | O_TRUNC;
+  if(mode[0] == 'a') flags |= O_CREAT | O_APPEND;
+  if(strchr(mode, 'x')) flags |= O_EXCL;
+  return flags;
+}
+
+int openat(int directory, const char* path, int flags, ...)
+{
+  mode_t mode = 0;
+  if(_openNeedsMode(flags))
+  {
+    va_list args;
+    va_start(args, flags);
+    mode = va_arg(args, int);
+    va_end(args);
+  }
+  // Memory file paths are absolute, so the directory does not change them
+  if(_isMemoryFilePath(path)) return _openMemoryFile(path, flags, mode);
+  static int (*realOpen)(int, const char*, int, ...) = 0;
+  if(!realOpen) *(void**)&realOpen = _realFunction("openat");
+  return realOpen(directory, path, flags, mode);
+}
+
+int open(const char* path, int flags, ...)
+{
+  mode_t mode = 0;
+  if(_openNeedsMode(flags))
+  {
+    va_list args;
+    va_start(args, flags);
+    mode = va_arg(args, int);
+    va_end(args);
+  }
+  if(_isMemoryFilePath(path)) return _openMemoryFile(path, flags, mode);
+  return openat(AT_FDCWD, path, flags, mode);
+}
+
+FILE* fopen(const char* path, const char* mode)
+{
+  if(!_isMemoryFilePath(path))
+  {
+    static FILE* (*realOpen)(const char*, const char*) = 0;
+    if(!realOpen) *(void**)&realOpen = _realFunction("fopen");
+    return realOpen(path, mode);
+  }
+  int descriptor = _openMemoryFile(path, _openFlagsForMode(mode), 0666);
+  if(descriptor < 0) return 0;
+  FILE* file = fdopen(descriptor, mode);
+  if(!file) close(descriptor);
+  return file;
+}
+
+int stat(const char* path, struct stat* status) _BTR_NOTHROW
+{
+  if(_isMemoryFilePath(path)) return _statMemoryFile(path, status);
+  return fstatat(AT_FDCWD, path, status, 0);
+}
+
+int unlink(const char* path) _BTR_NOTHROW
+{
+  if(_isMemoryFilePath(path)) return _unlinkMemoryFile(path);
+  return unlinkat(AT_FDCWD, path, 0);
+}
+
+int access(const char* path, int mode) _BTR_NOTHROW
+{
+  struct stat status;
+  if(_isMemoryFilePath(path)) return _statMemoryFile(path, &status);
+  return faccessat(AT_FDCWD, path, mode, 0);
+}
+
+int remove(const char* path) _BTR_NOTHROW
+{
+  if(!_isMemoryFilePath(path))
+  {
+    static int (*realRemove)(const char*) = 0;
+    if(!realRemove) *(void**)&realRemove = _realFunction("remove");
+    return realRemove(path);
+  }
+  struct stat status;
+  if(_unlinkMemoryFile(path) == 0) return 0;
+  // A directory that exists has files in it
+  if(_statMemoryFile(path, &status) == 0) errno = ENOTEMPTY;
+  return -1;
+}
+
+int rename(const char* from, const char* to) _BTR_NOTHROW
+{
+  if(_isMemoryFilePath(from) && _isMemoryFilePath(to)) return _renameMemoryFile(from, to);
+  if(!_isMemoryFilePath(from) && !_isMemoryFilePath(to)) return renameat(AT_FDCWD, from, AT_FDCWD, to);
+  errno = EXDEV;
+  return -1;
+}
+
+int mkdir(const char* path, mode_t mode) _BTR_NOTHROW
+{
+  if(!_isMemoryFilePath(path)) return mkdirat(AT_FDCWD, path, mode);
+  while(__sync_lock_test_and_set(&_memoryFilesLock, 1));
+  bool exists = _findMemoryFile(path) != 0;
+  __sync_lock_release(&_memoryFilesLock);
+  if(exists) errno = EEXIST;
+  return exists ? -1 : 0;
+}
+
+// With _FILE_OFFSET_BITS=64 the functions above already are the 64 bit variants
+#ifndef __USE_FILE_OFFSET64
+int open64(const char* path, int flags, ...)
+{
+  mode_t mode = 0;
+  if(_openNeedsMode(flags))
+  {
+    va_list args;
+    va_start(args, flags);
+    mode = va_arg(args, int);
+    va_end(args);
+  }
+  return open(path, flags, mode);
+}
+
+int openat64(int directory, const char* path, int flags, ...)
+{
+  mode_t mode = 0;
+  if(_openNeedsMode(flags))
+  {
+    va_list args;
+    va_start(args, flags);
+    mode = va_arg(args, int);
+    va_end(args);
+  }
+  return openat(directory, path, flags, mode);
+}
+
+FILE* fopen64(const char* path, const char* mode)
+{
+  return fopen(path, mode);
+}
+#endif
+#else
+void _resetMemoryFiles(){}
+#endif
+// This content is part of test.h
+// Platform specific functions
+
+#ifdef _WIN32
+#include <windows.h>
+
+int _listFiles(char* path, char** output)
+{
+  char basePath[MAX_PATH];
+	char wildPath[MAX_PATH];
+	int fileCount = 0;
+	WIN32_FIND_DATA ffd;
+	HANDLE hFind = INVALID_HANDLE_VALUE;
+
+	strcpy(basePath, path);
+  if(path[strlen(path-1)] != '/')
+    strcat(basePath, "/");
+  strcpy(wildPath, basePath);
+	strcat(wildPath,"*");
+
+	int basePathLength = strlen(basePath);
+	hFind = FindFirstFile(wildPath, &ffd);
+	if (INVALID_HANDLE_VALUE == hFind)
+	  return 0;
+
+	do
 	{
 	  if(strcmp(".", ffd.cFileName) != 0 && strcmp("..", ffd.cFileName) != 0)
 	  {
@@ -1122,11 +4981,191 @@ int _listFiles(char* path, char** output)
 
 	return fileCount;
 }
+
+bool _mapFile(char* path, _MappedFile* out)
+{
+  memset(out, 0, sizeof(_MappedFile));
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+  if(file == INVALID_HANDLE_VALUE) return false;
+
+  LARGE_INTEGER size;
+  HANDLE mapping = 0;
+  if(GetFileSizeEx(file, &size) && size.QuadPart > 0)
+    mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+  if(mapping)
+    out->data = (char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if(!out->data)
+  {
+    if(mapping) CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+
+  out->size = size.QuadPart;
+  out->handle = (intptr_t)file;
+  out->mapping = (intptr_t)mapping;
+  return true;
+}
+
+void _unmapFile(_MappedFile* file)
+{
+  if(file->data) UnmapViewOfFile(file->data);
+  if(file->mapping) CloseHandle((HANDLE)file->mapping);
+  if(file->handle) CloseHandle((HANDLE)file->handle);
+  memset(file, 0, sizeof(_MappedFile));
+}
+
+bool _copyFileRange(FILE* output, _MappedFile* source, long long offset, long long size)
+{
+  return fwrite(source->data + offset, 1, size, output) == (size_t)size;
+}
+
+bool _makeParentDirectories(char* path)
+{
+  char directory[strlen(path) + 1];
+  strcpy(directory, path);
+  for(char* separator = directory + 1; *separator; separator++)
+  {
+    if(*separator != '/' && *separator != '\\') continue;
+    char aux = *separator;
+    *separator = '\0';
+    if(!CreateDirectoryA(directory, 0) && GetLastError() != ERROR_ALREADY_EXISTS) return false;
+    *separator = aux;
+  }
+  return true;
+}
+
+bool _writeCode(void* address, const void* code, int size)
+{
+  DWORD protection;
+  if(!VirtualProtect(address, size, PAGE_EXECUTE_READWRITE, &protection)) return false;
+  memcpy(address, code, size);
+  VirtualProtect(address, size, protection, &protection);
+  FlushInstructionCache(GetCurrentProcess(), address, size);
+  return true;
+}
+
+long long _functionSize(void* address)
+{
+  return -1;
+}
+
+typedef struct
+{
+  volatile LONG next;
+  int jobCount;
+  void (*job)(void* data, int index);
+  void* data;
+} _ParallelJobs;
+
+DWORD WINAPI _parallelWorker(LPVOID parameter)
+{
+  _ParallelJobs* jobs = (_ParallelJobs*)parameter;
+  for(int index; (index = InterlockedIncrement(&jobs->next) - 1) < jobs->jobCount;)
+    jobs->job(jobs->data, index);
+  return 0;
+}
+
+unsigned long long _monotonicTime()
+{
+  LARGE_INTEGER counter, frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  return counter.QuadPart/frequency.QuadPart*1000000000ULL + counter.QuadPart%frequency.QuadPart*1000000000ULL/frequency.QuadPart;
+}
+
+unsigned long long _currentThreadId()
+{
+  return GetCurrentThreadId();
+}
+
+void _runInParallel(int jobCount, void (*job)(void* data, int index), void* data)
+{
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  int threadCount = info.dwNumberOfProcessors < (DWORD)jobCount ? (int)info.dwNumberOfProcessors : jobCount;
+  _ParallelJobs jobs = {0, jobCount, job, data};
+  HANDLE threads[threadCount > 1 ? threadCount : 1];
+  int started = 0;
+  for(int i = 1; i < threadCount; i++)
+    if((threads[started] = CreateThread(0, 0, _parallelWorker, &jobs, 0, 0))) started++;
+  _parallelWorker(&jobs);
+  WaitForMultipleObjects(started, threads, TRUE, INFINITE);
+  for(int i = 0; i < started; i++)
+    CloseHandle(threads[i]);
+}
+
+typedef struct
+{
+  void (*job)(void* data, int index);
+  void* data;
+  int index;
+  HANDLE handle;
+} _Thread;
+
+DWORD WINAPI _threadMain(LPVOID parameter)
+{
+  _Thread* thread = (_Thread*)parameter;
+  thread->job(thread->data, thread->index);
+  return 0;
+}
+
+// Runs the job on a new thread for each index from 1 to count - 1, index 0 being left for the caller
+// startedCount gets the number of threads running the job, counting the caller
+void* _startThreads(int count, void (*job)(void* data, int index), void* data, int* startedCount)
+{
+  *startedCount = 1;
+  _Thread* threads = (_Thread*)calloc(count, sizeof(_Thread));
+  for(int i = 1; i < count; i++)
+  {
+    threads[i] = (_Thread){job, data, i, 0};
+    threads[i].handle = CreateThread(0, 0, _threadMain, &threads[i], 0, 0);
+    if(threads[i].handle) (*startedCount)++;
+  }
+  return threads;
+}
+
+void _joinThreads(void* threads, int count)
+{
+  _Thread* started = (_Thread*)threads;
+  for(int i = 1; i < count; i++)
+    if(started[i].handle)
+    {
+      WaitForSingleObject(started[i].handle, INFINITE);
+      CloseHandle(started[i].handle);
+    }
+  free(started);
+}
+
+void _exitThread()
+{
+  ExitThread(0);
+}
+
+bool _startProfiler(char* path)
+{
+  printf("--profile is not supported on this platform\n");
+  free(path);
+  return false;
+}
 #else
 #include <dirent.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#endif
 #include <unistd.h>
+#include <signal.h>
+#include <sys/time.h>
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#define _BTR_HAS_BACKTRACE
+#endif
 
 bool _isDirectory(char* path)
 {
@@ -1167,6 +5206,380 @@ int _listFiles(char* path, char** output)
   
   return fileCount;
 }
+
+bool _mapFile(char* path, _MappedFile* out)
+{
+  memset(out, 0, sizeof(_MappedFile));
+  int file = open(path, O_RDONLY);
+  if(file < 0) return false;
+
+  struct stat stats;
+  void* data = MAP_FAILED;
+  if(fstat(file, &stats) == 0 && stats.st_size > 0)
+    data = mmap(0, stats.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+  if(data == MAP_FAILED)
+  {
+    close(file);
+    return false;
+  }
+
+  out->data = (char*)data;
+  out->size = stats.st_size;
+  out->handle = file;
+  return true;
+}
+
+void _unmapFile(_MappedFile* file)
+{
+  if(file->data)
+  {
+    munmap(file->data, file->size);
+    close((int)file->handle);
+  }
+  memset(file, 0, sizeof(_MappedFile));
+}
+
+bool _copyFileRange(FILE* output, _MappedFile* source, long long offset, long long size)
+{
+#ifdef __linux__
+  // Buffered stdio data must reach the descriptor before the kernel appends after it
+  if(fflush(output) != 0) return false;
+  off_t sourceOffset = offset;
+  long long remaining = size;
+  while(remaining > 0)
+  {
+    ssize_t copied = sendfile(fileno(output), (int)source->handle, &sourceOffset, remaining);
+    if(copied <= 0) break;
+    remaining -= copied;
+  }
+  offset += size - remaining;
+  size = remaining;
+#endif
+  return fwrite(source->data + offset, 1, size, output) == (size_t)size;
+}
+
+bool _makeParentDirectories(char* path)
+{
+  char directory[strlen(path) + 1];
+  strcpy(directory, path);
+  for(char* separator = directory + 1; *separator; separator++)
+  {
+    if(*separator != '/') continue;
+    *separator = '\0';
+    if(mkdir(directory, 0755) != 0 && !_isDirectory(directory)) return false;
+    *separator = '/';
+  }
+  return true;
+}
+
+bool _writeCode(void* address, const void* code, int size)
+{
+  uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+  uintptr_t begin = (uintptr_t)address & ~(pageSize - 1);
+  uintptr_t end = (uintptr_t)address + size;
+  if(mprotect((void*)begin, end - begin, PROT_READ | PROT_WRITE | PROT_EXEC) != 0) return false;
+  memcpy(address, code, size);
+  mprotect((void*)begin, end - begin, PROT_READ | PROT_EXEC);
+  __builtin___clear_cache((char*)address, (char*)address + size);
+  return true;
+}
+
+#if defined(__ELF__) && defined(__LP64__)
+// dl_iterate_phdr and its struct are only declared with _GNU_SOURCE by glibc, the start of the struct is the same everywhere
+struct _LoadedObjectInfo
+{
+  uintptr_t base;
+  const char* path;
+  const _ElfProgramHeader* headers;
+  uint16_t headerCount;
+};
+
+int _iterateLoadedObjects(int (*callback)(struct _LoadedObjectInfo* info, size_t size, void* data), void* data) __asm__("dl_iterate_phdr");
+
+typedef struct
+{
+  uintptr_t address;
+  const char* path;
+  uintptr_t base;
+} _LoadedObject;
+
+int _findLoadedObject(struct _LoadedObjectInfo* info, size_t size, void* data)
+{
+  _LoadedObject* object = (_LoadedObject*)data;
+  for(int i = 0; i < info->headerCount; i++)
+  {
+    uintptr_t start = info->base + info->headers[i].p_vaddr;
+    // 1 is a loadable segment
+    if(info->headers[i].p_type == 1 && object->address >= start && object->address < start + info->headers[i].p_memsz)
+    {
+      object->path = info->path;
+      object->base = info->base;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Reads the size of a loaded function from the symbols of the file it was loaded from, -1 when it is not found
+long long _functionSize(void* address)
+{
+  _LoadedObject object = {(uintptr_t)address, 0, 0};
+  if(!_iterateLoadedObjects(_findLoadedObject, &object)) return -1;
+  // The executable itself has no name
+  char* path = (char*)(object.path && *object.path ? object.path : "/proc/self/exe");
+  _MappedFile file;
+  if(!_mapFile(path, &file)) return -1;
+  long long size = _objectFileFunctionSize(file.data, file.size, (uintptr_t)address - object.base);
+  _unmapFile(&file);
+  return size;
+}
+#else
+long long _functionSize(void* address)
+{
+  return -1;
+}
+#endif
+
+typedef struct
+{
+  int next;
+  int jobCount;
+  void (*job)(void* data, int index);
+  void* data;
+} _ParallelJobs;
+
+void* _parallelWorker(void* parameter)
+{
+  _ParallelJobs* jobs = (_ParallelJobs*)parameter;
+  for(int index; (index = __sync_fetch_and_add(&jobs->next, 1)) < jobs->jobCount;)
+    jobs->job(jobs->data, index);
+  return 0;
+}
+
+unsigned long long _monotonicTime()
+{
+  struct timespec now;
+  _clockGettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec*1000000000ULL + now.tv_nsec;
+}
+
+unsigned long long _currentThreadId()
+{
+#ifdef __linux__
+  return syscall(SYS_gettid);
+#else
+  return (unsigned long long)(uintptr_t)pthread_self();
+#endif
+}
+
+void _runInParallel(int jobCount, void (*job)(void* data, int index), void* data)
+{
+  long processors = sysconf(_SC_NPROCESSORS_ONLN);
+  int threadCount = processors < jobCount ? (int)processors : jobCount;
+  _ParallelJobs jobs = {0, jobCount, job, data};
+  pthread_t threads[threadCount > 1 ? threadCount : 1];
+  int started = 0;
+  for(int i = 1; i < threadCount; i++)
+    if(pthread_create(&threads[started], 0, _parallelWorker, &jobs) == 0) started++;
+  _parallelWorker(&jobs);
+  for(int i = 0; i < started; i++)
+    pthread_join(threads[i], 0);
+}
+
+typedef struct
+{
+  void (*job)(void* data, int index);
+  void* data;
+  int index;
+  bool started;
+  pthread_t handle;
+} _Thread;
+
+void* _threadMain(void* parameter)
+{
+  _Thread* thread = (_Thread*)parameter;
+  thread->job(thread->data, thread->index);
+  return 0;
+}
+
+// Runs the job on a new thread for each index from 1 to count - 1, index 0 being left for the caller
+// startedCount gets the number of threads running the job, counting the caller
+void* _startThreads(int count, void (*job)(void* data, int index), void* data, int* startedCount)
+{
+  *startedCount = 1;
+  _Thread* threads = (_Thread*)calloc(count, sizeof(_Thread));
+  for(int i = 1; i < count; i++)
+  {
+    threads[i].job = job;
+    threads[i].data = data;
+    threads[i].index = i;
+    threads[i].started = pthread_create(&threads[i].handle, 0, _threadMain, &threads[i]) == 0;
+    if(threads[i].started) (*startedCount)++;
+  }
+  return threads;
+}
+
+void _joinThreads(void* threads, int count)
+{
+  _Thread* started = (_Thread*)threads;
+  for(int i = 1; i < count; i++)
+    if(started[i].started) pthread_join(started[i].handle, 0);
+  free(started);
+}
+
+void _exitThread()
+{
+  pthread_exit(0);
+}
+
+#ifdef _BTR_HAS_BACKTRACE
+#define _PROFILE_MAX_DEPTH 64
+#define _PROFILE_MAX_SAMPLES 32768
+#define _PROFILE_INTERVAL_US 1000
+// Frames of the signal handler and the kernel trampoline on top of every sample
+#define _PROFILE_SKIPPED_FRAMES 2
+
+typedef struct
+{
+  int depth;
+  void* frames[_PROFILE_MAX_DEPTH];
+} _ProfileSample;
+
+_ProfileSample* _profileSamples;
+int _profileSampleCount;
+char* _profilePath;
+
+// Runs on SIGPROF, only touching memory reserved before the timer started
+void _profileSignalHandler(int signum)
+{
+  int index = __sync_fetch_and_add(&_profileSampleCount, 1);
+  if(index < _PROFILE_MAX_SAMPLES)
+    _profileSamples[index].depth = backtrace(_profileSamples[index].frames, _PROFILE_MAX_DEPTH);
+}
+
+// Writes a frame as its function name, or as <module>+<offset> when the symbol is not exported
+void _profileWriteFrame(FILE* file, char* symbol)
+{
+  char* open = strchr(symbol, '(');
+  char* end = open ? strpbrk(open, "+)") : 0;
+  if(open && end && end > open + 1)
+  {
+    fwrite(open + 1, 1, end - open - 1, file);
+    return;
+  }
+  char* module = symbol;
+  for(char* c = symbol; *c && c != open; c++)
+    if(*c == '/') module = c + 1;
+  char* offset = open ? strchr(open, ')') : 0;
+  if(open && offset) fprintf(file, "%.*s%.*s", (int)(open - module), module, (int)(offset - open - 1), open + 1);
+  else fprintf(file, "%.*s", (int)strcspn(module, " "), module);
+}
+
+int _compareProfileSamples(const void* a, const void* b)
+{
+  const _ProfileSample* sampleA = (const _ProfileSample*)a;
+  const _ProfileSample* sampleB = (const _ProfileSample*)b;
+  if(sampleA->depth != sampleB->depth) return sampleA->depth - sampleB->depth;
+  return memcmp(sampleA->frames, sampleB->frames, sampleA->depth*sizeof(void*));
+}
+
+typedef struct
+{
+  char* line;
+  int count;
+} _ProfileStack;
+
+int _compareProfileStacks(const void* a, const void* b)
+{
+  return strcmp(((const _ProfileStack*)a)->line, ((const _ProfileStack*)b)->line);
+}
+
+// Stops sampling and writes the samples as folded stacks, one "root;...;leaf count" line per distinct stack
+void _writeProfile()
+{
+  struct itimerval stop = {{0, 0}, {0, 0}};
+  setitimer(ITIMER_PROF, &stop, 0);
+  signal(SIGPROF, SIG_IGN);
+
+  int count = _profileSampleCount < _PROFILE_MAX_SAMPLES ? _profileSampleCount : _PROFILE_MAX_SAMPLES;
+  for(int i = 0; i < count; i++)
+  {
+    _ProfileSample* sample = &_profileSamples[i];
+    sample->depth = sample->depth > _PROFILE_SKIPPED_FRAMES ? sample->depth - _PROFILE_SKIPPED_FRAMES : 0;
+    memmove(sample->frames, sample->frames + _PROFILE_SKIPPED_FRAMES, sample->depth*sizeof(void*));
+  }
+  qsort(_profileSamples, count, sizeof(_ProfileSample), _compareProfileSamples);
+
+  // Stacks sampled at different instructions of the same functions fold into a single line
+  _ProfileStack* stacks = (_ProfileStack*)malloc((count ? count : 1)*sizeof(_ProfileStack));
+  int stackCount = 0;
+  for(int i = 0, next; i < count; i = next)
+  {
+    for(next = i + 1; next < count && _compareProfileSamples(&_profileSamples[i], &_profileSamples[next]) == 0; next++);
+    _ProfileSample* sample = &_profileSamples[i];
+    char** symbols = sample->depth ? backtrace_symbols(sample->frames, sample->depth) : 0;
+    if(!symbols) continue;
+    size_t size;
+    FILE* line = open_memstream(&stacks[stackCount].line, &size);
+    for(int frame = sample->depth - 1; frame >= 0; frame--)
+    {
+      _profileWriteFrame(line, symbols[frame]);
+      if(frame) fputc(';', line);
+    }
+    fclose(line);
+    stacks[stackCount++].count = next - i;
+    free(symbols);
+  }
+  qsort(stacks, stackCount, sizeof(_ProfileStack), _compareProfileStacks);
+
+  FILE* file = _makeParentDirectories(_profilePath) ? fopen(_profilePath, "w") : 0;
+  if(!file) printf("Could not write profile %s\n", _profilePath);
+  for(int i = 0, next; i < stackCount; i = next)
+  {
+    int samples = stacks[i].count;
+    for(next = i + 1; next < stackCount && strcmp(stacks[i].line, stacks[next].line) == 0; next++)
+      samples += stacks[next].count;
+    if(file) fprintf(file, "%s %i\n", stacks[i].line, samples);
+  }
+  for(int i = 0; i < stackCount; i++)
+    free(stacks[i].line);
+  free(stacks);
+  if(file) fclose(file);
+}
+
+// Samples the process on CPU time with SIGPROF, which the failure handlers leave alone, until it exits
+bool _startProfiler(char* path)
+{
+  _profileSamples = (_ProfileSample*)calloc(_PROFILE_MAX_SAMPLES, sizeof(_ProfileSample));
+  if(!_profileSamples)
+  {
+    free(path);
+    return false;
+  }
+  _profilePath = path;
+  // The first backtrace loads the unwinder, which must not happen inside the handler
+  void* warmup[1];
+  backtrace(warmup, 1);
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = _profileSignalHandler;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGPROF, &action, 0);
+  atexit(_writeProfile);
+
+  struct itimerval interval = {{0, _PROFILE_INTERVAL_US}, {0, _PROFILE_INTERVAL_US}};
+  return setitimer(ITIMER_PROF, &interval, 0) == 0;
+}
+#else
+bool _startProfiler(char* path)
+{
+  printf("--profile is not supported on this platform\n");
+  free(path);
+  return false;
+}
+#endif
 #endif
 // Ends test.h
 #ifdef __cplusplus